@@ -5,28 +5,30 @@ cbuffer externalData : register(b0)
     int blurRadius;
     float pixelWidth;
     float pixelHeight;
+    int vertical; //one direction per pass, horizontal then vertical
 }
 
 Texture2D Pixels : register(t0);
 SamplerState ClampSampler : register(s0);
 float4 main(VertexToPixelPP input) : SV_TARGET
 {
-    // Track the total color and number of samples
-    float4 total = 0;
-    int sampleCount = 0;
-// Loop through the "box"
-    for (int x = -blurRadius; x <= blurRadius; x++)
+    //one pixel along this pass
+    float2 step = vertical ? float2(0, pixelHeight) : float2(pixelWidth, 0);
+
+    //center pixel
+    float4 total = Pixels.Sample(ClampSampler, input.uv);
+
+    //sampling halfway between two pixels averages them for free,
+    //so each sample counts for two (the last one is alone for odd radii)
+    //(same taps as BoxBlur::LinearTaps)
+    for (int i = 1; i <= blurRadius; i += 2)
     {
-        for (int y = -blurRadius; y <= blurRadius; y++)
-        {
-            //calculate the uv for this sample
-            float2 uv = input.uv;
-            uv += float2(x * pixelWidth, y * pixelHeight);
-            //add this color to the running total
-            total += Pixels.Sample(ClampSampler, uv);
-            sampleCount++;
-        }
+        float offset = i < blurRadius ? i + 0.5f : i;
+        float weight = i < blurRadius ? 2.0f : 1.0f;
+        total += Pixels.Sample(ClampSampler, input.uv + step * offset) * weight;
+        total += Pixels.Sample(ClampSampler, input.uv - step * offset) * weight;
     }
+
     //return the average
-    return total / sampleCount;
-}
\ No newline at end of file
+    return total / (2 * blurRadius + 1);
+}
@@ -0,0 +1,269 @@
+#include "BoxBlur.h"
+#include "JobSystem.h"
+#include "TextureCooker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <immintrin.h>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Columns each job handles in vertical passes, so every job
+	// still walks memory a row at a time
+	constexpr unsigned int ColumnBand = 64;
+
+	int Clamp(int value, int count)
+	{
+		return std::clamp(value, 0, count - 1);
+	}
+
+	__m128 Load(const FloatImage& image, int x, int y)
+	{
+		return _mm_loadu_ps(&image.Pixels[((size_t)Clamp(y, image.Height) * image.Width + Clamp(x, image.Width)) * 4]);
+	}
+
+	// What a clamping bilinear sampler returns part way between
+	// two texels along one axis (from texel "at", "fraction" of
+	// the way to the next one)
+	__m128 Linear(const FloatImage& image, int x, int y, bool vertical, float position)
+	{
+		int whole = (int)floorf(position);
+		float fraction = position - whole;
+		__m128 a = vertical ? Load(image, x, y + whole) : Load(image, x + whole, y);
+		if (fraction == 0.0f)
+			return a;
+		__m128 b = vertical ? Load(image, x, y + whole + 1) : Load(image, x + whole + 1, y);
+		return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(fraction)));
+	}
+
+	void SeparablePass(const FloatImage& source, const std::vector<BlurTap>& taps, float scale, bool vertical, FloatImage& blurred)
+	{
+		JobSystem::ParallelFor(source.Height, [&](unsigned int begin, unsigned int end)
+			{
+				for (unsigned int y = begin; y < end; y++)
+				{
+					for (unsigned int x = 0; x < source.Width; x++)
+					{
+						__m128 total = _mm_setzero_ps();
+						for (const BlurTap& tap : taps)
+							total = _mm_add_ps(total, _mm_mul_ps(Linear(source, x, y, vertical, tap.Offset), _mm_set1_ps(tap.Weight)));
+						_mm_storeu_ps(&blurred.Pixels[((size_t)y * source.Width + x) * 4], _mm_mul_ps(total, _mm_set1_ps(scale)));
+					}
+				}
+			});
+	}
+
+	// Each row keeps a running total of the 2r + 1 pixels around x
+	void SlidingRows(const FloatImage& source, int radius, FloatImage& blurred)
+	{
+		int width = (int)source.Width;
+		__m128 scale = _mm_set1_ps(1.0f / (2 * radius + 1));
+		JobSystem::ParallelFor(source.Height, [&](unsigned int begin, unsigned int end)
+			{
+				std::vector<float> row((size_t)width * 4);
+				for (unsigned int y = begin; y < end; y++)
+				{
+					// Copied first so the pass can run in place
+					std::copy_n(&source.Pixels[(size_t)y * width * 4], row.size(), row.begin());
+					auto texel = [&](int x) { return _mm_loadu_ps(&row[(size_t)Clamp(x, width) * 4]); };
+
+					__m128 sum = _mm_setzero_ps();
+					for (int x = -radius; x <= radius; x++)
+						sum = _mm_add_ps(sum, texel(x));
+					float* out = &blurred.Pixels[(size_t)y * width * 4];
+					for (int x = 0; x < width; x++)
+					{
+						_mm_storeu_ps(out + x * 4, _mm_mul_ps(sum, scale));
+						sum = _mm_add_ps(sum, _mm_sub_ps(texel(x + radius + 1), texel(x - radius)));
+					}
+				}
+			});
+	}
+
+	// The same down columns, a band at a time, with a running total per column
+	void SlidingColumns(const FloatImage& source, int radius, FloatImage& blurred)
+	{
+		int width = (int)source.Width;
+		int height = (int)source.Height;
+		__m128 scale = _mm_set1_ps(1.0f / (2 * radius + 1));
+		unsigned int bands = (source.Width + ColumnBand - 1) / ColumnBand;
+		JobSystem::ParallelFor(bands, [&](unsigned int begin, unsigned int end)
+			{
+				for (unsigned int band = begin; band < end; band++)
+				{
+					int first = band * ColumnBand;
+					int count = std::min((int)ColumnBand, width - first);
+
+					// Rows leaving the window are overwritten by then, so keep the band's input
+					std::vector<float> input((size_t)height * count * 4);
+					for (int y = 0; y < height; y++)
+						std::copy_n(&source.Pixels[((size_t)y * width + first) * 4], count * 4, &input[(size_t)y * count * 4]);
+					auto saved = [&](int x, int y) { return _mm_loadu_ps(&input[((size_t)Clamp(y, height) * count + x) * 4]); };
+
+					std::vector<float> sums((size_t)count * 4, 0.0f);
+					for (int x = 0; x < count; x++)
+					{
+						__m128 sum = _mm_setzero_ps();
+						for (int y = -radius; y <= radius; y++)
+							sum = _mm_add_ps(sum, saved(x, y));
+						_mm_storeu_ps(&sums[x * 4], sum);
+					}
+
+					for (int y = 0; y < height; y++)
+					{
+						float* out = &blurred.Pixels[((size_t)y * width + first) * 4];
+						for (int x = 0; x < count; x++)
+						{
+							__m128 sum = _mm_loadu_ps(&sums[x * 4]);
+							_mm_storeu_ps(out + x * 4, _mm_mul_ps(sum, scale));
+							_mm_storeu_ps(&sums[x * 4], _mm_add_ps(sum, _mm_sub_ps(saved(x, y + radius + 1), saved(x, y - radius))));
+						}
+					}
+				}
+			});
+	}
+}
+
+void FloatImage::Resize(unsigned int width, unsigned int height)
+{
+	Width = width;
+	Height = height;
+	Pixels.resize((size_t)width * height * 4);
+}
+
+void BoxBlur::Reference(const FloatImage& source, int radius, FloatImage& blurred)
+{
+	FloatImage result;
+	result.Resize(source.Width, source.Height);
+	// Doubles so big boxes don't pile up rounding error
+	double scale = 1.0 / ((2 * radius + 1) * (2 * radius + 1));
+	for (int y = 0; y < (int)source.Height; y++)
+	{
+		for (int x = 0; x < (int)source.Width; x++)
+		{
+			double total[4] = {};
+			for (int dx = -radius; dx <= radius; dx++)
+			{
+				for (int dy = -radius; dy <= radius; dy++)
+				{
+					const float* texel = &source.Pixels[((size_t)Clamp(y + dy, source.Height) * source.Width + Clamp(x + dx, source.Width)) * 4];
+					for (int c = 0; c < 4; c++)
+						total[c] += texel[c];
+				}
+			}
+			for (int c = 0; c < 4; c++)
+				result.Pixels[((size_t)y * source.Width + x) * 4 + c] = (float)(total[c] * scale);
+		}
+	}
+	blurred = std::move(result);
+}
+
+void BoxBlur::Separable(const FloatImage& source, int radius, FloatImage& blurred)
+{
+	std::vector<BlurTap> taps = LinearTaps(radius);
+	float scale = 1.0f / (2 * radius + 1);
+
+	// Horizontal into a temporary, then vertical into the result
+	FloatImage horizontal;
+	horizontal.Resize(source.Width, source.Height);
+	SeparablePass(source, taps, scale, false, horizontal);
+	blurred.Resize(source.Width, source.Height);
+	SeparablePass(horizontal, taps, scale, true, blurred);
+}
+
+void BoxBlur::SlidingWindow(const FloatImage& source, int radius, FloatImage& blurred)
+{
+	blurred.Resize(source.Width, source.Height);
+	SlidingRows(source, radius, blurred);
+	SlidingColumns(blurred, radius, blurred);
+}
+
+void BoxBlur::SummedArea(const FloatImage& source, int radius, FloatImage& blurred)
+{
+	// The table covers the image plus r repeated edge pixels on each
+	// side, so boxes never need clipping.  Doubles keep the big sums
+	// exact enough to subtract.
+	int width = (int)source.Width + 2 * radius;
+	int height = (int)source.Height + 2 * radius;
+	size_t pitch = (size_t)(width + 1) * 4;
+	std::vector<double> table(pitch * (height + 1), 0.0);
+
+	// Rows first, then add each row to the one below it (bands of columns at a time)
+	JobSystem::ParallelFor(height, [&](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int y = begin; y < end; y++)
+			{
+				double* row = &table[(y + 1) * pitch];
+				const float* input = &source.Pixels[(size_t)Clamp((int)y - radius, source.Height) * source.Width * 4];
+				for (int x = 0; x < width; x++)
+				{
+					const float* texel = input + Clamp(x - radius, source.Width) * 4;
+					for (int c = 0; c < 4; c++)
+						row[(x + 1) * 4 + c] = row[x * 4 + c] + texel[c];
+				}
+			}
+		});
+	unsigned int bands = (unsigned int)(pitch + ColumnBand - 1) / ColumnBand;
+	JobSystem::ParallelFor(bands, [&](unsigned int begin, unsigned int end)
+		{
+			size_t first = (size_t)begin * ColumnBand;
+			size_t last = std::min((size_t)end * ColumnBand, pitch);
+			for (int y = 1; y <= height; y++)
+				for (size_t i = first; i < last; i++)
+					table[y * pitch + i] += table[(y - 1) * pitch + i];
+		});
+
+	FloatImage result;
+	result.Resize(source.Width, source.Height);
+	double scale = 1.0 / ((2 * radius + 1) * (2 * radius + 1));
+	int size = 2 * radius + 1;
+	JobSystem::ParallelFor(source.Height, [&](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int y = begin; y < end; y++)
+			{
+				// Pixel (x, y) is at (x + r, y + r) in the table, so its box spans [x, x + 2r]
+				const double* top = &table[y * pitch];
+				const double* bottom = &table[(y + size) * pitch];
+				float* out = &result.Pixels[(size_t)y * source.Width * 4];
+				for (unsigned int x = 0; x < source.Width; x++)
+					for (int c = 0; c < 4; c++)
+						out[x * 4 + c] = (float)((bottom[(x + size) * 4 + c] - bottom[x * 4 + c] - top[(x + size) * 4 + c] + top[x * 4 + c]) * scale);
+			}
+		});
+	blurred = std::move(result);
+}
+
+std::vector<BlurTap> BoxBlur::LinearTaps(int radius)
+{
+	std::vector<BlurTap> taps;
+	taps.push_back({ 0.0f, 1.0f });
+	for (int i = 1; i <= radius; i += 2)
+	{
+		// Halfway between texels i and i + 1 reads both equally
+		BlurTap tap = i < radius ? BlurTap{ i + 0.5f, 2.0f } : BlurTap{ (float)i, 1.0f };
+		taps.push_back(tap);
+		taps.push_back({ -tap.Offset, tap.Weight });
+	}
+	return taps;
+}
+
+void BoxBlur::FromCpuImage(const CpuImage& image, FloatImage& floats)
+{
+	CpuImage rgba;
+	TextureCooker::ToRGBA8(image, rgba);
+	floats.Resize(rgba.Width, rgba.Height);
+	for (size_t i = 0; i < floats.Pixels.size(); i++)
+		floats.Pixels[i] = rgba.Pixels[i] / 255.0f;
+}
+
+float BoxBlur::MaxDifference(const FloatImage& a, const FloatImage& b)
+{
+	if (a.Width != b.Width || a.Height != b.Height)
+		return INFINITY;
+	float difference = 0.0f;
+	for (size_t i = 0; i < a.Pixels.size(); i++)
+		difference = std::max(difference, fabsf(a.Pixels[i] - b.Pixels[i]));
+	return difference;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+
+#include "PngDecoder.h"
+
+// --------------------------------------------------------
+// An RGBA float image, rows tightly packed top to bottom
+// --------------------------------------------------------
+struct FloatImage
+{
+	unsigned int Width = 0;
+	unsigned int Height = 0;
+	std::vector<float> Pixels;	// Width * Height * 4
+
+	void Resize(unsigned int width, unsigned int height);
+};
+
+// --------------------------------------------------------
+// One sample of a 1D blur pass: how far from the pixel it
+// is (in pixels, along the pass) and how many texels it
+// stands for.  Offsets halfway between two texels read
+// both at once through bilinear filtering.
+// --------------------------------------------------------
+struct BlurTap
+{
+	float Offset = 0.0f;
+	float Weight = 0.0f;
+};
+
+// --------------------------------------------------------
+// CPU versions of the post process box blur, which every
+// GPU version has to match.  A radius r averages the
+// (2r + 1)^2 pixels around each one, with pixels past the
+// edges repeating the edge (like a clamp sampler).
+//
+// - Reference: every pixel of the box (what BlurPPPS used
+//   to do), cost grows with r^2
+// - Separable: a horizontal then a vertical pass with the
+//   taps from LinearTaps(), about r + 1 samples per pass
+//   (BlurPPPS)
+// - SlidingWindow: horizontal then vertical running sums,
+//   the same cost at any radius (BoxBlurCS)
+// - SummedArea: four reads of a summed area table per
+//   pixel, also the same cost at any radius
+//
+// Everything but Reference and LinearTaps needs the job
+// system.  Images can be blurred in place.
+// --------------------------------------------------------
+namespace BoxBlur
+{
+	void Reference(const FloatImage& source, int radius, FloatImage& blurred);
+	void Separable(const FloatImage& source, int radius, FloatImage& blurred);
+	void SlidingWindow(const FloatImage& source, int radius, FloatImage& blurred);
+	void SummedArea(const FloatImage& source, int radius, FloatImage& blurred);
+
+	// Center first, then pairs of texels on each side (and a single
+	// texel for the last one when r is odd).  Weights add up to 2r + 1.
+	std::vector<BlurTap> LinearTaps(int radius);
+
+	// 8 bit color to 0-1 floats (no gamma), and for comparing results
+	void FromCpuImage(const CpuImage& image, FloatImage& floats);
+	float MaxDifference(const FloatImage& a, const FloatImage& b);
+}
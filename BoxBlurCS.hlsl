@@ -0,0 +1,45 @@
+//Box blur whose cost doesn't depend on the radius: each thread
+//walks one row (or column) keeping a running total of the
+//2r + 1 pixels around it, adding the one entering the window
+//and subtracting the one leaving it (see BoxBlur::SlidingWindow)
+
+cbuffer externalData : register(b0)
+{
+    int blurRadius;
+    int vertical; //rows first, then columns
+    int width;
+    int height;
+}
+
+Texture2D Pixels : register(t0);
+RWTexture2D<float4> Blurred : register(u0);
+
+//pixels past the edges repeat the edge, like a clamp sampler
+float4 Pixel(int line, int along)
+{
+    int length = vertical ? height : width;
+    along = clamp(along, 0, length - 1);
+    return Pixels.Load(int3(vertical ? int2(line, along) : int2(along, line), 0));
+}
+
+[numthreads(64, 1, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+    int line = id.x;
+    int lines = vertical ? width : height;
+    int length = vertical ? height : width;
+    if (line >= lines)
+        return;
+
+    //window around the first pixel
+    float4 total = 0;
+    for (int i = -blurRadius; i <= blurRadius; i++)
+        total += Pixel(line, i);
+
+    float scale = 1.0f / (2 * blurRadius + 1);
+    for (int along = 0; along < length; along++)
+    {
+        Blurred[vertical ? int2(line, along) : int2(along, line)] = total * scale;
+        total += Pixel(line, along + blurRadius + 1) - Pixel(line, along - blurRadius);
+    }
+}
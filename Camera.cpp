@@ -60,6 +60,40 @@ float Camera::GetFOV()
 	return fovAngle;
 }
 
+float Camera::GetNearClip()
+{
+	return nearClipDist;
+}
+
+float Camera::GetFarClip()
+{
+	return farClipDist;
+}
+
+bool Camera::IsPerspective()
+{
+	return isPerspective;
+}
+
+void Camera::GetFrustumPlanes(DirectX::XMVECTOR planes[6])
+{
+	//Gribb/Hartmann: the planes are sums and differences of the
+	//columns of view * projection (works for both projection types)
+	XMMATRIX cols = XMMatrixTranspose(XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection)));
+
+	//negated so they face outward
+	planes[0] = -(cols.r[3] + cols.r[0]); //left
+	planes[1] = -(cols.r[3] - cols.r[0]); //right
+	planes[2] = -(cols.r[3] + cols.r[1]); //bottom
+	planes[3] = -(cols.r[3] - cols.r[1]); //top
+	planes[4] = -cols.r[2];               //near (D3D depth starts at 0)
+	planes[5] = -(cols.r[3] - cols.r[2]); //far
+
+	for (int i = 0; i < 6; i++) {
+		planes[i] = XMPlaneNormalize(planes[i]);
+	}
+}
+
 void Camera::UpdateViewMatrix()
 {
 	//needs to be done so vars have an address
@@ -36,6 +36,12 @@ public:
 	DirectX::XMFLOAT4X4 GetProjection();
 	Transform GetTransform();
 	float GetFOV();
+	float GetNearClip();
+	float GetFarClip();
+	bool IsPerspective();
+	//Fills six world space planes (left, right, bottom, top, near, far)
+	//facing out of the view volume, ready for DirectX::BoundingBox::ContainedBy()
+	void GetFrustumPlanes(DirectX::XMVECTOR planes[6]);
 	//TODO: Add getters and setters for most camera variables
 
 	//Matrix Operations
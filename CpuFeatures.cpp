@@ -0,0 +1,40 @@
+#include "CpuFeatures.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	bool DetectAVX2()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+
+		// AVX + FMA, and the OS saves the YMM registers
+		__cpuid(info, 1);
+		bool fma = (info[2] & (1 << 12)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		if (!fma || !osxsave || !avx || (_xgetbv(0) & 6) != 6)
+			return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		// GCC and Clang check the OS saves the YMM registers too
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+	}
+}
+
+bool CpuFeatures::HasAVX2()
+{
+	static const bool supported = DetectAVX2();
+	return supported;
+}
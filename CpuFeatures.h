@@ -0,0 +1,23 @@
+#pragma once
+
+// --------------------------------------------------------
+// Instruction sets this machine can run, checked once with
+// CPUID so SIMD code paths can be picked at runtime
+// --------------------------------------------------------
+namespace CpuFeatures
+{
+	// AVX2 + FMA, and the OS saves the YMM registers
+	bool HasAVX2();
+}
+
+// GCC and Clang only allow intrinsics for the instruction sets
+// a file is built for, so functions using AVX2 (and FMA) opt in
+// one at a time (MSVC allows them anywhere).  Only call them once
+// HasAVX2() says so.
+#if defined(__GNUC__) || defined(__clang__)
+#define CPU_TARGET_AVX2 __attribute__((target("avx2")))
+#define CPU_TARGET_AVX2_FMA __attribute__((target("avx2,fma")))
+#else
+#define CPU_TARGET_AVX2
+#define CPU_TARGET_AVX2_FMA
+#endif
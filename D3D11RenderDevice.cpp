@@ -0,0 +1,186 @@
+#include "D3D11RenderDevice.h"
+
+#include <cstring>
+
+D3D11RenderDevice::D3D11RenderDevice(
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	Microsoft::WRL::ComPtr<IDXGISwapChain> swapChain,
+	bool allowTearing) :
+	context(context),
+	swapChain(swapChain),
+	allowTearing(allowTearing)
+{
+}
+
+void D3D11RenderDevice::SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+	stats.StateBinds++;
+	context->IASetPrimitiveTopology(topology);
+}
+
+void D3D11RenderDevice::SetVertexBuffer(ID3D11Buffer* buffer, unsigned int stride)
+{
+	stats.ResourceBinds++;
+	UINT offset = 0;
+	context->IASetVertexBuffers(0, 1, &buffer, &stride, &offset);
+}
+
+void D3D11RenderDevice::SetIndexBuffer(ID3D11Buffer* buffer)
+{
+	stats.ResourceBinds++;
+	context->IASetIndexBuffer(buffer, DXGI_FORMAT_R32_UINT, 0);
+}
+
+void D3D11RenderDevice::SetBlendState(ID3D11BlendState* state)
+{
+	stats.StateBinds++;
+	context->OMSetBlendState(state, 0, 0xffffffff);
+}
+
+void D3D11RenderDevice::SetDepthStencilState(ID3D11DepthStencilState* state)
+{
+	stats.StateBinds++;
+	context->OMSetDepthStencilState(state, 0);
+}
+
+void D3D11RenderDevice::SetRasterizerState(ID3D11RasterizerState* state)
+{
+	stats.StateBinds++;
+	context->RSSetState(state);
+}
+
+void D3D11RenderDevice::SetViewport(float width, float height)
+{
+	stats.StateBinds++;
+	D3D11_VIEWPORT viewport = {};
+	viewport.Width = width;
+	viewport.Height = height;
+	viewport.MaxDepth = 1.0f;
+	context->RSSetViewports(1, &viewport);
+}
+
+void D3D11RenderDevice::SetRenderTargets(unsigned int count, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv)
+{
+	stats.ResourceBinds++;
+	context->OMSetRenderTargets(count, rtvs, dsv);
+}
+
+void D3D11RenderDevice::ClearRenderTarget(ID3D11RenderTargetView* rtv, const float color[4])
+{
+	stats.Clears++;
+	context->ClearRenderTargetView(rtv, color);
+}
+
+void D3D11RenderDevice::ClearDepth(ID3D11DepthStencilView* dsv, float depth)
+{
+	stats.Clears++;
+	context->ClearDepthStencilView(dsv, D3D11_CLEAR_DEPTH, depth, 0);
+}
+
+void D3D11RenderDevice::UnbindPixelShader()
+{
+	stats.StateBinds++;
+	context->PSSetShader(0, 0, 0);
+}
+
+void D3D11RenderDevice::UnbindPixelShaderResources(unsigned int count)
+{
+	stats.ResourceBinds++;
+	ID3D11ShaderResourceView* nullSRVs[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT] = {};
+	if (count > D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT)
+		count = D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT;
+	context->PSSetShaderResources(0, count, nullSRVs);
+}
+
+void D3D11RenderDevice::UnbindComputeShaderResources(unsigned int count)
+{
+	stats.ResourceBinds++;
+	ID3D11ShaderResourceView* nullSRVs[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT] = {};
+	if (count > D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT)
+		count = D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT;
+	context->CSSetShaderResources(0, count, nullSRVs);
+}
+
+void D3D11RenderDevice::UnbindComputeUnorderedAccessViews(unsigned int count)
+{
+	stats.ResourceBinds++;
+	ID3D11UnorderedAccessView* nullUAVs[D3D11_PS_CS_UAV_REGISTER_COUNT] = {};
+	if (count > D3D11_PS_CS_UAV_REGISTER_COUNT)
+		count = D3D11_PS_CS_UAV_REGISTER_COUNT;
+	context->CSSetUnorderedAccessViews(0, count, nullUAVs, 0);
+}
+
+void D3D11RenderDevice::UploadDynamicBuffer(ID3D11Buffer* buffer, const void* dataA, size_t bytesA, const void* dataB, size_t bytesB)
+{
+	stats.BytesUploaded += bytesA + bytesB;
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return;
+
+	if (bytesA > 0) memcpy(mapped.pData, dataA, bytesA);
+	if (bytesB > 0) memcpy((char*)mapped.pData + bytesA, dataB, bytesB);
+
+	context->Unmap(buffer, 0);
+}
+
+void D3D11RenderDevice::UpdateBuffer(ID3D11Buffer* buffer, unsigned int offset, const void* data, size_t bytes)
+{
+	if (bytes == 0)
+		return;
+	stats.BytesUploaded += bytes;
+
+	// Buffers only use the x axis of the box (in bytes)
+	D3D11_BOX box = {};
+	box.left = offset;
+	box.right = offset + (UINT)bytes;
+	box.bottom = 1;
+	box.back = 1;
+	context->UpdateSubresource(buffer, 0, &box, data, 0, 0);
+}
+
+void D3D11RenderDevice::UpdateSubresource(ID3D11Resource* resource, unsigned int subresource, const void* data, unsigned int rowPitch, size_t bytes)
+{
+	stats.BytesUploaded += bytes;
+	context->UpdateSubresource(resource, subresource, 0, data, rowPitch, (UINT)bytes);
+}
+
+void D3D11RenderDevice::CopySubresourceRegion(ID3D11Resource* dest, unsigned int destSubresource, ID3D11Resource* source, unsigned int sourceSubresource)
+{
+	stats.Copies++;
+	context->CopySubresourceRegion(dest, destSubresource, 0, 0, 0, source, sourceSubresource, 0);
+}
+
+void D3D11RenderDevice::GenerateMips(ID3D11ShaderResourceView* srv)
+{
+	stats.Copies++;
+	context->GenerateMips(srv);
+}
+
+void D3D11RenderDevice::Draw(unsigned int vertexCount)
+{
+	stats.DrawCalls++;
+	stats.IndicesSubmitted += vertexCount;
+	context->Draw(vertexCount, 0);
+}
+
+void D3D11RenderDevice::DrawIndexed(unsigned int indexCount)
+{
+	stats.DrawCalls++;
+	stats.IndicesSubmitted += indexCount;
+	context->DrawIndexed(indexCount, 0, 0);
+}
+
+void D3D11RenderDevice::Dispatch(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ)
+{
+	stats.Dispatches++;
+	context->Dispatch(groupsX, groupsY, groupsZ);
+}
+
+void D3D11RenderDevice::Present(bool vsync)
+{
+	stats.Presents++;
+	swapChain->Present(
+		vsync ? 1 : 0,
+		vsync || !allowTearing ? 0 : DXGI_PRESENT_ALLOW_TEARING);
+}
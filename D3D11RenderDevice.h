@@ -0,0 +1,51 @@
+#pragma once
+
+#include <wrl/client.h>
+
+#include "RenderDevice.h"
+
+// --------------------------------------------------------
+// Forwards every call to a real D3D11 context (and counts
+// it, so the stats match what the recording device sees)
+// --------------------------------------------------------
+class D3D11RenderDevice : public IRenderDevice
+{
+public:
+	D3D11RenderDevice(
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		Microsoft::WRL::ComPtr<IDXGISwapChain> swapChain,
+		bool allowTearing);
+
+	void SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) override;
+	void SetVertexBuffer(ID3D11Buffer* buffer, unsigned int stride) override;
+	void SetIndexBuffer(ID3D11Buffer* buffer) override;
+
+	void SetBlendState(ID3D11BlendState* state) override;
+	void SetDepthStencilState(ID3D11DepthStencilState* state) override;
+	void SetRasterizerState(ID3D11RasterizerState* state) override;
+	void SetViewport(float width, float height) override;
+
+	void SetRenderTargets(unsigned int count, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv) override;
+	void ClearRenderTarget(ID3D11RenderTargetView* rtv, const float color[4]) override;
+	void ClearDepth(ID3D11DepthStencilView* dsv, float depth) override;
+	void UnbindPixelShader() override;
+	void UnbindPixelShaderResources(unsigned int count) override;
+	void UnbindComputeShaderResources(unsigned int count) override;
+	void UnbindComputeUnorderedAccessViews(unsigned int count) override;
+
+	void UploadDynamicBuffer(ID3D11Buffer* buffer, const void* dataA, size_t bytesA, const void* dataB, size_t bytesB) override;
+	void UpdateBuffer(ID3D11Buffer* buffer, unsigned int offset, const void* data, size_t bytes) override;
+	void UpdateSubresource(ID3D11Resource* resource, unsigned int subresource, const void* data, unsigned int rowPitch, size_t bytes) override;
+	void CopySubresourceRegion(ID3D11Resource* dest, unsigned int destSubresource, ID3D11Resource* source, unsigned int sourceSubresource) override;
+	void GenerateMips(ID3D11ShaderResourceView* srv) override;
+
+	void Draw(unsigned int vertexCount) override;
+	void DrawIndexed(unsigned int indexCount) override;
+	void Dispatch(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ) override;
+	void Present(bool vsync) override;
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	Microsoft::WRL::ComPtr<IDXGISwapChain> swapChain;
+	bool allowTearing;
+};
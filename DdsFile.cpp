@@ -0,0 +1,209 @@
+#include "DdsFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	constexpr uint32_t Magic = 0x20534444;		// "DDS "
+	constexpr uint32_t FourCCDX10 = 0x30315844;	// "DX10"
+
+	// Header flags (only the ones that get written)
+	constexpr uint32_t FlagCaps = 0x1;
+	constexpr uint32_t FlagHeight = 0x2;
+	constexpr uint32_t FlagWidth = 0x4;
+	constexpr uint32_t FlagPitch = 0x8;
+	constexpr uint32_t FlagPixelFormat = 0x1000;
+	constexpr uint32_t FlagMipCount = 0x20000;
+	constexpr uint32_t FlagLinearSize = 0x80000;
+	constexpr uint32_t PixelFormatFourCC = 0x4;
+	constexpr uint32_t CapsTexture = 0x1000;
+	constexpr uint32_t CapsComplex = 0x8;
+	constexpr uint32_t CapsMipMap = 0x400000;
+	constexpr uint32_t Dimension2D = 3;
+
+	struct PixelFormat
+	{
+		uint32_t Size;
+		uint32_t Flags;
+		uint32_t FourCC;
+		uint32_t RGBBitCount;
+		uint32_t RBitMask;
+		uint32_t GBitMask;
+		uint32_t BBitMask;
+		uint32_t ABitMask;
+	};
+
+	struct Header
+	{
+		uint32_t Size;
+		uint32_t Flags;
+		uint32_t Height;
+		uint32_t Width;
+		uint32_t PitchOrLinearSize;
+		uint32_t Depth;
+		uint32_t MipMapCount;
+		uint32_t Reserved1[11];
+		PixelFormat Format;
+		uint32_t Caps;
+		uint32_t Caps2;
+		uint32_t Caps3;
+		uint32_t Caps4;
+		uint32_t Reserved2;
+	};
+
+	struct HeaderDX10
+	{
+		uint32_t DxgiFormat;
+		uint32_t ResourceDimension;
+		uint32_t MiscFlag;
+		uint32_t ArraySize;
+		uint32_t MiscFlags2;
+	};
+
+	static_assert(sizeof(Header) == 124, "DDS header must be 124 bytes");
+	static_assert(4 + sizeof(Header) + sizeof(HeaderDX10) == DdsFile::HeaderSize, "DDS headers must be 148 bytes");
+
+	bool Fail(std::string* error, const char* message)
+	{
+		if (error)
+			*error = message;
+		return false;
+	}
+}
+
+unsigned int DdsImage::MipWidth(unsigned int mip) const
+{
+	return std::max(Width >> mip, 1u);
+}
+
+unsigned int DdsImage::MipHeight(unsigned int mip) const
+{
+	return std::max(Height >> mip, 1u);
+}
+
+size_t DdsImage::MipRowPitch(unsigned int mip) const
+{
+	if (DdsFile::IsBlockCompressed(Format))
+		return (size_t)((MipWidth(mip) + 3) / 4) * DdsFile::BytesPerBlock(Format);
+	return (size_t)MipWidth(mip) * DdsFile::BytesPerBlock(Format);
+}
+
+size_t DdsImage::MipSize(unsigned int mip) const
+{
+	unsigned int rows = DdsFile::IsBlockCompressed(Format) ? (MipHeight(mip) + 3) / 4 : MipHeight(mip);
+	return MipRowPitch(mip) * rows;
+}
+
+size_t DdsImage::MipOffset(unsigned int mip) const
+{
+	size_t offset = 0;
+	for (unsigned int i = 0; i < mip; i++)
+		offset += MipSize(i);
+	return offset;
+}
+
+bool DdsFile::IsBlockCompressed(DdsFormat format)
+{
+	return format == DdsFormat::BC1 || format == DdsFormat::BC4 || format == DdsFormat::BC5 || format == DdsFormat::BC7;
+}
+
+unsigned int DdsFile::BytesPerBlock(DdsFormat format)
+{
+	switch (format)
+	{
+	case DdsFormat::BC1: return 8;
+	case DdsFormat::BC4: return 8;
+	case DdsFormat::BC5: return 16;
+	case DdsFormat::BC7: return 16;
+	case DdsFormat::RGBA8: return 4;
+	case DdsFormat::RG8: return 2;
+	case DdsFormat::R16: return 2;
+	case DdsFormat::R8: return 1;
+	default: return 0;
+	}
+}
+
+bool DdsFile::Read(const uint8_t* data, size_t size, DdsImage& image, std::string* error)
+{
+	size_t offset = 0;
+	if (!ReadHeader(data, size, image, offset, error))
+		return false;
+
+	size_t dataSize = image.MipOffset(image.MipLevels);
+	if (size - offset < dataSize)
+		return Fail(error, "truncated DDS file");
+
+	image.Data.assign(data + offset, data + offset + dataSize);
+	return true;
+}
+
+bool DdsFile::ReadHeader(const uint8_t* data, size_t size, DdsImage& image, size_t& dataOffset, std::string* error)
+{
+	if (size < 4 + sizeof(Header) || memcmp(data, &Magic, 4) != 0)
+		return Fail(error, "not a DDS file");
+
+	Header header;
+	memcpy(&header, data + 4, sizeof(header));
+	size_t offset = 4 + sizeof(Header);
+
+	// Only DX10 style files (what Write() makes)
+	if (!(header.Format.Flags & PixelFormatFourCC) || header.Format.FourCC != FourCCDX10 || size < offset + sizeof(HeaderDX10))
+		return Fail(error, "only DX10 DDS files are supported");
+
+	HeaderDX10 dx10;
+	memcpy(&dx10, data + offset, sizeof(dx10));
+	offset += sizeof(HeaderDX10);
+	if (dx10.ResourceDimension != Dimension2D || dx10.ArraySize > 1)
+		return Fail(error, "only single 2D textures are supported");
+
+	image.Width = header.Width;
+	image.Height = header.Height;
+	image.MipLevels = std::max(header.MipMapCount, 1u);
+	image.Format = (DdsFormat)dx10.DxgiFormat;
+	if (BytesPerBlock(image.Format) == 0 || image.Width == 0 || image.Height == 0)
+		return Fail(error, "unsupported format");
+	if (image.Width > MaxDimension || image.Height > MaxDimension)
+		return Fail(error, "texture too large");
+
+	// No more mips than it takes to get down to 1x1
+	unsigned int fullChain = 1;
+	while ((std::max(image.Width, image.Height) >> fullChain) > 0)
+		fullChain++;
+	if (image.MipLevels > fullChain)
+		return Fail(error, "too many mips");
+
+	dataOffset = offset;
+	return true;
+}
+
+bool DdsFile::Write(const std::filesystem::path& path, const DdsImage& image)
+{
+	Header header = {};
+	header.Size = sizeof(Header);
+	header.Flags = FlagCaps | FlagHeight | FlagWidth | FlagPixelFormat | FlagMipCount;
+	header.Flags |= IsBlockCompressed(image.Format) ? FlagLinearSize : FlagPitch;
+	header.Height = image.Height;
+	header.Width = image.Width;
+	header.PitchOrLinearSize = (uint32_t)(IsBlockCompressed(image.Format) ? image.MipSize(0) : image.MipRowPitch(0));
+	header.MipMapCount = image.MipLevels;
+	header.Format.Size = sizeof(PixelFormat);
+	header.Format.Flags = PixelFormatFourCC;
+	header.Format.FourCC = FourCCDX10;
+	header.Caps = CapsTexture | (image.MipLevels > 1 ? CapsComplex | CapsMipMap : 0);
+
+	HeaderDX10 dx10 = {};
+	dx10.DxgiFormat = (uint32_t)image.Format;
+	dx10.ResourceDimension = Dimension2D;
+	dx10.ArraySize = 1;
+
+	std::ofstream file(path, std::ios::binary);
+	file.write((const char*)&Magic, 4);
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)&dx10, sizeof(dx10));
+	file.write((const char*)image.Data.data(), image.Data.size());
+	return (bool)file;
+}
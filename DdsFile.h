@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Formats a cooked texture can be in (values match DXGI_FORMAT)
+enum class DdsFormat : uint32_t
+{
+	Unknown = 0,
+	RGBA8 = 28,		// DXGI_FORMAT_R8G8B8A8_UNORM
+	RG8 = 49,		// DXGI_FORMAT_R8G8_UNORM
+	R16 = 56,		// DXGI_FORMAT_R16_UNORM
+	R8 = 61,		// DXGI_FORMAT_R8_UNORM
+	BC1 = 71,		// DXGI_FORMAT_BC1_UNORM
+	BC4 = 80,		// DXGI_FORMAT_BC4_UNORM
+	BC5 = 83,		// DXGI_FORMAT_BC5_UNORM
+	BC7 = 98		// DXGI_FORMAT_BC7_UNORM
+};
+
+// --------------------------------------------------------
+// A 2D texture with its whole mip chain, as stored in a
+// DDS file: every mip back to back, largest first.  Block
+// compressed mips are rows of 4x4 blocks.
+// --------------------------------------------------------
+struct DdsImage
+{
+	unsigned int Width = 0;
+	unsigned int Height = 0;
+	unsigned int MipLevels = 0;
+	DdsFormat Format = DdsFormat::Unknown;
+	std::vector<uint8_t> Data;
+
+	unsigned int MipWidth(unsigned int mip) const;
+	unsigned int MipHeight(unsigned int mip) const;
+	size_t MipRowPitch(unsigned int mip) const;	// One row of blocks for BC formats
+	size_t MipSize(unsigned int mip) const;
+	size_t MipOffset(unsigned int mip) const;
+};
+
+// --------------------------------------------------------
+// Reading and writing DDS files (always with the DX10
+// header extension, which every format here can use)
+// --------------------------------------------------------
+namespace DdsFile
+{
+	// Largest width or height accepted (D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION)
+	constexpr unsigned int MaxDimension = 16384;
+
+	bool IsBlockCompressed(DdsFormat format);
+	unsigned int BytesPerBlock(DdsFormat format);	// Bytes per pixel for uncompressed formats
+
+	bool Read(const uint8_t* data, size_t size, DdsImage& image, std::string* error = 0);
+
+	// Just the size and format (no Data), from at least HeaderSize
+	// bytes.  Mip i is at dataOffset + image.MipOffset(i) in the file.
+	constexpr size_t HeaderSize = 148;
+	bool ReadHeader(const uint8_t* data, size_t size, DdsImage& image, size_t& dataOffset, std::string* error = 0);
+	bool Write(const std::filesystem::path& path, const DdsImage& image);
+}
@@ -0,0 +1,58 @@
+#include "DynamicStructuredBuffer.h"
+#include "Graphics.h"
+
+DynamicStructuredBuffer::DynamicStructuredBuffer(unsigned int stride, unsigned int initialCapacity) :
+	stride(stride),
+	capacity(0),
+	count(0)
+{
+	Create((std::max)(initialCapacity, 1u));
+}
+
+void DynamicStructuredBuffer::Upload(const void* data, unsigned int count)
+{
+	if (count > capacity)
+		Create((std::max)(count, capacity * 2));
+
+	this->count = count;
+	if (count > 0)
+		Graphics::Renderer->UploadDynamicBuffer(buffer.Get(), data, (size_t)stride * count);
+}
+
+void DynamicStructuredBuffer::Create(unsigned int capacity)
+{
+	buffer.Reset();
+	srv.Reset();
+	this->capacity = capacity;
+
+	D3D11_BUFFER_DESC desc = {};
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	desc.StructureByteStride = stride;
+	desc.ByteWidth = stride * capacity;
+	Graphics::Device->CreateBuffer(&desc, 0, buffer.GetAddressOf());
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+	srvDesc.Buffer.FirstElement = 0;
+	srvDesc.Buffer.NumElements = capacity;
+	Graphics::Device->CreateShaderResourceView(buffer.Get(), &srvDesc, srv.GetAddressOf());
+}
+
+ID3D11ShaderResourceView* DynamicStructuredBuffer::GetSRV() const
+{
+	return srv.Get();
+}
+
+unsigned int DynamicStructuredBuffer::GetCount() const
+{
+	return count;
+}
+
+unsigned int DynamicStructuredBuffer::GetCapacity() const
+{
+	return capacity;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+// --------------------------------------------------------
+// A structured buffer the CPU rewrites every frame (with
+// WRITE_DISCARD), for shaders to read through its SRV.  It
+// grows (doubling) when more elements are uploaded than
+// fit, and never shrinks.
+// --------------------------------------------------------
+class DynamicStructuredBuffer
+{
+public:
+	DynamicStructuredBuffer(unsigned int stride, unsigned int initialCapacity = 64);
+
+	// Replaces the contents with count elements (none still
+	// leaves a valid, if stale, buffer to bind)
+	void Upload(const void* data, unsigned int count);
+
+	// Getters
+	ID3D11ShaderResourceView* GetSRV() const;
+	unsigned int GetCount() const;		// Elements uploaded last
+	unsigned int GetCapacity() const;
+
+private:
+	void Create(unsigned int capacity);
+
+	unsigned int stride;
+	unsigned int capacity;
+	unsigned int count;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+};
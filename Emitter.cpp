@@ -1,11 +1,18 @@
 #include "Emitter.h"
 #include "Graphics.h"
-
-// Helper macro for getting a float between min and max
-#define RandomRange(min, max) ((float)rand() / RAND_MAX * (max - min) + min)
+#include "JobSystem.h"
+#include "Profiler.h"
 
 using namespace DirectX;
 
+// Annonymous namespace to hold variables
+// only accessible in this file
+namespace
+{
+	// Default seeds, so every emitter gets its own stream
+	uint64_t emittersCreated = 0;
+}
+
 Emitter::Emitter(
 	int maxParticles,
 	int particlesPerSecond,
@@ -23,12 +30,14 @@ Emitter::Emitter(
 	DirectX::XMFLOAT2 rotationEndMinMax,
 	DirectX::XMFLOAT3 emitterAcceleration,
 	std::shared_ptr<Material> material,
+	std::shared_ptr<ParticleArena> arena,
 	unsigned int spriteSheetWidth,
 	unsigned int spriteSheetHeight,
 	float spriteSheetSpeedScale,
 	bool paused,
 	bool visible) :
 material(material),
+arena(arena),
 maxParticles(maxParticles),
 particlesPerSecond(particlesPerSecond),
 secondsPerParticle(1.0f / particlesPerSecond),
@@ -51,8 +60,19 @@ spriteSheetFrameHeight(1.0f / spriteSheetHeight),
 spriteSheetSpeedScale(spriteSheetSpeedScale),
 paused(paused),
 visible(visible),
-particles(0),
-totalEmitterTime(0)
+alphaBlend(false),
+totalEmitterTime(0),
+emissionScale(1.0f),
+culled(false),
+spawner(++emittersCreated),
+simulateOnCPU(false),
+simulationMs(0.0),
+drag(0.5f),
+turbulenceStrength(0.0f),
+turbulenceFrequency(1.0f),
+floorCollision(false),
+floorHeight(-2.0f),
+bounciness(0.5f)
 {
 	transform = std::make_shared<Transform>();
 	transform->SetPosition(emitterPosition);
@@ -63,82 +83,46 @@ totalEmitterTime(0)
 	firstAliveIndex = 0;
 	firstDeadIndex = 0;
 
-	// Actually create the array and underlying GPU resources
-	CreateParticlesAndGPUResources();
+	// Claim space in the arena and a row in its emitter table
+	arenaEmitterIndex = arena->AddEmitter();
+	AllocateParticles();
 }
 
 Emitter::~Emitter()
 {
-	// Clean up the particle array
-	delete[] particles;
+	// Give the space back
+	arena->Free(arenaRange);
+	arena->RemoveEmitter(arenaEmitterIndex);
 }
 
 std::shared_ptr<Transform> Emitter::GetTransform() { return transform; }
 std::shared_ptr<Material> Emitter::GetMaterial() { return material; }
 void Emitter::SetMaterial(std::shared_ptr<Material> material) { this->material = material; }
 
-void Emitter::CreateParticlesAndGPUResources()
+// --------------------------------------------------------
+// (Re)claims this emitter's part of the arena.  Drawing
+// resources all belong to the arena.
+// --------------------------------------------------------
+void Emitter::AllocateParticles()
 {
-	// Delete and release existing resources
-	if (particles) delete[] particles;
-	indexBuffer.Reset();
-	particleDataBuffer.Reset();
-	particleDataSRV.Reset();
+	arena->Free(arenaRange);
+	arenaRange = arena->Allocate(maxParticles);
 
-	// Set up the particle array
-	particles = new Particle[maxParticles];
-	ZeroMemory(particles, sizeof(Particle) * maxParticles);
+	cpuParticles.Resize(maxParticles);
+	uploadTracker.Reset(maxParticles);
+}
 
-	// Create an index buffer for particle drawing
-	// indices as if we had two triangles per particle
-	int numIndices = maxParticles * 6;
-	unsigned int* indices = new unsigned int[numIndices];
-	int indexCount = 0;
-	for (int i = 0; i < maxParticles * 4; i += 4)
-	{
-		indices[indexCount++] = i;
-		indices[indexCount++] = i + 1;
-		indices[indexCount++] = i + 2;
-		indices[indexCount++] = i;
-		indices[indexCount++] = i + 2;
-		indices[indexCount++] = i + 3;
-	}
-	D3D11_SUBRESOURCE_DATA indexData = {};
-	indexData.pSysMem = indices;
-
-	// Regular (static) index buffer
-	D3D11_BUFFER_DESC ibDesc = {};
-	ibDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	ibDesc.CPUAccessFlags = 0;
-	ibDesc.Usage = D3D11_USAGE_DEFAULT;
-	ibDesc.ByteWidth = sizeof(unsigned int) * maxParticles * 6;
-	Graphics::Device->CreateBuffer(&ibDesc, &indexData, indexBuffer.GetAddressOf());
-	delete[] indices; // Sent to GPU already
-
-	// Make a dynamic buffer to hold all particle data on GPU
-	// Note: We'll be overwriting this every frame with new lifetime data
-	D3D11_BUFFER_DESC allParticleBufferDesc = {};
-	allParticleBufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-	allParticleBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	allParticleBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	allParticleBufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
-	allParticleBufferDesc.StructureByteStride = sizeof(Particle);
-	allParticleBufferDesc.ByteWidth = sizeof(Particle) * maxParticles;
-	Graphics::Device->CreateBuffer(&allParticleBufferDesc, 0, particleDataBuffer.GetAddressOf());
-
-	// Create an SRV that points to a structured buffer of particles
-	// so we can grab this data in a vertex shader
-	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
-	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
-	srvDesc.Buffer.FirstElement = 0;
-	srvDesc.Buffer.NumElements = maxParticles;
-	Graphics::Device->CreateShaderResourceView(particleDataBuffer.Get(), &srvDesc, particleDataSRV.GetAddressOf());
+// The arena's array moves when it grows, so this is looked up each time
+Particle* Emitter::GetParticleArray()
+{
+	return arena->GetParticles() + arenaRange.Start;
 }
 
 
 void Emitter::Update(float dt, float currentTime)
 {
+	PROFILE_SCOPE("Emitter::Update");
+
 	if (paused)
 		return;
 
@@ -190,18 +174,39 @@ void Emitter::Update(float dt, float currentTime)
 	}
 
 
-	// Enough time to emit?
-	while (timeSinceLastEmit > secondsPerParticle)
+	// Move survivors before any new particles show up
+	simulationMs = 0.0;
+	if (simulateOnCPU && livingParticleCount > 0)
 	{
-		EmitParticle(totalEmitterTime);
-		timeSinceLastEmit -= secondsPerParticle;
+		uint64_t start = Profiler::Now();
+		ForEachLivingRange([this, dt](int begin, int end) { SimulateRange(begin, end, dt); });
+		simulationMs = Profiler::TicksToMilliseconds(Profiler::Now() - start);
+	}
+
+	// Nothing to emit at this level of detail
+	if (emissionScale <= 0.0f)
+	{
+		timeSinceLastEmit = 0.0f;
+		return;
+	}
+
+	// Enough time to emit?  Everything owed this frame goes out in one batch,
+	// up to this level of detail's share of the ring
+	float scaledSecondsPerParticle = secondsPerParticle / emissionScale;
+	if (timeSinceLastEmit > scaledSecondsPerParticle)
+	{
+		int spawnCount = (int)(timeSinceLastEmit / scaledSecondsPerParticle);
+		timeSinceLastEmit -= spawnCount * scaledSecondsPerParticle;
+
+		int allowedParticles = (int)(maxParticles * emissionScale);
+		EmitParticles(min(spawnCount, allowedParticles - livingParticleCount), totalEmitterTime);
 	}
 }
 
 
 void Emitter::UpdateSingleParticle(float currentTime, int index)
 {
-	float age = currentTime - particles[index].EmitTime;
+	float age = currentTime - GetParticleArray()[index].EmitTime;
 
 	// Update and check for death
 	if (age >= lifetime)
@@ -213,131 +218,129 @@ void Emitter::UpdateSingleParticle(float currentTime, int index)
 	}
 }
 
-void Emitter::EmitParticle(float currentTime)
+// --------------------------------------------------------
+// Spawns as many of count as there is room for.  The dead
+// part of the ring is at most two contiguous spans (up to
+// the end of the array, then from 0).
+// --------------------------------------------------------
+void Emitter::EmitParticles(int count, float emitTime)
 {
 	// Any left to spawn?
-	if (livingParticleCount == maxParticles)
+	count = min(count, maxParticles - livingParticleCount);
+	if (count <= 0)
 		return;
 
-	// Which particle is spawning?
-	int spawnedIndex = firstDeadIndex;
-
-	// Update the spawn time
-	particles[spawnedIndex].EmitTime = currentTime;
+	ParticleSpawnSettings settings;
+	settings.Position = transform->GetPosition();
+	settings.PositionRandomRange = positionRandomRange;
+	settings.StartVelocity = startVelocity;
+	settings.VelocityRandomRange = velocityRandomRange;
+	settings.RotationStartMinMax = rotationStartMinMax;
+	settings.RotationEndMinMax = rotationEndMinMax;
+	settings.EmitterIndex = arenaEmitterIndex;
+	spawner.Spawn(GetParticleArray(), maxParticles, firstDeadIndex, count, emitTime, settings);
+
+	if (simulateOnCPU)
+	{
+		int firstSpanEnd = min(firstDeadIndex + count, maxParticles);
+		StartOnCPU(firstDeadIndex, firstSpanEnd);
+		if (firstSpanEnd - firstDeadIndex < count)
+			StartOnCPU(0, count - (firstSpanEnd - firstDeadIndex));
+	}
+	uploadTracker.MarkChanged(firstDeadIndex, count);
 
-	// Adjust the particle start position based on the random range (box shape)
-	particles[spawnedIndex].StartPosition = transform->GetPosition();
-	particles[spawnedIndex].StartPosition.x += positionRandomRange.x * RandomRange(-1.0f, 1.0f);
-	particles[spawnedIndex].StartPosition.y += positionRandomRange.y * RandomRange(-1.0f, 1.0f);
-	particles[spawnedIndex].StartPosition.z += positionRandomRange.z * RandomRange(-1.0f, 1.0f);
+	// Move the first dead particle past the new ones (and wrap)
+	firstDeadIndex = (firstDeadIndex + count) % maxParticles;
+	livingParticleCount += count;
+}
 
-	// Adjust particle start velocity based on random range
-	particles[spawnedIndex].StartVelocity = startVelocity;
-	particles[spawnedIndex].StartVelocity.x += velocityRandomRange.x * RandomRange(-1.0f, 1.0f);
-	particles[spawnedIndex].StartVelocity.y += velocityRandomRange.y * RandomRange(-1.0f, 1.0f);
-	particles[spawnedIndex].StartVelocity.z += velocityRandomRange.z * RandomRange(-1.0f, 1.0f);
+// --------------------------------------------------------
+// CPU simulated particles [begin, end) start from their
+// spawned values, and the GPU copy becomes "sit still at
+// this spot" until the next simulation step
+// --------------------------------------------------------
+void Emitter::StartOnCPU(int begin, int end)
+{
+	Particle* particles = GetParticleArray();
+	for (int i = begin; i < end; i++)
+	{
+		Particle& p = particles[i];
+		cpuParticles.PositionX[i] = p.StartPosition.x;
+		cpuParticles.PositionY[i] = p.StartPosition.y;
+		cpuParticles.PositionZ[i] = p.StartPosition.z;
+		cpuParticles.VelocityX[i] = p.StartVelocity.x;
+		cpuParticles.VelocityY[i] = p.StartVelocity.y;
+		cpuParticles.VelocityZ[i] = p.StartVelocity.z;
+		cpuParticles.Rotation[i] = p.StartRotation;
+		cpuParticles.RotationSpeed[i] = (p.EndRotation - p.StartRotation) / lifetime;
+
+		p.StartVelocity = XMFLOAT3(0, 0, 0);
+		p.EndRotation = p.StartRotation;
+	}
+}
 
-	// Adjust start and end rotation values based on range
-	particles[spawnedIndex].StartRotation = RandomRange(rotationStartMinMax.x, rotationStartMinMax.y);
-	particles[spawnedIndex].EndRotation = RandomRange(rotationEndMinMax.x, rotationEndMinMax.y);
+bool Emitter::IsCulled()
+{
+	return culled;
+}
 
-	// Increment the first dead particle (since it's now alive)
-	firstDeadIndex++;
-	firstDeadIndex %= maxParticles; // Wrap
+void Emitter::SetCulled(bool culled)
+{
+	this->culled = culled;
+}
 
-	// One more living particle
-	livingParticleCount++;
+int Emitter::GetLivingParticleCount()
+{
+	return livingParticleCount;
 }
 
-void Emitter::Draw(std::shared_ptr<Camera> camera, float currentTime, bool debugWireframe)
+unsigned int Emitter::GetArenaEmitterIndex()
 {
-	if (!visible)
-		return;
+	return arenaEmitterIndex;
+}
 
+// --------------------------------------------------------
+// Called by the arena before drawing: sends new particles
+// to the GPU and fills in this emitter's table row
+// --------------------------------------------------------
+void Emitter::PrepareForDraw(ParticleEmitterData& data)
+{
 	CopyParticlesToGPU();
 
-	// Set up buffers - note that we're NOT using a vertex buffer!
-	// When we draw, we'll calculate the number of vertices we expect
-	// to have given how many particles are currently alive.  We'll
-	// construct the actual vertex data on the fly in the shader.
-	UINT stride = 0;
-	UINT offset = 0;
-	ID3D11Buffer* nullBuffer = 0;
-	Graphics::Context->IASetVertexBuffers(0, 1, &nullBuffer, &stride, &offset);
-	Graphics::Context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-
-	// Set particle-specific data and let the
-	// material take care of the rest
-	material->PrepareMaterial(*transform, camera);
-
-	// Vertex data
-	std::shared_ptr<SimpleVertexShader> vs = material->GetVertexShader();
-	vs->SetMatrix4x4("view", camera->GetView());
-	vs->SetMatrix4x4("projection", camera->GetProjection());
-	vs->SetFloat("currentTime", totalEmitterTime);
-	vs->SetFloat("lifetime", lifetime);
-	vs->SetFloat3("acceleration", emitterAcceleration);
-	vs->SetFloat("startSize", startSize);
-	vs->SetFloat("endSize", endSize);
-	vs->SetFloat4("startColor", startColor);
-	vs->SetFloat4("endColor", endColor);
-	vs->SetInt("constrainYAxis", constrainYAxis);
-	vs->SetInt("spriteSheetWidth", spriteSheetWidth);
-	vs->SetInt("spriteSheetHeight", spriteSheetHeight);
-	vs->SetFloat("spriteSheetFrameWidth", spriteSheetFrameWidth);
-	vs->SetFloat("spriteSheetFrameHeight", spriteSheetFrameHeight);
-	vs->SetFloat("spriteSheetSpeedScale", spriteSheetSpeedScale);
-	vs->CopyAllBufferData();
-
-	vs->SetShaderResourceView("ParticleData", particleDataSRV);
-
-	// Pixel data
-	std::shared_ptr<SimplePixelShader> ps = material->GetPixelShader();
-	ps->SetInt("debugWireframe", debugWireframe);
-	ps->CopyAllBufferData();
-
-
-	// Now that all of our data is in the beginning of the particle buffer,
-	// we can simply draw the correct amount of living particle indices.
-	// Each particle = 4 vertices = 6 indices for a quad
-	Graphics::Context->DrawIndexed(livingParticleCount * 6, 0, 0);
+	data.StartColor = startColor;
+	data.EndColor = endColor;
+	data.Acceleration = simulateOnCPU ? XMFLOAT3(0, 0, 0) : emitterAcceleration; // already applied on the CPU
+	data.CurrentTime = totalEmitterTime;
+	data.Lifetime = lifetime;
+	data.StartSize = startSize;
+	data.EndSize = endSize;
+	data.ConstrainYAxis = constrainYAxis;
+	data.SpriteSheetWidth = spriteSheetWidth;
+	data.SpriteSheetHeight = spriteSheetHeight;
+	data.SpriteSheetFrameWidth = spriteSheetFrameWidth;
+	data.SpriteSheetFrameHeight = spriteSheetFrameHeight;
+	data.SpriteSheetSpeedScale = spriteSheetSpeedScale;
+	data.RangeStart = arenaRange.Start;
+	data.RangeSize = maxParticles;
+	data.FirstAlive = firstAliveIndex;
 }
 
+// --------------------------------------------------------
+// The GPU buffer mirrors the particle ring index for index,
+// so only particles written since the last copy go up.
+// CPU simulated particles move every frame, so all living
+// ones are marked changed first.
+// --------------------------------------------------------
 void Emitter::CopyParticlesToGPU()
 {
-	// Now that we have emit and updated all particles for this frame, 
-	// we can copy them to the GPU as either one big chunk or two smaller chunks
-
-	// Map the buffer
-	D3D11_MAPPED_SUBRESOURCE mapped = {};
-	Graphics::Context->Map(particleDataBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+	PROFILE_SCOPE("Emitter::CopyParticlesToGPU");
 
-	// How are living particles arranged in the buffer?
-	if (firstAliveIndex < firstDeadIndex)
-	{
-		// Only copy from FirstAlive -> FirstDead
-		memcpy(
-			mapped.pData, // Destination = start of particle buffer
-			particles + firstAliveIndex, // Source = particle array, offset to first living particle
-			sizeof(Particle) * livingParticleCount); // Amount = number of particles (measured in BYTES!)
-	}
-	else
-	{
-		// Copy from 0 -> FirstDead 
-		memcpy(
-			mapped.pData, // Destination = start of particle buffer
-			particles, // Source = start of particle array
-			sizeof(Particle) * firstDeadIndex); // Amount = particles up to first dead (measured in BYTES!)
-
-		// ALSO copy from FirstAlive -> End
-		memcpy(
-			(void*)((Particle*)mapped.pData + firstDeadIndex), // Destination = particle buffer, AFTER the data we copied in previous memcpy()
-			particles + firstAliveIndex,  // Source = particle array, offset to first living particle
-			sizeof(Particle) * (maxParticles - firstAliveIndex)); // Amount = number of living particles at end of array (measured in BYTES!)
-	}
+	if (simulateOnCPU)
+		uploadTracker.MarkChanged(firstAliveIndex, livingParticleCount);
 
-	// Unmap now that we're done copying
-	Graphics::Context->Unmap(particleDataBuffer.Get(), 0);
+	uploadTracker.Flush([this](unsigned int first, unsigned int count) {
+		arena->UploadParticles(arenaRange.Start + first, count);
+	});
 }
 
 int Emitter::GetParticlesPerSecond()
@@ -359,7 +362,7 @@ int Emitter::GetMaxParticles()
 void Emitter::SetMaxParticles(int maxParticles)
 {
 	this->maxParticles = max(1, maxParticles);
-	CreateParticlesAndGPUResources();
+	AllocateParticles();
 
 	// Reset emission details
 	timeSinceLastEmit = 0.0f;
@@ -368,7 +371,225 @@ void Emitter::SetMaxParticles(int maxParticles)
 	firstDeadIndex = 0;
 }
 
+uint64_t Emitter::GetSeed()
+{
+	return spawner.GetSeed();
+}
+
+void Emitter::SetSeed(uint64_t seed)
+{
+	spawner.SetSeed(seed);
+}
+
+float Emitter::GetEmitterTime()
+{
+	return totalEmitterTime;
+}
+
+float Emitter::GetEmissionScale()
+{
+	return emissionScale;
+}
+
+void Emitter::SetEmissionScale(float scale)
+{
+	emissionScale = max(0.0f, min(scale, 1.0f));
+}
+
+// --------------------------------------------------------
+// Per axis, a particle is at p + v*t + a*t*t/2.  That's
+// biggest with the fastest start velocity and smallest with
+// the slowest, so checking the start and end of the
+// lifetime and where it turns around gives the exact range.
+// CPU simulation adds a margin for turbulence (drag only
+// slows particles and bounces don't go higher than the
+// drop they came from).
+// --------------------------------------------------------
+DirectX::BoundingBox Emitter::GetWorldBounds()
+{
+	const XMFLOAT3 position = transform->GetPosition();
+	const float center[3] = { position.x, position.y, position.z };
+	const float positionRange[3] = { positionRandomRange.x, positionRandomRange.y, positionRandomRange.z };
+	const float velocity[3] = { startVelocity.x, startVelocity.y, startVelocity.z };
+	const float velocityRange[3] = { velocityRandomRange.x, velocityRandomRange.y, velocityRandomRange.z };
+	const float acceleration[3] = { emitterAcceleration.x, emitterAcceleration.y, emitterAcceleration.z };
+
+	// Farthest along the axis over [0, lifetime] for one start velocity
+	auto furthest = [this](float v, float a, float sign) {
+		float best = max(0.0f, sign * (v * lifetime + 0.5f * a * lifetime * lifetime));
+		if (a != 0.0f)
+		{
+			float turn = -v / a;
+			if (turn > 0.0f && turn < lifetime)
+				best = max(best, sign * (v * turn + 0.5f * a * turn * turn));
+		}
+		return best;
+	};
+
+	// Quads are billboards that can spin, so their corners reach size * sqrt(2)
+	float particleRadius = max(fabsf(startSize), fabsf(endSize)) * sqrtf(2.0f);
+	float turbulenceMargin = simulateOnCPU ? 0.5f * fabsf(turbulenceStrength) * lifetime * lifetime : 0.0f;
+
+	XMFLOAT3 minCorner, maxCorner;
+	float* low = &minCorner.x;
+	float* high = &maxCorner.x;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float range = fabsf(positionRange[axis]) + particleRadius + turbulenceMargin;
+		float spread = fabsf(velocityRange[axis]);
+		low[axis] = center[axis] - range - furthest(velocity[axis] - spread, acceleration[axis], -1.0f);
+		high[axis] = center[axis] + range + furthest(velocity[axis] + spread, acceleration[axis], 1.0f);
+	}
+
+	// Bounced particles stay above the floor
+	if (simulateOnCPU && floorCollision)
+		minCorner.y = max(minCorner.y, min(floorHeight, position.y - fabsf(positionRandomRange.y)) - particleRadius);
+
+	BoundingBox bounds;
+	BoundingBox::CreateFromPoints(bounds, XMLoadFloat3(&minCorner), XMLoadFloat3(&maxCorner));
+	return bounds;
+}
+
+void Emitter::Burst(int count)
+{
+	EmitParticles(count, totalEmitterTime);
+}
+
+// --------------------------------------------------------
+// Particles emitted in the past start out already aged.
+// Particles retire from the front of the ring, so the time
+// can't be earlier than the newest living particle's.
+// --------------------------------------------------------
+void Emitter::Burst(int count, float emitTime)
+{
+	if (livingParticleCount > 0)
+	{
+		int newest = (firstDeadIndex + maxParticles - 1) % maxParticles;
+		emitTime = max(emitTime, GetParticleArray()[newest].EmitTime);
+	}
+	EmitParticles(count, min(emitTime, totalEmitterTime));
+}
+
 bool Emitter::IsSpriteSheet()
 {
 	return spriteSheetHeight > 1 || spriteSheetWidth > 1;
 }
+
+bool Emitter::IsSimulatedOnCPU()
+{
+	return simulateOnCPU;
+}
+
+// --------------------------------------------------------
+// Switches between analytic (GPU) and simulated (CPU)
+// motion.  Living particles are converted so they carry on
+// from where they are instead of jumping.
+// --------------------------------------------------------
+void Emitter::SetSimulatedOnCPU(bool simulateOnCPU)
+{
+	if (this->simulateOnCPU == simulateOnCPU)
+		return;
+	this->simulateOnCPU = simulateOnCPU;
+
+	Particle* particles = GetParticleArray();
+	XMFLOAT3 a = emitterAcceleration;
+	ForEachLivingRange([&](int begin, int end) {
+		for (int i = begin; i < end; i++)
+		{
+			Particle& p = particles[i];
+			float age = totalEmitterTime - p.EmitTime;
+
+			if (simulateOnCPU)
+			{
+				// Evaluate the analytic motion at the current age
+				cpuParticles.PositionX[i] = p.StartPosition.x + p.StartVelocity.x * age + 0.5f * a.x * age * age;
+				cpuParticles.PositionY[i] = p.StartPosition.y + p.StartVelocity.y * age + 0.5f * a.y * age * age;
+				cpuParticles.PositionZ[i] = p.StartPosition.z + p.StartVelocity.z * age + 0.5f * a.z * age * age;
+				cpuParticles.VelocityX[i] = p.StartVelocity.x + a.x * age;
+				cpuParticles.VelocityY[i] = p.StartVelocity.y + a.y * age;
+				cpuParticles.VelocityZ[i] = p.StartVelocity.z + a.z * age;
+				cpuParticles.RotationSpeed[i] = (p.EndRotation - p.StartRotation) / lifetime;
+				cpuParticles.Rotation[i] = p.StartRotation + cpuParticles.RotationSpeed[i] * age;
+
+				p.StartPosition = XMFLOAT3(cpuParticles.PositionX[i], cpuParticles.PositionY[i], cpuParticles.PositionZ[i]);
+				p.StartVelocity = XMFLOAT3(0, 0, 0);
+				p.StartRotation = p.EndRotation = cpuParticles.Rotation[i];
+			}
+			else
+			{
+				// Work backwards to the start values that land here now
+				XMFLOAT3 velocity(cpuParticles.VelocityX[i] - a.x * age, cpuParticles.VelocityY[i] - a.y * age, cpuParticles.VelocityZ[i] - a.z * age);
+				p.StartPosition.x = cpuParticles.PositionX[i] - velocity.x * age - 0.5f * a.x * age * age;
+				p.StartPosition.y = cpuParticles.PositionY[i] - velocity.y * age - 0.5f * a.y * age * age;
+				p.StartPosition.z = cpuParticles.PositionZ[i] - velocity.z * age - 0.5f * a.z * age * age;
+				p.StartVelocity = velocity;
+				p.StartRotation = cpuParticles.Rotation[i] - cpuParticles.RotationSpeed[i] * age;
+				p.EndRotation = p.StartRotation + cpuParticles.RotationSpeed[i] * lifetime;
+			}
+		}
+	});
+
+	// Every living record was rewritten
+	uploadTracker.MarkChanged(firstAliveIndex, livingParticleCount);
+}
+
+double Emitter::GetSimulationMs()
+{
+	return simulationMs;
+}
+
+// --------------------------------------------------------
+// Steps particles [begin, end) on the CPU and writes their
+// new state into the records that get copied to the GPU.
+// Big ranges are split across the job system.
+// --------------------------------------------------------
+void Emitter::SimulateRange(int begin, int end, float dt)
+{
+	PROFILE_SCOPE("Emitter::SimulateRange");
+
+	ParticleForces forces;
+	forces.Acceleration = emitterAcceleration;
+	forces.Drag = drag;
+	forces.TurbulenceStrength = turbulenceStrength;
+	forces.TurbulenceFrequency = turbulenceFrequency;
+	forces.FloorCollision = floorCollision;
+	forces.FloorHeight = floorHeight;
+	forces.Bounciness = bounciness;
+
+	Particle* particles = GetParticleArray();
+
+	// Multiple of 8 so every chunk but the last is whole AVX2 batches
+	const unsigned int grain = 8192;
+	JobSystem::ParallelFor((unsigned int)(end - begin), [&](unsigned int chunkBegin, unsigned int chunkEnd) {
+		unsigned int first = begin + chunkBegin;
+		unsigned int last = begin + chunkEnd;
+		ParticleSimulation::Integrate(cpuParticles, first, last, dt, totalEmitterTime, forces);
+
+		// The vertex shader sees a particle sitting at its current spot
+		for (unsigned int i = first; i < last; i++)
+		{
+			particles[i].StartPosition = XMFLOAT3(cpuParticles.PositionX[i], cpuParticles.PositionY[i], cpuParticles.PositionZ[i]);
+			particles[i].StartVelocity = XMFLOAT3(0, 0, 0);
+			particles[i].StartRotation = cpuParticles.Rotation[i];
+			particles[i].EndRotation = cpuParticles.Rotation[i];
+		}
+	}, grain);
+}
+
+// Calls body once or twice to cover every living particle (the ring may wrap)
+void Emitter::ForEachLivingRange(const std::function<void(int begin, int end)>& body)
+{
+	if (livingParticleCount == 0)
+		return;
+
+	if (firstAliveIndex < firstDeadIndex)
+	{
+		body(firstAliveIndex, firstDeadIndex);
+	}
+	else
+	{
+		body(firstAliveIndex, maxParticles);
+		if (firstDeadIndex > 0)
+			body(0, firstDeadIndex);
+	}
+}
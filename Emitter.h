@@ -2,27 +2,20 @@
 
 #include <d3d11.h>
 #include <DirectXMath.h>
+#include <DirectXCollision.h>
 #include <wrl/client.h>
+#include <functional>
 #include <memory>
+#include <vector>
 
 #include "Camera.h"
 #include "Material.h"
 #include "Transform.h"
 #include "SimpleShader.h"
-
-// We'll be mimicking this in HLSL
-// so we need to care about alignment!
-struct Particle
-{
-	float EmitTime;
-	DirectX::XMFLOAT3 StartPosition;
-
-	DirectX::XMFLOAT3 StartVelocity;
-	float StartRotation;
-
-	float EndRotation;
-	DirectX::XMFLOAT3 pad;
-};
+#include "ParticleSimulation.h"
+#include "ParticleArena.h"
+#include "ParticleSpawner.h"
+#include "RingUploadTracker.h"
 
 class Emitter
 {
@@ -44,6 +37,7 @@ public:
 		DirectX::XMFLOAT2 rotationEndMinMax,
 		DirectX::XMFLOAT3 emitterAcceleration,
 		std::shared_ptr<Material> material,
+		std::shared_ptr<ParticleArena> arena,
 		unsigned int spriteSheetWidth = 1,
 		unsigned int spriteSheetHeight = 1,
 		float spriteSheetSpeedScale = 1.0f,
@@ -53,10 +47,14 @@ public:
 	~Emitter();
 
 	void Update(float dt, float currentTime);
-	void Draw(
-		std::shared_ptr<Camera> camera,
-		float currentTime,
-		bool debugWireframe);
+
+	// Drawing happens in ParticleArena::Draw(), which uses these
+	// (culled emitters keep simulating but aren't uploaded or drawn)
+	bool IsCulled();
+	void SetCulled(bool culled);
+	int GetLivingParticleCount();
+	unsigned int GetArenaEmitterIndex();
+	void PrepareForDraw(ParticleEmitterData& data);
 
 	std::shared_ptr<Transform> GetTransform();
 	std::shared_ptr<Material> GetMaterial();
@@ -68,6 +66,21 @@ public:
 	void SetParticlesPerSecond(int particlesPerSecond);
 	int GetMaxParticles();
 	void SetMaxParticles(int maxParticles);
+	float GetEmitterTime();
+
+	// Level of detail, set by ParticleBudget: 0-1 of the emission rate
+	// and of maxParticles (the ring itself keeps its full size)
+	float GetEmissionScale();
+	void SetEmissionScale(float scale);
+
+	// Box every particle stays inside over its lifetime (plus its size),
+	// assuming the emitter doesn't move while they're alive
+	DirectX::BoundingBox GetWorldBounds();
+
+	// Spawns up to count particles at once (explosions, impacts...),
+	// either now or as if emitted at an earlier emitter time
+	void Burst(int count);
+	void Burst(int count, float emitTime);
 
 	// Emitter-level data (this is the same for all particles)
 	DirectX::XMFLOAT3 emitterAcceleration;
@@ -81,6 +94,7 @@ public:
 	bool constrainYAxis;
 	bool paused;
 	bool visible;
+	bool alphaBlend;		// Sorted back to front and alpha blended (smoke) instead of additive
 
 	// Particle randomization ranges
 	DirectX::XMFLOAT3 positionRandomRange;
@@ -88,10 +102,27 @@ public:
 	DirectX::XMFLOAT2 rotationStartMinMax;
 	DirectX::XMFLOAT2 rotationEndMinMax;
 
+	// Same seed -> same particles (emitters are numbered 1, 2, 3...
+	// in creation order until a seed is set)
+	uint64_t GetSeed();
+	void SetSeed(uint64_t seed);
+
 	// Sprite sheet animation
 	float spriteSheetSpeedScale;
 	bool IsSpriteSheet();
 
+	// CPU simulation - needed for drag, turbulence and collisions,
+	// which the analytic motion in ParticleVS can't do
+	bool IsSimulatedOnCPU();
+	void SetSimulatedOnCPU(bool simulateOnCPU);
+	double GetSimulationMs();
+	float drag;
+	float turbulenceStrength;
+	float turbulenceFrequency;
+	bool floorCollision;
+	float floorHeight;
+	float bounciness;
+
 private:
 
 	// Emission
@@ -100,6 +131,8 @@ private:
 	float secondsPerParticle;
 	float timeSinceLastEmit;
 	float totalEmitterTime;
+	float emissionScale;
+	ParticleSpawner spawner;
 
 	// Sprite sheet options
 	int spriteSheetWidth;
@@ -107,17 +140,24 @@ private:
 	float spriteSheetFrameWidth;
 	float spriteSheetFrameHeight;
 
-	// Particle array
-	Particle* particles;
+	// Particle ring, kept in a range of the shared arena
+	std::shared_ptr<ParticleArena> arena;
+	ParticleArenaRange arenaRange;
+	unsigned int arenaEmitterIndex;
 	int firstDeadIndex;
 	int firstAliveIndex;
 	int livingParticleCount;
-	void CreateParticlesAndGPUResources();
+	void AllocateParticles();
+	Particle* GetParticleArray();
+
+	// CPU simulated state (only kept up to date when simulateOnCPU is set)
+	bool simulateOnCPU;
+	ParticleSoA cpuParticles;
+	double simulationMs;
 
 	// Rendering
-	Microsoft::WRL::ComPtr<ID3D11Buffer> particleDataBuffer;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> particleDataSRV;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
+	bool culled;
+	RingUploadTracker uploadTracker;	// Particles not yet copied to the arena's GPU buffer
 
 	// Material & transform
 	std::shared_ptr<Transform> transform;
@@ -128,7 +168,10 @@ private:
 
 	// Simulation methods
 	void UpdateSingleParticle(float currentTime, int index);
-	void EmitParticle(float currentTime);
+	void EmitParticles(int count, float emitTime);
+	void StartOnCPU(int begin, int end);
+	void SimulateRange(int begin, int end, float dt);
+	void ForEachLivingRange(const std::function<void(int begin, int end)>& body);
 };
 
 
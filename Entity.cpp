@@ -3,7 +3,7 @@
 #include "Window.h"
 
 Entity::Entity(const std::shared_ptr<Mesh> mesh, const std::shared_ptr<Material> material)
-	: mesh(mesh), material(material)
+	: mesh(mesh), material(material), occluder(false)
 {
 	//Transform field is a reference, 
 	//it is created when Entity is instantiated
@@ -29,11 +29,32 @@ std::shared_ptr<Material> Entity::GetMaterial()
 	return material;
 }
 
+const DirectX::BoundingBox& Entity::GetWorldBounds() const
+{
+	return worldBounds;
+}
+
+bool Entity::IsOccluder() const
+{
+	return occluder;
+}
+
 void Entity::SetMaterial(std::shared_ptr<Material> newMat)
 {
 	material = newMat;
 }
 
+void Entity::SetOccluder(bool isOccluder)
+{
+	occluder = isOccluder;
+}
+
+void Entity::UpdateWorldBounds()
+{
+	DirectX::XMFLOAT4X4 world = transform.GetWorldMatrix();
+	mesh->GetBounds().Transform(worldBounds, DirectX::XMLoadFloat4x4(&world));
+}
+
 void Entity::Draw(std::shared_ptr<Camera> activeCam)
 {
 	material->PrepareMaterial(transform, activeCam);
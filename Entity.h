@@ -2,6 +2,7 @@
 #include <memory>
 #include <wrl/client.h>
 #include <DirectXMath.h>
+#include <DirectXCollision.h>
 
 #include "Transform.h"
 #include "Mesh.h"
@@ -16,6 +17,10 @@ private:
 	Transform transform;
 	std::shared_ptr<Mesh> mesh;
 	std::shared_ptr<Material> material;
+	//mesh bounds moved into world space (see UpdateWorldBounds)
+	DirectX::BoundingBox worldBounds;
+	//drawn into the occlusion buffer to hide things behind it
+	bool occluder;
 
 public:
 	//Constructors
@@ -27,8 +32,16 @@ public:
 	std::shared_ptr<Mesh> GetMesh();
 	Transform& GetTransform();
 	std::shared_ptr<Material> GetMaterial();
+	const DirectX::BoundingBox& GetWorldBounds() const;
+	bool IsOccluder() const;
 	//Setters
 	void SetMaterial(std::shared_ptr<Material> newMat);
+	void SetOccluder(bool isOccluder);
+
+	//Per frame
+	//rebuilds the world matrix if needed and refits the world bounds
+	//only touches this entity, so it is safe to call from jobs
+	void UpdateWorldBounds();
 
 	//Drawing
 	void Draw(std::shared_ptr<Camera> activeCam);
@@ -0,0 +1,244 @@
+#include "EntityLightLists.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <immintrin.h>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// How bright a light's color looks
+	float Brightness(const XMFLOAT3& color)
+	{
+		return color.x * 0.2126f + color.y * 0.7152f + color.z * 0.0722f;
+	}
+}
+
+void EntityLightLists::Build(const PackedLight* lights, unsigned int lightCount, const BoundingBox* bounds, unsigned int entityCount,
+	const unsigned char* visible, unsigned int maxLights)
+{
+	PrepareLights(lights, lightCount, entityCount, maxLights);
+
+	// Each entity only writes its own list, and each thread has its own scratch
+	threadCandidates.resize(JobSystem::ThreadCount());
+	JobSystem::ParallelFor(entityCount, [&](unsigned int begin, unsigned int end)
+	{
+		std::vector<Candidate>& candidates = threadCandidates[JobSystem::ThreadIndex()];
+		for (unsigned int e = begin; e < end; e++)
+			if (!visible || visible[e])
+				BuildEntity(e, bounds[e], candidates);
+	}, 16);
+
+	Finish(visible, entityCount);
+}
+
+void EntityLightLists::BuildReference(const PackedLight* lights, unsigned int lightCount, const BoundingBox* bounds, unsigned int entityCount,
+	const unsigned char* visible, unsigned int maxLights)
+{
+	PrepareLights(lights, lightCount, entityCount, maxLights);
+
+	std::vector<Candidate> candidates;
+	for (unsigned int e = 0; e < entityCount; e++)
+	{
+		if (visible && !visible[e])
+			continue;
+
+		candidates.clear();
+		for (unsigned int l = 0; l < this->lightCount; l++)
+		{
+			float score;
+			if (TestLight(l, bounds[e], score))
+				candidates.push_back({ score, source[l] });
+		}
+		Keep(e, candidates);
+	}
+
+	Finish(visible, entityCount);
+}
+
+// Copies the point and spot lights into SoA arrays, directional ones
+// (which light everything anyway) left out
+void EntityLightLists::PrepareLights(const PackedLight* lights, unsigned int lightCount, unsigned int entityCount, unsigned int maxLights)
+{
+	this->maxLights = std::min(std::max(maxLights, 1u), MaxLights);
+	stats = EntityLightStats();
+
+	source.clear();
+	for (unsigned int i = 0; i < lightCount; i++)
+		if (lights[i].Type != LIGHT_TYPE_DIRECTIONAL)
+			source.push_back(i);
+	this->lightCount = (unsigned int)source.size();
+	stats.Lights = this->lightCount;
+
+	// Padding never hits: nothing is closer than a negative range squared
+	size_t padded = (this->lightCount + 3) & ~3u;
+	for (std::vector<float>* soa : { &x, &y, &z, &range, &invRangeSq, &dirX, &dirY, &dirZ, &cosAngle, &sinAngle, &cone, &brightness })
+		soa->assign(padded, 0.0f);
+	rangeSq.assign(padded, -1.0f);
+
+	for (unsigned int l = 0; l < this->lightCount; l++)
+	{
+		const PackedLight& light = lights[source[l]];
+		x[l] = light.Position.x;
+		y[l] = light.Position.y;
+		z[l] = light.Position.z;
+		range[l] = light.Range;
+		rangeSq[l] = light.Range > 0.0f ? light.Range * light.Range : -1.0f;
+		invRangeSq[l] = light.InvRangeSq;
+		brightness[l] = Brightness(light.Color);
+
+		// Wider cones than a hemisphere only get the sphere test
+		if (light.Type == LIGHT_TYPE_SPOT && light.CosOuter > 0.0f)
+		{
+			dirX[l] = light.Direction.x;
+			dirY[l] = light.Direction.y;
+			dirZ[l] = light.Direction.z;
+			cosAngle[l] = light.CosOuter;
+			sinAngle[l] = sqrtf(std::max(1.0f - light.CosOuter * light.CosOuter, 0.0f));
+			cone[l] = 1.0f;
+		}
+	}
+
+	lists.resize((size_t)entityCount * this->maxLights);
+	counts.assign(entityCount, 0);
+	hits.assign(entityCount, 0);
+}
+
+// Every light against one entity's bounds, four at a time
+void EntityLightLists::BuildEntity(unsigned int entity, const BoundingBox& bounds, std::vector<Candidate>& candidates)
+{
+	candidates.clear();
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	__m128 minX = _mm_set1_ps(bounds.Center.x - bounds.Extents.x);
+	__m128 minY = _mm_set1_ps(bounds.Center.y - bounds.Extents.y);
+	__m128 minZ = _mm_set1_ps(bounds.Center.z - bounds.Extents.z);
+	__m128 maxX = _mm_set1_ps(bounds.Center.x + bounds.Extents.x);
+	__m128 maxY = _mm_set1_ps(bounds.Center.y + bounds.Extents.y);
+	__m128 maxZ = _mm_set1_ps(bounds.Center.z + bounds.Extents.z);
+	__m128 centerX = _mm_set1_ps(bounds.Center.x);
+	__m128 centerY = _mm_set1_ps(bounds.Center.y);
+	__m128 centerZ = _mm_set1_ps(bounds.Center.z);
+	__m128 boxRadius = _mm_set1_ps(sqrtf(bounds.Extents.x * bounds.Extents.x + bounds.Extents.y * bounds.Extents.y + bounds.Extents.z * bounds.Extents.z));
+
+	alignas(16) float scores[4];
+	for (unsigned int l = 0; l < lightCount; l += 4)
+	{
+		// Sphere against box: squared distance to the closest point
+		__m128 lx = _mm_loadu_ps(&x[l]);
+		__m128 ly = _mm_loadu_ps(&y[l]);
+		__m128 lz = _mm_loadu_ps(&z[l]);
+		__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, lx), _mm_sub_ps(lx, maxX)), zero);
+		__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, ly), _mm_sub_ps(ly, maxY)), zero);
+		__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, lz), _mm_sub_ps(lz, maxZ)), zero);
+		__m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		__m128 hit = _mm_cmple_ps(distanceSq, _mm_loadu_ps(&rangeSq[l]));
+		if (_mm_movemask_ps(hit) == 0)
+			continue;
+
+		// Cone against the box's bounding sphere: outside the cone's
+		// sides, past its end, or behind its tip
+		__m128 vx = _mm_sub_ps(centerX, lx);
+		__m128 vy = _mm_sub_ps(centerY, ly);
+		__m128 vz = _mm_sub_ps(centerZ, lz);
+		__m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+		__m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, _mm_loadu_ps(&dirX[l])), _mm_mul_ps(vy, _mm_loadu_ps(&dirY[l]))), _mm_mul_ps(vz, _mm_loadu_ps(&dirZ[l])));
+		__m128 across = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(lengthSq, _mm_mul_ps(along, along)), zero));
+		__m128 closest = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(&cosAngle[l]), across), _mm_mul_ps(along, _mm_loadu_ps(&sinAngle[l])));
+		__m128 outside = _mm_or_ps(_mm_cmpgt_ps(closest, boxRadius),
+			_mm_or_ps(_mm_cmpgt_ps(along, _mm_add_ps(boxRadius, _mm_loadu_ps(&range[l]))), _mm_cmplt_ps(along, _mm_sub_ps(zero, boxRadius))));
+		__m128 isCone = _mm_cmpgt_ps(_mm_loadu_ps(&cone[l]), zero);
+		hit = _mm_andnot_ps(_mm_and_ps(outside, isCone), hit);
+
+		// Brightness with the attenuation at the closest point
+		__m128 attenuation = _mm_max_ps(_mm_sub_ps(one, _mm_mul_ps(distanceSq, _mm_loadu_ps(&invRangeSq[l]))), zero);
+		_mm_store_ps(scores, _mm_mul_ps(_mm_loadu_ps(&brightness[l]), _mm_mul_ps(attenuation, attenuation)));
+
+		int mask = _mm_movemask_ps(hit);
+		for (int bit = 0; mask != 0; bit++, mask >>= 1)
+			if (mask & 1)
+				candidates.push_back({ scores[bit], source[l + bit] });
+	}
+
+	Keep(entity, candidates);
+}
+
+// The same tests as BuildEntity(), for one light
+bool EntityLightLists::TestLight(unsigned int l, const BoundingBox& bounds, float& score) const
+{
+	float dx = std::max(std::max((bounds.Center.x - bounds.Extents.x) - x[l], x[l] - (bounds.Center.x + bounds.Extents.x)), 0.0f);
+	float dy = std::max(std::max((bounds.Center.y - bounds.Extents.y) - y[l], y[l] - (bounds.Center.y + bounds.Extents.y)), 0.0f);
+	float dz = std::max(std::max((bounds.Center.z - bounds.Extents.z) - z[l], z[l] - (bounds.Center.z + bounds.Extents.z)), 0.0f);
+	float distanceSq = dx * dx + dy * dy + dz * dz;
+	if (!(distanceSq <= rangeSq[l]))
+		return false;
+
+	if (cone[l] > 0.0f)
+	{
+		float boxRadius = sqrtf(bounds.Extents.x * bounds.Extents.x + bounds.Extents.y * bounds.Extents.y + bounds.Extents.z * bounds.Extents.z);
+		float vx = bounds.Center.x - x[l];
+		float vy = bounds.Center.y - y[l];
+		float vz = bounds.Center.z - z[l];
+		float lengthSq = vx * vx + vy * vy + vz * vz;
+		float along = vx * dirX[l] + vy * dirY[l] + vz * dirZ[l];
+		float across = sqrtf(std::max(lengthSq - along * along, 0.0f));
+		float closest = cosAngle[l] * across - along * sinAngle[l];
+		if (closest > boxRadius || along > boxRadius + range[l] || along < 0.0f - boxRadius)
+			return false;
+	}
+
+	float attenuation = std::max(1.0f - distanceSq * invRangeSq[l], 0.0f);
+	score = brightness[l] * (attenuation * attenuation);
+	return true;
+}
+
+// Keeps the highest scoring candidates (lower light index first on
+// ties, so the lists don't depend on the order lights were tested in)
+void EntityLightLists::Keep(unsigned int entity, std::vector<Candidate>& candidates)
+{
+	auto better = [](const Candidate& a, const Candidate& b) {
+		return a.Score != b.Score ? a.Score > b.Score : a.Light < b.Light;
+	};
+	unsigned int kept = std::min((unsigned int)candidates.size(), maxLights);
+	std::partial_sort(candidates.begin(), candidates.begin() + kept, candidates.end(), better);
+
+	uint32_t* list = &lists[(size_t)entity * maxLights];
+	for (unsigned int i = 0; i < kept; i++)
+		list[i] = candidates[i].Light;
+	counts[entity] = kept;
+	hits[entity] = (uint32_t)candidates.size();
+}
+
+void EntityLightLists::Finish(const unsigned char* visible, unsigned int entityCount)
+{
+	for (unsigned int e = 0; e < entityCount; e++)
+	{
+		if (visible && !visible[e])
+			continue;
+		stats.Entities++;
+		stats.Hits += hits[e];
+		stats.Kept += counts[e];
+		if (hits[e] > counts[e])
+			stats.Capped++;
+	}
+}
+
+const uint32_t* EntityLightLists::GetLights(unsigned int entity) const
+{
+	return &lists[(size_t)entity * maxLights];
+}
+
+unsigned int EntityLightLists::GetCount(unsigned int entity) const
+{
+	return counts[entity];
+}
+
+const EntityLightStats& EntityLightLists::GetStats() const
+{
+	return stats;
+}
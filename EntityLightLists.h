@@ -0,0 +1,86 @@
+#pragma once
+
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <vector>
+
+#include "LightPacker.h"
+
+// --------------------------------------------------------
+// What building the lists found this frame
+// --------------------------------------------------------
+struct EntityLightStats
+{
+	unsigned int Entities = 0;		// Given lists (visible)
+	unsigned int Lights = 0;		// Point and spot lights tested
+	unsigned int Hits = 0;			// Lights touching an entity, before the cap
+	unsigned int Kept = 0;			// In the lists, after it
+	unsigned int Capped = 0;		// Entities with more lights than fit
+};
+
+// --------------------------------------------------------
+// A short list of lights per entity, for forward shading
+// without clusters: every point and spot light whose range
+// sphere (or spot cone) touches the entity's world bounds,
+// keeping the maxLights that should light it the most
+// (brightest at the closest point of the bounds).
+// Directional lights light everything, so they're never
+// listed.
+//
+// Entities are split across the job system and each is
+// tested against four lights at a time with SSE: spheres
+// against the box, cones against the box's bounding sphere.
+//
+// Usage:
+//   Build() every frame -> GetLights() / GetCount() per draw
+// --------------------------------------------------------
+class EntityLightLists
+{
+public:
+	// Longest list (MAX_ENTITY_LIGHTS in Lighting.hlsli)
+	static constexpr unsigned int MaxLights = 8;
+
+	// Lists for the entities marked visible (all of them if visible
+	// is null).  Indices in the lists are into lights[].
+	void Build(const PackedLight* lights, unsigned int lightCount, const DirectX::BoundingBox* bounds, unsigned int entityCount,
+		const unsigned char* visible = 0, unsigned int maxLights = MaxLights);
+	// Same result, one light against one entity at a time on this
+	// thread (to check Build() against)
+	void BuildReference(const PackedLight* lights, unsigned int lightCount, const DirectX::BoundingBox* bounds, unsigned int entityCount,
+		const unsigned char* visible = 0, unsigned int maxLights = MaxLights);
+
+	// An entity's lists, most important first (empty if it wasn't visible)
+	const uint32_t* GetLights(unsigned int entity) const;
+	unsigned int GetCount(unsigned int entity) const;
+	const EntityLightStats& GetStats() const;
+
+private:
+	// A light touching an entity, and how much it's worth
+	struct Candidate
+	{
+		float Score;
+		uint32_t Light;
+	};
+
+	void PrepareLights(const PackedLight* lights, unsigned int lightCount, unsigned int entityCount, unsigned int maxLights);
+	void BuildEntity(unsigned int entity, const DirectX::BoundingBox& bounds, std::vector<Candidate>& candidates);
+	bool TestLight(unsigned int light, const DirectX::BoundingBox& bounds, float& score) const;
+	void Keep(unsigned int entity, std::vector<Candidate>& candidates);
+	void Finish(const unsigned char* visible, unsigned int entityCount);
+
+	unsigned int maxLights = MaxLights;
+
+	// Point and spot lights (SoA for SSE), padded to 4 with lights that never hit
+	unsigned int lightCount = 0;
+	std::vector<uint32_t> source;	// Index into the lights given
+	std::vector<float> x, y, z, range, rangeSq, invRangeSq;
+	std::vector<float> dirX, dirY, dirZ, cosAngle, sinAngle, cone, brightness;
+
+	// Per entity: maxLights slots, how many are used and how many touched it
+	std::vector<uint32_t> lists;
+	std::vector<uint32_t> counts;
+	std::vector<uint32_t> hits;
+	std::vector<std::vector<Candidate>> threadCandidates;
+
+	EntityLightStats stats;
+};
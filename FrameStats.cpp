@@ -0,0 +1,136 @@
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+FrameStats::FrameStats(unsigned int capacity, float hitchThresholdMs) :
+	frameTimes(std::max(1u, capacity), 0.0f),
+	nextIndex(0),
+	count(0),
+	totalFrames(0),
+	hitchCount(0),
+	hitchThreshold(hitchThresholdMs),
+	dirty(false)
+{
+}
+
+// --------------------------------------------------------
+// Adds a frame time to the history, overwriting the oldest
+// once the history is full.
+//
+// milliseconds - How long the frame took
+// --------------------------------------------------------
+bool FrameStats::AddFrame(float milliseconds)
+{
+	frameTimes[nextIndex] = milliseconds;
+	nextIndex = (nextIndex + 1) % (unsigned int)frameTimes.size();
+	count = std::min(count + 1, (unsigned int)frameTimes.size());
+	totalFrames++;
+	dirty = true;
+
+	bool hitch = milliseconds > hitchThreshold;
+	if (hitch)
+		hitchCount++;
+	return hitch;
+}
+
+void FrameStats::Clear()
+{
+	nextIndex = 0;
+	count = 0;
+	totalFrames = 0;
+	hitchCount = 0;
+	sorted.clear();
+	summary = {};
+	dirty = false;
+}
+
+// Getters
+unsigned int FrameStats::Capacity() const { return (unsigned int)frameTimes.size(); }
+unsigned int FrameStats::Count() const { return count; }
+unsigned long long FrameStats::TotalFrames() const { return totalFrames; }
+unsigned long long FrameStats::HitchCount() const { return hitchCount; }
+float FrameStats::GetHitchThreshold() const { return hitchThreshold; }
+const float* FrameStats::Data() const { return frameTimes.data(); }
+
+// Once the ring has wrapped, the oldest frame is the next one to be overwritten
+unsigned int FrameStats::Offset() const { return count < frameTimes.size() ? 0 : nextIndex; }
+
+// Setters
+void FrameStats::SetHitchThreshold(float milliseconds) { hitchThreshold = milliseconds; }
+
+// --------------------------------------------------------
+// Nearest-rank percentile of the stored frame times
+//
+// percent - 0 to 100 (50 = median)
+// --------------------------------------------------------
+float FrameStats::Percentile(float percent) const
+{
+	Refresh();
+	if (sorted.empty())
+		return 0.0f;
+
+	// Multiplied before dividing, so whole ranks stay exact (0.15f * 100
+	// lands just above 15 in floats, which would round up to rank 16)
+	percent = std::clamp(percent, 0.0f, 100.0f);
+	size_t rank = (size_t)std::ceil((double)percent * sorted.size() / 100.0);
+	return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+const FrameStatsSummary& FrameStats::Summary() const
+{
+	Refresh();
+	return summary;
+}
+
+// Re-sorts the history and rebuilds the summary if a frame was added
+void FrameStats::Refresh() const
+{
+	if (!dirty)
+		return;
+	dirty = false;
+
+	// Order doesn't matter for percentiles, so the ring is copied as-is
+	sorted.assign(frameTimes.begin(), frameTimes.begin() + count);
+	std::sort(sorted.begin(), sorted.end());
+
+	summary = {};
+	if (sorted.empty())
+		return;
+
+	double total = 0.0;
+	for (float ms : sorted)
+		total += ms;
+
+	summary.Average = (float)(total / sorted.size());
+	summary.P50 = Percentile(50.0f);
+	summary.P95 = Percentile(95.0f);
+	summary.P99 = Percentile(99.0f);
+	summary.Max = sorted.back();
+}
+
+// --------------------------------------------------------
+// Writes the history as CSV so runs can be compared offline
+//
+// path - File to create (overwritten if it exists)
+// --------------------------------------------------------
+bool FrameStats::ExportCSV(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file.is_open())
+		return false;
+
+	// Frame numbers count from the start of the run, not the history
+	unsigned long long firstFrame = totalFrames - count;
+	unsigned int offset = Offset();
+
+	file << "frame,milliseconds,hitch\n";
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float ms = frameTimes[(offset + i) % frameTimes.size()];
+		file << (firstFrame + i) << "," << ms << "," << (ms > hitchThreshold ? 1 : 0) << "\n";
+	}
+
+	return file.good();
+}
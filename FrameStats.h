@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Summary of everything currently in the history (in ms)
+// --------------------------------------------------------
+struct FrameStatsSummary
+{
+	float Average = 0.0f;
+	float P50 = 0.0f;
+	float P95 = 0.0f;
+	float P99 = 0.0f;
+	float Max = 0.0f;
+};
+
+// --------------------------------------------------------
+// Fixed size history of frame times with percentiles and
+// hitch detection.  No platform or graphics dependencies,
+// so it can be fed from anywhere (including tools).
+// --------------------------------------------------------
+class FrameStats
+{
+public:
+	FrameStats(unsigned int capacity = 4096, float hitchThresholdMs = 33.3f);
+
+	// Records one frame, returning true if it counts as a hitch
+	bool AddFrame(float milliseconds);
+	void Clear();
+
+	// Getters
+	unsigned int Capacity() const;
+	unsigned int Count() const;
+	unsigned long long TotalFrames() const;
+	unsigned long long HitchCount() const;
+	float GetHitchThreshold() const;
+	float Percentile(float percent) const;
+	const FrameStatsSummary& Summary() const;
+
+	// Oldest to newest frame times, laid out for ImGui::PlotLines
+	// (pass Count() as the count and Offset() as the values_offset)
+	const float* Data() const;
+	unsigned int Offset() const;
+
+	// Setters
+	void SetHitchThreshold(float milliseconds);
+
+	// Writes frame index, time and hitch flag, oldest frame first
+	bool ExportCSV(const std::string& path) const;
+
+private:
+	std::vector<float> frameTimes;
+	unsigned int nextIndex;
+	unsigned int count;
+	unsigned long long totalFrames;
+	unsigned long long hitchCount;
+	float hitchThreshold;
+
+	// Percentiles are only worked out again when asked for
+	// after something changed
+	mutable std::vector<float> sorted;
+	mutable FrameStatsSummary summary;
+	mutable bool dirty;
+	void Refresh() const;
+};
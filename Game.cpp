@@ -4,8 +4,15 @@
 #include "Input.h"
 #include "PathHelpers.h"
 #include "Window.h"
+#include "JobSystem.h"
+#include "CpuFeatures.h"
+#include "TextureLoader.h"
+#include "ResourceRegistry.h"
+#include "IBLBaker.h"
+#include "Random.h"
 
 #include <DirectXMath.h>
+#include <algorithm>
 
 // Needed for a helper function to load pre-compiled shader files
 #pragma comment(lib, "d3dcompiler.lib")
@@ -43,15 +50,18 @@ void Game::Initialize()
 		// Tell the input assembler (IA) stage of the pipeline what kind of
 		// geometric primitives (points, lines or triangles) we want to draw.  
 		// Essentially: "What kind of shape should the GPU draw with our vertices?"
-		Graphics::Context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		Graphics::Renderer->SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
 		// Initialize ImGui itself & platform/renderer backends
-		IMGUI_CHECKVERSION();
-		ImGui::CreateContext();
-		ImGui_ImplWin32_Init(Window::Handle());
-		ImGui_ImplDX11_Init(Graphics::Device.Get(), Graphics::Context.Get());
-		// Pick a style
-		ImGui::StyleColorsDark();
+		// (no window to draw it in when running headless)
+		if (!Graphics::IsHeadless()) {
+			IMGUI_CHECKVERSION();
+			ImGui::CreateContext();
+			ImGui_ImplWin32_Init(Window::Handle());
+			ImGui_ImplDX11_Init(Graphics::Device.Get(), Graphics::Context.Get());
+			// Pick a style
+			ImGui::StyleColorsDark();
+		}
 
 		//Create cameras
 		float aspectRatio = (float)Window::Width() / (float)Window::Height();
@@ -79,50 +89,26 @@ void Game::Initialize()
 
 		shadowMapResolution = 1024; //set shadow map resolution
 
+		//occluders are drawn at a quarter of the window size
+		occlusionCuller = std::make_shared<OcclusionCuller>(Window::Width() / 4, Window::Height() / 4);
+
 		//create shadow mapping resources
 		CreateShadowMap();
 		//setup post processing
-		ResetPostProcess();
+		CreatePostProcess();
+		//and the passes of a frame, which use both
+		CreateRenderGraph();
+
+		//packed lights and the lists for clustered lighting, grown as needed
+		lightBuffer = std::make_shared<DynamicStructuredBuffer>((unsigned int)sizeof(PackedLight), 64);
+		clusterRangeBuffer = std::make_shared<DynamicStructuredBuffer>((unsigned int)sizeof(ClusterRange), lightClusters.GetClusterCount());
+		clusterIndexBuffer = std::make_shared<DynamicStructuredBuffer>((unsigned int)sizeof(uint32_t), 1024);
 	}
 }
 
+//States and matrices for the shadow map
+//(the texture comes from the render graph)
 void Game::CreateShadowMap() {
-	//Create a description for the Shadow Map
-	D3D11_TEXTURE2D_DESC shadowDesc = {};
-	shadowDesc.Width = shadowMapResolution; //ideally a power of 2 (like 1024)
-	shadowDesc.Height = shadowMapResolution; //ideally a power of 2 (like 1024)
-	shadowDesc.ArraySize = 1;
-	shadowDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
-	shadowDesc.CPUAccessFlags = 0;
-	shadowDesc.Format = DXGI_FORMAT_R32_TYPELESS;
-	shadowDesc.MipLevels = 1;
-	shadowDesc.MiscFlags = 0;
-	shadowDesc.SampleDesc.Count = 1;
-	shadowDesc.SampleDesc.Quality = 0;
-	shadowDesc.Usage = D3D11_USAGE_DEFAULT;
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowTexture;
-	Graphics::Device->CreateTexture2D(&shadowDesc, 0, shadowTexture.GetAddressOf());
-
-	//Create the depth/stencil view
-	D3D11_DEPTH_STENCIL_VIEW_DESC shadowDSDesc = {};
-	shadowDSDesc.Format = DXGI_FORMAT_D32_FLOAT;
-	shadowDSDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D; //2d in our case
-	shadowDSDesc.Texture2D.MipSlice = 0; //depth to mip map (none for this)
-	Graphics::Device->CreateDepthStencilView(
-		shadowTexture.Get(),
-		&shadowDSDesc,
-		shadowDSV.GetAddressOf());
-	//Create the SRV for the shadow map
-	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Format = DXGI_FORMAT_R32_FLOAT; //format specific for depth
-	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MipLevels = 1;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	Graphics::Device->CreateShaderResourceView(
-		shadowTexture.Get(),
-		&srvDesc,
-		shadowSRV.GetAddressOf());
-
 	//create the rasterizer state for a shadow map
 	D3D11_RASTERIZER_DESC shadowRastDesc = {};
 	shadowRastDesc.FillMode = D3D11_FILL_SOLID;
@@ -162,57 +148,137 @@ void Game::CreateShadowMap() {
 
 }
 
-//Setup the Sampler and texture descriptions
-//for post process effects
-//should be called when screen resizes
-void Game::ResetPostProcess() {
-	//reset them if they exist
-	ppSRV.Reset();
-	ppRTV.Reset();
-
-	// Sampler state for post processing
-	D3D11_SAMPLER_DESC ppSampDesc = {};
-	ppSampDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
-	ppSampDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
-	ppSampDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
-	ppSampDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
-	ppSampDesc.MaxLOD = D3D11_FLOAT32_MAX;
-	Graphics::Device->CreateSamplerState(&ppSampDesc, ppSampler.GetAddressOf());
-
-	// Describe the texture we're creating
-	D3D11_TEXTURE2D_DESC textureDesc = {};
-	textureDesc.Width = Window::Width();
-	textureDesc.Height = Window::Height();
-	textureDesc.ArraySize = 1;
-	textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-	textureDesc.CPUAccessFlags = 0;
-	textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	textureDesc.MipLevels = 1;
-	textureDesc.MiscFlags = 0;
-	textureDesc.SampleDesc.Count = 1;
-	textureDesc.SampleDesc.Quality = 0;
-	textureDesc.Usage = D3D11_USAGE_DEFAULT;
-
-	// Create the resource (no need to track it after the views are created below)
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> ppTexture;
-	Graphics::Device->CreateTexture2D(&textureDesc, 0, ppTexture.GetAddressOf());
-
-	// Create the Render Target View
-	D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
-	rtvDesc.Format = textureDesc.Format;
-	rtvDesc.Texture2D.MipSlice = 0;
-	rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
-	Graphics::Device->CreateRenderTargetView(
-		ppTexture.Get(),
-		&rtvDesc,
-		ppRTV.ReleaseAndGetAddressOf());
-	// Create the Shader Resource View
-	// By passing it a null description for the SRV, we
-	// get a "default" SRV that has access to the entire resource
-	Graphics::Device->CreateShaderResourceView(
-		ppTexture.Get(),
-		0,
-		ppSRV.ReleaseAndGetAddressOf());
+//Sets up the post process passes, in the order they run
+//render targets come from the post processor's pool,
+//so nothing has to be recreated when the screen resizes
+void Game::CreatePostProcess() {
+	postProcessor = std::make_shared<PostProcessor>(ppVS);
+
+	//separable blur, at a fraction of the screen size if asked
+	//one pixel shader for both directions
+	auto blurPixels = [this](const PostProcessContext& context, int vertical, int radius) {
+		context.FullscreenVS->SetShader();
+		ppPS->SetShader();
+		ppPS->SetSamplerState("ClampSampler", context.ClampSampler);
+		ppPS->SetShaderResourceView("Pixels", context.Inputs[0]);
+		ppPS->SetInt("blurRadius", radius);
+		ppPS->SetInt("vertical", vertical);
+		//steps are a pixel of what's being drawn, not read
+		ppPS->SetFloat("pixelWidth", 1.0f / context.Width);
+		ppPS->SetFloat("pixelHeight", 1.0f / context.Height);
+		context.FullscreenVS->CopyAllBufferData();
+		ppPS->CopyAllBufferData();
+		Graphics::Renderer->Draw(3); // Draw exactly 3 vertices (one triangle)
+	};
+	auto scaledRadius = [this](float scale) {
+		return (int)(blurRadius * scale + 0.5f);
+	};
+
+	PostProcessPass pass;
+	pass.Name = "Blur Rows";
+	blurRowsPass = postProcessor->AddPass(pass, [this, blurPixels, scaledRadius](const PostProcessContext& context) {
+		blurPixels(context, 0, scaledRadius(postProcessor->GetPass(blurRowsPass).Scale));
+	});
+	pass.Name = "Blur Columns";
+	blurColumnsPass = postProcessor->AddPass(pass, [this, blurPixels, scaledRadius](const PostProcessContext& context) {
+		blurPixels(context, 1, scaledRadius(postProcessor->GetPass(blurColumnsPass).Scale));
+	});
+
+	//sliding window: one thread per row, then one per column
+	auto blurCompute = [this](const PostProcessContext& context, int vertical) {
+		blurCS->SetShader();
+		blurCS->SetInt("blurRadius", blurRadius);
+		blurCS->SetInt("vertical", vertical);
+		blurCS->SetInt("width", context.Width);
+		blurCS->SetInt("height", context.Height);
+		blurCS->SetShaderResourceView("Pixels", context.Inputs[0]);
+		blurCS->SetUnorderedAccessView("Blurred", context.OutputUAV);
+		blurCS->CopyAllBufferData();
+		//64 threads per group in BoxBlurCS
+		Graphics::Renderer->Dispatch(((vertical ? context.Width : context.Height) + 63) / 64, 1, 1);
+	};
+	pass.Compute = true;
+	pass.Name = "Blur Rows (compute)";
+	blurRowsCSPass = postProcessor->AddPass(pass, [blurCompute](const PostProcessContext& context) {
+		blurCompute(context, 0);
+	});
+	pass.Name = "Blur Columns (compute)";
+	blurColumnsCSPass = postProcessor->AddPass(pass, [blurCompute](const PostProcessContext& context) {
+		blurCompute(context, 1);
+	});
+
+	//a blur of nothing is a copy (scaled up with the clamp sampler)
+	pass.Compute = false;
+	pass.Name = "Copy";
+	copyPass = postProcessor->AddPass(pass, [blurPixels](const PostProcessContext& context) {
+		blurPixels(context, 1, 0);
+	});
+}
+
+//Declares the passes of a frame and the textures between them
+//the graph culls, orders resource lifetimes and binds targets,
+//so passes only draw (see RenderGraph)
+void Game::CreateRenderGraph() {
+	renderGraph = std::make_shared<RenderGraphExecutor>();
+	RenderGraph& graph = renderGraph->GetGraph();
+
+	//textures only alive during the frame
+	RenderTargetDesc shadowDesc;
+	shadowDesc.Width = shadowMapResolution;
+	shadowDesc.Height = shadowMapResolution;
+	shadowDesc.Format = RenderTargetFormat::D32;
+	shadowMapResource = graph.CreateTexture("Shadow Map", shadowDesc);
+
+	RenderTargetDesc sceneDesc; //sized to the window every frame
+	sceneDesc.Width = Window::Width();
+	sceneDesc.Height = Window::Height();
+	sceneColorResource = graph.CreateTexture("Scene Color", sceneDesc);
+
+	//made by Graphics, cleared at the start of the frame
+	depthBufferResource = graph.ImportTexture("Depth Buffer");
+	backBufferResource = graph.ImportTexture("Back Buffer");
+
+	unsigned int pass = renderGraph->AddPass("Shadow Map", [this](const RenderGraphContext& context) {
+		DrawShadowMap(context);
+	});
+	graph.WriteDepth(pass, shadowMapResource);
+
+	//the shadow map is t4 or t5 depending on the material's shader
+	pass = renderGraph->AddPass("Scene", [this](const RenderGraphContext& context) {
+		DrawScene(context);
+	});
+	graph.Read(pass, shadowMapResource, 5);
+	graph.Write(pass, sceneColorResource);
+	graph.WriteDepth(pass, depthBufferResource);
+
+	pass = renderGraph->AddPass("Sky", [this](const RenderGraphContext& context) {
+		defaultSky->Draw(cams[activeCam]);
+	});
+	graph.Write(pass, sceneColorResource);
+	graph.WriteDepth(pass, depthBufferResource);
+
+	pass = renderGraph->AddPass("Particles", [this](const RenderGraphContext& context) {
+		DrawParticles(frameTotalTime);
+	});
+	graph.Write(pass, sceneColorResource);
+	graph.WriteDepth(pass, depthBufferResource);
+
+	pass = renderGraph->AddPass("Post Process", [this](const RenderGraphContext& context) {
+		DrawPostProcess(context);
+	});
+	graph.Read(pass, sceneColorResource, 0);
+	graph.Write(pass, backBufferResource);
+
+	// UI is drawn last so it is on top
+	//(it shows the shadow map and the scene too)
+	pass = renderGraph->AddPass("UI", [this](const RenderGraphContext& context) {
+		if (!Graphics::IsHeadless()) {
+			DrawUI();
+		}
+	});
+	graph.Read(pass, shadowMapResource, 0);
+	graph.Read(pass, sceneColorResource, 0);
+	graph.Write(pass, backBufferResource);
 }
 
 
@@ -225,34 +291,40 @@ void Game::ResetPostProcess() {
 Game::~Game()
 {
 	// ImGui clean up
-	ImGui_ImplDX11_Shutdown();
-	ImGui_ImplWin32_Shutdown();
-	ImGui::DestroyContext();
+	if (!Graphics::IsHeadless()) {
+		ImGui_ImplDX11_Shutdown();
+		ImGui_ImplWin32_Shutdown();
+		ImGui::DestroyContext();
+	}
+
+	//drop the registry's handles before the device goes away
+	ResourceRegistry::Clear();
 }
 
 
 void Game::DrawParticles(float totalTime)
 {
+	PROFILE_SCOPE("Game::DrawParticles");
+
 	// Particle drawing =============
 	{
 
-		// Particle states
-		Graphics::Context->OMSetBlendState(particleBlendState.Get(), 0, 0xffffffff);	// Additive blending
-		Graphics::Context->OMSetDepthStencilState(particleDepthState.Get(), 0);		// No depth WRITING
+		// Particle states (the arena sets additive or alpha blending per draw)
+		Graphics::Renderer->SetDepthStencilState(particleDepthState.Get());		// No depth WRITING
 
-		particleSystem->Draw(cams[activeCam], totalTime, false);
+		particleArena->Draw(emitters, cams[activeCam], false);
 
 		// Should we also draw them in wireframe?
 		if (Input::KeyDown('C'))
 		{
-			Graphics::Context->RSSetState(particleDebugRasterState.Get());
-			particleSystem->Draw(cams[activeCam], totalTime, true);
+			Graphics::Renderer->SetRasterizerState(particleDebugRasterState.Get());
+			particleArena->Draw(emitters, cams[activeCam], true);
 		}
 
 		// Reset to default states for next frame
-		Graphics::Context->OMSetBlendState(0, 0, 0xffffffff);
-		Graphics::Context->OMSetDepthStencilState(0, 0);
-		Graphics::Context->RSSetState(0);
+		Graphics::Renderer->SetBlendState(0);
+		Graphics::Renderer->SetDepthStencilState(0);
+		Graphics::Renderer->SetRasterizerState(0);
 	}
 }
 
@@ -263,27 +335,28 @@ void Game::CreateGeometry()
 {
 	//Create shaders
 	//one texture, no normal map
-	std::shared_ptr<SimpleVertexShader> basicVertexShader = std::make_shared<SimpleVertexShader>(Graphics::Device, Graphics::Context, FixPath(L"VertexShader.cso").c_str());
-	std::shared_ptr<SimplePixelShader> basicPixelShader = std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"PixelShader.cso").c_str());
+	std::shared_ptr<SimpleVertexShader> basicVertexShader = ResourceRegistry::GetVertexShader(FixPath(L"VertexShader.cso"));
+	std::shared_ptr<SimplePixelShader> basicPixelShader = ResourceRegistry::GetPixelShader(FixPath(L"PixelShader.cso"));
 
 	//two textures, no normal map
-	std::shared_ptr<SimplePixelShader> twoTexturePS = std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"TwoTexturePS.cso").c_str());
+	std::shared_ptr<SimplePixelShader> twoTexturePS = ResourceRegistry::GetPixelShader(FixPath(L"TwoTexturePS.cso"));
 
 	//one texture with normal map
-	std::shared_ptr<SimpleVertexShader> normalMapVS = std::make_shared<SimpleVertexShader>(Graphics::Device, Graphics::Context, FixPath(L"NormalMapVS.cso").c_str());
-	std::shared_ptr<SimplePixelShader> normalMapPS = std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"NormalMapPS.cso").c_str());
-	std::shared_ptr<SimplePixelShader> normalMapSkyPS = std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"NormalMapSkyPS.cso").c_str()); //reflect sky on objects
+	std::shared_ptr<SimpleVertexShader> normalMapVS = ResourceRegistry::GetVertexShader(FixPath(L"NormalMapVS.cso"));
+	std::shared_ptr<SimplePixelShader> normalMapPS = ResourceRegistry::GetPixelShader(FixPath(L"NormalMapPS.cso"));
+	std::shared_ptr<SimplePixelShader> normalMapSkyPS = ResourceRegistry::GetPixelShader(FixPath(L"NormalMapSkyPS.cso")); //reflect sky on objects
 
-	std::shared_ptr<SimplePixelShader> PBRPixelShader = std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"PBRPixelShader.cso").c_str()); //physically based
-	std::shared_ptr<SimplePixelShader> parallaxPixelShader = std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"ParallaxPS.cso").c_str()); //parallax
+	std::shared_ptr<SimplePixelShader> PBRPixelShader = ResourceRegistry::GetPixelShader(FixPath(L"PBRPixelShader.cso")); //physically based
+	std::shared_ptr<SimplePixelShader> parallaxPixelShader = ResourceRegistry::GetPixelShader(FixPath(L"ParallaxPS.cso")); //parallax
 
 	//shadows
-	shadowMapVS = std::make_shared<SimpleVertexShader>(Graphics::Device, Graphics::Context, FixPath(L"ShadowMapVS.cso").c_str());
-	shadowMapPS = std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"ShadowMapPS.cso").c_str());
+	shadowMapVS = ResourceRegistry::GetVertexShader(FixPath(L"ShadowMapVS.cso"));
+	shadowMapPS = ResourceRegistry::GetPixelShader(FixPath(L"ShadowMapPS.cso"));
 
 	//post processing
-	ppVS = std::make_shared<SimpleVertexShader>(Graphics::Device, Graphics::Context, FixPath(L"BlurPPVS.cso").c_str());
-	ppPS = std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"BlurPPPS.cso").c_str());
+	ppVS = ResourceRegistry::GetVertexShader(FixPath(L"BlurPPVS.cso"));
+	ppPS = ResourceRegistry::GetPixelShader(FixPath(L"BlurPPPS.cso"));
+	blurCS = std::make_shared<SimpleComputeShader>(Graphics::Device, Graphics::Context, FixPath(L"BoxBlurCS.cso").c_str());
 
 
 	//Give data to lights
@@ -332,30 +405,25 @@ void Game::CreateGeometry()
 
 	//Add lights to vector
 	lights.insert(lights.end(), { directionLight1, spotLight1, spotLight2 });
+	sceneLightCount = lights.size();
 
 	//Load textures
 	//create SRVs for textures
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> concreteSRV;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> concreteNormalsSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> concreteMetalSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> concreteRoughnessSRV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> concretePackedSRV;
 
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedSRV;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedNormalsSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedMetalSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedRoughnessSRV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedPackedSRV;
 
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>paintSRV;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>paintNormalsSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>paintMetalSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>paintRoughnessSRV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>paintPackedSRV;
 
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>roughSRV;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>roughNormalsSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>roughMetalSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>roughRoughnessSRV;
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>heightSRV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>roughPackedSRV;
 
 	//Define Sampler State
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampleState;
@@ -370,48 +438,105 @@ void Game::CreateGeometry()
 
 	Graphics::Device->CreateSamplerState(&sampleDesc, sampleState.GetAddressOf()); //set sample state
 
-	//Load textures (albedo)
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/concrete_albedo.png").c_str(), 0, concreteSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/scratched_albedo.png").c_str(), 0, scratchedSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/paint_albedo.png").c_str(), 0, paintSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/rough_albedo.png").c_str(), 0, roughSRV.GetAddressOf());
+	//Load every texture at once: files are read and decoded as jobs
+	//and uploaded here as each one is ready (see TextureLoader)
+	TextureLoader textureLoader;
+	//cooked (.dds) textures only load their small mips here, see Update()
+	textureStreamer = std::make_shared<TextureStreamer>(48 * 1024 * 1024);
+	textureLoader.SetStreamer(textureStreamer.get());
+	//Load albedo
+	unsigned int concreteTexture = textureLoader.Add(FixPath(L"../../Assets/Textures/concrete_albedo.png"));
+	unsigned int scratchedTexture = textureLoader.Add(FixPath(L"../../Assets/Textures/scratched_albedo.png"));
+	unsigned int paintTexture = textureLoader.Add(FixPath(L"../../Assets/Textures/paint_albedo.png"));
+	unsigned int roughTexture = textureLoader.Add(FixPath(L"../../Assets/Textures/rough_albedo.png"));
 	//Load normal maps
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/concrete_normals.png").c_str(), 0, concreteNormalsSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/scratched_normals.png").c_str(), 0, scratchedNormalsSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/paint_normals.png").c_str(), 0, paintNormalsSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/rough_normals.png").c_str(), 0, roughNormalsSRV.GetAddressOf());
-	//Load metalness
-	//CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/bronze_metal.png").c_str(), 0, bronzeMetalSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/scratched_metal.png").c_str(), 0, scratchedMetalSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/rough_metal.png").c_str(), 0, roughMetalSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/paint_metal.png").c_str(), 0, paintMetalSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/concrete_metal.png").c_str(), 0, concreteMetalSRV.GetAddressOf());
-	//Load roughness
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/concrete_roughness.png").c_str(), 0, concreteRoughnessSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/scratched_roughness.png").c_str(), 0, scratchedRoughnessSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/paint_roughness.png").c_str(), 0, paintRoughnessSRV.GetAddressOf());
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/rough_roughness.png").c_str(), 0, roughRoughnessSRV.GetAddressOf());
-	//Load Height Map
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/concrete_height.png").c_str(), 0, heightSRV.GetAddressOf());
+	unsigned int concreteNormalsTexture = textureLoader.Add(FixPath(L"../../Assets/Textures/concrete_normals.png"));
+	unsigned int scratchedNormalsTexture = textureLoader.Add(FixPath(L"../../Assets/Textures/scratched_normals.png"));
+	unsigned int paintNormalsTexture = textureLoader.Add(FixPath(L"../../Assets/Textures/paint_normals.png"));
+	unsigned int roughNormalsTexture = textureLoader.Add(FixPath(L"../../Assets/Textures/rough_normals.png"));
+	//Load roughness + metalness (+ height for parallax) packed into one texture each
+	//uses the "_packed.dds" made by -cook, or packs the separate maps while loading
+	unsigned int concretePackedTexture = textureLoader.AddPacked(FixPath(L"../../Assets/Textures/concrete_packed.dds"), {
+		FixPath(L"../../Assets/Textures/concrete_roughness.png"),
+		FixPath(L"../../Assets/Textures/concrete_metal.png"),
+		FixPath(L"../../Assets/Textures/concrete_height.png") });
+	unsigned int scratchedPackedTexture = textureLoader.AddPacked(FixPath(L"../../Assets/Textures/scratched_packed.dds"), {
+		FixPath(L"../../Assets/Textures/scratched_roughness.png"),
+		FixPath(L"../../Assets/Textures/scratched_metal.png") });
+	unsigned int paintPackedTexture = textureLoader.AddPacked(FixPath(L"../../Assets/Textures/paint_packed.dds"), {
+		FixPath(L"../../Assets/Textures/paint_roughness.png"),
+		FixPath(L"../../Assets/Textures/paint_metal.png") });
+	unsigned int roughPackedTexture = textureLoader.AddPacked(FixPath(L"../../Assets/Textures/rough_packed.dds"), {
+		FixPath(L"../../Assets/Textures/rough_roughness.png"),
+		FixPath(L"../../Assets/Textures/rough_metal.png") });
+
+	//Sky faces (no mips needed) and the particle sprite sheet
+	unsigned int skyTextures[6] = {
+		textureLoader.Add(FixPath(L"../../Assets/Skyboxes/Pink/right.png"), false),
+		textureLoader.Add(FixPath(L"../../Assets/Skyboxes/Pink/left.png"), false),
+		textureLoader.Add(FixPath(L"../../Assets/Skyboxes/Pink/up.png"), false),
+		textureLoader.Add(FixPath(L"../../Assets/Skyboxes/Pink/down.png"), false),
+		textureLoader.Add(FixPath(L"../../Assets/Skyboxes/Pink/front.png"), false),
+		textureLoader.Add(FixPath(L"../../Assets/Skyboxes/Pink/back.png"), false) };
+	unsigned int fireSpriteSheetTexture = textureLoader.Add(FixPath(L"../../Assets/Textures/explosion_spritesheet.png"));
+
+	textureLoader.LoadAll();
+	textureLoadTimings = textureLoader.GetTimings();
+	textureLoadMs = textureLoader.GetTotalMs();
+	printf("Loaded %u textures in %.1f ms\n", (unsigned int)textureLoadTimings.size(), textureLoadMs);
+
+	concreteSRV = textureLoader.GetSRV(concreteTexture);
+	scratchedSRV = textureLoader.GetSRV(scratchedTexture);
+	paintSRV = textureLoader.GetSRV(paintTexture);
+	roughSRV = textureLoader.GetSRV(roughTexture);
+	concreteNormalsSRV = textureLoader.GetSRV(concreteNormalsTexture);
+	scratchedNormalsSRV = textureLoader.GetSRV(scratchedNormalsTexture);
+	paintNormalsSRV = textureLoader.GetSRV(paintNormalsTexture);
+	roughNormalsSRV = textureLoader.GetSRV(roughNormalsTexture);
+	concretePackedSRV = textureLoader.GetSRV(concretePackedTexture);
+	scratchedPackedSRV = textureLoader.GetSRV(scratchedPackedTexture);
+	paintPackedSRV = textureLoader.GetSRV(paintPackedTexture);
+	roughPackedSRV = textureLoader.GetSRV(roughPackedTexture);
 
 	//create pointers to meshes
-	std::shared_ptr<Mesh> cubeMesh = std::make_shared<Mesh>(FixPath("../../Assets/Models/cube.obj").c_str());
-	std::shared_ptr<Mesh> cylinderMesh = std::make_shared<Mesh>(FixPath("../../Assets/Models/cylinder.obj").c_str());
-	std::shared_ptr<Mesh> helixMesh = std::make_shared<Mesh>(FixPath("../../Assets/Models/helix.obj").c_str());
-	std::shared_ptr<Mesh> sphereMesh = std::make_shared<Mesh>(FixPath("../../Assets/Models/sphere.obj").c_str());
-	std::shared_ptr<Mesh> torusMesh = std::make_shared<Mesh>(FixPath("../../Assets/Models/torus.obj").c_str());
-	std::shared_ptr<Mesh> quadMesh = std::make_shared<Mesh>(FixPath("../../Assets/Models/quad.obj").c_str());
-	std::shared_ptr<Mesh> quad2sidedMesh = std::make_shared<Mesh>(FixPath("../../Assets/Models/quad_double_sided.obj").c_str());
+	std::shared_ptr<Mesh> cubeMesh = ResourceRegistry::GetMesh(FixPath(L"../../Assets/Models/cube.obj"));
+	std::shared_ptr<Mesh> cylinderMesh = ResourceRegistry::GetMesh(FixPath(L"../../Assets/Models/cylinder.obj"));
+	std::shared_ptr<Mesh> helixMesh = ResourceRegistry::GetMesh(FixPath(L"../../Assets/Models/helix.obj"));
+	std::shared_ptr<Mesh> sphereMesh = ResourceRegistry::GetMesh(FixPath(L"../../Assets/Models/sphere.obj"));
+	std::shared_ptr<Mesh> torusMesh = ResourceRegistry::GetMesh(FixPath(L"../../Assets/Models/torus.obj"));
+	std::shared_ptr<Mesh> quadMesh = ResourceRegistry::GetMesh(FixPath(L"../../Assets/Models/quad.obj"));
+	std::shared_ptr<Mesh> quad2sidedMesh = ResourceRegistry::GetMesh(FixPath(L"../../Assets/Models/quad_double_sided.obj"));
 
 
 	//create sky
-	defaultSky = std::make_shared<Sky>(cubeMesh, sampleState,
-		FixPath(L"../../Assets/Skyboxes/Pink/right.png").c_str(),
-		FixPath(L"../../Assets/Skyboxes/Pink/left.png").c_str(),
-		FixPath(L"../../Assets/Skyboxes/Pink/up.png").c_str(),
-		FixPath(L"../../Assets/Skyboxes/Pink/down.png").c_str(),
-		FixPath(L"../../Assets/Skyboxes/Pink/front.png").c_str(),
-		FixPath(L"../../Assets/Skyboxes/Pink/back.png").c_str());
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> skyFaces[6];
+	for (int i = 0; i < 6; i++) {
+		skyFaces[i] = textureLoader.GetTexture(skyTextures[i]);
+	}
+	defaultSky = std::make_shared<Sky>(cubeMesh, sampleState, skyFaces);
+
+	//bake lighting from the sky, unless the cache was made from the same faces
+	std::filesystem::path skyFacePaths[6] = {
+		FixPath(L"../../Assets/Skyboxes/Pink/right.png"),
+		FixPath(L"../../Assets/Skyboxes/Pink/left.png"),
+		FixPath(L"../../Assets/Skyboxes/Pink/up.png"),
+		FixPath(L"../../Assets/Skyboxes/Pink/down.png"),
+		FixPath(L"../../Assets/Skyboxes/Pink/front.png"),
+		FixPath(L"../../Assets/Skyboxes/Pink/back.png") };
+	std::filesystem::path iblCachePath = FixPath(L"../../Assets/Skyboxes/Pink/ibl.bin");
+	uint64_t iblStart = Profiler::Now();
+	uint64_t skyStamp = IBLBaker::SourceStamp(skyFacePaths);
+	IBLData ibl;
+	iblFromCache = IBLBaker::Load(iblCachePath, skyStamp, ibl);
+	if (!iblFromCache) {
+		CubeImage skyImage;
+		IBLBaker::LoadFaces(skyFacePaths, 256, skyImage);
+		IBLBaker::Bake(skyImage, ibl);
+		IBLBaker::Save(iblCachePath, ibl, skyStamp);
+	}
+	defaultSky->SetIBL(ibl);
+	iblMs = Profiler::TicksToMilliseconds(Profiler::Now() - iblStart);
+	printf("%s sky lighting in %.1f ms\n", iblFromCache ? "Loaded" : "Baked", iblMs);
 
 	//add all meshes to vector
 	meshes.insert(meshes.end(), { cubeMesh, cylinderMesh, helixMesh, sphereMesh, torusMesh, quadMesh, quad2sidedMesh });
@@ -424,28 +549,32 @@ void Game::CreateGeometry()
 	//add samplers to materials
 	matConcretePBR->AddTextureSRV("Albedo", concreteSRV);
 	matConcretePBR->AddTextureSRV("NormalMap", concreteNormalsSRV);
-	matConcretePBR->AddTextureSRV("RoughnessMap", concreteRoughnessSRV);
-	matConcretePBR->AddTextureSRV("MetalnessMap", concreteMetalSRV);
-	matConcretePBR->AddTextureSRV("HeightMap", heightSRV);
+	matConcretePBR->AddTextureSRV("PackedMap", concretePackedSRV);
+	matConcretePBR->SetPackedMaps(true);
 
 	//do it again for scratched metal
 	matScratchedPBR->AddSampler("BasicSampler", sampleState);
 	matScratchedPBR->AddTextureSRV("Albedo", scratchedSRV);
 	matScratchedPBR->AddTextureSRV("NormalMap", scratchedNormalsSRV);
-	matScratchedPBR->AddTextureSRV("RoughnessMap", scratchedRoughnessSRV);
-	matScratchedPBR->AddTextureSRV("MetalnessMap", scratchedMetalSRV);
+	matScratchedPBR->AddTextureSRV("PackedMap", scratchedPackedSRV);
+	matScratchedPBR->SetPackedMaps(true);
 
 	matPaintPBR->AddSampler("BasicSampler", sampleState);
 	matPaintPBR->AddTextureSRV("Albedo", paintSRV);
 	matPaintPBR->AddTextureSRV("NormalMap", paintNormalsSRV);
-	matPaintPBR->AddTextureSRV("RoughnessMap", paintRoughnessSRV);
-	matPaintPBR->AddTextureSRV("MetalnessMap", paintMetalSRV);
+	matPaintPBR->AddTextureSRV("PackedMap", paintPackedSRV);
+	matPaintPBR->SetPackedMaps(true);
 
 	matRoughPBR->AddSampler("BasicSampler", sampleState);
 	matRoughPBR->AddTextureSRV("Albedo", roughSRV);
 	matRoughPBR->AddTextureSRV("NormalMap", roughNormalsSRV);
-	matRoughPBR->AddTextureSRV("RoughnessMap", roughRoughnessSRV);
-	matRoughPBR->AddTextureSRV("MetalnessMap", roughMetalSRV);
+	matRoughPBR->AddTextureSRV("PackedMap", roughPackedSRV);
+	matRoughPBR->SetPackedMaps(true);
+
+	//streamed textures get swapped in these materials as their mips change
+	for (auto& material : { matConcretePBR, matScratchedPBR, matPaintPBR, matRoughPBR }) {
+		textureStreamer->BindMaterial(material);
+	}
 
 	//create initial entities
 	entities.push_back(std::make_shared<Entity>(meshes[0], matScratchedPBR));
@@ -460,18 +589,21 @@ void Game::CreateGeometry()
 	// Particles
 
 	// Grab loaded particle resources
-	std::shared_ptr<SimpleVertexShader> particleVS = std::make_shared<SimpleVertexShader>(Graphics::Device, Graphics::Context, FixPath(L"ParticleVS.cso").c_str());
-	std::shared_ptr<SimplePixelShader> particlePS = std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"ParticlePS.cso").c_str());
+	std::shared_ptr<SimpleVertexShader> particleVS = ResourceRegistry::GetVertexShader(FixPath(L"ParticleVS.cso"));
+	std::shared_ptr<SimplePixelShader> particlePS = ResourceRegistry::GetPixelShader(FixPath(L"ParticlePS.cso"));
 
 	// Create Particle Material
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> fireSpriteSheetSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), FixPath(L"../../Assets/Textures/explosion_spritesheet.png").c_str(), 0, fireSpriteSheetSRV.GetAddressOf());
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> fireSpriteSheetSRV = textureLoader.GetSRV(fireSpriteSheetTexture);
 	std::shared_ptr<Material> fireMat = std::make_shared<Material>(particleVS, particlePS, XMFLOAT3(1, 1, 1));
 	// Add smapler and texture
 	fireMat->AddSampler("BasicSampler", sampleState);
 	fireMat->AddTextureSRV("Particle", fireSpriteSheetSRV);
 
-	particleSystem = std::make_shared<Emitter>(
+	// Every emitter's particles live here (and draw together)
+	particleArena = std::make_shared<ParticleArena>();
+	particleBudget = std::make_shared<ParticleBudget>();
+
+	emitters.push_back(std::make_shared<Emitter>(
 		1000,                          // maxParticles
 		100,                            // particlesPerSecond  
 		1.0f,                          // lifetime
@@ -488,12 +620,13 @@ void Game::CreateGeometry()
 		XMFLOAT2(0.0f, XM_2PI),        // rotationEndMinMax
 		XMFLOAT3(0.0f, 0.5f, 0.0f),   // acceleration
 		fireMat,                   // material
+		particleArena,             // arena
 		5,                             // spriteSheetWidth
 		5,                             // spriteSheetHeight
 		1.0f,                          // spriteSheetSpeedScale
 		false,                         // paused
 		true                           // visible
-	);
+	));
 
 	// A depth state for the particles
 	D3D11_DEPTH_STENCIL_DESC dsDesc = {};
@@ -516,6 +649,12 @@ void Game::CreateGeometry()
 	blend.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
 	Graphics::Device->CreateBlendState(&blend, particleBlendState.GetAddressOf());
 
+	// Blend for sorted particles (regular alpha blending, drawn back to front)
+	blend.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+	blend.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+	Graphics::Device->CreateBlendState(&blend, particleAlphaBlendState.GetAddressOf());
+	particleArena->SetBlendStates(particleBlendState.Get(), particleAlphaBlendState.Get());
+
 	// Debug rasterizer state for particles
 	D3D11_RASTERIZER_DESC rd = {};
 	rd.CullMode = D3D11_CULL_BACK;
@@ -540,6 +679,10 @@ void Game::CreateGeometry()
 	floor->GetTransform().SetScale(XMFLOAT3(15.0f, 1.0f, 15.0f));
 	floor->GetTransform().MoveAbsolute(XMFLOAT3(0.0f, -2.0f, 0.0f));
 	entities.push_back(floor);
+
+	//big, simple shapes make the best occluders
+	floor->SetOccluder(true);
+	entities[0]->SetOccluder(true); //cube
 }
 
 
@@ -558,11 +701,63 @@ void Game::OnResize()
 		cams[i]->UpdateProjectionMatrix(aspectRatio);
 	}
 
-	//null check
-	if (Graphics::Device) {
-		//reset post process
-		ResetPostProcess();
+	if (occlusionCuller) {
+		occlusionCuller->Resize(Window::Width() / 4, Window::Height() / 4);
+	}
+}
+
+// --------------------------------------------------------
+// Renders the current scene with the software rasterizer
+// from the active camera and writes it to disk.  Textures,
+// shadows, the sky and particles are left out, so this is
+// a reference for geometry and direct lighting only.
+// --------------------------------------------------------
+const SoftwareRasterTimings& Game::RenderReference(const std::string& path)
+{
+	PROFILE_FUNCTION();
+
+	if (!referenceRasterizer) {
+		referenceRasterizer = std::make_shared<SoftwareRasterizer>(Window::Width(), Window::Height());
+	}
+	else if (referenceRasterizer->GetWidth() != Window::Width() || referenceRasterizer->GetHeight() != Window::Height()) {
+		referenceRasterizer->Resize(Window::Width(), Window::Height());
+	}
+
+	//one draw per entity, all pointing at the meshes' own CPU copies
+	std::vector<SoftwareRasterDraw> draws;
+	draws.reserve(entities.size());
+	for (std::shared_ptr<Entity>& entity : entities) {
+		std::shared_ptr<Mesh> mesh = entity->GetMesh();
+		std::shared_ptr<Material> mat = entity->GetMaterial();
+
+		SoftwareRasterDraw draw;
+		draw.Vertices = mesh->GetVertices().data();
+		draw.VertexCount = (unsigned int)mesh->GetVertices().size();
+		draw.Indices = mesh->GetIndices().data();
+		draw.IndexCount = (unsigned int)mesh->GetIndices().size();
+		draw.World = entity->GetTransform().GetWorldMatrix();
+		draw.WorldInverseTranspose = entity->GetTransform().GetWorldInverseTransposeMatrix();
+		draw.Color = mat->GetColor();
+		draw.Roughness = mat->GetRoughness();
+		draws.push_back(draw);
 	}
+
+	std::shared_ptr<Camera> cam = cams[activeCam];
+	referenceRasterizer->Render(
+		draws,
+		cam->GetView(),
+		cam->GetProjection(),
+		cam->GetTransform().GetPosition(),
+		lightPacker.GetLights(), //same packed lights the shaders got this frame
+		lightPacker.GetCounts(),
+		XMFLOAT3(color[0], color[1], color[2]));
+
+	//pick the format from the extension, png otherwise
+	bool ppm = path.size() >= 4 && path.compare(path.size() - 4, 4, ".ppm") == 0;
+	bool saved = ppm ? referenceRasterizer->SavePPM(path) : referenceRasterizer->SavePNG(path);
+	referencePath = saved ? path : "";
+
+	return referenceRasterizer->GetTimings();
 }
 
 void Game::UpdateUI(float deltaTime)
@@ -592,8 +787,18 @@ void Game::UpdateUI(float deltaTime)
 // --------------------------------------------------------
 void Game::Update(float deltaTime, float totalTime)
 {
+	PROFILE_SCOPE("Game::Update");
+
+	//deltaTime covers the previous frame, which is also the profiler's last frame
+	if (frameStats.AddFrame(deltaTime * 1000.0f)) {
+		hitchSnapshot = Profiler::LastFrame();
+		hasHitchSnapshot = true;
+	}
+
 	// Must be done at very beginning so UI is up to date
-	UpdateUI(deltaTime);
+	if (!Graphics::IsHeadless()) {
+		UpdateUI(deltaTime);
+	}
 
 	//Only update active camera
 	cams[activeCam]->Update(deltaTime);
@@ -604,31 +809,236 @@ void Game::Update(float deltaTime, float totalTime)
 	//	entities[i]->GetTransform().Rotate(XMFLOAT3(0.0f, 0.1f * deltaTime, 0.0f));
 	//}
 
-	particleSystem->Update(deltaTime, totalTime);
+	//Off screen and far away emitters emit less (and aren't drawn)
+	particleBudget->Update(emitters, cams[activeCam]);
+
+	//Emitters don't share any state, so each one is its own job
+	//and they run while this thread does the culling below
+	JobCounter emitterJobs;
+	for (auto& emitter : emitters) {
+		JobSystem::Run(emitterJobs, [emitter, deltaTime, totalTime]() { emitter->Update(deltaTime, totalTime); });
+	}
+
+	//Transforms + frustum culling, then the draw order for this frame
+	CullEntities();
+	BuildRenderQueue();
+	PackLights();
+	BuildLightClusters();
+	BuildEntityLightLists();
+
+	//Visible entities ask for the texture detail they need on screen
+	for (size_t i = 0; i < entities.size(); i++) {
+		if (entityVisible[i]) {
+			textureStreamer->RequestForEntity(*entities[i], *cams[activeCam], (float)Window::Height());
+		}
+	}
+	textureStreamer->Update();
+
+	JobSystem::Wait(emitterJobs);
 
 	//Example input checking: Quit if the escape key is pressed
 	if (Input::KeyDown(VK_ESCAPE))
 		Window::Quit();
 }
 
-void Game::DrawShadowMap() {
+//Refits every entity's world bounds and tests them against the active camera
+void Game::CullEntities()
+{
+	PROFILE_SCOPE("Game::CullEntities");
+
+	XMVECTOR planes[6];
+	cams[activeCam]->GetFrustumPlanes(planes);
+
+	entityVisible.resize(entities.size());
+
+	//each entity only writes its own transform, bounds and visibility slot
+	JobSystem::ParallelFor((unsigned int)entities.size(), [&](unsigned int begin, unsigned int end) {
+		for (unsigned int i = begin; i < end; i++) {
+			entities[i]->UpdateWorldBounds();
+			ContainmentType containment = entities[i]->GetWorldBounds().ContainedBy(
+				planes[0], planes[1], planes[2], planes[3], planes[4], planes[5]);
+			entityVisible[i] = containment != DISJOINT;
+		}
+	});
+
+	if (occlusionCullingEnabled) {
+		CullOccludedEntities();
+	}
+	else {
+		occlusionMs = 0.0;
+	}
+}
+
+//Draws the occluders on the CPU and hides entities that end up behind them
+void Game::CullOccludedEntities()
+{
+	PROFILE_SCOPE("Game::CullOccludedEntities");
+	uint64_t start = Profiler::Now();
+
+	std::shared_ptr<Camera> cam = cams[activeCam];
+	occlusionCuller->BeginFrame(cam->GetView(), cam->GetProjection());
+
+	//only occluders that survived frustum culling can hide anything
+	for (size_t i = 0; i < entities.size(); i++) {
+		if (entityVisible[i] && entities[i]->IsOccluder()) {
+			std::shared_ptr<Mesh> mesh = entities[i]->GetMesh();
+			occlusionCuller->AddOccluder(mesh->GetVertices(), mesh->GetIndices(), entities[i]->GetTransform().GetWorldMatrix());
+		}
+	}
+	occlusionCuller->RasterizeOccluders();
+
+	//occluders are tested too, they can be behind each other
+	JobSystem::ParallelFor((unsigned int)entities.size(), [&](unsigned int begin, unsigned int end) {
+		for (unsigned int i = begin; i < end; i++) {
+			if (entityVisible[i]) {
+				entityVisible[i] = occlusionCuller->IsVisible(entities[i]->GetWorldBounds());
+			}
+		}
+	});
+
+	occlusionMs = Profiler::TicksToMilliseconds(Profiler::Now() - start);
+}
+
+OcclusionStats Game::GetOcclusionStats() const
+{
+	return occlusionCullingEnabled ? occlusionCuller->GetStats() : OcclusionStats();
+}
+
+double Game::GetOcclusionMs() const
+{
+	return occlusionMs;
+}
+
+//Packs every light the way shaders read them (sorted by type, with
+//the per pixel math done up front) and uploads them, once a frame
+//instead of copying the whole array into every draw's constant buffer
+void Game::PackLights()
+{
+	PROFILE_SCOPE("Game::PackLights");
+
+	uint64_t start = Profiler::Now();
+	lightPacker.Pack(lights.data(), (unsigned int)lights.size());
+	lightBuffer->Upload(lightPacker.GetLights().data(), (unsigned int)lightPacker.GetLights().size());
+	lightPackMs = Profiler::TicksToMilliseconds(Profiler::Now() - start);
+}
+
+//Sorts the point and spot lights into the active camera's clusters
+//and uploads the lists for the PBR shaders (orthographic cameras
+//don't have slices that grow with depth, so they light everything)
+void Game::BuildLightClusters()
+{
+	PROFILE_SCOPE("Game::BuildLightClusters");
+
+	std::shared_ptr<Camera> cam = cams[activeCam];
+	clustersBuilt = lightCulling == 1 && cam->IsPerspective();
+	if (!clustersBuilt) {
+		clusterMs = 0.0;
+		return;
+	}
+
+	uint64_t start = Profiler::Now();
+	//slices start a little way out, the first one covers everything closer
+	XMFLOAT4X4 view = cam->GetView();
+	lightClusters.SetProjection(cam->GetProjection(), (std::max)(cam->GetNearClip(), 0.5f), cam->GetFarClip());
+	const std::vector<PackedLight>& packed = lightPacker.GetLights();
+	lightClusters.Build(packed.data(), (unsigned int)packed.size(), view);
+	clusterDepthRow = XMFLOAT4(view._13, view._23, view._33, view._43);
+
+	clusterRangeBuffer->Upload(lightClusters.GetRanges().data(), (unsigned int)lightClusters.GetRanges().size());
+	clusterIndexBuffer->Upload(lightClusters.GetIndices().data(), (unsigned int)lightClusters.GetIndices().size());
+	clusterMs = Profiler::TicksToMilliseconds(Profiler::Now() - start);
+}
+
+//Lists the point and spot lights touching each visible entity's
+//world bounds, brightest first and capped so a draw only loops
+//over a handful (the lists go into each draw's constant buffer)
+void Game::BuildEntityLightLists()
+{
+	PROFILE_SCOPE("Game::BuildEntityLightLists");
+
+	entityListsBuilt = lightCulling == 2;
+	if (!entityListsBuilt) {
+		entityLightMs = 0.0;
+		return;
+	}
+
+	uint64_t start = Profiler::Now();
+	entityBounds.resize(entities.size());
+	for (size_t i = 0; i < entities.size(); i++) {
+		entityBounds[i] = entities[i]->GetWorldBounds();
+	}
+	const std::vector<PackedLight>& packed = lightPacker.GetLights();
+	entityLights.Build(packed.data(), (unsigned int)packed.size(), entityBounds.data(), (unsigned int)entities.size(), entityVisible.data());
+	entityLightMs = Profiler::TicksToMilliseconds(Profiler::Now() - start);
+}
+
+//Replaces the extra point lights with a fresh set (same seed,
+//so the same count always gives the same lights)
+void Game::ScatterPointLights()
+{
+	lights.resize(sceneLightCount);
+	RandomGenerator random(1234);
+	for (int i = 0; i < extraPointLights; i++) {
+		Lights light = {};
+		light.type = LIGHT_TYPE_POINT;
+		light.position = XMFLOAT3(random.NextFloat(-10.0f, 20.0f), random.NextFloat(-2.0f, 3.0f), random.NextFloat(-5.0f, 10.0f));
+		light.color = XMFLOAT3(random.NextFloat(0.2f, 1.0f), random.NextFloat(0.2f, 1.0f), random.NextFloat(0.2f, 1.0f));
+		light.range = random.NextFloat(1.0f, 4.0f);
+		light.intensity = 1.0f;
+		lights.push_back(light);
+	}
+}
+
+//Collects visible entities and orders them to cut down on state changes
+void Game::BuildRenderQueue()
+{
+	PROFILE_SCOPE("Game::BuildRenderQueue");
+
+	//each job thread fills its own bucket, so no locking is needed
+	renderBuckets.resize(JobSystem::ThreadCount());
+	for (auto& bucket : renderBuckets) {
+		bucket.clear();
+	}
+
+	JobSystem::ParallelFor((unsigned int)entities.size(), [&](unsigned int begin, unsigned int end) {
+		std::vector<unsigned int>& bucket = renderBuckets[JobSystem::ThreadIndex()];
+		for (unsigned int i = begin; i < end; i++) {
+			if (entityVisible[i]) {
+				bucket.push_back(i);
+			}
+		}
+	});
+
+	renderQueue.clear();
+	for (auto& bucket : renderBuckets) {
+		renderQueue.insert(renderQueue.end(), bucket.begin(), bucket.end());
+	}
+
+	//group by material, then mesh (index breaks ties so the order is stable)
+	std::sort(renderQueue.begin(), renderQueue.end(), [&](unsigned int a, unsigned int b) {
+		Material* matA = entities[a]->GetMaterial().get();
+		Material* matB = entities[b]->GetMaterial().get();
+		if (matA != matB) return matA < matB;
+		Mesh* meshA = entities[a]->GetMesh().get();
+		Mesh* meshB = entities[b]->GetMesh().get();
+		if (meshA != meshB) return meshA < meshB;
+		return a < b;
+	});
+}
+
+//Draws every entity's depth from the light
+//the graph has already bound the shadow map (with no color output) and its viewport
+void Game::DrawShadowMap(const RenderGraphContext& context) {
+	PROFILE_SCOPE("Game::DrawShadowMap");
+
 	//Clear Depth stencil view
 	//all depth values now = 1
-	Graphics::Context->ClearDepthStencilView(shadowDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+	Graphics::Renderer->ClearDepth(context.DepthTarget, 1.0f);
 
-	Graphics::Context->RSSetState(shadowRasterizer.Get());
+	Graphics::Renderer->SetRasterizerState(shadowRasterizer.Get());
 
-	//Set shadow map as current depth buffer amd unbingd the back buffer to prevent color output
-	ID3D11RenderTargetView* nullRTV{};
-	Graphics::Context->OMSetRenderTargets(1, &nullRTV, shadowDSV.Get());
 	//unbind pixel shader
-	Graphics::Context->PSSetShader(0, 0, 0);
-	//Change viewport
-	D3D11_VIEWPORT viewport = {};
-	viewport.Width = (float)shadowMapResolution;
-	viewport.Height = (float)shadowMapResolution;
-	viewport.MaxDepth = 1.0f;
-	Graphics::Context->RSSetViewports(1, &viewport);
+	Graphics::Renderer->UnbindPixelShader();
 
 	shadowMapVS->SetShader();
 	shadowMapVS->SetMatrix4x4("view", lightViewMatrix);
@@ -644,25 +1054,94 @@ void Game::DrawShadowMap() {
 	}
 
 	//reset after drawing
-	viewport.Width = (float)Window::Width();
-	viewport.Height = (float)Window::Height();
-	Graphics::Context->RSSetViewports(1, &viewport);
-	Graphics::Context->OMSetRenderTargets(
-		1,
-		Graphics::BackBufferRTV.GetAddressOf(),
-		Graphics::DepthBufferDSV.Get());
-	Graphics::Context->RSSetState(0);
-
-	ID3D11ShaderResourceView* nullSRVs[128] = {};
-	Graphics::Context->PSSetShaderResources(0, 128, nullSRVs);
+	Graphics::Renderer->SetRasterizerState(0);
+}
+
+//Picks which post process passes run this frame, then
+//draws them onto the back buffer (blurred rows then
+//columns either way, no blur is a single copy pass)
+void Game::DrawPostProcess(const RenderGraphContext& context) {
+	bool blur = blurRadius > 0;
+	bool compute = blur && blurMode == 1;
+	float scale = compute ? 1.0f : 1.0f / (1 << blurResolution);
+
+	postProcessor->GetPass(blurRowsPass).Enabled = blur && !compute;
+	postProcessor->GetPass(blurColumnsPass).Enabled = blur && !compute;
+	postProcessor->GetPass(blurRowsPass).Scale = scale;
+	postProcessor->GetPass(blurColumnsPass).Scale = scale;
+	postProcessor->GetPass(blurRowsCSPass).Enabled = compute;
+	postProcessor->GetPass(blurColumnsCSPass).Enabled = compute;
+	//only needed if the last blur pass can't draw to the screen itself
+	postProcessor->GetPass(copyPass).Enabled = !blur || compute || scale < 1.0f;
+
+	postProcessor->Draw(context.Reads[0], context.Width, context.Height, context.RenderTargets[0]);
 }
 
-//prepares all needed operations before drawing to post process
-void Game::PreparePostProcess() {
+//Draws every visible entity into the scene color target
+//(cleared first), with the shadow map as its first read
+void Game::DrawScene(const RenderGraphContext& context) {
+	PROFILE_SCOPE("Game::DrawScene");
+
 	//reset to "background" color
-	Graphics::Context->ClearRenderTargetView(ppRTV.Get(), color);
-	//swap the active render target
-	Graphics::Context->OMSetRenderTargets(1, ppRTV.GetAddressOf(), Graphics::DepthBufferDSV.Get());
+	Graphics::Renderer->ClearRenderTarget(context.RenderTargets[0], color);
+
+	//Draw visible Entities
+	for (unsigned int i : renderQueue) {
+		std::shared_ptr<Entity>& e = entities[i];
+
+		//Shadow Mapping
+		//send shadow map to entity
+		e->GetMaterial()->GetVertexShader()->SetMatrix4x4("lightView", lightViewMatrix);
+		e->GetMaterial()->GetVertexShader()->SetMatrix4x4("lightProj", lightProjectionMatrix);
+		e->GetMaterial()->GetPixelShader()->SetShaderResourceView("ShadowMap", context.Reads[0]);
+		e->GetMaterial()->AddSampler("ShadowSampler", shadowSampler);
+
+		//Pixel Shader
+		//if the following values are not in the pixel shader,
+		//SimpleShader ignores
+		//pass in window height and width for entity's pixel shader
+		float width = static_cast<float>(context.Width);
+		float height = static_cast<float>(context.Height);
+		e->GetMaterial()->GetPixelShader()->SetFloat2("resolution", XMFLOAT2(width, height));
+		//pass in deltaTime for pixel shader
+		e->GetMaterial()->GetPixelShader()->SetFloat("deltaTime", frameDeltaTime);
+		e->GetMaterial()->GetPixelShader()->SetFloat3("ambientColor", ambientLight);
+		//image based lighting (PBR shaders)
+		e->GetMaterial()->GetPixelShader()->SetShaderResourceView("SpecularIBL", defaultSky->GetSpecularIBLSRV());
+		e->GetMaterial()->GetPixelShader()->SetShaderResourceView("BrdfLUT", defaultSky->GetBrdfLutSRV());
+		e->GetMaterial()->GetPixelShader()->SetData("irradianceSH", defaultSky->GetIrradianceSH(), sizeof(float) * 4 * 9);
+		e->GetMaterial()->GetPixelShader()->SetInt("specularIBLMips", int(defaultSky->GetSpecularIBLMips()));
+		e->GetMaterial()->GetPixelShader()->SetFloat("iblIntensity", defaultSky->HasIBL() ? iblIntensity : 0.0f);
+		//lights were packed and uploaded once this frame, so only the counts per type go in
+		const PackedLightCounts& lightCounts = lightPacker.GetCounts();
+		uint32_t lightCountsByType[3] = { lightCounts.Directional, lightCounts.Point, lightCounts.Spot };
+		e->GetMaterial()->GetPixelShader()->SetData("lightCounts", lightCountsByType, sizeof(lightCountsByType));
+		e->GetMaterial()->GetPixelShader()->SetShaderResourceView("LightData", lightBuffer->GetSRV());
+		//clustered lighting (PBR shaders), only the lights in each pixel's cluster
+		uint32_t clusterCounts[3] = { lightClusters.GetTilesX(), lightClusters.GetTilesY(), lightClusters.GetSlices() };
+		XMFLOAT4 clusterParams(lightClusters.GetTilesX() / width, lightClusters.GetTilesY() / height,
+			lightClusters.GetDepthScale(), lightClusters.GetDepthBias());
+		e->GetMaterial()->GetPixelShader()->SetInt("lightCulling", clustersBuilt ? 1 : entityListsBuilt ? 2 : 0);
+		e->GetMaterial()->GetPixelShader()->SetInt("numGlobalLights", int(lightClusters.GetGlobalCount()));
+		e->GetMaterial()->GetPixelShader()->SetData("clusterCounts", clusterCounts, sizeof(clusterCounts));
+		e->GetMaterial()->GetPixelShader()->SetFloat4("clusterParams", clusterParams);
+		e->GetMaterial()->GetPixelShader()->SetFloat4("viewDepthRow", clusterDepthRow);
+		e->GetMaterial()->GetPixelShader()->SetShaderResourceView("ClusterRanges", clusterRangeBuffer->GetSRV());
+		e->GetMaterial()->GetPixelShader()->SetShaderResourceView("ClusterLightIndices", clusterIndexBuffer->GetSRV());
+		//per entity light lists (PBR shaders), only the lights touching this entity
+		if (entityListsBuilt) {
+			uint32_t entityLightIndices[EntityLightLists::MaxLights] = {};
+			for (unsigned int l = 0; l < entityLights.GetCount(i); l++) {
+				entityLightIndices[l] = entityLights.GetLights(i)[l];
+			}
+			e->GetMaterial()->GetPixelShader()->SetInt("entityLightCount", int(entityLights.GetCount(i)));
+			e->GetMaterial()->GetPixelShader()->SetData("entityLightIndices", entityLightIndices, sizeof(entityLightIndices));
+		}
+
+		//Drawing
+		//draw entities
+		e->Draw(cams[activeCam]);
+	}
 }
 
 // --------------------------------------------------------
@@ -670,13 +1149,25 @@ void Game::PreparePostProcess() {
 // --------------------------------------------------------
 void Game::Draw(float deltaTime, float totalTime)
 {
+	PROFILE_SCOPE("Game::Draw");
+
 	// Frame START
 	// - These things should happen ONCE PER FRAME
 	// - At the beginning of Game::Draw() before drawing *anything*
 	{
 		// Clear the back buffer (erase what's on screen) and depth buffer
-		Graphics::Context->ClearRenderTargetView(Graphics::BackBufferRTV.Get(), color);
-		Graphics::Context->ClearDepthStencilView(Graphics::DepthBufferDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+		Graphics::Renderer->ClearRenderTarget(Graphics::BackBufferRTV.Get(), color);
+		Graphics::Renderer->ClearDepth(Graphics::DepthBufferDSV.Get(), 1.0f);
+
+		//what the graph draws into this frame
+		frameDeltaTime = deltaTime;
+		frameTotalTime = totalTime;
+		RenderTargetDesc sceneDesc = renderGraph->GetGraph().GetResourceDesc(sceneColorResource);
+		sceneDesc.Width = Window::Width();
+		sceneDesc.Height = Window::Height();
+		renderGraph->GetGraph().SetTextureDesc(sceneColorResource, sceneDesc);
+		renderGraph->Import(backBufferResource, Graphics::BackBufferRTV.Get(), 0, 0, Window::Width(), Window::Height());
+		renderGraph->Import(depthBufferResource, 0, Graphics::DepthBufferDSV.Get(), 0, Window::Width(), Window::Height());
 	}
 
 	// Frame END
@@ -686,78 +1177,14 @@ void Game::Draw(float deltaTime, float totalTime)
 		// Present at the end of the frame
 		bool vsync = Graphics::VsyncState();
 
-		//handle shadows
-		DrawShadowMap();
-
-		//do the same for post processes
-		PreparePostProcess();
-
-		//Draw all Entities
-		for (auto& e : entities) {
-
-			//Shadow Mapping
-			//send shadow map to entity
-			e->GetMaterial()->GetVertexShader()->SetMatrix4x4("lightView", lightViewMatrix);
-			e->GetMaterial()->GetVertexShader()->SetMatrix4x4("lightProj", lightProjectionMatrix);
-			e->GetMaterial()->GetPixelShader()->SetShaderResourceView("ShadowMap", shadowSRV);
-			e->GetMaterial()->AddSampler("ShadowSampler", shadowSampler);
-
-			//Pixel Shader
-			//if the following values are not in the pixel shader,
-			//SimpleShader ignores
-			//pass in window height and width for entity's pixel shader
-			float width = static_cast<float>(Window::Width());
-			float height = static_cast<float>(Window::Height());
-			e->GetMaterial()->GetPixelShader()->SetFloat2("resolution", XMFLOAT2(width, height));
-			//pass in deltaTime for pixel shader
-			e->GetMaterial()->GetPixelShader()->SetFloat("deltaTime", deltaTime);
-			e->GetMaterial()->GetPixelShader()->SetFloat3("ambientColor", ambientLight);
-			e->GetMaterial()->GetPixelShader()->SetInt("numLights", int(lights.size())); //number of lights
-			e->GetMaterial()->GetPixelShader()->SetData("lights", //shader variable name
-				&lights[0], //address of data
-				sizeof(Lights) * //size of data structure
-				(int)lights.size());
-
-			//Drawing
-			//draw entities
-			e->Draw(cams[activeCam]);
-		}
-
-		defaultSky->Draw(cams[activeCam]);
-
-		//Draw emitter
-		DrawParticles(totalTime);
-
-		//start post process
-		Graphics::Context->OMSetRenderTargets(1, Graphics::BackBufferRTV.GetAddressOf(), 0);
+		//shadows, the scene, post processing and the UI
+		//(see CreateRenderGraph)
+		renderGraph->Execute();
 
-		// Activate shaders and bind resources
-		// Also set any required cbuffer data
-		ppVS->SetShader();
-		ppPS->SetShader();
-		ppPS->SetShaderResourceView("Pixels", ppSRV.Get());
-		ppPS->SetSamplerState("ClampSampler", ppSampler.Get());
-		ppPS->SetInt("blurRadius", blurRadius);
-		ppPS->SetFloat("pixelWidth", 1.0f / Window::Width());
-		ppPS->SetFloat("pixelHeight", 1.0f / Window::Height());
-
-		ppVS->CopyAllBufferData();
-		ppPS->CopyAllBufferData();
-
-		Graphics::Context->Draw(3, 0); // Draw exactly 3 vertices (one triangle)
-
-		ID3D11ShaderResourceView* nullSRVs[128] = {};
-		Graphics::Context->PSSetShaderResources(0, 128, nullSRVs);
-
-		// UI is drawn last so it is on top
-		DrawUI();
-
-		Graphics::SwapChain->Present(
-			vsync ? 1 : 0,
-			vsync ? 0 : DXGI_PRESENT_ALLOW_TEARING);
+		Graphics::Renderer->Present(vsync);
 
 		// Re-bind back buffer and depth buffer after presenting
-		Graphics::Context->OMSetRenderTargets(
+		Graphics::Renderer->SetRenderTargets(
 			1,
 			Graphics::BackBufferRTV.GetAddressOf(),
 			Graphics::DepthBufferDSV.Get());
@@ -766,6 +1193,8 @@ void Game::Draw(float deltaTime, float totalTime)
 
 void Game::DrawUI()
 {
+	PROFILE_SCOPE("Game::DrawUI");
+
 	//Begin the window, everything until End() is included
 	ImGui::Begin("Controls");
 
@@ -785,6 +1214,37 @@ void Game::DrawUI()
 			// Replace each %d with the next parameter, and format as decimal integers
 			// The "x" will be printed as-is between the numbers, like so: 800x600
 			ImGui::Text("Window Resolution: %dx%d", Window::Width(), Window::Height());
+			ImGui::SeparatorText("Frame Work");
+			ImGui::Text("Job Threads: %u", JobSystem::ThreadCount());
+			ImGui::Text("Visible Entities: %d / %d", (int)renderQueue.size(), (int)entities.size());
+			ImGui::Checkbox("Occlusion Culling", &occlusionCullingEnabled);
+			if (occlusionCullingEnabled) {
+				OcclusionStats occlusion = occlusionCuller->GetStats();
+				ImGui::Text("Occluded Entities: %u / %u tested", occlusion.Occluded, occlusion.Tested);
+				ImGui::Text("Occluders: %u (%u triangles) at %ux%u", occlusion.Occluders, occlusion.OccluderTriangles,
+					occlusionCuller->GetWidth(), occlusionCuller->GetHeight());
+				ImGui::Text("Occlusion Cost: %.3f ms (%.3f ms drawing occluders)", occlusionMs, occlusion.RasterMs);
+			}
+			ImGui::SeparatorText("Frame Times");
+			DrawFrameStatsUI();
+			ImGui::Unindent();
+		}
+
+		if (ImGui::CollapsingHeader("Profiler")) {
+			ImGui::Indent();
+			DrawProfilerUI();
+			ImGui::Unindent();
+		}
+
+		if (ImGui::CollapsingHeader("Software Rasterizer")) {
+			ImGui::Indent();
+			DrawReferenceUI();
+			ImGui::Unindent();
+		}
+
+		if (ImGui::CollapsingHeader("Render Graph")) {
+			ImGui::Indent();
+			DrawRenderGraphUI();
 			ImGui::Unindent();
 		}
 
@@ -941,10 +1401,37 @@ void Game::DrawUI()
 		if (ImGui::CollapsingHeader("Lighting")) {
 			ImGui::SeparatorText("Universal Lighting");
 			ImGui::ColorPicker3("Ambient Light", &ambientLight.x);
+			ImGui::SliderFloat("Sky Lighting (IBL)", &iblIntensity, 0.0f, 2.0f);
+			ImGui::Text("Sky lighting %s in %.1f ms", iblFromCache ? "loaded from cache" : "baked", iblMs);
 			ImGui::DragFloat3("Background Color", &color[0], 0.001f, 0.0f, 1.5f);
+			ImGui::SeparatorText("Light Culling");
+			ImGui::Combo("Lights Per Pixel", &lightCulling, "Every light\0Per cluster\0Per entity\0");
+			if (ImGui::SliderInt("Extra Point Lights", &extraPointLights, 0, MaxExtraLights, "%d", ImGuiSliderFlags_Logarithmic)) {
+				ScatterPointLights();
+			}
+			const PackedLightCounts& packedCounts = lightPacker.GetCounts();
+			ImGui::Text("Packed: %u directional, %u point, %u spot (%.1f KB) in %.3f ms", packedCounts.Directional, packedCounts.Point, packedCounts.Spot,
+				lightPacker.GetLights().size() * sizeof(PackedLight) / 1024.0, lightPackMs);
+			if (clustersBuilt) {
+				LightClusterStats clusterStats = lightClusters.GetStats();
+				ImGui::Text("%u x %u x %u clusters, built in %.3f ms", lightClusters.GetTilesX(), lightClusters.GetTilesY(), lightClusters.GetSlices(), clusterMs);
+				ImGui::Text("Lights in view: %u / %u (+%u directional)", clusterStats.Visible, clusterStats.Lights, clusterStats.Global);
+				ImGui::Text("Per cluster: %.2f average, %u max, %u empty", (double)clusterStats.Indices / lightClusters.GetClusterCount(),
+					clusterStats.MaxPerCluster, clusterStats.EmptyClusters);
+			}
+			else if (entityListsBuilt) {
+				EntityLightStats entityStats = entityLights.GetStats();
+				ImGui::Text("Lists for %u entities, built in %.3f ms", entityStats.Entities, entityLightMs);
+				ImGui::Text("Lights touching them: %u, kept %u (up to %u each)", entityStats.Hits, entityStats.Kept, EntityLightLists::MaxLights);
+				ImGui::Text("Entities with more lights than fit: %u", entityStats.Capped);
+			}
+			else {
+				ImGui::Text("Every light for every pixel");
+			}
 			ImGui::SeparatorText("Light Sources");
 			if (ImGui::CollapsingHeader("Lights")) {
-				for (size_t i = 0; i < lights.size(); i++) {
+				//the scene's own lights, not the scattered ones
+				for (size_t i = 0; i < sceneLightCount; i++) {
 					std::string label = "Light " + std::to_string(i + 1);
 					if (ImGui::CollapsingHeader(label.c_str())) {
 						//Could reorganize conditionals for efficency
@@ -975,14 +1462,204 @@ void Game::DrawUI()
 				}
 			}
 			ImGui::SeparatorText("Shadow Map");
-			ImGui::Image((ImTextureID)shadowSRV.Get(), ImVec2(512, 512));
-			ImGui::Image((ImTextureID)ppSRV.Get(), ImVec2(512, 512));
+			ImGui::Image((ImTextureID)renderGraph->GetSRV(shadowMapResource), ImVec2(512, 512));
+			ImGui::Image((ImTextureID)renderGraph->GetSRV(sceneColorResource), ImVec2(512, 512));
+		}
+
+		//Startup textures
+		if (ImGui::CollapsingHeader("Texture Loading")) {
+			ImGui::Text("%u textures in %.1f ms (decoded on %u threads)", (unsigned int)textureLoadTimings.size(), textureLoadMs, JobSystem::ThreadCount());
+			//cooked (.dds) textures are block compressed, run with -cook to make them
+			size_t gpuBytes = 0;
+			for (const TextureLoadTiming& timing : textureLoadTimings) {
+				gpuBytes += timing.GpuBytes;
+			}
+			ImGui::Text("GPU memory: %.1f MB", gpuBytes / (1024.0 * 1024.0));
+			if (ImGui::BeginTable("TextureTimings", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+				ImGui::TableSetupColumn("File");
+				ImGui::TableSetupColumn("KB");
+				ImGui::TableSetupColumn("Read ms");
+				ImGui::TableSetupColumn("Decode ms");
+				ImGui::TableSetupColumn("Upload ms");
+				ImGui::TableSetupColumn("GPU KB");
+				ImGui::TableHeadersRow();
+				for (const TextureLoadTiming& timing : textureLoadTimings) {
+					//just the file name, paths are long
+					std::string name = WideToNarrow(timing.Path);
+					name = name.substr(name.find_last_of("/\\") + 1);
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn(); ImGui::Text("%s%s", name.c_str(), !timing.Loaded ? " (missing)" : timing.Shared ? " (shared)" : timing.Streamed ? " (streamed)" : timing.UsedDDS ? " (DDS)" : timing.UsedWIC ? " (WIC)" : timing.Packed ? " (packed)" : "");
+					ImGui::TableNextColumn(); ImGui::Text("%zu", timing.FileBytes / 1024);
+					ImGui::TableNextColumn(); ImGui::Text("%.2f", timing.ReadMs);
+					ImGui::TableNextColumn(); ImGui::Text("%.2f", timing.DecodeMs);
+					ImGui::TableNextColumn(); ImGui::Text("%.2f", timing.UploadMs);
+					ImGui::TableNextColumn(); ImGui::Text("%zu", timing.GpuBytes / 1024);
+				}
+				ImGui::EndTable();
+			}
+		}
+
+		//Mips of cooked textures, loaded and dropped by screen size
+		if (ImGui::CollapsingHeader("Texture Streaming")) {
+			TextureResidency& residency = textureStreamer->GetResidency();
+			const TextureResidencyStats& streamStats = residency.GetStats();
+			int budgetMB = (int)(residency.GetBudget() / (1024 * 1024));
+			if (ImGui::SliderInt("Budget (MB)", &budgetMB, 1, 256)) {
+				residency.SetBudget((size_t)budgetMB * 1024 * 1024);
+			}
+			ImGui::SliderFloat("Mip Bias", &textureStreamer->mipBias, -2.0f, 4.0f);
+			ImGui::Text("Resident: %.1f MB (+%.1f MB loading) of %.1f MB",
+				streamStats.ResidentBytes / (1024.0 * 1024.0), streamStats.PendingBytes / (1024.0 * 1024.0), streamStats.BudgetBytes / (1024.0 * 1024.0));
+			ImGui::Text("%u textures, %u requested, %u short of detail, %u loading", streamStats.Textures, streamStats.Requested, streamStats.Starved, streamStats.Loading);
+			ImGui::Text("Loads: %u (%.1f MB), evictions: %u (%.1f MB)",
+				streamStats.Loads, streamStats.BytesLoaded / (1024.0 * 1024.0), streamStats.Evictions, streamStats.BytesEvicted / (1024.0 * 1024.0));
+			if (ImGui::BeginTable("StreamedTextures", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+				ImGui::TableSetupColumn("File");
+				ImGui::TableSetupColumn("Size");
+				ImGui::TableSetupColumn("Resident");
+				ImGui::TableSetupColumn("Wanted");
+				ImGui::TableSetupColumn("KB");
+				ImGui::TableHeadersRow();
+				for (unsigned int i = 0; i < residency.GetTextureCount(); i++) {
+					std::string name = WideToNarrow(textureStreamer->GetPath(i));
+					name = name.substr(name.find_last_of("/\\") + 1);
+					const DdsImage& layout = residency.GetLayout(i);
+					unsigned int resident = residency.GetResidentMip(i);
+					unsigned int wanted = residency.GetWantedMip(i);
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn(); ImGui::Text("%s%s", name.c_str(), residency.IsLoading(i) ? " (loading)" : "");
+					ImGui::TableNextColumn(); ImGui::Text("%ux%u", layout.Width, layout.Height);
+					ImGui::TableNextColumn(); ImGui::Text("%ux%u", layout.MipWidth(resident), layout.MipHeight(resident));
+					ImGui::TableNextColumn(); ImGui::Text("%ux%u", layout.MipWidth(wanted), layout.MipHeight(wanted));
+					ImGui::TableNextColumn(); ImGui::Text("%zu", residency.GetBytes(i, resident) / 1024);
+				}
+				ImGui::EndTable();
+			}
+		}
+
+		//Loaded once, shared by everything that uses them
+		if (ImGui::CollapsingHeader("Resources")) {
+			ResourceStats stats = ResourceRegistry::GetStats();
+			ImGui::Text("%u resources, %.1f MB resident", stats.Resources, stats.ResidentBytes / (1024.0 * 1024.0));
+			ImGui::Text("Loads: %u, duplicates avoided: %u (%u by path, %u by contents)", stats.Loads, stats.PathHits + stats.ContentHits, stats.PathHits, stats.ContentHits);
+			ImGui::Text("Unloaded: %u", stats.Unloaded);
+			//only drops what nothing else holds
+			if (ImGui::Button("Unload Unused")) {
+				ResourceRegistry::UnloadUnused();
+			}
+			if (ImGui::BeginTable("Resources", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+				const char* typeNames[] = { "Texture", "Mesh", "Vertex Shader", "Pixel Shader" };
+				ImGui::TableSetupColumn("Type");
+				ImGui::TableSetupColumn("File");
+				ImGui::TableSetupColumn("KB");
+				ImGui::TableSetupColumn("Refs");
+				ImGui::TableSetupColumn("Aliases");
+				ImGui::TableHeadersRow();
+				for (const ResourceInfo& info : ResourceRegistry::GetResources()) {
+					std::string name = WideToNarrow(info.Path);
+					name = name.substr(name.find_last_of("/\\") + 1);
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn(); ImGui::Text("%s", typeNames[(int)info.Type]);
+					ImGui::TableNextColumn(); ImGui::Text("%s", name.c_str());
+					ImGui::TableNextColumn(); ImGui::Text("%zu", info.Bytes / 1024);
+					ImGui::TableNextColumn(); ImGui::Text("%ld", info.References);
+					ImGui::TableNextColumn(); ImGui::Text("%u", info.Aliases);
+				}
+				ImGui::EndTable();
+			}
 		}
 
 		//Post Processing
 		if (ImGui::CollapsingHeader("Post Processing")) {
 			ImGui::SeparatorText("Blur");
-			ImGui::DragInt("Blur Radius", &blurRadius, 0.2f, 0, 10);
+			ImGui::DragInt("Blur Radius", &blurRadius, 0.2f, 0, 32);
+			ImGui::Combo("Blur Method", &blurMode, "Separable (linear taps)\0Sliding window (compute)\0");
+			ImGui::Text("%d samples per pixel", blurRadius == 0 ? 1 : blurMode == 1 ? 4 : 2 * (1 + 2 * ((blurRadius + 1) / 2)));
+			if (blurMode == 0) {
+				ImGui::Combo("Blur Resolution", &blurResolution, "Full\0Half\0Quarter\0");
+			}
+
+			//where each pass drew last frame
+			ImGui::SeparatorText("Passes");
+			for (const ScheduledPass& scheduled : postProcessor->GetSchedule()) {
+				if (scheduled.Output == PostProcessChain::BackBuffer) {
+					ImGui::Text("%s -> back buffer (%ux%u)", postProcessor->GetPass(scheduled.Pass).Name.c_str(), scheduled.Width, scheduled.Height);
+				}
+				else {
+					ImGui::Text("%s -> target %d (%ux%u)", postProcessor->GetPass(scheduled.Pass).Name.c_str(), scheduled.Output, scheduled.Width, scheduled.Height);
+				}
+			}
+
+			//pooled render targets, the scene's included
+			const RenderTargetPoolStats& poolStats = postProcessor->GetPool().GetStats();
+			ImGui::SeparatorText("Render Target Pool");
+			ImGui::Text("Targets: %u (%u at once)", poolStats.Targets, poolStats.PeakInUse);
+			ImGui::Text("Memory: %.2f MB", poolStats.Bytes / (1024.0f * 1024.0f));
+			ImGui::Text("Created: %u, Destroyed: %u", poolStats.Created, poolStats.Destroyed);
+		}
+
+		//Particles
+		if (ImGui::CollapsingHeader("Particles")) {
+			ImGui::Text("AVX2: %s", CpuFeatures::HasAVX2() ? "yes" : "no (scalar fallback)");
+			bool batching = particleArena->IsBatching();
+			if (ImGui::Checkbox("Batch Emitters (one draw per material)", &batching)) {
+				particleArena->SetBatching(batching);
+			}
+			const ParticleArenaStats& arenaStats = particleArena->GetStats();
+			ImGui::Text("Drawn: %u particles from %u emitters in %u draws", arenaStats.ParticlesDrawn, arenaStats.Emitters, arenaStats.DrawCalls);
+			ImGui::Text("Arena: %u particles", arenaStats.Capacity);
+			ImGui::Text("Sorted: %u particles in %.3f ms", arenaStats.ParticlesSorted, arenaStats.SortMs);
+
+			//every emitter shares one budget, scaled by how much of the screen it covers
+			int budget = (int)particleBudget->GetMaxParticles();
+			if (ImGui::DragInt("Particle Budget", &budget, 100.0f, 0, 1000000)) {
+				particleBudget->SetMaxParticles((unsigned int)max(budget, 0));
+			}
+			ImGui::SliderFloat("Full Detail Coverage", &particleBudget->fullDetailCoverage, 0.01f, 1.0f);
+			ImGui::SliderFloat("Culled Detail", &particleBudget->culledDetail, 0.0f, 1.0f);
+			const ParticleBudgetStats& budgetStats = particleBudget->GetStats();
+			ImGui::Text("Budget: %u of %u particles allowed (x%.2f), %u of %u emitters culled",
+				budgetStats.Allowed, budgetStats.Requested, budgetStats.BudgetScale, budgetStats.Culled, budgetStats.Emitters);
+			for (size_t i = 0; i < emitters.size(); i++) {
+				std::shared_ptr<Emitter> emitter = emitters[i];
+				ImGui::PushID((int)i);
+				ImGui::SeparatorText(("Emitter " + std::to_string(i + 1)).c_str());
+
+				//same seed replays the same particles from an empty emitter
+				uint64_t seed = emitter->GetSeed();
+				if (ImGui::InputScalar("Seed", ImGuiDataType_U64, &seed)) {
+					emitter->SetSeed(seed);
+				}
+				ImGui::SameLine();
+				if (ImGui::Button("Replay")) {
+					emitter->SetSeed(seed);
+					emitter->SetMaxParticles(emitter->GetMaxParticles());
+				}
+				if (ImGui::Button("Burst")) {
+					emitter->Burst(emitter->GetMaxParticles() / 2);
+				}
+
+				ImGui::Checkbox("Alpha Blend (sorted)", &emitter->alphaBlend);
+
+				ImGui::Text("Detail: %.2f%s", emitter->GetEmissionScale(), emitter->IsCulled() ? " (culled)" : "");
+
+				bool simulateOnCPU = emitter->IsSimulatedOnCPU();
+				if (ImGui::Checkbox("Simulate On CPU", &simulateOnCPU)) {
+					emitter->SetSimulatedOnCPU(simulateOnCPU);
+				}
+
+				//forces only exist in the CPU simulation
+				if (simulateOnCPU) {
+					ImGui::Text("Simulation: %.3f ms", emitter->GetSimulationMs());
+					ImGui::DragFloat("Drag", &emitter->drag, 0.01f, 0.0f, 10.0f);
+					ImGui::DragFloat("Turbulence", &emitter->turbulenceStrength, 0.05f, 0.0f, 50.0f);
+					ImGui::DragFloat("Turbulence Frequency", &emitter->turbulenceFrequency, 0.01f, 0.0f, 10.0f);
+					ImGui::Checkbox("Floor Collision", &emitter->floorCollision);
+					ImGui::DragFloat("Floor Height", &emitter->floorHeight, 0.05f);
+					ImGui::SliderFloat("Bounciness", &emitter->bounciness, 0.0f, 1.0f);
+				}
+				ImGui::PopID();
+			}
 		}
 	}
 
@@ -993,3 +1670,181 @@ void Game::DrawUI()
 	ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData()); // Draws it to the screen
 }
 
+
+//Shows last frame's profile markers as a tree per thread
+void Game::DrawProfilerUI()
+{
+#if PROFILING_ENABLED
+	const ProfileFrame& frame = Profiler::LastFrame();
+	ImGui::Text("Frame %llu: %.3f ms", frame.FrameIndex, Profiler::TicksToMilliseconds(frame.End - frame.Start));
+	ImGui::Text("Threads: %u  Dropped Events: %llu", Profiler::ThreadCount(), Profiler::DroppedEvents());
+
+	if (ImGui::Button("Export Chrome Trace")) {
+		Profiler::ExportChromeTrace(FixPath("profile_trace.json"));
+	}
+
+	DrawProfileTree(frame);
+#else
+	ImGui::Text("Profile markers are compiled out of this build");
+	ImGui::Text("(define PROFILING_ENABLED 1 to turn them on)");
+#endif
+}
+
+//Button to render a CPU reference image, plus how long each stage took
+void Game::DrawReferenceUI()
+{
+	if (ImGui::Button("Render Reference Image")) {
+		RenderReference(FixPath("reference.png"));
+	}
+
+	if (!referenceRasterizer) {
+		ImGui::Text("Nothing rendered yet");
+		return;
+	}
+
+	ImGui::Text("Saved to: %s", referencePath.empty() ? "(failed to save)" : referencePath.c_str());
+
+	const SoftwareRasterTimings& timings = referenceRasterizer->GetTimings();
+	ImGui::Text("Resolution: %ux%u  Tile: %u", referenceRasterizer->GetWidth(), referenceRasterizer->GetHeight(), SoftwareRasterizer::TileSize);
+	ImGui::Text("Triangles: %u submitted, %u rasterized", timings.TrianglesSubmitted, timings.TrianglesRasterized);
+	ImGui::Text("Blocks skipped by depth: %llu", timings.BlocksRejectedByDepth);
+	ImGui::SeparatorText("Stage Times (ms)");
+	ImGui::Text("Vertex: %.3f", timings.VertexMs);
+	ImGui::Text("Setup:  %.3f", timings.SetupMs);
+	ImGui::Text("Bin:    %.3f", timings.BinMs);
+	ImGui::Text("Raster: %.3f", timings.RasterMs);
+	ImGui::Text("Shade:  %.3f", timings.ShadeMs);
+	ImGui::Text("Total:  %.3f", timings.TotalMs);
+}
+
+//Passes this frame, and where each texture lived
+void Game::DrawRenderGraphUI()
+{
+	const RenderGraph& graph = renderGraph->GetGraph();
+	const CompiledRenderGraph& compiled = renderGraph->GetCompiled();
+
+	ImGui::SeparatorText("Passes");
+	for (unsigned int p = 0; p < graph.GetPassCount(); p++) {
+		ImGui::Text("%s%s", graph.GetPassName(p).c_str(), compiled.Culled.size() > p && compiled.Culled[p] ? " (culled)" : "");
+	}
+	for (const CompiledRenderPass& pass : compiled.Passes) {
+		if (pass.UnbindAfter > 0) {
+			ImGui::Text("%s unbinds %u slots after", graph.GetPassName(pass.Pass).c_str(), pass.UnbindAfter);
+		}
+	}
+
+	ImGui::SeparatorText("Textures");
+	for (unsigned int r = 0; r < graph.GetResourceCount() && r < compiled.Physical.size(); r++) {
+		if (compiled.Physical[r] == RenderGraph::Unused) {
+			ImGui::Text("%s: unused", graph.GetResourceName(r).c_str());
+		}
+		else if (compiled.Physical[r] == RenderGraph::Imported) {
+			ImGui::Text("%s: imported", graph.GetResourceName(r).c_str());
+		}
+		else {
+			const RenderTargetDesc& desc = graph.GetResourceDesc(r);
+			ImGui::Text("%s: target %d (%ux%u), passes %d-%d", graph.GetResourceName(r).c_str(), compiled.Physical[r],
+				desc.Width, desc.Height, compiled.FirstUse[r], compiled.LastUse[r]);
+		}
+	}
+
+	const RenderTargetPoolStats& poolStats = renderGraph->GetPool().GetStats();
+	ImGui::Text("Memory: %.2f MB in %u targets", poolStats.Bytes / (1024.0f * 1024.0f), poolStats.Targets);
+}
+
+//Frame time graph, percentiles and hitch capture
+void Game::DrawFrameStatsUI()
+{
+	const FrameStatsSummary& summary = frameStats.Summary();
+	ImGui::PlotLines("##FrameTimes", frameStats.Data(), (int)frameStats.Count(), (int)frameStats.Offset(),
+		0, 0.0f, (std::max)(summary.Max, frameStats.GetHitchThreshold()), ImVec2(0, 80));
+
+	ImGui::Text("Avg %.2f  p50 %.2f  p95 %.2f  p99 %.2f  Max %.2f (ms)",
+		summary.Average, summary.P50, summary.P95, summary.P99, summary.Max);
+	ImGui::Text("Frames: %u / %u stored", frameStats.Count(), frameStats.Capacity());
+
+	float threshold = frameStats.GetHitchThreshold();
+	if (ImGui::DragFloat("Hitch Threshold (ms)", &threshold, 0.1f, 1.0f, 1000.0f)) {
+		frameStats.SetHitchThreshold(threshold);
+	}
+	ImGui::Text("Hitches: %llu", frameStats.HitchCount());
+
+	if (ImGui::Button("Export CSV")) {
+		frameStats.ExportCSV(FixPath("frame_times.csv"));
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Reset")) {
+		frameStats.Clear();
+		hasHitchSnapshot = false;
+	}
+
+	//profile captured the last time a frame went over the threshold
+	if (hasHitchSnapshot && ImGui::TreeNode("Last Hitch")) {
+#if PROFILING_ENABLED
+		ImGui::Text("Frame %llu: %.3f ms", hitchSnapshot.FrameIndex,
+			Profiler::TicksToMilliseconds(hitchSnapshot.End - hitchSnapshot.Start));
+		ImGui::PushID("Hitch");
+		DrawProfileTree(hitchSnapshot);
+		ImGui::PopID();
+#else
+		ImGui::Text("Profile markers are compiled out of this build");
+#endif
+		ImGui::TreePop();
+	}
+}
+
+//Draws a frame's markers as a tree per thread
+void Game::DrawProfileTree(const ProfileFrame& frame)
+{
+	//events are sorted by thread then start time, so children always
+	//follow their parent and the depth says how far to nest them
+	std::vector<uint32_t> openDepths;
+	uint32_t currentThread = UINT32_MAX;
+	uint32_t collapsedDepth = UINT32_MAX;
+
+	for (size_t i = 0; i < frame.Events.size(); i++) {
+		const ProfileEvent& e = frame.Events[i];
+
+		//new thread, close everything from the last one
+		if (e.Thread != currentThread) {
+			for (; !openDepths.empty(); openDepths.pop_back()) {
+				ImGui::TreePop();
+			}
+			currentThread = e.Thread;
+			collapsedDepth = UINT32_MAX;
+			ImGui::SeparatorText(("Thread " + std::to_string(e.Thread)).c_str());
+		}
+
+		//close nodes that this event isn't inside of
+		while (!openDepths.empty() && openDepths.back() >= e.Depth) {
+			ImGui::TreePop();
+			openDepths.pop_back();
+		}
+
+		//skip children of a collapsed node
+		if (e.Depth > collapsedDepth) {
+			continue;
+		}
+		collapsedDepth = UINT32_MAX;
+
+		bool hasChildren = i + 1 < frame.Events.size() &&
+			frame.Events[i + 1].Thread == e.Thread &&
+			frame.Events[i + 1].Depth > e.Depth;
+
+		ImGuiTreeNodeFlags flags = hasChildren ? 0 : ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen;
+		bool open = ImGui::TreeNodeEx((void*)(intptr_t)i, flags, "%s: %.3f ms", e.Name, Profiler::TicksToMilliseconds(e.End - e.Start));
+
+		if (hasChildren) {
+			if (open) {
+				openDepths.push_back(e.Depth);
+			}
+			else {
+				collapsedDepth = e.Depth;
+			}
+		}
+	}
+
+	for (; !openDepths.empty(); openDepths.pop_back()) {
+		ImGui::TreePop();
+	}
+}
@@ -5,6 +5,7 @@
 #include <DirectXMath.h>
 
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "Mesh.h"
@@ -19,6 +20,19 @@
 #include "Lights.h"
 #include "Sky.h"
 #include "Emitter.h"
+#include "ParticleBudget.h"
+#include "FrameStats.h"
+#include "Profiler.h"
+#include "SoftwareRasterizer.h"
+#include "OcclusionCuller.h"
+#include "TextureLoader.h"
+#include "TextureStreamer.h"
+#include "PostProcessor.h"
+#include "RenderGraphExecutor.h"
+#include "LightPacker.h"
+#include "LightClusters.h"
+#include "EntityLightLists.h"
+#include "DynamicStructuredBuffer.h"
 
 using namespace DirectX;
 
@@ -37,6 +51,13 @@ public:
 	void Draw(float deltaTime, float totalTime);
 	void OnResize();
 
+	// Draws the scene on the CPU and saves it (.png or .ppm)
+	const SoftwareRasterTimings& RenderReference(const std::string& path);
+
+	// Last frame's occlusion culling results and total cost
+	OcclusionStats GetOcclusionStats() const;
+	double GetOcclusionMs() const;
+
 private:
 	//UI related fields
 	bool showDemoUI = false; //only draw demo text if needed
@@ -56,12 +77,40 @@ private:
 	//Lights pointLight1 = {};
 	//Lights pointLight2 = {};
 
+	//Lights in the layout shaders read, packed and uploaded once per frame (see LightPacker)
+	static constexpr int MaxExtraLights = 4096;
+	LightPacker lightPacker;
+	std::shared_ptr<DynamicStructuredBuffer> lightBuffer;
+	double lightPackMs = 0.0;
+
+	//Clustered lighting: which lights reach each part of the view (see LightClusters)
+	LightClusters lightClusters;
+	std::shared_ptr<DynamicStructuredBuffer> clusterRangeBuffer; //ClusterRange per cluster
+	std::shared_ptr<DynamicStructuredBuffer> clusterIndexBuffer; //light indices
+	int lightCulling = 1; //0 = every light for every pixel, 1 = clusters, 2 = per entity lists
+	bool clustersBuilt = false; //this frame (not for orthographic cameras)
+	XMFLOAT4 clusterDepthRow = XMFLOAT4(0, 0, 0, 0); //view matrix column giving view depth
+	double clusterMs = 0.0;
+	size_t sceneLightCount = 0; //lights before the extra ones
+
+	//Per entity light lists: the lights touching each visible entity's bounds (see EntityLightLists)
+	EntityLightLists entityLights;
+	std::vector<DirectX::BoundingBox> entityBounds; //copied out of the entities for the tests
+	bool entityListsBuilt = false; //this frame
+	double entityLightMs = 0.0;
+	int extraPointLights = 0; //scattered around the scene to stress the culling
+
 	//lighting values
 	XMFLOAT3 ambientLight = XMFLOAT3(0.25f, 0.25f, 0.25f); //complement gray "sky"
 
 	//sky
 	std::shared_ptr<Sky> defaultSky;
 
+	//image based lighting from the sky, baked at startup (or read from the cache)
+	float iblIntensity = 1.0f;
+	double iblMs = 0.0; //baking or loading
+	bool iblFromCache = false;
+
 
 	////Vertices Default Colors
 	//XMFLOAT4 top;
@@ -87,9 +136,40 @@ private:
 	//variable for floor
 	std::shared_ptr<Entity> floor;
 
+	//Visibility
+	std::vector<unsigned char> entityVisible; //1 if the entity survived culling this frame
+	std::vector<std::vector<unsigned int>> renderBuckets; //one per job thread, merged into renderQueue
+	std::vector<unsigned int> renderQueue; //visible entity indices in draw order
+
+	//Occlusion culling
+	std::shared_ptr<OcclusionCuller> occlusionCuller; //quarter resolution depth of the occluders
+	bool occlusionCullingEnabled = true;
+	double occlusionMs = 0.0; //drawing occluders + testing, last frame
+
+	//Startup texture loading
+	std::vector<TextureLoadTiming> textureLoadTimings; //one per texture, in load order
+	double textureLoadMs = 0.0; //whole batch, decode + upload
+
+	//Cooked textures: small mips at startup, the rest streamed in by screen size
+	std::shared_ptr<TextureStreamer> textureStreamer;
+
+	//Frame timing
+	FrameStats frameStats; //last few thousand frame times
+	ProfileFrame hitchSnapshot; //profile of the most recent hitch
+	bool hasHitchSnapshot = false;
+
+	//CPU reference renderer, created the first time it's used
+	std::shared_ptr<SoftwareRasterizer> referenceRasterizer;
+	std::string referencePath; //last image written, shown in the UI
+
+	//Frame passes and the textures between them (see RenderGraph)
+	std::shared_ptr<RenderGraphExecutor> renderGraph;
+	unsigned int shadowMapResource, sceneColorResource; //transient, made by the graph
+	unsigned int depthBufferResource, backBufferResource; //imported
+	float frameDeltaTime = 0.0f, frameTotalTime = 0.0f; //for passes, set at the start of Draw()
+
 	//Shadows
-	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowDSV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV;
+	//the shadow map itself is a render graph texture
 	Microsoft::WRL::ComPtr<ID3D11RasterizerState> shadowRasterizer;
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> shadowSampler;
 	DirectX::XMFLOAT4X4 lightViewMatrix;
@@ -102,22 +182,29 @@ private:
 	float lightProjectionSize;
 
 	//Post Processing
-	//resources that are shared among all post processes
-	Microsoft::WRL::ComPtr<ID3D11SamplerState> ppSampler;
+	//passes and the pooled render targets they draw into
+	std::shared_ptr<PostProcessor> postProcessor;
 	std::shared_ptr<SimpleVertexShader> ppVS;
-	//resources that are tied to a particular post process
 	std::shared_ptr<SimplePixelShader> ppPS;
-	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> ppRTV; //rendering
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> ppSRV; //sampling
+	//blur runs in two passes, rows then columns (see BoxBlur)
+	std::shared_ptr<SimpleComputeShader> blurCS; //sliding window, same cost at any radius
+	unsigned int blurRowsPass, blurColumnsPass; //separable
+	unsigned int blurRowsCSPass, blurColumnsCSPass; //compute
+	unsigned int copyPass; //onto the screen when nothing else gets there
 	int blurRadius = 0;
+	int blurMode = 0; //0 = separable pixel shader passes, 1 = sliding window compute
+	int blurResolution = 0; //0 = full, 1 = half, 2 = quarter (separable only)
 	float parallaxScale = 0.001f;
 	int parallaxSamples = 5;
 
 	// Particles
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> particleDepthState;
 	Microsoft::WRL::ComPtr<ID3D11BlendState> particleBlendState;
+	Microsoft::WRL::ComPtr<ID3D11BlendState> particleAlphaBlendState;
 	Microsoft::WRL::ComPtr<ID3D11RasterizerState> particleDebugRasterState;
-	std::shared_ptr<Emitter> particleSystem;
+	std::shared_ptr<ParticleArena> particleArena;
+	std::shared_ptr<ParticleBudget> particleBudget; //culling + distance LOD under one particle count
+	std::vector<std::shared_ptr<Emitter>> emitters;
 	void DrawParticles(float totalTime);
 
 	// Initialization helper methods - feel free to customize, combine, remove, etc.
@@ -126,11 +213,28 @@ private:
 	//UI helper functions
 	void UpdateUI(float deltaTime);
 	void DrawUI();
+	void DrawProfilerUI();
+	void DrawFrameStatsUI();
+	void DrawProfileTree(const ProfileFrame& frame);
+	void DrawReferenceUI();
+	void DrawRenderGraphUI();
+
+	//Per frame visibility helpers
+	void CullEntities();
+	void CullOccludedEntities();
+	void BuildRenderQueue();
+	void PackLights();
+	void BuildLightClusters();
+	void BuildEntityLightLists();
+	void ScatterPointLights();
+
+	void CreateRenderGraph();
+	void DrawScene(const RenderGraphContext& context);
 
 	void CreateShadowMap();
-	void DrawShadowMap();
+	void DrawShadowMap(const RenderGraphContext& context);
 
-	void ResetPostProcess();
-	void PreparePostProcess();
+	void CreatePostProcess();
+	void DrawPostProcess(const RenderGraphContext& context);
 };
 
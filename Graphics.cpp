@@ -1,4 +1,6 @@
 #include "Graphics.h"
+#include "D3D11RenderDevice.h"
+#include "RecordingRenderDevice.h"
 #include <dxgi1_6.h>
 
 // Tell the drivers to use high-performance GPU in multi-GPU systems (like laptops)
@@ -17,6 +19,7 @@ namespace Graphics
 		bool apiInitialized = false;
 		bool supportsTearing = false;
 		bool vsyncDesired = false;
+		bool headless = false;
 		BOOL isFullscreen = false;
 
 		D3D_FEATURE_LEVEL featureLevel;
@@ -27,6 +30,7 @@ namespace Graphics
 
 // Getters
 bool Graphics::VsyncState() { return vsyncDesired || !supportsTearing || isFullscreen; }
+bool Graphics::IsHeadless() { return headless; }
 std::wstring Graphics::APIName() 
 { 
 	switch (featureLevel)
@@ -122,6 +126,9 @@ HRESULT Graphics::Initialize(unsigned int windowWidth, unsigned int windowHeight
 		Context.GetAddressOf());	// Pointer to our Device Context pointer
 	if (FAILED(hr)) return hr;
 
+	// Frame commands go straight through to the context
+	Renderer = std::make_unique<D3D11RenderDevice>(Context, SwapChain, supportsTearing);
+
 	// We're set up
 	apiInitialized = true;
 
@@ -142,6 +149,48 @@ HRESULT Graphics::Initialize(unsigned int windowWidth, unsigned int windowHeight
 	return S_OK;
 }
 
+// --------------------------------------------------------
+// Initializes the Graphics API without a window or GPU.
+// 
+// Uses the NULL driver, which supports creating resources
+// and shaders but never renders anything, and a recording
+// device that only counts the commands of each frame.
+// 
+// width  - Width of the offscreen back buffer
+// height - Height of the offscreen back buffer
+// --------------------------------------------------------
+HRESULT Graphics::InitializeHeadless(unsigned int width, unsigned int height)
+{
+	// Only initialize once
+	if (apiInitialized)
+		return E_FAIL;
+
+	HRESULT hr = D3D11CreateDevice(
+		0,						// Default adapter
+		D3D_DRIVER_TYPE_NULL,	// No rendering at all
+		0,						// Not a software rasterizer
+		0,						// No debug layer on the null driver
+		0,						// Default feature levels
+		0,
+		D3D11_SDK_VERSION,
+		Device.GetAddressOf(),
+		&featureLevel,
+		Context.GetAddressOf());
+	if (FAILED(hr)) return hr;
+
+	Renderer = std::make_unique<RecordingRenderDevice>();
+
+	// No swap chain, so vsync and tearing don't apply
+	vsyncDesired = false;
+	supportsTearing = true;
+	headless = true;
+	apiInitialized = true;
+
+	// Creates the offscreen back buffer and depth buffer
+	ResizeBuffers(width, height);
+	return S_OK;
+}
+
 // --------------------------------------------------------
 // Called at the end of the program to clean up any
 // graphics API specific memory. 
@@ -152,6 +201,7 @@ HRESULT Graphics::Initialize(unsigned int windowWidth, unsigned int windowHeight
 // --------------------------------------------------------
 void Graphics::ShutDown()
 {
+	Renderer.reset();
 }
 
 
@@ -175,20 +225,38 @@ void Graphics::ResizeBuffers(unsigned int width, unsigned int height)
 	BackBufferRTV.Reset();
 	DepthBufferDSV.Reset();
 
-	// Resize the swap chain buffers
-	SwapChain->ResizeBuffers(
-		2, 
-		width, 
-		height, 
-		DXGI_FORMAT_R8G8B8A8_UNORM, 
-		supportsTearing ? DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING : 0);
-
-	// Grab the references to the first buffer
+	// Headless runs have no swap chain, so the
+	// "back buffer" is just an offscreen texture
 	Microsoft::WRL::ComPtr<ID3D11Texture2D> backBufferTexture;
-	SwapChain->GetBuffer(
-		0,
-		__uuidof(ID3D11Texture2D),
-		(void**)backBufferTexture.GetAddressOf());
+	if (headless)
+	{
+		D3D11_TEXTURE2D_DESC backBufferDesc = {};
+		backBufferDesc.Width = width;
+		backBufferDesc.Height = height;
+		backBufferDesc.MipLevels = 1;
+		backBufferDesc.ArraySize = 1;
+		backBufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		backBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+		backBufferDesc.BindFlags = D3D11_BIND_RENDER_TARGET;
+		backBufferDesc.SampleDesc.Count = 1;
+		Device->CreateTexture2D(&backBufferDesc, 0, backBufferTexture.GetAddressOf());
+	}
+	else
+	{
+		// Resize the swap chain buffers
+		SwapChain->ResizeBuffers(
+			2,
+			width,
+			height,
+			DXGI_FORMAT_R8G8B8A8_UNORM,
+			supportsTearing ? DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING : 0);
+
+		// Grab the references to the first buffer
+		SwapChain->GetBuffer(
+			0,
+			__uuidof(ID3D11Texture2D),
+			(void**)backBufferTexture.GetAddressOf());
+	}
 
 	// Now that we have the texture, create a render target view
 	// for the back buffer so we can render into it.
@@ -239,7 +307,8 @@ void Graphics::ResizeBuffers(unsigned int width, unsigned int height)
 	Context->RSSetViewports(1, &viewport);
 
 	// Are we in a fullscreen state?
-	SwapChain->GetFullscreenState(&isFullscreen, 0);
+	if (SwapChain)
+		SwapChain->GetFullscreenState(&isFullscreen, 0);
 }
 
 
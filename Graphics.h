@@ -2,9 +2,12 @@
 
 #include <Windows.h>
 #include <d3d11.h>
+#include <memory>
 #include <string>
 #include <wrl/client.h>
 
+#include "RenderDevice.h"
+
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "dxgi.lib")
 
@@ -21,14 +24,19 @@ namespace Graphics
 	inline Microsoft::WRL::ComPtr<ID3D11RenderTargetView> BackBufferRTV;
 	inline Microsoft::WRL::ComPtr<ID3D11DepthStencilView> DepthBufferDSV;
 
+	// Per-frame command submission (D3D11, or recording only when headless)
+	inline std::unique_ptr<IRenderDevice> Renderer;
+
 	// --- FUNCTIONS ---
 
 	// Getters
 	bool VsyncState();
+	bool IsHeadless();
 	std::wstring APIName();
 
 	// General functions
 	HRESULT Initialize(unsigned int windowWidth, unsigned int windowHeight, HWND windowHandle, bool vsyncIfPossible);
+	HRESULT InitializeHeadless(unsigned int width, unsigned int height);
 	void ShutDown();
 	void ResizeBuffers(unsigned int width, unsigned int height);
 
@@ -0,0 +1,698 @@
+#include "IBLBaker.h"
+#include "JobSystem.h"
+#include "TextureCooker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <immintrin.h>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	constexpr float PI = 3.14159265359f;
+	constexpr uint32_t CacheMagic = 0x314C4249;	// "IBL1"
+	constexpr uint32_t CacheVersion = 1;
+
+	struct CacheHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint64_t Stamp;
+		uint32_t SpecularSize;
+		uint32_t SpecularMips;
+		uint32_t LutSize;
+		uint32_t Padding;
+	};
+
+	uint64_t Fnv(const void* data, size_t size, uint64_t hash)
+	{
+		const uint8_t* bytes = (const uint8_t*)data;
+		for (size_t i = 0; i < size; i++)
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		return hash;
+	}
+
+	// Direction through texel (u, v) in [-1, 1] of a face (D3D layout, not normalized)
+	void FaceDirection(unsigned int face, float u, float v, float dir[3])
+	{
+		switch (face)
+		{
+		case 0: dir[0] = 1;  dir[1] = -v; dir[2] = -u; break;
+		case 1: dir[0] = -1; dir[1] = -v; dir[2] = u;  break;
+		case 2: dir[0] = u;  dir[1] = 1;  dir[2] = v;  break;
+		case 3: dir[0] = u;  dir[1] = -1; dir[2] = -v; break;
+		case 4: dir[0] = u;  dir[1] = -v; dir[2] = 1;  break;
+		default: dir[0] = -u; dir[1] = -v; dir[2] = -1; break;
+		}
+	}
+
+	// The reverse: which face a direction hits and where, u and v in [0, 1]
+	unsigned int DirectionToFace(const float dir[3], float& u, float& v)
+	{
+		float ax = fabsf(dir[0]), ay = fabsf(dir[1]), az = fabsf(dir[2]);
+		unsigned int face;
+		float su, sv, major;
+		if (ax >= ay && ax >= az)
+		{
+			face = dir[0] > 0 ? 0 : 1;
+			major = ax;
+			su = dir[0] > 0 ? -dir[2] : dir[2];
+			sv = -dir[1];
+		}
+		else if (ay >= az)
+		{
+			face = dir[1] > 0 ? 2 : 3;
+			major = ay;
+			su = dir[0];
+			sv = dir[1] > 0 ? dir[2] : -dir[2];
+		}
+		else
+		{
+			face = dir[2] > 0 ? 4 : 5;
+			major = az;
+			su = dir[2] > 0 ? dir[0] : -dir[0];
+			sv = -dir[1];
+		}
+		u = (su / major) * 0.5f + 0.5f;
+		v = (sv / major) * 0.5f + 0.5f;
+		return face;
+	}
+
+	// The sky and all of its box filtered mips
+	struct CubeMips
+	{
+		std::vector<CubeImage> Levels;
+
+		void Build(const CubeImage& sky)
+		{
+			Levels.assign(1, sky);
+			while (Levels.back().Size > 1)
+			{
+				const CubeImage& source = Levels.back();
+				CubeImage level;
+				level.Resize(source.Size / 2);
+				for (unsigned int face = 0; face < 6; face++)
+				{
+					const float* in = source.Faces[face].data();
+					float* out = level.Faces[face].data();
+					for (unsigned int y = 0; y < level.Size; y++)
+					{
+						for (unsigned int x = 0; x < level.Size; x++)
+						{
+							const float* a = in + ((y * 2) * source.Size + x * 2) * 4;
+							const float* b = a + source.Size * 4;
+							__m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(a), _mm_loadu_ps(a + 4)),
+								_mm_add_ps(_mm_loadu_ps(b), _mm_loadu_ps(b + 4)));
+							_mm_storeu_ps(out + (y * level.Size + x) * 4, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+						}
+					}
+				}
+				Levels.push_back(std::move(level));
+			}
+		}
+
+		// Bilinear within one face (edges clamp rather than wrap to the next face)
+		__m128 Bilinear(unsigned int mip, const float dir[3]) const
+		{
+			const CubeImage& level = Levels[mip];
+			float u, v;
+			unsigned int face = DirectionToFace(dir, u, v);
+			float x = std::clamp(u * level.Size - 0.5f, 0.0f, (float)(level.Size - 1));
+			float y = std::clamp(v * level.Size - 0.5f, 0.0f, (float)(level.Size - 1));
+			unsigned int x0 = (unsigned int)x, y0 = (unsigned int)y;
+			unsigned int x1 = std::min(x0 + 1, level.Size - 1), y1 = std::min(y0 + 1, level.Size - 1);
+			float fx = x - x0, fy = y - y0;
+
+			const float* texels = level.Faces[face].data();
+			__m128 top = _mm_add_ps(
+				_mm_mul_ps(_mm_loadu_ps(texels + (y0 * level.Size + x0) * 4), _mm_set1_ps(1 - fx)),
+				_mm_mul_ps(_mm_loadu_ps(texels + (y0 * level.Size + x1) * 4), _mm_set1_ps(fx)));
+			__m128 bottom = _mm_add_ps(
+				_mm_mul_ps(_mm_loadu_ps(texels + (y1 * level.Size + x0) * 4), _mm_set1_ps(1 - fx)),
+				_mm_mul_ps(_mm_loadu_ps(texels + (y1 * level.Size + x1) * 4), _mm_set1_ps(fx)));
+			return _mm_add_ps(_mm_mul_ps(top, _mm_set1_ps(1 - fy)), _mm_mul_ps(bottom, _mm_set1_ps(fy)));
+		}
+
+		// Between the two nearest mips
+		__m128 Trilinear(float lod, const float dir[3]) const
+		{
+			lod = std::clamp(lod, 0.0f, (float)(Levels.size() - 1));
+			unsigned int mip = (unsigned int)lod;
+			float blend = lod - mip;
+			__m128 color = Bilinear(mip, dir);
+			if (blend <= 0.0f || mip + 1 >= Levels.size())
+				return color;
+			__m128 next = Bilinear(mip + 1, dir);
+			return _mm_add_ps(color, _mm_mul_ps(_mm_sub_ps(next, color), _mm_set1_ps(blend)));
+		}
+	};
+
+	// Low discrepancy points in [0, 1)^2
+	void Hammersley(unsigned int i, unsigned int count, float& x, float& y)
+	{
+		uint32_t bits = i;
+		bits = (bits << 16) | (bits >> 16);
+		bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+		bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+		bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+		bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+		x = (float)i / count;
+		y = bits * 2.3283064365386963e-10f;
+	}
+
+	// Cosine of a GGX half vector's angle from the normal for a random number
+	float GGXCosTheta(float random, float alpha)
+	{
+		return sqrtf((1.0f - random) / (1.0f + (alpha * alpha - 1.0f) * random));
+	}
+
+	void Orthonormal(const float n[3], float t[3], float b[3])
+	{
+		float up[3] = { 0, 0, 0 };
+		up[fabsf(n[1]) < 0.999f ? 1 : 0] = 1;
+		t[0] = up[1] * n[2] - up[2] * n[1];
+		t[1] = up[2] * n[0] - up[0] * n[2];
+		t[2] = up[0] * n[1] - up[1] * n[0];
+		float length = sqrtf(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+		t[0] /= length; t[1] /= length; t[2] /= length;
+		b[0] = n[1] * t[2] - n[2] * t[1];
+		b[1] = n[2] * t[0] - n[0] * t[2];
+		b[2] = n[0] * t[1] - n[1] * t[0];
+	}
+
+	// One importance sample for prefiltering, relative to the normal
+	struct SpecularSample
+	{
+		float Local[3];
+		float Weight;	// N.L
+		float Lod;		// Sky mip with texels about the size of the sample's footprint
+	};
+
+	// With N = V = R (the usual split sum assumption) the samples are the
+	// same for every texel of a mip, only their frame changes
+	std::vector<SpecularSample> SpecularSamples(float roughness, unsigned int count, unsigned int skySize)
+	{
+		float alpha = roughness * roughness;
+		float texelSolidAngle = 4.0f * PI / (6.0f * skySize * skySize);
+
+		std::vector<SpecularSample> samples;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			float rx, ry;
+			Hammersley(i, count, rx, ry);
+			float phi = 2.0f * PI * rx;
+			float cosTheta = GGXCosTheta(ry, alpha);
+			float sinTheta = sqrtf(1.0f - cosTheta * cosTheta);
+			float h[3] = { sinTheta * cosf(phi), sinTheta * sinf(phi), cosTheta };
+
+			// Reflect V = N = (0, 0, 1) about H
+			SpecularSample sample;
+			sample.Local[0] = 2.0f * cosTheta * h[0];
+			sample.Local[1] = 2.0f * cosTheta * h[1];
+			sample.Local[2] = 2.0f * cosTheta * h[2] - 1.0f;
+			sample.Weight = sample.Local[2];
+			if (sample.Weight <= 0.0f)
+				continue;
+
+			// pdf = D * N.H / (4 V.H), and N.H = V.H here
+			float a2 = alpha * alpha;
+			float denominator = cosTheta * cosTheta * (a2 - 1.0f) + 1.0f;
+			float d = a2 / (PI * denominator * denominator);
+			float pdf = d * 0.25f;
+			float sampleSolidAngle = 1.0f / (count * pdf + 0.0001f);
+			sample.Lod = std::max(0.5f * log2f(sampleSolidAngle / texelSolidAngle) + 1.0f, 0.0f);
+			samples.push_back(sample);
+		}
+		return samples;
+	}
+
+	// sRGB bytes to linear floats
+	struct LinearTable
+	{
+		float Values[256];
+		LinearTable()
+		{
+			for (int i = 0; i < 256; i++)
+				Values[i] = powf(i / 255.0f, 2.2f);
+		}
+	};
+}
+
+void CubeImage::Resize(unsigned int size)
+{
+	Size = size;
+	for (std::vector<float>& face : Faces)
+		face.assign((size_t)size * size * 4, 0.0f);
+}
+
+size_t IBLData::SpecularOffset(unsigned int face, unsigned int mip) const
+{
+	size_t perFace = 0, offset = 0;
+	for (unsigned int m = 0; m < SpecularMips; m++)
+	{
+		size_t size = std::max(SpecularSize >> m, 1u);
+		if (m < mip)
+			offset += size * size * 4;
+		perFace += size * size * 4;
+	}
+	return face * perFace + offset;
+}
+
+void IBLBaker::FaceFromImage(const CpuImage& image, unsigned int size, std::vector<float>& face)
+{
+	static const LinearTable linear;
+
+	CpuImage rgba;
+	TextureCooker::ToRGBA8(image, rgba);
+	face.assign((size_t)size * size * 4, 0.0f);
+	if (rgba.Width == 0 || rgba.Height == 0)
+		return;
+
+	// Every source pixel lands in exactly one output texel
+	std::vector<float> counts((size_t)size * size, 0.0f);
+	for (unsigned int y = 0; y < rgba.Height; y++)
+	{
+		unsigned int outY = (unsigned int)((uint64_t)y * size / rgba.Height);
+		const uint8_t* row = rgba.Pixels.data() + (size_t)y * rgba.RowPitch();
+		for (unsigned int x = 0; x < rgba.Width; x++)
+		{
+			unsigned int outX = (unsigned int)((uint64_t)x * size / rgba.Width);
+			float* out = &face[((size_t)outY * size + outX) * 4];
+			const uint8_t* pixel = row + x * 4;
+			out[0] += linear.Values[pixel[0]];
+			out[1] += linear.Values[pixel[1]];
+			out[2] += linear.Values[pixel[2]];
+			out[3] += pixel[3] / 255.0f;
+			counts[(size_t)outY * size + outX] += 1.0f;
+		}
+	}
+
+	// Upsampling leaves gaps, fill them from the nearest source pixel
+	for (unsigned int y = 0; y < size; y++)
+	{
+		for (unsigned int x = 0; x < size; x++)
+		{
+			size_t index = (size_t)y * size + x;
+			if (counts[index] > 0.0f)
+			{
+				for (int c = 0; c < 4; c++)
+					face[index * 4 + c] /= counts[index];
+				continue;
+			}
+			unsigned int sx = std::min((unsigned int)((x + 0.5f) * rgba.Width / size), rgba.Width - 1);
+			unsigned int sy = std::min((unsigned int)((y + 0.5f) * rgba.Height / size), rgba.Height - 1);
+			const uint8_t* pixel = rgba.Pixels.data() + (size_t)sy * rgba.RowPitch() + sx * 4;
+			for (int c = 0; c < 3; c++)
+				face[index * 4 + c] = linear.Values[pixel[c]];
+			face[index * 4 + 3] = pixel[3] / 255.0f;
+		}
+	}
+}
+
+void IBLBaker::LoadFaces(const std::filesystem::path faces[6], unsigned int size, CubeImage& cube)
+{
+	cube.Resize(size);
+
+	JobCounter counter;
+	for (unsigned int i = 0; i < 6; i++)
+	{
+		JobSystem::Run(counter, [&cube, &faces, i, size]() {
+			CpuImage image;
+			if (PngDecoder::DecodeFile(faces[i], image))
+				FaceFromImage(image, size, cube.Faces[i]);
+		});
+	}
+	JobSystem::Wait(counter);
+}
+
+uint64_t IBLBaker::SourceStamp(const std::filesystem::path faces[6])
+{
+	uint64_t hash = Fnv(&CacheVersion, sizeof(CacheVersion), 14695981039346656037ull);
+	for (unsigned int i = 0; i < 6; i++)
+	{
+		std::error_code error;
+		uint64_t size = std::filesystem::file_size(faces[i], error);
+		if (error)
+			size = ~0ull;
+		int64_t time = 0;
+		std::filesystem::file_time_type written = std::filesystem::last_write_time(faces[i], error);
+		if (!error)
+			time = (int64_t)written.time_since_epoch().count();
+
+		hash = Fnv(&size, sizeof(size), hash);
+		hash = Fnv(&time, sizeof(time), hash);
+	}
+	return hash;
+}
+
+void IBLBaker::Bake(const CubeImage& sky, IBLData& data, unsigned int specularSize, unsigned int specularMips, unsigned int lutSize)
+{
+	ProjectSH(sky, data.IrradianceSH);
+	PrefilterSpecular(sky, specularSize, specularMips, 256, data);
+	BakeBrdfLut(lutSize, 512, data);
+}
+
+void IBLBaker::ProjectSH(const CubeImage& sky, float sh[9][4])
+{
+	// One partial sum per row, added up in order afterwards so
+	// the result doesn't depend on how the rows were split up
+	unsigned int rows = sky.Size * 6;
+	std::vector<float> partial((size_t)rows * 40, 0.0f);
+
+	JobSystem::ParallelFor(rows, [&](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int row = begin; row < end; row++)
+			{
+				unsigned int face = row / sky.Size;
+				unsigned int y = row % sky.Size;
+				float v = (y + 0.5f) * 2.0f / sky.Size - 1.0f;
+				const float* texels = sky.Faces[face].data() + (size_t)y * sky.Size * 4;
+
+				__m128 sums[9] = {};
+				float weights = 0.0f;
+				for (unsigned int x = 0; x < sky.Size; x++)
+				{
+					float u = (x + 0.5f) * 2.0f / sky.Size - 1.0f;
+					float dir[3];
+					FaceDirection(face, u, v, dir);
+					float lengthSq = 1.0f + u * u + v * v;
+					float inverseLength = 1.0f / sqrtf(lengthSq);
+					float nx = dir[0] * inverseLength, ny = dir[1] * inverseLength, nz = dir[2] * inverseLength;
+
+					// Solid angle of the texel (up to a constant, normalized below)
+					float weight = inverseLength / lengthSq;
+					weights += weight;
+
+					float basis[9] = {
+						0.282095f,
+						0.488603f * ny, 0.488603f * nz, 0.488603f * nx,
+						1.092548f * nx * ny, 1.092548f * ny * nz, 0.315392f * (3.0f * nz * nz - 1.0f),
+						1.092548f * nx * nz, 0.546274f * (nx * nx - ny * ny) };
+
+					__m128 color = _mm_mul_ps(_mm_loadu_ps(texels + x * 4), _mm_set1_ps(weight));
+					for (int i = 0; i < 9; i++)
+						sums[i] = _mm_add_ps(sums[i], _mm_mul_ps(color, _mm_set1_ps(basis[i])));
+				}
+
+				for (int i = 0; i < 9; i++)
+					_mm_storeu_ps(&partial[((size_t)row * 10 + i) * 4], sums[i]);
+				_mm_storeu_ps(&partial[((size_t)row * 10 + 9) * 4], _mm_set1_ps(weights));
+			}
+		});
+
+	__m128 totals[10] = {};
+	for (unsigned int row = 0; row < rows; row++)
+		for (int i = 0; i < 10; i++)
+			totals[i] = _mm_add_ps(totals[i], _mm_loadu_ps(&partial[((size_t)row * 10 + i) * 4]));
+
+	// Weights add up to the sphere (4 pi), then convolve with the
+	// cosine lobe (pi, 2pi/3, pi/4 per band) and divide by pi
+	float weightSum = _mm_cvtss_f32(totals[9]);
+	const float band[9] = { 1.0f, 2.0f / 3, 2.0f / 3, 2.0f / 3, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+	for (int i = 0; i < 9; i++)
+	{
+		float scale = weightSum > 0.0f ? 4.0f * PI / weightSum * band[i] : 0.0f;
+		_mm_storeu_ps(sh[i], _mm_mul_ps(totals[i], _mm_set1_ps(scale)));
+		sh[i][3] = 0.0f;
+	}
+}
+
+void IBLBaker::PrefilterSpecular(const CubeImage& sky, unsigned int size, unsigned int mips, unsigned int samples, IBLData& data)
+{
+	mips = std::max(mips, 1u);
+	data.SpecularSize = size;
+	data.SpecularMips = mips;
+	data.Specular.assign(data.SpecularOffset(6, 0), 0);
+
+	CubeMips source;
+	source.Build(sky);
+
+	for (unsigned int mip = 0; mip < mips; mip++)
+	{
+		unsigned int mipSize = std::max(size >> mip, 1u);
+		float roughness = mips > 1 ? (float)mip / (mips - 1) : 0.0f;
+
+		// Mirror-like: a straight resample of the matching sky mip
+		std::vector<SpecularSample> sampleSet;
+		if (mip > 0)
+			sampleSet = SpecularSamples(roughness, samples, sky.Size);
+		float mirrorLod = std::max(log2f((float)sky.Size / mipSize), 0.0f);
+
+		JobSystem::ParallelFor(mipSize * 6, [&](unsigned int begin, unsigned int end)
+			{
+				for (unsigned int row = begin; row < end; row++)
+				{
+					unsigned int face = row / mipSize;
+					unsigned int y = row % mipSize;
+					float v = (y + 0.5f) * 2.0f / mipSize - 1.0f;
+					uint16_t* out = data.Specular.data() + data.SpecularOffset(face, mip) + (size_t)y * mipSize * 4;
+
+					for (unsigned int x = 0; x < mipSize; x++)
+					{
+						float u = (x + 0.5f) * 2.0f / mipSize - 1.0f;
+						float n[3];
+						FaceDirection(face, u, v, n);
+						float inverseLength = 1.0f / sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+						n[0] *= inverseLength; n[1] *= inverseLength; n[2] *= inverseLength;
+
+						__m128 color;
+						if (sampleSet.empty())
+						{
+							color = source.Trilinear(mirrorLod, n);
+						}
+						else
+						{
+							float t[3], b[3];
+							Orthonormal(n, t, b);
+							__m128 sum = _mm_setzero_ps();
+							float weights = 0.0f;
+							for (const SpecularSample& s : sampleSet)
+							{
+								float l[3];
+								for (int c = 0; c < 3; c++)
+									l[c] = t[c] * s.Local[0] + b[c] * s.Local[1] + n[c] * s.Local[2];
+								sum = _mm_add_ps(sum, _mm_mul_ps(source.Trilinear(s.Lod, l), _mm_set1_ps(s.Weight)));
+								weights += s.Weight;
+							}
+							color = _mm_mul_ps(sum, _mm_set1_ps(1.0f / weights));
+						}
+
+						float rgba[4];
+						_mm_storeu_ps(rgba, color);
+						for (int c = 0; c < 4; c++)
+							out[x * 4 + c] = FloatToHalf(rgba[c]);
+					}
+				}
+			}, 1);
+	}
+}
+
+void IBLBaker::BakeBrdfLut(unsigned int size, unsigned int samples, IBLData& data)
+{
+	data.LutSize = size;
+	data.BrdfLut.assign((size_t)size * size * 2, 0);
+
+	// Samples go through the SIMD loop 4 at a time, so round up and
+	// give the extras no weight
+	unsigned int padded = (samples + 3) & ~3u;
+	std::vector<float> random(padded), cosPhi(padded), sinPhi(padded), valid(padded);
+	for (unsigned int i = 0; i < padded; i++)
+	{
+		float rx, ry;
+		Hammersley(std::min(i, samples - 1), samples, rx, ry);
+		random[i] = ry;
+		cosPhi[i] = cosf(2.0f * PI * rx);
+		sinPhi[i] = sinf(2.0f * PI * rx);
+		valid[i] = i < samples ? 1.0f : 0.0f;
+	}
+
+	JobSystem::ParallelFor(size, [&](unsigned int begin, unsigned int end)
+		{
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 one = _mm_set1_ps(1.0f);
+			const __m128 two = _mm_set1_ps(2.0f);
+
+			for (unsigned int y = begin; y < end; y++)
+			{
+				float roughness = (y + 0.5f) / size;
+				float alpha = roughness * roughness;
+				__m128 alpha2Minus1 = _mm_set1_ps(alpha * alpha - 1.0f);
+				__m128 k = _mm_set1_ps(alpha * 0.5f);
+				__m128 oneMinusK = _mm_sub_ps(one, k);
+
+				for (unsigned int x = 0; x < size; x++)
+				{
+					// View in the xz plane, normal along z
+					float nDotV = std::max((x + 0.5f) / size, 0.0001f);
+					__m128 vx = _mm_set1_ps(sqrtf(1.0f - nDotV * nDotV));
+					__m128 vz = _mm_set1_ps(nDotV);
+					__m128 gView = _mm_div_ps(vz, _mm_add_ps(_mm_mul_ps(vz, oneMinusK), k));
+
+					__m128 sumA = zero, sumB = zero;
+					for (unsigned int i = 0; i < padded; i += 4)
+					{
+						// GGX half vector
+						__m128 r = _mm_loadu_ps(&random[i]);
+						__m128 cosTheta = _mm_sqrt_ps(_mm_div_ps(_mm_sub_ps(one, r), _mm_add_ps(one, _mm_mul_ps(alpha2Minus1, r))));
+						__m128 sinTheta = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(one, _mm_mul_ps(cosTheta, cosTheta)), zero));
+						__m128 hx = _mm_mul_ps(sinTheta, _mm_loadu_ps(&cosPhi[i]));
+						__m128 hz = cosTheta;
+
+						// L = 2 (V.H) H - V, only its z (N.L) matters
+						__m128 vDotH = _mm_add_ps(_mm_mul_ps(vx, hx), _mm_mul_ps(vz, hz));
+						__m128 nDotL = _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(two, vDotH), hz), vz);
+						__m128 mask = _mm_and_ps(_mm_cmpgt_ps(nDotL, zero), _mm_cmpgt_ps(_mm_loadu_ps(&valid[i]), zero));
+						nDotL = _mm_max_ps(nDotL, zero);
+						vDotH = _mm_max_ps(vDotH, zero);
+
+						// G * V.H / (N.H * N.V)
+						__m128 gLight = _mm_div_ps(nDotL, _mm_add_ps(_mm_mul_ps(nDotL, oneMinusK), k));
+						__m128 gVisible = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(gView, gLight), vDotH), _mm_mul_ps(hz, vz));
+						gVisible = _mm_and_ps(gVisible, mask);
+
+						// Schlick's (1 - V.H)^5
+						__m128 f = _mm_sub_ps(one, vDotH);
+						__m128 f2 = _mm_mul_ps(f, f);
+						__m128 fresnel = _mm_mul_ps(_mm_mul_ps(f2, f2), f);
+
+						sumA = _mm_add_ps(sumA, _mm_mul_ps(_mm_sub_ps(one, fresnel), gVisible));
+						sumB = _mm_add_ps(sumB, _mm_mul_ps(fresnel, gVisible));
+					}
+
+					float a[4], b[4];
+					_mm_storeu_ps(a, sumA);
+					_mm_storeu_ps(b, sumB);
+					uint16_t* out = data.BrdfLut.data() + ((size_t)y * size + x) * 2;
+					out[0] = FloatToHalf((a[0] + a[1] + a[2] + a[3]) / samples);
+					out[1] = FloatToHalf((b[0] + b[1] + b[2] + b[3]) / samples);
+				}
+			}
+		}, 1);
+}
+
+bool IBLBaker::Save(const std::filesystem::path& path, const IBLData& data, uint64_t stamp)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	CacheHeader header = {};
+	header.Magic = CacheMagic;
+	header.Version = CacheVersion;
+	header.Stamp = stamp;
+	header.SpecularSize = data.SpecularSize;
+	header.SpecularMips = data.SpecularMips;
+	header.LutSize = data.LutSize;
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)data.IrradianceSH, sizeof(data.IrradianceSH));
+	file.write((const char*)data.Specular.data(), data.Specular.size() * sizeof(uint16_t));
+	file.write((const char*)data.BrdfLut.data(), data.BrdfLut.size() * sizeof(uint16_t));
+	return (bool)file;
+}
+
+bool IBLBaker::Load(const std::filesystem::path& path, uint64_t stamp, IBLData& data)
+{
+	std::ifstream file(path, std::ios::binary);
+	CacheHeader header = {};
+	if (!file || !file.read((char*)&header, sizeof(header)) ||
+		header.Magic != CacheMagic || header.Version != CacheVersion || header.Stamp != stamp ||
+		header.SpecularSize == 0 || header.SpecularSize > 4096 || header.SpecularMips == 0 || header.SpecularMips > 13 ||
+		header.LutSize > 1024)
+		return false;
+
+	IBLData loaded;
+	loaded.SpecularSize = header.SpecularSize;
+	loaded.SpecularMips = header.SpecularMips;
+	loaded.LutSize = header.LutSize;
+	loaded.Specular.resize(loaded.SpecularOffset(6, 0));
+	loaded.BrdfLut.resize((size_t)header.LutSize * header.LutSize * 2);
+
+	file.read((char*)loaded.IrradianceSH, sizeof(loaded.IrradianceSH));
+	file.read((char*)loaded.Specular.data(), loaded.Specular.size() * sizeof(uint16_t));
+	file.read((char*)loaded.BrdfLut.data(), loaded.BrdfLut.size() * sizeof(uint16_t));
+	if (!file)
+		return false;
+
+	data = std::move(loaded);
+	return true;
+}
+
+void IBLBaker::EvaluateSH(const float sh[9][4], float x, float y, float z, float rgb[3])
+{
+	float basis[9] = {
+		0.282095f,
+		0.488603f * y, 0.488603f * z, 0.488603f * x,
+		1.092548f * x * y, 1.092548f * y * z, 0.315392f * (3.0f * z * z - 1.0f),
+		1.092548f * x * z, 0.546274f * (x * x - y * y) };
+
+	for (int c = 0; c < 3; c++)
+	{
+		rgb[c] = 0.0f;
+		for (int i = 0; i < 9; i++)
+			rgb[c] += sh[i][c] * basis[i];
+	}
+}
+
+float IBLBaker::HalfToFloat(uint16_t half)
+{
+	uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+	uint32_t exponent = (half >> 10) & 0x1F;
+	uint32_t mantissa = half & 0x3FF;
+
+	uint32_t bits;
+	if (exponent == 0x1F)
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	else if (exponent != 0)
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	else if (mantissa == 0)
+		bits = sign;
+	else
+	{
+		// Denormal: shift up until it's normalized
+		exponent = 113;
+		while (!(mantissa & 0x400))
+		{
+			mantissa <<= 1;
+			exponent--;
+		}
+		bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+	}
+
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+uint16_t IBLBaker::FloatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	uint32_t magnitude = bits & 0x7FFFFFFF;
+
+	if (magnitude >= 0x7F800000)
+		return sign | (magnitude > 0x7F800000 ? 0x7E00 : 0x7C00);
+	if (magnitude >= 0x477FF000)	// Rounds past the largest half
+		return sign | 0x7C00;
+	if (magnitude < 0x38800000)
+	{
+		// Denormal (or zero), rounded to nearest
+		if (magnitude < 0x33000000)
+			return sign;
+		uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+		uint32_t shift = 126 - (magnitude >> 23);
+		uint32_t half = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (half & 1)))
+			half++;
+		return sign | (uint16_t)half;
+	}
+
+	// Rebias the exponent and round the mantissa to nearest even
+	uint32_t half = ((magnitude - 0x38000000) + 0xFFF + ((magnitude >> 13) & 1)) >> 13;
+	return sign | (uint16_t)half;
+}
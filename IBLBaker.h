@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "PngDecoder.h"
+
+// --------------------------------------------------------
+// A cube map on the CPU: six square faces of linear RGBA
+// floats, in D3D order (+X, -X, +Y, -Y, +Z, -Z)
+// --------------------------------------------------------
+struct CubeImage
+{
+	unsigned int Size = 0;
+	std::vector<float> Faces[6];	// Size * Size * 4 each
+
+	void Resize(unsigned int size);
+};
+
+// --------------------------------------------------------
+// Everything image based lighting needs from one sky
+// --------------------------------------------------------
+struct IBLData
+{
+	// Diffuse: L2 spherical harmonics, already convolved with
+	// the cosine lobe and divided by pi (xyz = rgb, w unused)
+	float IrradianceSH[9][4] = {};
+
+	// Specular: the sky convolved with GGX, roughness 0 at mip 0
+	// up to 1 at the last mip.  Half floats (RGBA), all mips of
+	// face 0 then face 1... like D3D11 subresources.
+	unsigned int SpecularSize = 0;
+	unsigned int SpecularMips = 0;
+	std::vector<uint16_t> Specular;
+
+	// Split sum BRDF: scale (R) and bias (G) for F0, with
+	// N.V along U and roughness along V.  Half floats.
+	unsigned int LutSize = 0;
+	std::vector<uint16_t> BrdfLut;
+
+	size_t SpecularOffset(unsigned int face, unsigned int mip) const;	// In halfs
+};
+
+// --------------------------------------------------------
+// Precomputes image based lighting for a sky on the CPU:
+//
+// - Irradiance as 9 spherical harmonic coefficients, each
+//   texel weighted by its solid angle
+// - A GGX prefiltered mip chain, importance sampled, with
+//   each sample read from the sky mip matching its pdf so
+//   few samples are needed without fireflies
+// - The split sum BRDF lookup table
+//
+// Everything runs on the job system and the inner loops use
+// SSE (4 channels, or 4 samples of the BRDF, at a time).
+// Results can be saved so the baking only happens when the
+// sky's files change.
+// --------------------------------------------------------
+namespace IBLBaker
+{
+	// Faces as PNG files in D3D order.  Each is converted from
+	// sRGB and box filtered down to size.  Missing faces are
+	// black (like the sky itself).  Needs the job system.
+	void LoadFaces(const std::filesystem::path faces[6], unsigned int size, CubeImage& cube);
+	void FaceFromImage(const CpuImage& image, unsigned int size, std::vector<float>& face);
+
+	// Size, time and bake settings of the face files, to tell
+	// whether a saved bake is still good
+	uint64_t SourceStamp(const std::filesystem::path faces[6]);
+
+	// Needs the job system
+	void Bake(const CubeImage& sky, IBLData& data, unsigned int specularSize = 128, unsigned int specularMips = 6, unsigned int lutSize = 64);
+	void ProjectSH(const CubeImage& sky, float sh[9][4]);
+	void PrefilterSpecular(const CubeImage& sky, unsigned int size, unsigned int mips, unsigned int samples, IBLData& data);
+	void BakeBrdfLut(unsigned int size, unsigned int samples, IBLData& data);
+
+	// Cache files (false if missing, from another version or stamp)
+	bool Save(const std::filesystem::path& path, const IBLData& data, uint64_t stamp);
+	bool Load(const std::filesystem::path& path, uint64_t stamp, IBLData& data);
+
+	// For checking results
+	void EvaluateSH(const float sh[9][4], float x, float y, float z, float rgb[3]);
+	float HalfToFloat(uint16_t half);
+	uint16_t FloatToHalf(float value);
+}
@@ -0,0 +1,346 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace JobSystem
+{
+	// Annonymous namespace to hold variables
+	// only accessible in this file
+	namespace
+	{
+		// Both sizes must be powers of 2
+		constexpr unsigned int QueueCapacity = 4096;
+		constexpr unsigned int JobPoolSize = 4096;
+
+		// Number of empty scans before an idle worker goes to sleep
+		constexpr int IdleSpinCount = 64;
+
+		struct Job
+		{
+			std::function<void()> work;
+			JobCounter* counter = 0;
+			std::atomic<bool> busy = false;
+		};
+
+		// --------------------------------------------------------
+		// Chase-Lev work-stealing deque with a fixed capacity
+		//  - Push/Pop are only called by the owning thread
+		//  - Steal can be called by any thread
+		// --------------------------------------------------------
+		struct WorkQueue
+		{
+			std::atomic<int64_t> top = 0;
+			std::atomic<int64_t> bottom = 0;
+			std::atomic<Job*> jobs[QueueCapacity] = {};
+
+			bool Push(Job* job)
+			{
+				int64_t b = bottom.load(std::memory_order_relaxed);
+				int64_t t = top.load(std::memory_order_acquire);
+				if (b - t >= (int64_t)QueueCapacity)
+					return false;
+
+				jobs[b & (QueueCapacity - 1)].store(job, std::memory_order_release);
+				bottom.store(b + 1, std::memory_order_release);
+				return true;
+			}
+
+			Job* Pop()
+			{
+				int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+				bottom.store(b, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64_t t = top.load(std::memory_order_relaxed);
+
+				// Empty, so put bottom back
+				if (t > b)
+				{
+					bottom.store(b + 1, std::memory_order_relaxed);
+					return 0;
+				}
+
+				Job* job = jobs[b & (QueueCapacity - 1)].load(std::memory_order_relaxed);
+				if (t == b)
+				{
+					// Last job - race any thieves for it
+					if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+						job = 0;
+					bottom.store(b + 1, std::memory_order_relaxed);
+				}
+				return job;
+			}
+
+			Job* Steal()
+			{
+				int64_t t = top.load(std::memory_order_acquire);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64_t b = bottom.load(std::memory_order_acquire);
+				if (t >= b)
+					return 0;
+
+				Job* job = jobs[t & (QueueCapacity - 1)].load(std::memory_order_acquire);
+				if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					return 0; // Lost to the owner or another thief
+				return job;
+			}
+		};
+
+		// Everything a single thread owns.  Aligned so neighbouring
+		// threads never share a cache line on the hot counters.
+		struct alignas(64) ThreadContext
+		{
+			WorkQueue queue;
+			Job pool[JobPoolSize];
+			unsigned int poolIndex = 0;
+			unsigned int stealSeed = 0;
+		};
+
+		bool initialized = false;
+		std::atomic<bool> running = false;
+		unsigned int threadCount = 1;
+		std::unique_ptr<ThreadContext[]> contexts;
+		std::vector<std::thread> workers;
+
+		// Bumped whenever work is added, so sleeping workers can wake
+		std::atomic<unsigned int> workSignal = 0;
+		std::atomic<int> sleepingWorkers = 0;
+
+		// Index into contexts for the calling thread (-1 = not a job thread)
+		thread_local int localIndex = -1;
+
+		// Returns 0 when every slot is still in flight.  Spinning until one
+		// frees up could hang if every thread's pool filled at once.
+		Job* AllocateJob(ThreadContext& context)
+		{
+			// Each thread owns its pool, so only the "busy" flag is shared.
+			// Skip over any slot whose job is still in flight.
+			for (unsigned int i = 0; i < JobPoolSize; i++)
+			{
+				Job& job = context.pool[context.poolIndex++ & (JobPoolSize - 1)];
+				if (!job.busy.load(std::memory_order_acquire))
+				{
+					job.busy.store(true, std::memory_order_relaxed);
+					return &job;
+				}
+			}
+			return 0;
+		}
+
+		void Execute(Job* job)
+		{
+			job->work();
+			job->work = nullptr;
+
+			JobCounter* counter = job->counter;
+			job->busy.store(false, std::memory_order_release);
+			counter->pending.fetch_sub(1, std::memory_order_acq_rel);
+		}
+
+		// Finds one job: our own queue first, then other threads' queues
+		Job* FindJob(unsigned int index)
+		{
+			ThreadContext& self = contexts[index];
+			if (Job* job = self.queue.Pop())
+				return job;
+
+			// Cheap xorshift so thieves don't all hammer the same victim
+			unsigned int seed = self.stealSeed;
+			seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+			self.stealSeed = seed;
+
+			for (unsigned int i = 0; i < threadCount; i++)
+			{
+				unsigned int victim = (seed + i) % threadCount;
+				if (victim == index)
+					continue;
+				if (Job* job = contexts[victim].queue.Steal())
+					return job;
+			}
+			return 0;
+		}
+
+		void WorkerLoop(unsigned int index)
+		{
+			localIndex = (int)index;
+			int idleScans = 0;
+
+			while (running.load(std::memory_order_acquire))
+			{
+				// Read the signal BEFORE looking for work so a push that
+				// happens in between is guaranteed to wake us back up
+				unsigned int signal = workSignal.load(std::memory_order_acquire);
+
+				if (Job* job = FindJob(index))
+				{
+					Execute(job);
+					idleScans = 0;
+					continue;
+				}
+
+				if (++idleScans < IdleSpinCount)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+
+				sleepingWorkers.fetch_add(1, std::memory_order_acq_rel);
+				workSignal.wait(signal, std::memory_order_acquire);
+				sleepingWorkers.fetch_sub(1, std::memory_order_acq_rel);
+				idleScans = 0;
+			}
+		}
+	}
+}
+
+// Getters
+unsigned int JobSystem::ThreadCount() { return threadCount; }
+unsigned int JobSystem::ThreadIndex() { return localIndex < 0 ? 0 : (unsigned int)localIndex; }
+
+// --------------------------------------------------------
+// Starts the worker threads.  The calling thread becomes
+// job thread 0 and takes part whenever it waits on work.
+//
+// workerThreads - Extra threads to create (0 = one per core, minus this one)
+// --------------------------------------------------------
+void JobSystem::Initialize(unsigned int workerThreads)
+{
+	// Only initialize once
+	if (initialized)
+		return;
+
+	if (workerThreads == 0)
+	{
+		unsigned int cores = std::thread::hardware_concurrency();
+		workerThreads = cores > 1 ? cores - 1 : 0;
+	}
+
+	threadCount = workerThreads + 1;
+	contexts = std::make_unique<ThreadContext[]>(threadCount);
+	for (unsigned int i = 0; i < threadCount; i++)
+		contexts[i].stealSeed = 0x9E3779B9u * (i + 1);
+
+	localIndex = 0;
+	running = true;
+	initialized = true;
+
+	for (unsigned int i = 1; i < threadCount; i++)
+		workers.emplace_back(WorkerLoop, i);
+}
+
+// --------------------------------------------------------
+// Stops and joins all worker threads.  Any work still queued
+// is abandoned, so wait on outstanding counters first.
+// --------------------------------------------------------
+void JobSystem::ShutDown()
+{
+	if (!initialized)
+		return;
+
+	running = false;
+	workSignal.fetch_add(1, std::memory_order_acq_rel);
+	workSignal.notify_all();
+
+	for (auto& t : workers)
+		t.join();
+
+	workers.clear();
+	contexts.reset();
+	threadCount = 1;
+	localIndex = -1;
+	initialized = false;
+}
+
+// --------------------------------------------------------
+// Queues a job on the calling thread's deque.  Threads that
+// are not job threads (or have a full deque or job pool)
+// run the job inline.
+// --------------------------------------------------------
+void JobSystem::Run(JobCounter& counter, std::function<void()> job)
+{
+	counter.pending.fetch_add(1, std::memory_order_relaxed);
+
+	Job* queued = 0;
+	if (initialized && localIndex >= 0 && threadCount > 1)
+		queued = AllocateJob(contexts[localIndex]);
+	if (!queued)
+	{
+		job();
+		counter.pending.fetch_sub(1, std::memory_order_release);
+		return;
+	}
+
+	ThreadContext& context = contexts[localIndex];
+	queued->work = std::move(job);
+	queued->counter = &counter;
+
+	if (!context.queue.Push(queued))
+	{
+		Execute(queued);
+		return;
+	}
+
+	// Only touch the futex when somebody is actually asleep
+	workSignal.fetch_add(1, std::memory_order_acq_rel);
+	if (sleepingWorkers.load(std::memory_order_acquire) > 0)
+		workSignal.notify_one();
+}
+
+// --------------------------------------------------------
+// Blocks until every job tied to the counter has finished.
+// Instead of sleeping, the waiting thread runs queued jobs.
+// --------------------------------------------------------
+void JobSystem::Wait(JobCounter& counter)
+{
+	while (counter.pending.load(std::memory_order_acquire) > 0)
+	{
+		if (localIndex >= 0 && initialized)
+		{
+			if (Job* job = FindJob((unsigned int)localIndex))
+			{
+				Execute(job);
+				continue;
+			}
+		}
+		std::this_thread::yield();
+	}
+}
+
+// --------------------------------------------------------
+// Runs body over [0, count) split into chunks of grainSize.
+// With no grain size given, aims for ~4 chunks per thread
+// so stealing can even out uneven chunks.
+// --------------------------------------------------------
+void JobSystem::ParallelFor(
+	unsigned int count,
+	const std::function<void(unsigned int begin, unsigned int end)>& body,
+	unsigned int grainSize)
+{
+	if (count == 0)
+		return;
+
+	if (grainSize == 0)
+		grainSize = std::max(1u, count / (threadCount * 4));
+
+	// Not worth splitting
+	if (count <= grainSize || threadCount == 1)
+	{
+		body(0, count);
+		return;
+	}
+
+	JobCounter counter;
+	const auto* bodyPtr = &body;
+	for (unsigned int begin = grainSize; begin < count; begin += grainSize)
+	{
+		unsigned int end = std::min(count, begin + grainSize);
+		Run(counter, [bodyPtr, begin, end]() { (*bodyPtr)(begin, end); });
+	}
+
+	// Do the first chunk ourselves, then help with the rest
+	body(0, grainSize);
+	Wait(counter);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+
+// --------------------------------------------------------
+// Tracks how many jobs in a group have not finished yet.
+// Hand the same counter to several JobSystem::Run() calls
+// and then JobSystem::Wait() on it to join the whole group.
+// --------------------------------------------------------
+struct JobCounter
+{
+	std::atomic<int> pending = 0;
+};
+
+// --------------------------------------------------------
+// Work-stealing job scheduler built on std::thread
+//
+// - Every thread (main + workers) owns a Chase-Lev deque
+// - Owners push/pop at the bottom, idle threads steal from the top
+// - Waiting on a counter runs other jobs instead of blocking
+// - Threads only sleep when there is no work anywhere
+// --------------------------------------------------------
+namespace JobSystem
+{
+	// General functions
+	void Initialize(unsigned int workerThreads = 0);
+	void ShutDown();
+
+	// Getters
+	unsigned int ThreadCount();
+	unsigned int ThreadIndex();
+
+	// Scheduling
+	void Run(JobCounter& counter, std::function<void()> job);
+	void Wait(JobCounter& counter);
+
+	// Splits [0, count) into chunks and runs body(begin, end) on each,
+	// returning once every chunk is done. A grain size of zero picks one
+	// based on the number of threads.
+	void ParallelFor(
+		unsigned int count,
+		const std::function<void(unsigned int begin, unsigned int end)>& body,
+		unsigned int grainSize = 0);
+}
@@ -0,0 +1,422 @@
+#include "LightClusters.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <immintrin.h>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Closer than this the projection blows up, so a light reaching it
+	// could be anywhere on screen
+	constexpr float MinProjectDepth = 0.0001f;
+
+	// Tile a normalized device coordinate falls in
+	int Tile(float ndc, unsigned int tiles)
+	{
+		return std::clamp((int)floorf((ndc + 1.0f) * 0.5f * tiles), 0, (int)tiles - 1);
+	}
+}
+
+LightClusters::LightClusters(unsigned int tilesX, unsigned int tilesY, unsigned int slices) :
+	tilesX(tilesX),
+	tilesY(tilesY),
+	slices(slices),
+	rowStride((tilesX + 3) & ~3u),
+	xScale(1.0f),
+	yScale(1.0f),
+	nearSlice(0.0f),
+	farZ(0.0f),
+	depthScale(0.0f),
+	depthBias(0.0f),
+	projection()
+{
+	sliceHits.resize(slices);
+	ranges.resize(GetClusterCount());
+}
+
+void LightClusters::SetProjection(const XMFLOAT4X4& projection, float nearSlice, float farZ)
+{
+	// Bounds only change with the projection
+	if (memcmp(&projection, &this->projection, sizeof(XMFLOAT4X4)) == 0 && nearSlice == this->nearSlice && farZ == this->farZ)
+		return;
+	this->projection = projection;
+	this->nearSlice = nearSlice;
+	this->farZ = farZ;
+	xScale = projection._11;
+	yScale = projection._22;
+
+	float logRatio = logf(farZ / nearSlice);
+	depthScale = slices / logRatio;
+	depthBias = -(slices * logf(nearSlice)) / logRatio;
+
+	size_t padded = (size_t)slices * tilesY * rowStride;
+	for (std::vector<float>* bounds : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ, &centerX, &centerY, &centerZ, &radius })
+		bounds->assign(padded, 0.0f);
+	sliceNear.resize(slices);
+	sliceFar.resize(slices);
+
+	for (unsigned int s = 0; s < slices; s++)
+	{
+		// The inverse of the slice formula, with the first slice reaching the camera
+		float zNear = s == 0 ? 0.0f : nearSlice * powf(farZ / nearSlice, (float)s / slices);
+		float zFar = nearSlice * powf(farZ / nearSlice, (float)(s + 1) / slices);
+		sliceNear[s] = zNear;
+		sliceFar[s] = zFar;
+
+		for (unsigned int y = 0; y < tilesY; y++)
+		{
+			// Rows go down the screen, y goes up
+			float yBottom = 1.0f - 2.0f * (y + 1) / tilesY;
+			float yTop = 1.0f - 2.0f * y / tilesY;
+			for (unsigned int x = 0; x < tilesX; x++)
+			{
+				float xLeft = -1.0f + 2.0f * x / tilesX;
+				float xRight = -1.0f + 2.0f * (x + 1) / tilesX;
+
+				// The tile's corners at both ends of the slice
+				size_t i = ((size_t)s * tilesY + y) * rowStride + x;
+				minX[i] = std::min(xLeft * zNear, xLeft * zFar) / xScale;
+				maxX[i] = std::max(xRight * zNear, xRight * zFar) / xScale;
+				minY[i] = std::min(yBottom * zNear, yBottom * zFar) / yScale;
+				maxY[i] = std::max(yTop * zNear, yTop * zFar) / yScale;
+				minZ[i] = zNear;
+				maxZ[i] = zFar;
+
+				float halfX = (maxX[i] - minX[i]) * 0.5f;
+				float halfY = (maxY[i] - minY[i]) * 0.5f;
+				float halfZ = (maxZ[i] - minZ[i]) * 0.5f;
+				centerX[i] = minX[i] + halfX;
+				centerY[i] = minY[i] + halfY;
+				centerZ[i] = minZ[i] + halfZ;
+				radius[i] = sqrtf(halfX * halfX + halfY * halfY + halfZ * halfZ);
+			}
+		}
+	}
+}
+
+void LightClusters::Build(const PackedLight* lights, unsigned int count, const XMFLOAT4X4& view)
+{
+	PrepareLights(lights, count, view);
+
+	// Each slice only writes its own hits
+	JobSystem::ParallelFor(slices, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int s = begin; s < end; s++)
+			BuildSlice(s);
+	}, 1);
+
+	Compact();
+}
+
+void LightClusters::BuildReference(const PackedLight* lights, unsigned int count, const XMFLOAT4X4& view)
+{
+	PrepareLights(lights, count, view);
+
+	unsigned int tilesPerSlice = tilesX * tilesY;
+	for (unsigned int s = 0; s < slices; s++)
+	{
+		SliceHits& hits = sliceHits[s];
+		hits.Clusters.clear();
+		hits.Lights.clear();
+		for (const ViewLight& light : viewLights)
+			for (unsigned int c = 0; c < tilesPerSlice; c++)
+				if (TestCluster(light, s * tilesPerSlice + c))
+				{
+					hits.Clusters.push_back(c);
+					hits.Lights.push_back(light.Index);
+				}
+	}
+
+	Compact();
+}
+
+// Puts the lights in view space, directional ones aside
+void LightClusters::PrepareLights(const PackedLight* lights, unsigned int count, const XMFLOAT4X4& view)
+{
+	viewLights.clear();
+	global.clear();
+	stats = LightClusterStats();
+
+	XMMATRIX viewMatrix = XMLoadFloat4x4(&view);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const PackedLight& light = lights[i];
+		if (light.Type == LIGHT_TYPE_DIRECTIONAL)
+		{
+			global.push_back(i);
+			continue;
+		}
+
+		// No range, no light (Attenuate() would divide by zero anyway)
+		stats.Lights++;
+		if (light.Range <= 0.0f)
+			continue;
+
+		ViewLight viewLight = {};
+		XMFLOAT3 position;
+		XMStoreFloat3(&position, XMVector3Transform(XMLoadFloat3(&light.Position), viewMatrix));
+		viewLight.X = position.x;
+		viewLight.Y = position.y;
+		viewLight.Z = position.z;
+		viewLight.Range = light.Range;
+		viewLight.Index = i;
+
+		// Wider cones than a hemisphere only get the sphere test
+		if (light.Type == LIGHT_TYPE_SPOT && light.CosOuter > 0.0f)
+		{
+			XMFLOAT3 direction;
+			XMStoreFloat3(&direction, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&light.Direction), viewMatrix)));
+			viewLight.DirX = direction.x;
+			viewLight.DirY = direction.y;
+			viewLight.DirZ = direction.z;
+			viewLight.CosAngle = light.CosOuter;
+			viewLight.SinAngle = sqrtf(std::max(1.0f - light.CosOuter * light.CosOuter, 0.0f));
+			viewLight.Cone = true;
+		}
+		viewLights.push_back(viewLight);
+	}
+	stats.Global = (unsigned int)global.size();
+}
+
+// Tests every light that reaches the slice against the tiles it
+// covers on screen, four at a time
+void LightClusters::BuildSlice(unsigned int slice)
+{
+	SliceHits& hits = sliceHits[slice];
+	hits.Clusters.clear();
+	hits.Lights.clear();
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+	for (const ViewLight& light : viewLights)
+	{
+		int x0, x1, y0, y1;
+		if (!TileRange(light, slice, x0, x1, y0, y1))
+			continue;
+
+		float r = light.Range;
+		__m128 cx = _mm_set1_ps(light.X);
+		__m128 cy = _mm_set1_ps(light.Y);
+		__m128 cz = _mm_set1_ps(light.Z);
+		__m128 range = _mm_set1_ps(r);
+		__m128 rangeSq = _mm_set1_ps(r * r);
+		for (int y = y0; y <= y1; y++)
+		{
+			size_t row = ((size_t)slice * tilesY + y) * rowStride;
+			for (int x = x0 & ~3; x <= x1; x += 4)
+			{
+				size_t i = row + x;
+
+				// Sphere against box: squared distance to the closest point
+				__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minX[i]), cx), _mm_sub_ps(cx, _mm_loadu_ps(&maxX[i]))), zero);
+				__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minY[i]), cy), _mm_sub_ps(cy, _mm_loadu_ps(&maxY[i]))), zero);
+				__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minZ[i]), cz), _mm_sub_ps(cz, _mm_loadu_ps(&maxZ[i]))), zero);
+				__m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+				__m128 hit = _mm_cmple_ps(distanceSq, rangeSq);
+
+				// Cone against the box's bounding sphere: outside the cone's
+				// sides, past its end, or behind its tip
+				if (light.Cone)
+				{
+					__m128 clusterRadius = _mm_loadu_ps(&radius[i]);
+					__m128 vx = _mm_sub_ps(_mm_loadu_ps(&centerX[i]), cx);
+					__m128 vy = _mm_sub_ps(_mm_loadu_ps(&centerY[i]), cy);
+					__m128 vz = _mm_sub_ps(_mm_loadu_ps(&centerZ[i]), cz);
+					__m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+					__m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, _mm_set1_ps(light.DirX)), _mm_mul_ps(vy, _mm_set1_ps(light.DirY))), _mm_mul_ps(vz, _mm_set1_ps(light.DirZ)));
+					__m128 across = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(lengthSq, _mm_mul_ps(along, along)), zero));
+					__m128 closest = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(light.CosAngle), across), _mm_mul_ps(along, _mm_set1_ps(light.SinAngle)));
+					__m128 outside = _mm_or_ps(_mm_cmpgt_ps(closest, clusterRadius),
+						_mm_or_ps(_mm_cmpgt_ps(along, _mm_add_ps(clusterRadius, range)), _mm_cmplt_ps(along, _mm_sub_ps(zero, clusterRadius))));
+					hit = _mm_andnot_ps(outside, hit);
+				}
+
+				// Only the tiles in range (the row is padded past the last one)
+				__m128i column = _mm_add_epi32(_mm_set1_epi32(x), lane);
+				__m128i inRange = _mm_and_si128(_mm_cmpgt_epi32(column, _mm_set1_epi32(x0 - 1)), _mm_cmplt_epi32(column, _mm_set1_epi32(x1 + 1)));
+				int mask = _mm_movemask_ps(_mm_and_ps(hit, _mm_castsi128_ps(inRange)));
+				for (int bit = 0; mask != 0; bit++, mask >>= 1)
+					if (mask & 1)
+					{
+						hits.Clusters.push_back(y * tilesX + x + bit);
+						hits.Lights.push_back(light.Index);
+					}
+			}
+		}
+	}
+}
+
+// Tiles a light's sphere could cover in a slice: the corners of its
+// box, clipped to the slice, projected at both of its depths.  False
+// if it misses the slice (or the screen) entirely.
+bool LightClusters::TileRange(const ViewLight& light, unsigned int slice, int& x0, int& x1, int& y0, int& y1) const
+{
+	float zNear = sliceNear[slice];
+	float zFar = sliceFar[slice];
+	float r = light.Range;
+	if (light.Z + r < zNear || light.Z - r > zFar)
+		return false;
+
+	x0 = 0;
+	x1 = (int)tilesX - 1;
+	y0 = 0;
+	y1 = (int)tilesY - 1;
+	float za = std::max(zNear, light.Z - r);
+	float zb = std::min(zFar, light.Z + r);
+	if (za <= MinProjectDepth)
+		return true;
+
+	float left = std::min((light.X - r) * xScale / za, (light.X - r) * xScale / zb);
+	float right = std::max((light.X + r) * xScale / za, (light.X + r) * xScale / zb);
+	float bottom = std::min((light.Y - r) * yScale / za, (light.Y - r) * yScale / zb);
+	float top = std::max((light.Y + r) * yScale / za, (light.Y + r) * yScale / zb);
+	if (right < -1.0f || left > 1.0f || top < -1.0f || bottom > 1.0f)
+		return false;
+	x0 = Tile(left, tilesX);
+	x1 = Tile(right, tilesX);
+	y0 = (int)tilesY - 1 - Tile(top, tilesY);
+	y1 = (int)tilesY - 1 - Tile(bottom, tilesY);
+	return true;
+}
+
+// The same tests as BuildSlice(), one cluster at a time
+bool LightClusters::TestCluster(const ViewLight& light, unsigned int cluster) const
+{
+	unsigned int tilesPerSlice = tilesX * tilesY;
+	unsigned int slice = cluster / tilesPerSlice;
+	unsigned int tile = cluster % tilesPerSlice;
+	int x0, x1, y0, y1;
+	int tileX = (int)(tile % tilesX), tileY = (int)(tile / tilesX);
+	if (!TileRange(light, slice, x0, x1, y0, y1) || tileX < x0 || tileX > x1 || tileY < y0 || tileY > y1)
+		return false;
+	size_t i = ((size_t)slice * tilesY + tileY) * rowStride + tileX;
+
+	float dx = std::max(std::max(minX[i] - light.X, light.X - maxX[i]), 0.0f);
+	float dy = std::max(std::max(minY[i] - light.Y, light.Y - maxY[i]), 0.0f);
+	float dz = std::max(std::max(minZ[i] - light.Z, light.Z - maxZ[i]), 0.0f);
+	if (!(dx * dx + dy * dy + dz * dz <= light.Range * light.Range))
+		return false;
+	if (!light.Cone)
+		return true;
+
+	float vx = centerX[i] - light.X;
+	float vy = centerY[i] - light.Y;
+	float vz = centerZ[i] - light.Z;
+	float lengthSq = vx * vx + vy * vy + vz * vz;
+	float along = vx * light.DirX + vy * light.DirY + vz * light.DirZ;
+	float across = sqrtf(std::max(lengthSq - along * along, 0.0f));
+	float closest = light.CosAngle * across - along * light.SinAngle;
+	return !(closest > radius[i] || along > radius[i] + light.Range || along < 0.0f - radius[i]);
+}
+
+// Sorts each slice's hits by cluster (lights stay in order within
+// one), then lays them out after the directional lights
+void LightClusters::Compact()
+{
+	unsigned int tilesPerSlice = tilesX * tilesY;
+	for (SliceHits& hits : sliceHits)
+	{
+		hits.Counts.assign(tilesPerSlice + 1, 0);
+		for (uint32_t c : hits.Clusters)
+			hits.Counts[c + 1]++;
+		for (unsigned int c = 0; c < tilesPerSlice; c++)
+			hits.Counts[c + 1] += hits.Counts[c];
+
+		// Counts becomes where each cluster starts, then where it ends
+		hits.Sorted.resize(hits.Lights.size());
+		for (size_t h = 0; h < hits.Lights.size(); h++)
+			hits.Sorted[hits.Counts[hits.Clusters[h]]++] = hits.Lights[h];
+	}
+
+	indices.assign(global.begin(), global.end());
+	for (unsigned int s = 0; s < slices; s++)
+	{
+		const SliceHits& hits = sliceHits[s];
+		uint32_t start = (uint32_t)indices.size();
+		for (unsigned int c = 0; c < tilesPerSlice; c++)
+		{
+			ClusterRange& range = ranges[s * tilesPerSlice + c];
+			range.Offset = start + (c == 0 ? 0 : hits.Counts[c - 1]);
+			range.Count = hits.Counts[c] - (c == 0 ? 0 : hits.Counts[c - 1]);
+			stats.MaxPerCluster = std::max(stats.MaxPerCluster, range.Count);
+			if (range.Count == 0)
+				stats.EmptyClusters++;
+		}
+		indices.insert(indices.end(), hits.Sorted.begin(), hits.Sorted.end());
+	}
+	stats.Indices = (unsigned int)(indices.size() - global.size());
+
+	// Lights that made it into any cluster
+	std::vector<bool> visible(viewLights.empty() ? 0 : viewLights.back().Index + 1);
+	for (size_t i = global.size(); i < indices.size(); i++)
+		if (!visible[indices[i]])
+		{
+			visible[indices[i]] = true;
+			stats.Visible++;
+		}
+}
+
+unsigned int LightClusters::ClusterIndex(float x, float y, float viewDepth, float width, float height) const
+{
+	unsigned int tileX = std::min((unsigned int)std::max(x * tilesX / width, 0.0f), tilesX - 1);
+	unsigned int tileY = std::min((unsigned int)std::max(y * tilesY / height, 0.0f), tilesY - 1);
+	float slice = logf(std::max(viewDepth, MinProjectDepth)) * depthScale + depthBias;
+	unsigned int s = (unsigned int)std::clamp(slice, 0.0f, (float)(slices - 1));
+	return (s * tilesY + tileY) * tilesX + tileX;
+}
+
+unsigned int LightClusters::GetTilesX() const
+{
+	return tilesX;
+}
+
+unsigned int LightClusters::GetTilesY() const
+{
+	return tilesY;
+}
+
+unsigned int LightClusters::GetSlices() const
+{
+	return slices;
+}
+
+unsigned int LightClusters::GetClusterCount() const
+{
+	return tilesX * tilesY * slices;
+}
+
+float LightClusters::GetDepthScale() const
+{
+	return depthScale;
+}
+
+float LightClusters::GetDepthBias() const
+{
+	return depthBias;
+}
+
+unsigned int LightClusters::GetGlobalCount() const
+{
+	return (unsigned int)global.size();
+}
+
+const std::vector<ClusterRange>& LightClusters::GetRanges() const
+{
+	return ranges;
+}
+
+const std::vector<uint32_t>& LightClusters::GetIndices() const
+{
+	return indices;
+}
+
+const LightClusterStats& LightClusters::GetStats() const
+{
+	return stats;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+#include "LightPacker.h"
+
+// --------------------------------------------------------
+// Where one cluster's lights are in the index list
+// --------------------------------------------------------
+struct ClusterRange
+{
+	uint32_t Offset = 0;
+	uint32_t Count = 0;
+};
+
+// --------------------------------------------------------
+// What building the clusters found this frame
+// --------------------------------------------------------
+struct LightClusterStats
+{
+	unsigned int Lights = 0;		// Point and spot lights given
+	unsigned int Global = 0;		// Directional, which light everything
+	unsigned int Visible = 0;		// In at least one cluster
+	unsigned int Indices = 0;		// Cluster entries, over every cluster
+	unsigned int MaxPerCluster = 0;
+	unsigned int EmptyClusters = 0;
+};
+
+// --------------------------------------------------------
+// Clustered light culling for forward shading.  The view
+// frustum is split into tiles across the screen and depth
+// slices that grow exponentially (so clusters stay roughly
+// cube shaped), and every point and spot light is tested
+// against the view space bounds of each cluster it could
+// touch: spheres against boxes, spot cones against each
+// box's bounding sphere too.  Slices are built in parallel
+// on the job system, four clusters per SSE test.
+//
+// The result is a compact list: directional lights first
+// (GetGlobalCount() of them), then every cluster's lights,
+// with a range per cluster.  Shaders find their cluster
+// from the pixel position and view depth (ClusterIndex())
+// and only loop over the lights in it.
+//
+// Usage:
+//   SetProjection() (when it changes) -> Build() every frame
+// --------------------------------------------------------
+class LightClusters
+{
+public:
+	LightClusters(unsigned int tilesX = 16, unsigned int tilesY = 9, unsigned int slices = 24);
+
+	// Perspective projections only.  Slices run exponentially from
+	// nearSlice to farZ, and the first one reaches all the way to the
+	// camera (so a tiny near plane doesn't waste slices on nothing).
+	void SetProjection(const DirectX::XMFLOAT4X4& projection, float nearSlice, float farZ);
+
+	// Indices in the list are into lights[] (packed, see LightPacker)
+	void Build(const PackedLight* lights, unsigned int count, const DirectX::XMFLOAT4X4& view);
+	// Same result, one light against one cluster at a time on this
+	// thread (to check Build() against)
+	void BuildReference(const PackedLight* lights, unsigned int count, const DirectX::XMFLOAT4X4& view);
+
+	// Cluster of a pixel (in a width x height target) at a view depth,
+	// the same way the shaders work it out
+	unsigned int ClusterIndex(float x, float y, float viewDepth, float width, float height) const;
+
+	// Getters
+	unsigned int GetTilesX() const;
+	unsigned int GetTilesY() const;
+	unsigned int GetSlices() const;
+	unsigned int GetClusterCount() const;
+	float GetDepthScale() const;	// slice = log(depth) * scale + bias
+	float GetDepthBias() const;
+	unsigned int GetGlobalCount() const;
+	const std::vector<ClusterRange>& GetRanges() const;
+	const std::vector<uint32_t>& GetIndices() const;
+	const LightClusterStats& GetStats() const;
+
+private:
+	// A light in view space, ready to test
+	struct ViewLight
+	{
+		float X, Y, Z, Range;
+		float DirX, DirY, DirZ;
+		float CosAngle, SinAngle;
+		bool Cone;					// Spot lights under 90 degrees
+		uint32_t Index;
+	};
+
+	void PrepareLights(const PackedLight* lights, unsigned int count, const DirectX::XMFLOAT4X4& view);
+	void BuildSlice(unsigned int slice);
+	void Compact();
+	bool TileRange(const ViewLight& light, unsigned int slice, int& x0, int& x1, int& y0, int& y1) const;
+	bool TestCluster(const ViewLight& light, unsigned int cluster) const;
+
+	unsigned int tilesX;
+	unsigned int tilesY;
+	unsigned int slices;
+	unsigned int rowStride;		// Tiles per row, padded to 4
+	float xScale, yScale;		// Of the projection
+	float nearSlice, farZ;
+	float depthScale, depthBias;
+	DirectX::XMFLOAT4X4 projection;
+
+	// Cluster bounds, by slice, row, then padded column (SoA for SSE)
+	std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+	std::vector<float> centerX, centerY, centerZ, radius;
+	std::vector<float> sliceNear, sliceFar;
+
+	std::vector<ViewLight> viewLights;
+	std::vector<uint32_t> global;
+
+	// Hits per slice as (cluster in slice, light) pairs, then sorted by cluster
+	struct SliceHits
+	{
+		std::vector<uint32_t> Clusters;
+		std::vector<uint32_t> Lights;
+		std::vector<uint32_t> Sorted;
+		std::vector<uint32_t> Counts;
+	};
+	std::vector<SliceHits> sliceHits;
+
+	std::vector<ClusterRange> ranges;
+	std::vector<uint32_t> indices;
+	LightClusterStats stats;
+};
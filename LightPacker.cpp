@@ -0,0 +1,102 @@
+#include "LightPacker.h"
+
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Where each type goes in the sorted order, or -1
+	int TypeOrder(int type)
+	{
+		switch (type)
+		{
+		case LIGHT_TYPE_DIRECTIONAL: return 0;
+		case LIGHT_TYPE_POINT: return 1;
+		case LIGHT_TYPE_SPOT: return 2;
+		default: return -1;
+		}
+	}
+}
+
+void LightPacker::Pack(const Lights* lights, unsigned int count)
+{
+	// Counting sort by type, which keeps the order within a type
+	unsigned int perType[3] = {};
+	for (unsigned int i = 0; i < count; i++)
+	{
+		int order = TypeOrder(lights[i].type);
+		if (order >= 0)
+			perType[order]++;
+	}
+	counts.Directional = perType[0];
+	counts.Point = perType[1];
+	counts.Spot = perType[2];
+
+	unsigned int next[3] = { 0, perType[0], perType[0] + perType[1] };
+	packed.resize(next[2] + perType[2]);
+	sourceIndices.resize(packed.size());
+	packedIndices.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		int order = TypeOrder(lights[i].type);
+		if (order < 0)
+		{
+			packedIndices[i] = NotPacked;
+			continue;
+		}
+
+		unsigned int slot = next[order]++;
+		packed[slot] = PackLight(lights[i]);
+		sourceIndices[slot] = i;
+		packedIndices[i] = slot;
+	}
+}
+
+PackedLight LightPacker::PackLight(const Lights& light)
+{
+	PackedLight p = {};
+	p.Type = light.type;
+	p.Position = light.position;
+	p.Range = light.range;
+	p.Color = XMFLOAT3(light.color.x * light.intensity, light.color.y * light.intensity, light.color.z * light.intensity);
+
+	// No range attenuates to nothing rather than dividing by zero
+	p.InvRangeSq = light.range > 0.0f ? 1.0f / (light.range * light.range) : FLT_MAX;
+
+	// Left at zero if there's no direction to normalize
+	float length = sqrtf(light.direction.x * light.direction.x + light.direction.y * light.direction.y + light.direction.z * light.direction.z);
+	if (length > 0.0f)
+		p.Direction = XMFLOAT3(light.direction.x / length, light.direction.y / length, light.direction.z / length);
+
+	// The spot falloff is saturate((cos - CosOuter) * SpotScale), which
+	// is a hard edge if the angles are the same
+	p.CosInner = cosf(light.spotInnerAngle);
+	p.CosOuter = cosf(light.spotOuterAngle);
+	float falloff = p.CosInner - p.CosOuter;
+	p.SpotScale = fabsf(falloff) > 1e-6f ? 1.0f / falloff : 1e6f;
+	return p;
+}
+
+const std::vector<PackedLight>& LightPacker::GetLights() const
+{
+	return packed;
+}
+
+const PackedLightCounts& LightPacker::GetCounts() const
+{
+	return counts;
+}
+
+const std::vector<uint32_t>& LightPacker::GetPackedIndices() const
+{
+	return packedIndices;
+}
+
+const std::vector<uint32_t>& LightPacker::GetSourceIndices() const
+{
+	return sourceIndices;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+#include "Lights.h"
+
+// --------------------------------------------------------
+// A light the way shaders read it (PackedLight in
+// Lighting.hlsli), with everything that's the same for
+// every pixel already worked out.  64 bytes.
+// --------------------------------------------------------
+struct PackedLight
+{
+	DirectX::XMFLOAT3 Position;
+	float InvRangeSq;				// 1 / range^2, for attenuation
+	DirectX::XMFLOAT3 Direction;	// Normalized, away from the light
+	float Range;
+	DirectX::XMFLOAT3 Color;		// Times intensity
+	int Type;
+	float CosInner;					// Of the spot angles
+	float CosOuter;
+	float SpotScale;				// 1 / (CosInner - CosOuter)
+	float Padding;
+};
+
+// --------------------------------------------------------
+// How many lights of each type were packed (they're sorted
+// by type, in this order)
+// --------------------------------------------------------
+struct PackedLightCounts
+{
+	unsigned int Directional = 0;
+	unsigned int Point = 0;
+	unsigned int Spot = 0;
+};
+
+// --------------------------------------------------------
+// Turns the scene's lights into PackedLights once a frame,
+// so shaders don't redo the same math for every pixel and
+// can read thousands of them from a structured buffer.
+//
+// Packed lights are sorted by type (directional, point,
+// then spot, keeping their order within a type) so shaders
+// loop over each type without a switch.  Lights of unknown
+// types are left out.
+// --------------------------------------------------------
+class LightPacker
+{
+public:
+	static constexpr uint32_t NotPacked = 0xFFFFFFFF;
+
+	void Pack(const Lights* lights, unsigned int count);
+
+	// One light, wherever it ends up
+	static PackedLight PackLight(const Lights& light);
+
+	// Getters
+	const std::vector<PackedLight>& GetLights() const;
+	const PackedLightCounts& GetCounts() const;
+	const std::vector<uint32_t>& GetPackedIndices() const;	// By light given, or NotPacked
+	const std::vector<uint32_t>& GetSourceIndices() const;	// By packed light
+
+private:
+	std::vector<PackedLight> packed;
+	std::vector<uint32_t> packedIndices;
+	std::vector<uint32_t> sourceIndices;
+	PackedLightCounts counts;
+};
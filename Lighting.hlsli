@@ -8,9 +8,6 @@
 #define LIGHT_TYPE_POINT	   1
 #define LIGHT_TYPE_SPOT		   2
 
-//Max number of lights in a scene (power of 2)
-#define MAX_LIGHTS 64
-
 #define MAX_SPECULAR_EXPONENT 256.0f
 
 //a constant Fresnel value for non-metals (glass and plastic have values of about 0.04)
@@ -19,19 +16,21 @@ static const float F0_NON_METAL = 0.04f;
 static const float MIN_ROUGHNESS = 0.0000001f;
 static const float PI = 3.14159265359f;
 
-//see Lights.h for explanation of fields
-struct Lights
+//a light as LightPacker lays it out once per frame (see LightPacker.h)
+//lights are sorted by type: directional, then point, then spot
+struct PackedLight
 {
     //64 bytes (power of 2 is faster)
-    int type;
-    float3 direction;
-    float range;
     float3 position;
-    float intensity;
-    float3 color;
-    float spotInnerAngle;
-    float spotOuterAngle;
-    float2 padding;
+    float invRangeSq; //1 / range^2
+    float3 direction; //normalized, away from the light
+    float range;
+    float3 color; //already times intensity
+    int type;
+    float cosInner; //of the spot angles
+    float cosOuter;
+    float spotScale; //1 / (cosInner - cosOuter)
+    float padding;
 };
 
     //calculate diffuse lighting
@@ -55,15 +54,22 @@ float PhongSpecularLight(float3 normal, float3 directionToLight, float3 surfaceT
     return pow(max(dot(r, surfaceToCamera), 0.0f), specularExponent);
 }
 //softens the light
-float Attenuate(Lights currentLight, float3 worldPos)
+float Attenuate(PackedLight currentLight, float3 worldPos)
 {
-    float dist = distance(currentLight.position, worldPos);
-    float attenuation = saturate(1.0f - (dist * dist / (currentLight.range * currentLight.range)));
+    float3 toLight = currentLight.position - worldPos;
+    float attenuation = saturate(1.0f - dot(toLight, toLight) * currentLight.invRangeSq);
     return attenuation * attenuation;
 }
 
+//fades a spotlight from its inner cone to its outer one
+float SpotTerm(PackedLight currentLight, float3 surfaceToLight)
+{
+    float angle = saturate(dot(-surfaceToLight, currentLight.direction));
+    return saturate((angle - currentLight.cosOuter) * currentLight.spotScale);
+}
+
 //performs all necessary calculations for a directional light
-float3 DirectionLight(Lights currentLight, float3 normal, float3 surfaceToCamera, float roughness, float3 color) //can pass in a scalar to effect specular light on a per-pixel basis
+float3 DirectionLight(PackedLight currentLight, float3 normal, float3 surfaceToCamera, float roughness, float3 color) //can pass in a scalar to effect specular light on a per-pixel basis
 {
     //get direction from surface to light
     float3 surfaceToLight = -currentLight.direction;
@@ -73,10 +79,10 @@ float3 DirectionLight(Lights currentLight, float3 normal, float3 surfaceToCamera
     float3 specular = PhongSpecularLight(normal, surfaceToLight, surfaceToCamera, roughness);
     
     //return calculated light
-    return (diffuse * color + specular) * currentLight.intensity * currentLight.color;
+    return (diffuse * color + specular) * currentLight.color;
 }
 //performs all necessary calculations for a point light
-float3 PointLight(Lights currentLight, float3 normal, float3 surfaceToCamera, float3 worldPosition, float roughness, float3 color)
+float3 PointLight(PackedLight currentLight, float3 normal, float3 surfaceToCamera, float3 worldPosition, float roughness, float3 color)
 {
     //get distance from light
     float3 surfaceToLight = normalize(currentLight.position - worldPosition);
@@ -87,53 +93,34 @@ float3 PointLight(Lights currentLight, float3 normal, float3 surfaceToCamera, fl
     float attenuation = Attenuate(currentLight, worldPosition);
     
     //return lighting results
-    return (diffuse * color + specular) * attenuation * currentLight.intensity * currentLight.color;
+    return (diffuse * color + specular) * attenuation * currentLight.color;
 
 }
 //performs all necessary calculations for a spotlight
-float3 SpotLight(Lights currentLight, float3 normal, float3 surfaceToCamera, float3 worldPosition, float roughness, float3 color)
+float3 SpotLight(PackedLight currentLight, float3 normal, float3 surfaceToCamera, float3 worldPosition, float roughness, float3 color)
 {
     //get necessary components
     float3 surfaceToLight = normalize(currentLight.position - worldPosition);
-    float3 angle = saturate(dot(-surfaceToLight, currentLight.direction));
-    
-    //get two "cones"
-    float cosInner = cos(currentLight.spotInnerAngle);
-    float cosOuter = cos(currentLight.spotOuterAngle);
-    float falloffRange = cosOuter - cosInner;
     
-    //simulate shrinking of the lights to form cone
-    float spotTerm = saturate((cosOuter - angle) / falloffRange).x;
+    //simulate shrinking of the lights to form cone (cosines are precomputed)
+    float spotTerm = SpotTerm(currentLight, surfaceToLight);
     
     //use terms with point light calculation to create the cone
     return PointLight(currentLight, normal, surfaceToCamera, worldPosition, roughness, color) * spotTerm;
 }
 
-float3 CalculateTotalLight(int numLights, Lights lights[MAX_LIGHTS], float3 normal, float3 surfaceToCamera, float3 worldPos, float roughness, float3 color)
+//lightCounts = directional, point and spot lights (lights are sorted by type, so no switch is needed)
+float3 CalculateTotalLight(uint3 lightCounts, StructuredBuffer<PackedLight> lights, float3 normal, float3 surfaceToCamera, float3 worldPos, float roughness, float3 color)
 {
-    
-    float3 totalLight; //store total lighting
-    //loop through lights
-    for (int i = 0; i < numLights; i++)
-    {
-        //grab a copy of the current index
-        Lights currentLight = lights[i];
-        //normalize the direction to ensure consistent results
-        currentLight.direction = normalize(currentLight.direction);
-        
-        switch (currentLight.type)
-        {
-            case LIGHT_TYPE_DIRECTIONAL:
-                totalLight += DirectionLight(currentLight, normal, surfaceToCamera, roughness, color);
-                break;
-            case LIGHT_TYPE_POINT:
-                totalLight += PointLight(currentLight, normal, surfaceToCamera, worldPos, roughness, color);
-                break;
-            case LIGHT_TYPE_SPOT:
-                totalLight += SpotLight(currentLight, normal, surfaceToCamera, worldPos, roughness, color);
-                break;
-        }
-    }
+    float3 totalLight = float3(0, 0, 0); //store total lighting
+    uint i = 0;
+    //loop through each type of light
+    for (; i < lightCounts.x; i++)
+        totalLight += DirectionLight(lights[i], normal, surfaceToCamera, roughness, color);
+    for (; i < lightCounts.x + lightCounts.y; i++)
+        totalLight += PointLight(lights[i], normal, surfaceToCamera, worldPos, roughness, color);
+    for (; i < lightCounts.x + lightCounts.y + lightCounts.z; i++)
+        totalLight += SpotLight(lights[i], normal, surfaceToCamera, worldPos, roughness, color);
     
     return totalLight;
 }
@@ -151,7 +138,9 @@ float3x3 CreateTBN(float3 normal, float3 tangent)
 float3 NormalFromMap(Texture2D normalMap, SamplerState sample, float2 uv, float3 normal, float3 tangent)
 {
     //sample the normal map and "unpack" result
-    float3 normalMapData = normalize(normalMap.Sample(sample, uv).rgb * 2.0f - 1.0f);
+    //only x and y are used, z is rebuilt so two channel (BC5) maps work too
+    float2 normalXY = normalMap.Sample(sample, uv).rg * 2.0f - 1.0f;
+    float3 normalMapData = float3(normalXY, sqrt(saturate(1.0f - dot(normalXY, normalXY))));
     
     float3x3 tbn = CreateTBN(normal, tangent);
     
@@ -290,7 +279,7 @@ float3 MicrofacetBRDF(float3 n, float3 l, float3 v, float roughness, float3 f0,
 }
 
 //performs all necessary calculations for a direction light (PBR variant)
-float3 DirectionLightPBR(Lights currentLight, float3 normal, float3 surfaceToCamera, float roughness, float metalness, float3 surfaceColor, float3 specularColor)
+float3 DirectionLightPBR(PackedLight currentLight, float3 normal, float3 surfaceToCamera, float roughness, float metalness, float3 surfaceColor, float3 specularColor)
 {
     //get direction from surface to light
     float3 surfaceToLight = -currentLight.direction;
@@ -305,11 +294,11 @@ float3 DirectionLightPBR(Lights currentLight, float3 normal, float3 surfaceToCam
     float3 balancedDiffuse = DiffuseEnergyConserve(diffuse, specular, metalness);
     //return calculated light
     //this needs surface color
-    return (balancedDiffuse * surfaceColor + specular) * currentLight.intensity * currentLight.color;
+    return (balancedDiffuse * surfaceColor + specular) * currentLight.color;
 }
 
 //performs all necessary calculations for a point light (PBR variant)
-float3 PointLightPBR(Lights currentLight, float3 normal, float3 surfaceToCamera, float3 worldPosition, float roughness, float metalness, float3 surfaceColor, float3 specularColor)
+float3 PointLightPBR(PackedLight currentLight, float3 normal, float3 surfaceToCamera, float3 worldPosition, float roughness, float metalness, float3 surfaceColor, float3 specularColor)
 {
     //get distance from light
     float3 surfaceToLight = normalize(currentLight.position - worldPosition);
@@ -324,68 +313,118 @@ float3 PointLightPBR(Lights currentLight, float3 normal, float3 surfaceToCamera,
     float3 balancedDiffuse = DiffuseEnergyConserve(diffuse, specular, metalness);
     
     //return lighting results
-    return (balancedDiffuse * surfaceColor + specular) * attenuation * currentLight.intensity * currentLight.color;
+    return (balancedDiffuse * surfaceColor + specular) * attenuation * currentLight.color;
 }
 
 //performs all necessary calculations for a spotlight (PBR variant)
-float3 SpotLightPBR(Lights currentLight, float3 normal, float3 surfaceToCamera, float3 worldPosition, float roughness, float metalness, float3 surfaceColor, float3 specularColor)
+float3 SpotLightPBR(PackedLight currentLight, float3 normal, float3 surfaceToCamera, float3 worldPosition, float roughness, float metalness, float3 surfaceColor, float3 specularColor)
 {
     //get necessary components
     float3 surfaceToLight = normalize(currentLight.position - worldPosition);
-    float3 angle = saturate(dot(-surfaceToLight, currentLight.direction));
     
-    //get two "cones"
-    float cosInner = cos(currentLight.spotInnerAngle);
-    float cosOuter = cos(currentLight.spotOuterAngle);
-    float falloffRange = cosOuter - cosInner;
-    
-    //simulate shrinking of the lights to form cone
-    float spotTerm = saturate((cosOuter - angle) / falloffRange).x;
+    //simulate shrinking of the lights to form cone (cosines are precomputed)
+    float spotTerm = SpotTerm(currentLight, surfaceToLight);
     
     //use terms with point light calculation to create the cone
     return PointLightPBR(currentLight, normal, surfaceToCamera, worldPosition, roughness, metalness, surfaceColor, specularColor) * spotTerm;
 }
 
-float3 CalculateTotalLightPBR(int numLights, Lights lights[MAX_LIGHTS], float3 normal, float3 surfaceToCamera, float3 worldPos, float roughness, float metalness, float3 surfaceColor, float3 specularColor, float shadowAmount)
+//one light of any type (PBR variant), without shadows
+float3 LightPBR(PackedLight currentLight, float3 normal, float3 surfaceToCamera, float3 worldPos, float roughness, float metalness, float3 surfaceColor, float3 specularColor)
+{
+    switch (currentLight.type)
+    {
+        case LIGHT_TYPE_DIRECTIONAL:
+            return DirectionLightPBR(currentLight, normal, surfaceToCamera, roughness, metalness, surfaceColor, specularColor);
+        case LIGHT_TYPE_POINT:
+            return PointLightPBR(currentLight, normal, surfaceToCamera, worldPos, roughness, metalness, surfaceColor, specularColor);
+        case LIGHT_TYPE_SPOT:
+            return SpotLightPBR(currentLight, normal, surfaceToCamera, worldPos, roughness, metalness, surfaceColor, specularColor);
+    }
+    return float3(0, 0, 0);
+}
+
+//lightCounts = directional, point and spot lights (lights are sorted by type, so no switch is needed)
+//the first directional light is the one casting shadows
+float3 CalculateTotalLightPBR(uint3 lightCounts, StructuredBuffer<PackedLight> lights, float3 normal, float3 surfaceToCamera, float3 worldPos, float roughness, float metalness, float3 surfaceColor, float3 specularColor, float shadowAmount)
+{
+    float3 totalLight = float3(0, 0, 0); //store total lighting
+    uint i = 0;
+    //loop through each type of light
+    for (; i < lightCounts.x; i++)
+    {
+        float3 directionLight = DirectionLightPBR(lights[i], normal, surfaceToCamera, roughness, metalness, surfaceColor, specularColor);
+        totalLight += i == 0 ? directionLight * shadowAmount : directionLight;
+    }
+    for (; i < lightCounts.x + lightCounts.y; i++)
+        totalLight += PointLightPBR(lights[i], normal, surfaceToCamera, worldPos, roughness, metalness, surfaceColor, specularColor);
+    for (; i < lightCounts.x + lightCounts.y + lightCounts.z; i++)
+        totalLight += SpotLightPBR(lights[i], normal, surfaceToCamera, worldPos, roughness, metalness, surfaceColor, specularColor);
+    
+    return totalLight;
+}
+
+//Clustered lighting (see LightClusters)
+
+//cluster a pixel falls in: a tile across the screen, and a slice by the log of its view depth
+//clusterParams = tiles per pixel (x and y), depth scale, depth bias
+uint ClusterIndex(float2 pixel, float viewDepth, uint3 clusterCounts, float4 clusterParams)
+{
+    uint2 tile = min(uint2(max(pixel * clusterParams.xy, 0.0f)), clusterCounts.xy - 1);
+    float slice = log(max(viewDepth, 0.0001f)) * clusterParams.z + clusterParams.w;
+    uint s = uint(clamp(slice, 0.0f, float(clusterCounts.z - 1)));
+    return (s * clusterCounts.y + tile.y) * clusterCounts.x + tile.x;
+}
+
+//same as CalculateTotalLightPBR, but only for the lights in one cluster
+//the index list starts with the directional lights (which reach every cluster)
+float3 CalculateClusteredLightPBR(uint cluster, int numGlobalLights, StructuredBuffer<uint2> clusterRanges, StructuredBuffer<uint> clusterLightIndices, StructuredBuffer<PackedLight> lights, float3 normal, float3 surfaceToCamera, float3 worldPos, float roughness, float metalness, float3 surfaceColor, float3 specularColor, float shadowAmount)
 {
+    float3 totalLight = float3(0, 0, 0);
+    for (int g = 0; g < numGlobalLights; g++)
+    {
+        uint index = clusterLightIndices[g];
+        float3 light = LightPBR(lights[index], normal, surfaceToCamera, worldPos, roughness, metalness, surfaceColor, specularColor);
+        totalLight += index == 0 ? light * shadowAmount : light;
+    }
     
-    float3 totalLight; //store total lighting
-    //loop through lights
-    for (int i = 0; i < numLights; i++)
+    //offset and count
+    uint2 range = clusterRanges[cluster];
+    [loop]
+    for (uint i = 0; i < range.y; i++)
     {
-        //grab a copy of the current index
-        Lights currentLight = lights[i];
-        //normalize the direction to ensure consistent results
-        currentLight.direction = normalize(currentLight.direction);
-        
-        switch (currentLight.type)
-        {
-            case LIGHT_TYPE_DIRECTIONAL:
-                float3 directionLight = DirectionLightPBR(currentLight, normal, surfaceToCamera, roughness, metalness, surfaceColor, specularColor);
-                
-                if (i == 0)
-                {
-                    totalLight += directionLight * shadowAmount;
-                }
-                else
-                {
-                    totalLight += directionLight;
-
-                }
-                break;
-            case LIGHT_TYPE_POINT:
-                totalLight += PointLightPBR(currentLight, normal, surfaceToCamera, worldPos, roughness, metalness, surfaceColor, specularColor);
-                break;
-            case LIGHT_TYPE_SPOT:
-                totalLight += SpotLightPBR(currentLight, normal, surfaceToCamera, worldPos, roughness, metalness, surfaceColor, specularColor);
-                break;
-        }
+        totalLight += LightPBR(lights[clusterLightIndices[range.x + i]], normal, surfaceToCamera, worldPos, roughness, metalness, surfaceColor, specularColor);
+    }
+    
+    return totalLight;
+}
+
+//Per entity light lists (see EntityLightLists)
+
+#define MAX_ENTITY_LIGHTS 8
+
+//same as CalculateTotalLightPBR, but only the directional lights and the point and spot lights listed for this entity
+//listIndices = up to MAX_ENTITY_LIGHTS indices into lights, four to an element
+float3 CalculateListedLightPBR(uint numDirectional, int listCount, uint4 listIndices[MAX_ENTITY_LIGHTS / 4], StructuredBuffer<PackedLight> lights, float3 normal, float3 surfaceToCamera, float3 worldPos, float roughness, float metalness, float3 surfaceColor, float3 specularColor, float shadowAmount)
+{
+    float3 totalLight = float3(0, 0, 0);
+    for (uint i = 0; i < numDirectional; i++)
+    {
+        float3 directionLight = DirectionLightPBR(lights[i], normal, surfaceToCamera, roughness, metalness, surfaceColor, specularColor);
+        totalLight += i == 0 ? directionLight * shadowAmount : directionLight;
+    }
+    
+    [unroll]
+    for (int j = 0; j < MAX_ENTITY_LIGHTS; j++)
+    {
+        if (j < listCount)
+            totalLight += LightPBR(lights[listIndices[j / 4][j % 4]], normal, surfaceToCamera, worldPos, roughness, metalness, surfaceColor, specularColor);
     }
     
     return totalLight;
 }
 
-float2 GetParallaxUV(Texture2D HeightMap, SamplerState BasicSampler, float2 uv, float3 view, float3x3 TBN, int samples, float scale)
+float2 GetParallaxUV(Texture2D HeightMap, SamplerState BasicSampler, float2 uv, float3 view, float3x3 TBN, int samples, float scale, int channel = 0)
 {
 // Get tangent space view vector
 // Note: Multiplying in opposite order is effectively
@@ -412,7 +451,7 @@ float2 GetParallaxUV(Texture2D HeightMap, SamplerState BasicSampler, float2 uv,
 // Offset along ray and grab the height there
         currentPos -= uvStep;
         currentHeight -= stepSize;
-        float heightAtPos = HeightMap.SampleGrad(BasicSampler, currentPos, dx, dy).r;
+        float heightAtPos = HeightMap.SampleGrad(BasicSampler, currentPos, dx, dy)[channel]; //channel of a packed map
 // If we've gone "below" the heightmap, we've hit!
         if (currentHeight < heightAtPos)
         {
@@ -422,4 +461,40 @@ float2 GetParallaxUV(Texture2D HeightMap, SamplerState BasicSampler, float2 uv,
     return currentPos;
 }
 
+//Image based lighting (see IBLBaker)
+
+//irradiance from 9 spherical harmonic coefficients, already
+//convolved with the cosine lobe and divided by pi, so this is
+//what a white lambert surface facing "normal" would reflect
+float3 IrradianceFromSH(float4 sh[9], float3 normal)
+{
+    float3 n = normal;
+    float3 result = sh[0].rgb * 0.282095f;
+    result += sh[1].rgb * 0.488603f * n.y;
+    result += sh[2].rgb * 0.488603f * n.z;
+    result += sh[3].rgb * 0.488603f * n.x;
+    result += sh[4].rgb * 1.092548f * n.x * n.y;
+    result += sh[5].rgb * 1.092548f * n.y * n.z;
+    result += sh[6].rgb * 0.315392f * (3.0f * n.z * n.z - 1.0f);
+    result += sh[7].rgb * 1.092548f * n.x * n.z;
+    result += sh[8].rgb * 0.546274f * (n.x * n.x - n.y * n.y);
+    return max(result, 0.0f);
+}
+
+//split sum specular: the prefiltered sky (roughness picks the mip)
+//times the BRDF's scale and bias for the specular color
+float3 SpecularFromSky(TextureCube PrefilteredSky, Texture2D BrdfLUT, SamplerState BasicSampler, float3 normal, float3 view, float roughness, float3 specularColor, int mips)
+{
+    float NdotV = saturate(dot(normal, view));
+    float3 reflection = reflect(-view, normal);
+    float3 prefiltered = PrefilteredSky.SampleLevel(BasicSampler, reflection, roughness * (mips - 1)).rgb;
+
+    //stay half a texel inside the table so a wrapping sampler doesn't bleed across
+    float2 lutSize;
+    BrdfLUT.GetDimensions(lutSize.x, lutSize.y);
+    float2 lutUV = clamp(float2(NdotV, roughness), 0.5f / lutSize, 1.0f - 0.5f / lutSize);
+    float2 scaleBias = BrdfLUT.SampleLevel(BasicSampler, lutUV, 0).rg;
+    return prefiltered * (specularColor * scaleBias.x + scaleBias.y);
+}
+
 #endif
\ No newline at end of file
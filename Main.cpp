@@ -6,6 +6,22 @@
 #include "Graphics.h"
 #include "Game.h"
 #include "Input.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "FrameStats.h"
+#include "PathHelpers.h"
+#include "ParticleArena.h"
+#include "ParticleBudget.h"
+#include "Emitter.h"
+#include "PngDecoder.h"
+#include "TextureCooker.h"
+#include "IBLBaker.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <vector>
 
 // Annonymous namespace to hold variables
 // only accessible in this file
@@ -27,6 +43,399 @@ namespace
 		if(game)
 			game->OnResize();
 	}
+
+	// Looks for "-headless [frames]" on the command line,
+	// returning the number of frames to run (0 = normal run)
+	unsigned int HeadlessFrameCount(const char* commandLine)
+	{
+		const char* flag = strstr(commandLine, "-headless");
+		if (!flag)
+			return 0;
+
+		int frames = atoi(flag + strlen("-headless"));
+		return frames > 0 ? (unsigned int)frames : 600;
+	}
+
+	// --------------------------------------------------------
+	// Runs a fixed number of frames with no window and no GPU
+	// work, then prints how long the CPU side of each frame
+	// took and what was submitted to the (recording) device.
+	// With "-reference" the last frame is also drawn by the
+	// software rasterizer and saved as an image.
+	// --------------------------------------------------------
+	int RunHeadless(unsigned int frameCount, unsigned int width, unsigned int height, bool reference)
+	{
+		// Somewhere for the results to go, even in release
+		Window::CreateConsoleWindow(500, 120, 32, 120);
+
+		Window::CreateHeadless(width, height);
+		HRESULT graphicsResult = Graphics::InitializeHeadless(width, height);
+		if (FAILED(graphicsResult))
+			return graphicsResult;
+
+		// No window, so no input ever arrives - keys just read as up
+		Input::Initialize(0);
+		JobSystem::Initialize();
+
+		game = new Game();
+		game->Initialize();
+		Graphics::Renderer->ResetStats();
+
+		// Fixed time step so every run simulates exactly the same frames
+		const float deltaTime = 1.0f / 60.0f;
+		FrameStats cpuFrames(frameCount);
+		unsigned long long occlusionTested = 0;
+		unsigned long long occlusionOccluded = 0;
+		double occlusionMs = 0.0;
+
+		for (unsigned int i = 0; i < frameCount; i++)
+		{
+			uint64_t frameStart = Profiler::Now();
+			Profiler::BeginFrame();
+
+			game->Update(deltaTime, i * deltaTime);
+			game->Draw(deltaTime, i * deltaTime);
+
+			Profiler::EndFrame();
+			cpuFrames.AddFrame((float)Profiler::TicksToMilliseconds(Profiler::Now() - frameStart));
+
+			OcclusionStats occlusion = game->GetOcclusionStats();
+			occlusionTested += occlusion.Tested;
+			occlusionOccluded += occlusion.Occluded;
+			occlusionMs += game->GetOcclusionMs();
+		}
+
+		// Report
+		const FrameStatsSummary& summary = cpuFrames.Summary();
+		const RenderDeviceStats& device = Graphics::Renderer->Stats();
+		printf("Headless run: %u frames at %ux%u, %u job threads\n", frameCount, width, height, JobSystem::ThreadCount());
+		printf("CPU frame ms  avg %.3f  p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n",
+			summary.Average, summary.P50, summary.P95, summary.P99, summary.Max);
+		printf("Per frame     draws %.1f  dispatches %.1f  copies %.1f  state binds %.1f  resource binds %.1f  clears %.1f  bytes uploaded %.0f\n",
+			(double)device.DrawCalls / frameCount,
+			(double)device.Dispatches / frameCount,
+			(double)device.Copies / frameCount,
+			(double)device.StateBinds / frameCount,
+			(double)device.ResourceBinds / frameCount,
+			(double)device.Clears / frameCount,
+			(double)device.BytesUploaded / frameCount);
+		printf("Occlusion     tested %.1f  occluded %.1f  cost %.3f ms\n",
+			(double)occlusionTested / frameCount,
+			(double)occlusionOccluded / frameCount,
+			occlusionMs / frameCount);
+
+		std::string csvPath = FixPath("headless_frames.csv");
+		if (cpuFrames.ExportCSV(csvPath))
+			printf("Frame times written to %s\n", csvPath.c_str());
+
+		// CPU rendered image of the final frame, for comparing runs
+		if (reference)
+		{
+			std::string imagePath = FixPath("reference.png");
+			const SoftwareRasterTimings& raster = game->RenderReference(imagePath);
+			printf("Reference image written to %s (%u of %u triangles drawn)\n",
+				imagePath.c_str(), raster.TrianglesRasterized, raster.TrianglesSubmitted);
+			printf("Raster ms     vertex %.3f  setup %.3f  bin %.3f  raster %.3f  shade %.3f  total %.3f\n",
+				raster.VertexMs, raster.SetupMs, raster.BinMs, raster.RasterMs, raster.ShadeMs, raster.TotalMs);
+		}
+
+		// Clean up
+		delete game;
+		game = 0;
+		JobSystem::ShutDown();
+		Input::ShutDown();
+		Graphics::ShutDown();
+		return 0;
+	}
+
+	// What an uncompressed image takes up once uploaded with its mips
+	size_t UncompressedBytes(const CpuImage& image)
+	{
+		DdsImage layout;
+		layout.Width = image.Width;
+		layout.Height = image.Height;
+		while (((std::max)(image.Width, image.Height) >> layout.MipLevels) > 0)
+			layout.MipLevels++;
+		layout.Format = image.BytesPerPixel() == 1 ? DdsFormat::R8 : image.BytesPerPixel() == 2 ? DdsFormat::RG8 : DdsFormat::RGBA8;
+		return layout.MipOffset(layout.MipLevels);
+	}
+
+	// Cooks one image to a DDS file and prints a row of the
+	// results, returning false if it failed or looks wrong
+	bool CookTexture(const CpuImage& image, TextureKind kind, DdsFormat format, const std::filesystem::path& output, size_t before, size_t& after)
+	{
+		DdsImage cooked;
+		uint64_t start = Profiler::Now();
+		TextureCooker::Cook(image, kind, format, cooked);
+		double ms = Profiler::TicksToMilliseconds(Profiler::Now() - start);
+
+		// Only the channels the format keeps are compared
+		CpuImage original, decoded;
+		TextureCooker::ToRGBA8(image, original);
+		TextureCooker::DecodeMip(cooked, 0, decoded);
+		double psnr = TextureCooker::PSNR(original, decoded, TextureCooker::ChannelCount(format));
+
+		bool written = DdsFile::Write(output, cooked);
+		after = cooked.Data.size();
+
+		const char* formatName = format == DdsFormat::BC1 ? "BC1" : format == DdsFormat::BC4 ? "BC4" : format == DdsFormat::BC5 ? "BC5" : "BC7";
+		printf("%-30s %6s %10.1f %10.1f %8.2f %10zu %10zu %s\n", output.filename().string().c_str(), formatName, ms,
+			(double)image.Width * image.Height / 1e6 / (ms / 1000.0), psnr, before / 1024, after / 1024,
+			!written ? "WRITE FAILED" : psnr < 30.0 ? "LOW PSNR" : "");
+		return written && psnr >= 30.0;
+	}
+
+	// --------------------------------------------------------
+	// Block compresses every PNG in the bundled textures into a
+	// DDS file next to it (which TextureLoader then prefers),
+	// printing the format, encode speed, error and GPU memory
+	// before and after for each.  "-bc1" uses BC1 instead of
+	// BC7 for color.  Then packs each material's roughness,
+	// metalness and height into one "_packed" texture.  Exit
+	// code 1 if any of them fail or come out below 30 dB.
+	// --------------------------------------------------------
+	int RunTextureCooker(bool preferBC1)
+	{
+		Window::CreateConsoleWindow(500, 120, 32, 120);
+		JobSystem::Initialize();
+
+		std::filesystem::path folder = FixPath(L"../../Assets/Textures");
+		std::vector<std::filesystem::path> files;
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator(folder, error))
+			if (entry.path().extension() == ".png")
+				files.push_back(entry.path());
+		std::sort(files.begin(), files.end());
+
+		bool allCooked = true;
+		size_t totalBefore = 0, totalAfter = 0;
+		std::vector<std::string> materials;
+		printf("%-30s %6s %10s %10s %8s %10s %10s\n", "texture", "format", "ms", "MPixel/s", "PSNR", "before KB", "after KB");
+		for (const std::filesystem::path& file : files)
+		{
+			std::string name = file.filename().string();
+			CpuImage image;
+			std::string decodeError;
+			if (!PngDecoder::DecodeFile(file, image, &decodeError))
+			{
+				printf("%-30s %s\n", name.c_str(), decodeError.c_str());
+				allCooked = false;
+				continue;
+			}
+			if (!TextureCooker::CanCook(image))
+			{
+				// Stays a PNG, so it's still loaded the old way
+				printf("%-30s skipped (%ux%u isn't a multiple of 4)\n", name.c_str(), image.Width, image.Height);
+				continue;
+			}
+
+			// Materials with single channel maps get a packed texture too
+			TextureKind kind = TextureCooker::KindFromFileName(file);
+			std::string material = file.stem().string();
+			material = material.substr(0, material.find_last_of('_'));
+			if (kind == TextureKind::Single && std::find(materials.begin(), materials.end(), material) == materials.end())
+				materials.push_back(material);
+
+			std::filesystem::path output = file;
+			output.replace_extension(".dds");
+			size_t before = UncompressedBytes(image), after = 0;
+			allCooked = CookTexture(image, kind, TextureCooker::FormatFor(kind, preferBC1), output, before, after) && allCooked;
+			totalBefore += before;
+			totalAfter += after;
+		}
+		printf("GPU memory: %.1f MB as PNG, %.1f MB cooked (%.1fx smaller) on %u job threads\n",
+			totalBefore / (1024.0 * 1024.0), totalAfter / (1024.0 * 1024.0), (double)totalBefore / (std::max)(totalAfter, (size_t)1), JobSystem::ThreadCount());
+
+		// Same order the shaders read them in: R = roughness, G = metalness, B = height
+		const char* channelSuffixes[] = { "_roughness", "_metal", "_height" };
+		size_t packedBefore = 0, packedAfter = 0;
+		for (const std::string& material : materials)
+		{
+			CpuImage sources[3];
+			const CpuImage* found[3] = {};
+			size_t before = 0;
+			for (int i = 0; i < 3; i++)
+			{
+				if (PngDecoder::DecodeFile(folder / (material + channelSuffixes[i] + ".png"), sources[i]))
+				{
+					found[i] = &sources[i];
+					before += UncompressedBytes(sources[i]);
+				}
+			}
+
+			// Height only matters for parallax materials
+			CpuImage packed;
+			TextureCooker::PackChannels(found, found[2] ? 3 : 2, packed);
+			if (!TextureCooker::CanCook(packed))
+				continue;
+
+			size_t after = 0;
+			allCooked = CookTexture(packed, TextureKind::Packed, TextureCooker::PackedFormat(packed), folder / (material + "_packed.dds"), before, after) && allCooked;
+			packedBefore += before;
+			packedAfter += after;
+		}
+		printf("Packed maps: %.1f MB as separate PNGs, %.1f MB packed and cooked\n",
+			packedBefore / (1024.0 * 1024.0), packedAfter / (1024.0 * 1024.0));
+
+		JobSystem::ShutDown();
+		return allCooked && totalAfter > 0 ? 0 : 1;
+	}
+
+	// --------------------------------------------------------
+	// Bakes image based lighting for the Pink sky, timing each
+	// step, and writes the cache the game reads at startup.
+	// Exit code 1 if the cache can't be written or doesn't
+	// read back.
+	// --------------------------------------------------------
+	int RunIBLBaker()
+	{
+		Window::CreateConsoleWindow(500, 120, 32, 120);
+		JobSystem::Initialize();
+
+		std::filesystem::path faces[6] = {
+			FixPath(L"../../Assets/Skyboxes/Pink/right.png"),
+			FixPath(L"../../Assets/Skyboxes/Pink/left.png"),
+			FixPath(L"../../Assets/Skyboxes/Pink/up.png"),
+			FixPath(L"../../Assets/Skyboxes/Pink/down.png"),
+			FixPath(L"../../Assets/Skyboxes/Pink/front.png"),
+			FixPath(L"../../Assets/Skyboxes/Pink/back.png") };
+		std::filesystem::path cachePath = FixPath(L"../../Assets/Skyboxes/Pink/ibl.bin");
+
+		IBLData ibl;
+		CubeImage sky;
+		uint64_t start = Profiler::Now();
+		IBLBaker::LoadFaces(faces, 256, sky);
+		IBLBaker::Bake(sky, ibl);
+		printf("Pink sky baked in %.1f ms on %u job threads\n", Profiler::TicksToMilliseconds(Profiler::Now() - start), JobSystem::ThreadCount());
+
+		// Write the cache, then make sure it reads back
+		uint64_t stamp = IBLBaker::SourceStamp(faces);
+		IBLData reloaded;
+		bool cacheOK = IBLBaker::Save(cachePath, ibl, stamp) && IBLBaker::Load(cachePath, stamp, reloaded);
+		printf("Cache %s: %s\n", cachePath.string().c_str(), cacheOK ? "OK" : "FAILED");
+
+		JobSystem::ShutDown();
+		return cacheOK ? 0 : 1;
+	}
+
+	// --------------------------------------------------------
+	// Draws 1 to 1000 small emitters sharing a material through
+	// a headless device, once batched into a single draw and
+	// once with a draw per emitter, and prints the CPU cost of
+	// submitting a frame of particles for each.  Then runs the
+	// same scenes under a ParticleBudget, which should keep
+	// the living particle count flat as emitters are added.
+	// --------------------------------------------------------
+	int RunEmitterScaling(unsigned int width, unsigned int height)
+	{
+		Window::CreateConsoleWindow(500, 120, 32, 120);
+		Window::CreateHeadless(width, height);
+		HRESULT graphicsResult = Graphics::InitializeHeadless(width, height);
+		if (FAILED(graphicsResult))
+			return graphicsResult;
+
+		std::shared_ptr<SimpleVertexShader> particleVS = std::make_shared<SimpleVertexShader>(Graphics::Device, Graphics::Context, FixPath(L"ParticleVS.cso").c_str());
+		std::shared_ptr<SimplePixelShader> particlePS = std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"ParticlePS.cso").c_str());
+		std::shared_ptr<Material> material = std::make_shared<Material>(particleVS, particlePS, DirectX::XMFLOAT3(1, 1, 1));
+		std::shared_ptr<Camera> camera = std::make_shared<Camera>(DirectX::XMFLOAT3(0, 0, -10), DirectX::XM_PIDIV4, (float)width / height);
+
+		const float dt = 1.0f / 60.0f;
+		const unsigned int warmUpFrames = 120;	// Long enough to fill every emitter
+		const unsigned int frames = 240;
+		const unsigned int counts[] = { 1, 10, 100, 1000 };
+
+		printf("Emitter scaling: %u frames, 100 particles alive per emitter\n", frames);
+		printf("%10s %14s %14s %14s %14s %14s\n", "emitters", "batched draws", "batched ms", "single draws", "single ms", "upload B/frame");
+
+		for (unsigned int count : counts)
+		{
+			double drawsPerFrame[2] = {};
+			double msPerFrame[2] = {};
+			double bytesPerFrame = 0.0;
+			for (int mode = 0; mode < 2; mode++)
+			{
+				std::shared_ptr<ParticleArena> arena = std::make_shared<ParticleArena>();
+				arena->SetBatching(mode == 0);
+
+				std::vector<std::shared_ptr<Emitter>> emitters;
+				for (unsigned int i = 0; i < count; i++)
+				{
+					emitters.push_back(std::make_shared<Emitter>(
+						128, 50, 2.0f, 0.1f, 0.1f, false,
+						DirectX::XMFLOAT4(1, 1, 1, 1), DirectX::XMFLOAT4(1, 1, 1, 0),
+						DirectX::XMFLOAT3(0, 1, 0), DirectX::XMFLOAT3(0.5f, 0.5f, 0.5f),
+						DirectX::XMFLOAT3((float)(i % 32) - 16.0f, 0.0f, (float)(i / 32)), DirectX::XMFLOAT3(0.25f, 0.25f, 0.25f),
+						DirectX::XMFLOAT2(0, 0), DirectX::XMFLOAT2(0, 0), DirectX::XMFLOAT3(0, 0, 0),
+						material, arena));
+				}
+
+				uint64_t drawTicks = 0;
+				for (unsigned int frame = 0; frame < warmUpFrames + frames; frame++)
+				{
+					if (frame == warmUpFrames)
+					{
+						Graphics::Renderer->ResetStats();
+						drawTicks = 0;
+					}
+
+					for (auto& emitter : emitters)
+						emitter->Update(dt, frame * dt);
+
+					uint64_t start = Profiler::Now();
+					arena->Draw(emitters, camera, false);
+					drawTicks += Profiler::Now() - start;
+				}
+
+				drawsPerFrame[mode] = (double)Graphics::Renderer->Stats().DrawCalls / frames;
+				msPerFrame[mode] = Profiler::TicksToMilliseconds(drawTicks) / frames;
+				if (mode == 0)
+					bytesPerFrame = (double)Graphics::Renderer->Stats().BytesUploaded / frames;
+			}
+
+			printf("%10u %14.1f %14.4f %14.1f %14.4f %14.0f\n", count,
+				drawsPerFrame[0], msPerFrame[0], drawsPerFrame[1], msPerFrame[1], bytesPerFrame);
+		}
+
+		const unsigned int budget = 5000;
+		printf("\nParticle budget of %u\n", budget);
+		printf("%10s %14s %14s %14s %14s\n", "emitters", "culled", "alive", "drawn", "draws");
+
+		for (unsigned int count : counts)
+		{
+			std::shared_ptr<ParticleArena> arena = std::make_shared<ParticleArena>();
+			ParticleBudget particleBudget(budget);
+
+			std::vector<std::shared_ptr<Emitter>> emitters;
+			for (unsigned int i = 0; i < count; i++)
+			{
+				emitters.push_back(std::make_shared<Emitter>(
+					128, 50, 2.0f, 0.1f, 0.1f, false,
+					DirectX::XMFLOAT4(1, 1, 1, 1), DirectX::XMFLOAT4(1, 1, 1, 0),
+					DirectX::XMFLOAT3(0, 1, 0), DirectX::XMFLOAT3(0.5f, 0.5f, 0.5f),
+					DirectX::XMFLOAT3((float)(i % 32) - 16.0f, 0.0f, (float)(i / 32)), DirectX::XMFLOAT3(0.25f, 0.25f, 0.25f),
+					DirectX::XMFLOAT2(0, 0), DirectX::XMFLOAT2(0, 0), DirectX::XMFLOAT3(0, 0, 0),
+					material, arena));
+			}
+
+			for (unsigned int frame = 0; frame < warmUpFrames; frame++)
+			{
+				particleBudget.Update(emitters, camera);
+				for (auto& emitter : emitters)
+					emitter->Update(dt, frame * dt);
+			}
+			arena->Draw(emitters, camera, false);
+
+			unsigned int alive = 0;
+			for (auto& emitter : emitters)
+				alive += emitter->GetLivingParticleCount();
+
+			const ParticleArenaStats& stats = arena->GetStats();
+			printf("%10u %14u %14u %14u %14u\n", count, particleBudget.GetStats().Culled, alive, stats.ParticlesDrawn, stats.DrawCalls);
+		}
+
+		Graphics::ShutDown();
+		return 0;
+	}
 }
 
 
@@ -57,6 +466,19 @@ int WINAPI WinMain(
 	bool statsInTitleBar = true;
 	bool vsync = false;
 
+	// Tools and benchmarks that run instead of the game
+	if (strstr(lpCmdLine, "-emitterbench"))
+		return RunEmitterScaling(windowWidth, windowHeight);
+	if (strstr(lpCmdLine, "-bakeibl"))
+		return RunIBLBaker();
+	if (strstr(lpCmdLine, "-cook"))
+		return RunTextureCooker(strstr(lpCmdLine, "-bc1") != 0);
+
+	// Headless runs skip the window and GPU entirely
+	unsigned int headlessFrames = HeadlessFrameCount(lpCmdLine);
+	if (headlessFrames > 0)
+		return RunHeadless(headlessFrames, windowWidth, windowHeight, strstr(lpCmdLine, "-reference") != 0);
+
 	// The main application object
 	game = new Game();
 
@@ -83,6 +505,9 @@ int WINAPI WinMain(
 	// Initalize the input system, which requires the window handle
 	Input::Initialize(Window::Handle());
 
+	// Start the worker threads used for per-frame work
+	JobSystem::Initialize();
+
 	// Now the game itself can be initialzied
 	game->Initialize();
 
@@ -125,6 +550,9 @@ int WINAPI WinMain(
 			// Calculate basic fps
 			Window::UpdateStats(totalTime);
 
+			// Everything from here to EndFrame() is one profiler frame
+			Profiler::BeginFrame();
+
 			// Input updating
 			Input::Update();
 
@@ -135,6 +563,9 @@ int WINAPI WinMain(
 			// Notify Input system about end of frame
 			Input::EndOfFrame();
 
+			// Collect this frame's profile markers from every thread
+			Profiler::EndFrame();
+
 #if defined(DEBUG) || defined(_DEBUG)
 			// Print any graphics debug messages that occurred this frame
 			Graphics::PrintDebugMessages();
@@ -144,6 +575,7 @@ int WINAPI WinMain(
 
 	// Clean up
 	delete game;
+	JobSystem::ShutDown();
 	Input::ShutDown();
 	Graphics::ShutDown();
 	return (HRESULT)msg.wParam;
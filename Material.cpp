@@ -5,6 +5,7 @@ Material::Material(std::shared_ptr<SimpleVertexShader> vs, std::shared_ptr<Simpl
 {
 	uvOffset = DirectX::XMFLOAT2(0, 0);
 	uvScale = DirectX::XMFLOAT2(1, 1);
+	packedMaps = false;
 }
 
 std::shared_ptr<SimpleVertexShader> Material::GetVertexShader()
@@ -47,6 +48,11 @@ float Material::GetRoughness()
 	return roughness;
 }
 
+bool Material::GetPackedMaps()
+{
+	return packedMaps;
+}
+
 void Material::SetVertexShader(std::shared_ptr<SimpleVertexShader> newVs)
 {
 	vs = newVs;
@@ -77,9 +83,14 @@ void Material::SetRoughness(const float newRoughness)
 	roughness = newRoughness;
 }
 
+void Material::SetPackedMaps(const bool usePackedMaps)
+{
+	packedMaps = usePackedMaps;
+}
+
 void Material::AddTextureSRV(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
 {
-	textureSRVs.insert({ name,srv });
+	textureSRVs[name] = srv; //replaces one with the same name (streamed textures swap this way)
 }
 
 void Material::AddSampler(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler)
@@ -101,6 +112,7 @@ void Material::PrepareMaterial(Transform& transform, std::shared_ptr<Camera> act
 	ps->SetFloat2("uvScale", uvScale);
 	ps->SetFloat2("uvOffset", uvOffset);
 	ps->SetFloat("roughness", roughness);
+	ps->SetInt("packedMaps", packedMaps);
 	ps->SetFloat3("cameraPos", activeCam->GetTransform().GetPosition());
 	ps->CopyAllBufferData();
 
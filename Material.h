@@ -13,6 +13,7 @@ private:
 	DirectX::XMFLOAT2 uvOffset;
 	DirectX::XMFLOAT2 uvScale;
 	float roughness;
+	bool packedMaps; //roughness/metalness/height come from one "PackedMap"
 	std::shared_ptr<SimpleVertexShader> vs;
 	std::shared_ptr<SimplePixelShader> ps;
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> textureSRVs; //for textures (optional)
@@ -34,6 +35,7 @@ public:
 	DirectX::XMFLOAT2 GetUvScale();
 	DirectX::XMFLOAT2 GetUvOffset();
 	float GetRoughness();
+	bool GetPackedMaps();
 
 	//setters
 	void SetVertexShader(std::shared_ptr<SimpleVertexShader> newVs);
@@ -42,6 +44,7 @@ public:
 	void SetUvScale(const DirectX::XMFLOAT2& newScale);
 	void SetUvOffset(const DirectX::XMFLOAT2& newOffset);
 	void SetRoughness(const float newRoughness);
+	void SetPackedMaps(const bool usePackedMaps);
 
 	//adding textures
 	void AddTextureSRV(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
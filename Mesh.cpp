@@ -1,5 +1,6 @@
 #include "Mesh.h"
 #include "Graphics.h"
+#include <cmath>
 #include <fstream>
 #include <stdexcept>
 #include <vector>
@@ -229,6 +230,16 @@ void Mesh::CreateBuffers(Vertex* vertexData, unsigned int* indexData, size_t ver
 	//Generate Tangents using vertex data
 	CalculateTangents(vertexData, vertices, indexData, indices);
 
+	//Fit a box around the vertices for culling
+	BoundingBox::CreateFromPoints(bounds, vertexCount, &vertexData[0].Position, sizeof(Vertex));
+
+	//How stretched the textures are, so streaming knows which mip is needed
+	uvDensity = CalculateUVDensity(vertexData, indexData, indices);
+
+	//Keep a copy of the final data for anything drawing on the CPU
+	cpuVertices.assign(vertexData, vertexData + vertexCount);
+	cpuIndices.assign(indexData, indexData + indexCount);
+
 	//create buffers
 	// Create a VERTEX BUFFER
 	// - This holds the vertex data of triangles for a single object
@@ -293,10 +304,8 @@ void Mesh::Draw() {
 	//  - For this demo, this step *could* simply be done once during Init()
 	//  - However, this needs to be done between EACH DrawIndexed() call
 	//     when drawing different geometry, so it's here as an example
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
-	Graphics::Context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
-	Graphics::Context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	Graphics::Renderer->SetVertexBuffer(vertexBuffer.Get(), sizeof(Vertex));
+	Graphics::Renderer->SetIndexBuffer(indexBuffer.Get());
 
 	// Tell Direct3D to draw
 	//  - Begins the rendering pipeline on the GPU
@@ -304,10 +313,7 @@ void Mesh::Draw() {
 	//  - This will use all currently set Direct3D resources (shaders, buffers, etc)
 	//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
 	//     vertices in the currently set VERTEX BUFFER
-	Graphics::Context->DrawIndexed(
-		indices,    // The number of indices to use (we could draw a subset if we wanted)
-		0,			// Offset to the first index we want to use
-		0);			// Offset to add to each index when looking up vertices
+	Graphics::Renderer->DrawIndexed(indices); // The number of indices to use (we could draw a subset if we wanted)
 }
 
 //Return whole ComPtr Objects
@@ -327,6 +333,47 @@ int Mesh::GetIndexCount() const {
 	return indices;
 }
 
+const DirectX::BoundingBox& Mesh::GetBounds() const {
+	return bounds;
+}
+
+float Mesh::GetUVDensity() const {
+	return uvDensity;
+}
+
+//Square root of total UV area over total surface area: the average
+//number of UV units along one local space unit of the surface
+float Mesh::CalculateUVDensity(Vertex* verts, unsigned int* indices, int numIndices) {
+	float surfaceArea = 0.0f;
+	float uvArea = 0.0f;
+	for (int i = 0; i + 2 < numIndices; i += 3) {
+		const Vertex& v0 = verts[indices[i]];
+		const Vertex& v1 = verts[indices[i + 1]];
+		const Vertex& v2 = verts[indices[i + 2]];
+
+		XMVECTOR p0 = XMLoadFloat3(&v0.Position);
+		XMVECTOR edges = XMVector3Cross(XMLoadFloat3(&v1.Position) - p0, XMLoadFloat3(&v2.Position) - p0);
+		surfaceArea += 0.5f * XMVectorGetX(XMVector3Length(edges));
+
+		float u1 = v1.UV.x - v0.UV.x, w1 = v1.UV.y - v0.UV.y;
+		float u2 = v2.UV.x - v0.UV.x, w2 = v2.UV.y - v0.UV.y;
+		uvArea += 0.5f * fabsf(u1 * w2 - u2 * w1);
+	}
+
+	//no area (or no UVs) - treat it as one UV unit per unit
+	if (surfaceArea <= 0.0f || uvArea <= 0.0f)
+		return 1.0f;
+	return sqrtf(uvArea / surfaceArea);
+}
+
+const std::vector<Vertex>& Mesh::GetVertices() const {
+	return cpuVertices;
+}
+
+const std::vector<unsigned int>& Mesh::GetIndices() const {
+	return cpuIndices;
+}
+
 // --------------------------------------------------------
 // Author: Chris Cascioli
 // Purpose: Calculates the tangents of the vertices in a mesh
@@ -1,6 +1,8 @@
 #pragma once
 #include <wrl/client.h>
 #include <d3d11.h>
+#include <DirectXCollision.h>
+#include <vector>
 #include "Vertex.h"
 class Mesh
 {
@@ -13,6 +15,16 @@ private:
 	unsigned int indices; //index count
 	unsigned int vertices; //vertex count
 
+	//Local space box around every vertex (used for culling)
+	DirectX::BoundingBox bounds;
+
+	//UV units per local space unit, averaged over the surface (used for texture streaming)
+	float uvDensity;
+
+	//System memory copies of the buffers (used by CPU-side rendering)
+	std::vector<Vertex> cpuVertices;
+	std::vector<unsigned int> cpuIndices;
+
 	//Helper Methods
 	//Create buffers from necessary data
 	void CreateBuffers(Vertex* vertexData, unsigned int* indexData, size_t vertexCount, size_t indexCount);
@@ -39,6 +51,13 @@ public:
 	int GetIndexCount() const;
 	//Returns number of vertices
 	int GetVertexCount() const;
+	//Returns local space bounds
+	const DirectX::BoundingBox& GetBounds() const;
+	//Returns how many UV units cover one local space unit
+	float GetUVDensity() const;
+	//Returns the vertex/index data that was uploaded to the buffers
+	const std::vector<Vertex>& GetVertices() const;
+	const std::vector<unsigned int>& GetIndices() const;
 
 	//Output
 	//Sets buffers and draws using indices count
@@ -46,5 +65,6 @@ public:
 
 	//Helpers
 	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+	float CalculateUVDensity(Vertex* verts, unsigned int* indices, int numIndices);
 };
 
@@ -14,16 +14,14 @@ cbuffer ShaderData : register(b0)
     float3 cameraPos; //helps with specular + diffuse lighting
 
 	//light data
-    int numLights;
     float3 ambientColor;
-
-	//light objects
-    Lights lights[MAX_LIGHTS];
+    uint3 lightCounts; //directional, point and spot lights in LightData (in that order)
 };
 
 Texture2D SurfaceTexture : register(t0); // "t" registers for textures
 Texture2D NormalMap : register(t1); //second register for normal map
 TextureCube SkyBox : register(t2); //skybox
+StructuredBuffer<PackedLight> LightData : register(t3); //every light, packed once per frame (see LightPacker)
 SamplerState BasicSampler : register(s0); // "s" registers for samplers
 
 // --------------------------------------------------------
@@ -61,7 +59,7 @@ float4 main(VertexToNormalMapPS input) : SV_TARGET
     float3 surfaceToCamera = normalize(cameraPos - input.worldPos);
 	
 	//apply the total lighting
-    totalLight += CalculateTotalLight(numLights, lights, input.normal, surfaceToCamera, input.worldPos, roughness, color);
+    totalLight += CalculateTotalLight(lightCounts, LightData, input.normal, surfaceToCamera, input.worldPos, roughness, color);
     totalLight = GammaCorrect(totalLight);
     totalLight = ApplyFresnelReflection(cameraPos, input.worldPos, input.normal, totalLight, BasicSampler, SkyBox, 0.04);
 	
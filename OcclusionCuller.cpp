@@ -0,0 +1,330 @@
+#include "OcclusionCuller.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <emmintrin.h>
+
+using namespace DirectX;
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height) :
+	width(0),
+	height(0),
+	paddedWidth(0),
+	paddedHeight(0),
+	blocksX(0),
+	tested(0),
+	occluded(0)
+{
+	XMStoreFloat4x4(&viewProjection, XMMatrixIdentity());
+	Resize(width, height);
+}
+
+// Getters
+unsigned int OcclusionCuller::GetWidth() const { return width; }
+unsigned int OcclusionCuller::GetHeight() const { return height; }
+const std::vector<float>& OcclusionCuller::GetDepth() const { return depth; }
+unsigned int OcclusionCuller::GetPaddedWidth() const { return paddedWidth; }
+
+OcclusionStats OcclusionCuller::GetStats() const
+{
+	OcclusionStats result = stats;
+	result.Tested = tested.load(std::memory_order_relaxed);
+	result.Occluded = occluded.load(std::memory_order_relaxed);
+	return result;
+}
+
+void OcclusionCuller::Resize(unsigned int width, unsigned int height)
+{
+	this->width = std::max(1u, width);
+	this->height = std::max(1u, height);
+	paddedWidth = (this->width + BlockSize - 1) / BlockSize * BlockSize;
+	paddedHeight = (this->height + BlockSize - 1) / BlockSize * BlockSize;
+	blocksX = paddedWidth / BlockSize;
+
+	// Nothing drawn yet, so nothing is hidden
+	depth.assign((size_t)paddedWidth * paddedHeight, 1.0f);
+	blockMaxDepth.assign((size_t)blocksX * (paddedHeight / BlockSize), 1.0f);
+}
+
+// --------------------------------------------------------
+// Starts a new frame of occluders seen from this camera
+// --------------------------------------------------------
+void OcclusionCuller::BeginFrame(const XMFLOAT4X4& view, const XMFLOAT4X4& projection)
+{
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection)));
+	triangles.clear();
+	stats = {};
+	tested.store(0, std::memory_order_relaxed);
+	occluded.store(0, std::memory_order_relaxed);
+}
+
+// --------------------------------------------------------
+// Transforms, clips and sets up one occluder's triangles.
+// Keep occluders simple - every triangle is drawn by every
+// band that it touches.
+// --------------------------------------------------------
+void OcclusionCuller::AddOccluder(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const XMFLOAT4X4& world)
+{
+	PROFILE_SCOPE("OcclusionCuller::AddOccluder");
+	uint64_t start = Profiler::Now();
+
+	XMMATRIX worldViewProjection = XMMatrixMultiply(XMLoadFloat4x4(&world), XMLoadFloat4x4(&viewProjection));
+	std::vector<XMFLOAT4> clip(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+		XMStoreFloat4(&clip[i], XMVector3Transform(XMLoadFloat3(&vertices[i].Position), worldViewProjection));
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		XMFLOAT4 in[3] = { clip[indices[i]], clip[indices[i + 1]], clip[indices[i + 2]] };
+
+		// Entirely past a side or the far plane
+		if ((in[0].x > in[0].w && in[1].x > in[1].w && in[2].x > in[2].w) ||
+			(in[0].x < -in[0].w && in[1].x < -in[1].w && in[2].x < -in[2].w) ||
+			(in[0].y > in[0].w && in[1].y > in[1].w && in[2].y > in[2].w) ||
+			(in[0].y < -in[0].w && in[1].y < -in[1].w && in[2].y < -in[2].w) ||
+			(in[0].z > in[0].w && in[1].z > in[1].w && in[2].z > in[2].w))
+			continue;
+
+		// Clip to the near plane (z >= 0) - big occluders like the
+		// floor almost always reach behind the camera
+		XMFLOAT4 clipped[4];
+		int clippedCount = 0;
+		for (int v = 0; v < 3; v++)
+		{
+			const XMFLOAT4& a = in[v];
+			const XMFLOAT4& b = in[(v + 1) % 3];
+			if (a.z >= 0.0f)
+				clipped[clippedCount++] = a;
+
+			if ((a.z >= 0.0f) != (b.z >= 0.0f))
+			{
+				float s = a.z / (a.z - b.z);
+				clipped[clippedCount++] = XMFLOAT4(
+					a.x + (b.x - a.x) * s,
+					a.y + (b.y - a.y) * s,
+					a.z + (b.z - a.z) * s,
+					a.w + (b.w - a.w) * s);
+			}
+		}
+
+		for (int fan = 1; fan + 1 < clippedCount; fan++)
+		{
+			XMFLOAT4 tri[3] = { clipped[0], clipped[fan], clipped[fan + 1] };
+			AddTriangle(tri);
+		}
+	}
+
+	stats.Occluders++;
+	stats.RasterMs += Profiler::TicksToMilliseconds(Profiler::Now() - start);
+}
+
+// --------------------------------------------------------
+// Screen space setup.  Coverage is sampled at pixel centers
+// but depth is pushed back to the farthest point in each
+// pixel, so an occluder never ends up nearer than it is.
+// --------------------------------------------------------
+void OcclusionCuller::AddTriangle(const XMFLOAT4 clip[3])
+{
+	float x[3], y[3], z[3];
+	for (int i = 0; i < 3; i++)
+	{
+		if (clip[i].w <= 0.0f)
+			return;
+
+		float invW = 1.0f / clip[i].w;
+		x[i] = (clip[i].x * invW * 0.5f + 0.5f) * width;
+		y[i] = (0.5f - clip[i].y * invW * 0.5f) * height;
+		z[i] = clip[i].z * invW;
+	}
+
+	// Clockwise on screen is front facing, same as the GPU
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	if (!(area > 0.0f))
+		return;
+
+	// Pixels whose centers fall inside the triangle's bounds
+	OccluderTriangle tri;
+	tri.MinX = std::max(0, (int)std::ceil(std::min({ x[0], x[1], x[2] }) - 0.5f));
+	tri.MinY = std::max(0, (int)std::ceil(std::min({ y[0], y[1], y[2] }) - 0.5f));
+	tri.MaxX = std::min((int)width - 1, (int)std::floor(std::max({ x[0], x[1], x[2] }) - 0.5f));
+	tri.MaxY = std::min((int)height - 1, (int)std::floor(std::max({ y[0], y[1], y[2] }) - 0.5f));
+	if (tri.MinX > tri.MaxX || tri.MinY > tri.MaxY)
+		return;
+
+	// Edge i is opposite vertex i
+	float inverseArea = 1.0f / area;
+	for (int i = 0; i < 3; i++)
+	{
+		int a = (i + 1) % 3;
+		int b = (i + 2) % 3;
+		tri.EdgeA[i] = y[a] - y[b];
+		tri.EdgeB[i] = x[b] - x[a];
+		tri.EdgeC[i] = -(tri.EdgeA[i] * x[a] + tri.EdgeB[i] * y[a]);
+	}
+
+	tri.DepthA = ((y[1] - y[2]) * z[0] + (y[2] - y[0]) * z[1] + (y[0] - y[1]) * z[2]) * inverseArea;
+	tri.DepthB = ((x[2] - x[1]) * z[0] + (x[0] - x[2]) * z[1] + (x[1] - x[0]) * z[2]) * inverseArea;
+	tri.DepthC = z[0] - tri.DepthA * x[0] - tri.DepthB * y[0]
+		+ 0.5f * (std::abs(tri.DepthA) + std::abs(tri.DepthB));
+
+	triangles.push_back(tri);
+	stats.OccluderTriangles++;
+}
+
+// --------------------------------------------------------
+// Draws every occluder, one job per band of BlockSize rows
+// --------------------------------------------------------
+void OcclusionCuller::RasterizeOccluders()
+{
+	PROFILE_SCOPE("OcclusionCuller::RasterizeOccluders");
+	uint64_t start = Profiler::Now();
+
+	JobSystem::ParallelFor(paddedHeight / BlockSize, [this](unsigned int begin, unsigned int end) {
+		for (unsigned int band = begin; band < end; band++)
+			RasterizeBand(band);
+	}, 1);
+
+	stats.RasterMs += Profiler::TicksToMilliseconds(Profiler::Now() - start);
+}
+
+void OcclusionCuller::RasterizeBand(unsigned int band)
+{
+	const int bandTop = (int)(band * BlockSize);
+	const int bandBottom = bandTop + (int)BlockSize - 1;
+	std::fill_n(&depth[(size_t)bandTop * paddedWidth], (size_t)paddedWidth * BlockSize, 1.0f);
+
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+
+	for (const OccluderTriangle& tri : triangles)
+	{
+		int y0 = std::max(tri.MinY, bandTop);
+		int y1 = std::min(tri.MaxY, bandBottom);
+		if (y0 > y1)
+			continue;
+
+		// Four pixels at a time from an aligned start; the edges
+		// (not the bounds) decide coverage, so extra lanes are harmless.
+		// Pixels exactly on a shared edge go to both triangles, which
+		// is fine for depth and leaves no cracks
+		int x0 = tri.MinX & ~3;
+		__m128 edgeA[3];
+		for (int e = 0; e < 3; e++)
+			edgeA[e] = _mm_set1_ps(tri.EdgeA[e]);
+		__m128 depthA = _mm_set1_ps(tri.DepthA);
+
+		for (int y = y0; y <= y1; y++)
+		{
+			float py = y + 0.5f;
+			__m128 edgeRow[3];
+			for (int e = 0; e < 3; e++)
+				edgeRow[e] = _mm_set1_ps(tri.EdgeB[e] * py + tri.EdgeC[e]);
+			__m128 depthRow = _mm_set1_ps(tri.DepthB * py + tri.DepthC);
+			float* row = &depth[(size_t)y * paddedWidth];
+
+			for (int x = x0; x <= tri.MaxX; x += 4)
+			{
+				__m128 xs = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+				__m128 mask = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], xs), edgeRow[0]), zero);
+				mask = _mm_and_ps(mask, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[1], xs), edgeRow[1]), zero));
+				mask = _mm_and_ps(mask, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[2], xs), edgeRow[2]), zero));
+				if (_mm_movemask_ps(mask) == 0)
+					continue;
+
+				// Keep the nearest of what's there and this triangle
+				__m128 z = _mm_add_ps(_mm_mul_ps(depthA, xs), depthRow);
+				__m128 stored = _mm_loadu_ps(row + x);
+				__m128 nearest = _mm_min_ps(z, stored);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(mask, nearest), _mm_andnot_ps(mask, stored)));
+			}
+		}
+	}
+
+	// Farthest depth of each block in this band
+	for (unsigned int bx = 0; bx < blocksX; bx++)
+	{
+		__m128 farthest = zero;
+		for (unsigned int row = 0; row < BlockSize; row++)
+		{
+			const float* rowDepth = &depth[(size_t)(bandTop + row) * paddedWidth + bx * BlockSize];
+			farthest = _mm_max_ps(farthest, _mm_max_ps(_mm_loadu_ps(rowDepth), _mm_loadu_ps(rowDepth + 4)));
+		}
+		farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(1, 0, 3, 2)));
+		farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(2, 3, 0, 1)));
+		blockMaxDepth[band * blocksX + bx] = _mm_cvtss_f32(farthest);
+	}
+}
+
+// --------------------------------------------------------
+// False only when every pixel the bounds touch already has
+// an occluder in front of the nearest corner of the box
+// --------------------------------------------------------
+bool OcclusionCuller::IsVisible(const BoundingBox& worldBounds) const
+{
+	tested.fetch_add(1, std::memory_order_relaxed);
+
+	XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+	worldBounds.GetCorners(corners);
+	XMMATRIX vp = XMLoadFloat4x4(&viewProjection);
+
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	float nearestZ = FLT_MAX;
+	for (const XMFLOAT3& corner : corners)
+	{
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&corner), vp));
+
+		// Reaches past the near plane - can't say anything useful
+		if (clip.w <= 0.0f || clip.z < 0.0f)
+			return true;
+
+		float invW = 1.0f / clip.w;
+		float sx = (clip.x * invW * 0.5f + 0.5f) * width;
+		float sy = (0.5f - clip.y * invW * 0.5f) * height;
+		minX = std::min(minX, sx);
+		maxX = std::max(maxX, sx);
+		minY = std::min(minY, sy);
+		maxY = std::max(maxY, sy);
+		nearestZ = std::min(nearestZ, clip.z * invW);
+	}
+
+	// Every pixel the box touches plus a one pixel border - occluders
+	// are sampled at pixel centers, so an edge pixel may only be
+	// partly covered and its neighbor is what proves the box peeks out
+	int x0 = std::max(0, (int)std::floor(minX) - 1);
+	int y0 = std::max(0, (int)std::floor(minY) - 1);
+	int x1 = std::min((int)width - 1, (int)std::floor(maxX) + 1);
+	int y1 = std::min((int)height - 1, (int)std::floor(maxY) + 1);
+	if (x0 > x1 || y0 > y1)
+		return true; // Off screen, frustum culling's call
+
+	for (int by = y0 / (int)BlockSize; by <= y1 / (int)BlockSize; by++)
+	{
+		for (int bx = x0 / (int)BlockSize; bx <= x1 / (int)BlockSize; bx++)
+		{
+			// Whole block is nearer than the box
+			if (nearestZ > blockMaxDepth[by * blocksX + bx])
+				continue;
+
+			int px0 = std::max(x0, bx * (int)BlockSize);
+			int px1 = std::min(x1, bx * (int)BlockSize + (int)BlockSize - 1);
+			int py0 = std::max(y0, by * (int)BlockSize);
+			int py1 = std::min(y1, by * (int)BlockSize + (int)BlockSize - 1);
+			for (int py = py0; py <= py1; py++)
+			{
+				const float* row = &depth[(size_t)py * paddedWidth];
+				for (int px = px0; px <= px1; px++)
+				{
+					if (nearestZ <= row[px])
+						return true;
+				}
+			}
+		}
+	}
+
+	occluded.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <atomic>
+#include <vector>
+
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// What the occlusion culler did this frame
+// --------------------------------------------------------
+struct OcclusionStats
+{
+	unsigned int Occluders = 0;
+	unsigned int OccluderTriangles = 0;	// Left after clipping and culling
+	unsigned int Tested = 0;
+	unsigned int Occluded = 0;
+	double RasterMs = 0.0;				// Drawing occluders + building the hierarchy
+};
+
+// --------------------------------------------------------
+// CPU occlusion culling against a small depth buffer.
+//
+// A few big occluders are drawn each frame into a low
+// resolution depth buffer (SSE, in parallel 8 row bands),
+// which also keeps the farthest depth of every 8x8 block.
+// Bounds are then tested block first, pixel second.
+//
+// Occluders write the farthest depth inside each pixel and
+// tests look one pixel past the bounds, so anything that
+// is reported as hidden really is hidden.
+//
+// Usage each frame:
+//   BeginFrame() -> AddOccluder() ... -> RasterizeOccluders()
+//   -> IsVisible() (safe to call from several threads)
+// --------------------------------------------------------
+class OcclusionCuller
+{
+public:
+	static constexpr unsigned int BlockSize = 8;
+
+	OcclusionCuller(unsigned int width, unsigned int height);
+
+	void Resize(unsigned int width, unsigned int height);
+
+	// Building the buffer
+	void BeginFrame(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection);
+	void AddOccluder(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const DirectX::XMFLOAT4X4& world);
+	void RasterizeOccluders();
+
+	// Testing
+	bool IsVisible(const DirectX::BoundingBox& worldBounds) const;
+
+	// Getters
+	unsigned int GetWidth() const;
+	unsigned int GetHeight() const;
+	const std::vector<float>& GetDepth() const; // Padded rows, see GetPaddedWidth()
+	unsigned int GetPaddedWidth() const;
+	OcclusionStats GetStats() const;
+
+private:
+	// Screen space occluder triangle
+	struct OccluderTriangle
+	{
+		float EdgeA[3], EdgeB[3], EdgeC[3];	// Inside when all three are >= 0
+		float DepthA, DepthB, DepthC;		// z = A*x + B*y + C
+		int MinX, MinY, MaxX, MaxY;			// Pixel centers inside the bounds
+	};
+
+	unsigned int width;
+	unsigned int height;
+	unsigned int paddedWidth;	// Multiple of BlockSize
+	unsigned int paddedHeight;
+	unsigned int blocksX;
+
+	DirectX::XMFLOAT4X4 viewProjection;
+	std::vector<OccluderTriangle> triangles;
+	std::vector<float> depth;
+	std::vector<float> blockMaxDepth;
+
+	OcclusionStats stats;
+	mutable std::atomic<unsigned int> tested;
+	mutable std::atomic<unsigned int> occluded;
+
+	void AddTriangle(const DirectX::XMFLOAT4 clip[3]);
+	void RasterizeBand(unsigned int band);
+};
@@ -14,14 +14,28 @@ cbuffer ShaderData : register(b0)
     float3 cameraPos; //helps with specular + diffuse lighting
 
 	//light data
-    int numLights;
-
-	//light objects
-    Lights lights[MAX_LIGHTS];
+    uint3 lightCounts; //directional, point and spot lights in LightData (in that order)
+	
+	//material uses PackedMap instead of separate maps
+    int packedMaps;
+	
+	//image based lighting from the sky (see IBLBaker)
+    float4 irradianceSH[9];
+    int specularIBLMips;
+    float iblIntensity; //0 turns it off
 	
 	//scale of parallax effect
     int parallaxSamples;
     float parallaxScale;
+	
+	//which lights each pixel loops over: 0 every light, 1 its cluster's (see LightClusters), 2 the entity's own list (see EntityLightLists)
+    int lightCulling;
+    int numGlobalLights; //directional lights at the start of ClusterLightIndices
+    uint3 clusterCounts; //tiles across, tiles down, depth slices
+    float4 clusterParams; //tiles per pixel (x and y), depth scale, depth bias
+    float4 viewDepthRow; //dot with a world position for its view depth
+    int entityLightCount;
+    uint4 entityLightIndices[MAX_ENTITY_LIGHTS / 4]; //point and spot lights in LightData, four to an element
 };
 
 Texture2D Albedo : register(t0); //whiteness map (surface texture)
@@ -31,6 +45,12 @@ Texture2D MetalnessMap : register(t3); //metalness map (0 or 1)
 Texture2D HeightMap : register(t4); // height map (0-1)
 
 Texture2D ShadowMap : register(t5);
+Texture2D PackedMap : register(t6); //roughness in r, metalness in g and height in b (see TextureLoader::AddPacked)
+TextureCube SpecularIBL : register(t7); //prefiltered sky, roughness by mip
+Texture2D BrdfLUT : register(t8); //split sum scale and bias
+StructuredBuffer<uint2> ClusterRanges : register(t9); //offset and count into ClusterLightIndices, per cluster
+StructuredBuffer<uint> ClusterLightIndices : register(t10); //into LightData
+StructuredBuffer<PackedLight> LightData : register(t11); //every light, packed once per frame (see LightPacker)
 
 SamplerState BasicSampler : register(s0); //"s" registers for samplers
 SamplerComparisonState ShadowSampler : register(s1); //comparison sampler
@@ -57,7 +77,10 @@ float4 main(VertexToNormalMapPS input) : SV_TARGET
     float3 view = normalize(cameraPos - input.worldPos);
     float3x3 tbn = CreateTBN(input.normal, input.tangent);
 	
-    input.uv = GetParallaxUV(HeightMap, BasicSampler, input.uv, view, tbn, 10, parallaxScale);
+    if (packedMaps)
+        input.uv = GetParallaxUV(PackedMap, BasicSampler, input.uv, view, tbn, 10, parallaxScale, 2);
+    else
+        input.uv = GetParallaxUV(HeightMap, BasicSampler, input.uv, view, tbn, 10, parallaxScale);
 	
 
 	//normalize input normal
@@ -73,11 +96,23 @@ float4 main(VertexToNormalMapPS input) : SV_TARGET
 	//use pow for "unpacking" gamma correction
     float3 color = pow(Albedo.Sample(BasicSampler, input.uv).rgb, 2.2f); //swizzle using logical indices
 	
-	//detemrined by a single float, simply sample the red channel
-    float roughnessFromMap = RoughnessMap.Sample(BasicSampler, input.uv).r;
-	
-	//also a single float
-    float metalness = MetalnessMap.Sample(BasicSampler, input.uv).r;
+    float roughnessFromMap;
+    float metalness;
+    if (packedMaps)
+    {
+		//one sample for both
+        float2 packed = PackedMap.Sample(BasicSampler, input.uv).rg;
+        roughnessFromMap = packed.r;
+        metalness = packed.g;
+    }
+    else
+    {
+		//detemrined by a single float, simply sample the red channel
+        roughnessFromMap = RoughnessMap.Sample(BasicSampler, input.uv).r;
+	
+		//also a single float
+        metalness = MetalnessMap.Sample(BasicSampler, input.uv).r;
+    }
 	
 	//now, a specular color is needed
 	//metals generally tint reflections, while nonmetals generally have
@@ -105,7 +140,24 @@ float4 main(VertexToNormalMapPS input) : SV_TARGET
     float3 surfaceToCamera = normalize(cameraPos - input.worldPos);
 	
 	//apply the total lighting
-    totalLight += CalculateTotalLightPBR(numLights, lights, input.normal, surfaceToCamera, input.worldPos, roughnessFromMap, metalness, color, specularColor, shadowAmount);
+    if (lightCulling == 1)
+    {
+        uint cluster = ClusterIndex(input.screenPosition.xy, dot(float4(input.worldPos, 1.0f), viewDepthRow), clusterCounts, clusterParams);
+        totalLight += CalculateClusteredLightPBR(cluster, numGlobalLights, ClusterRanges, ClusterLightIndices, LightData, input.normal, surfaceToCamera, input.worldPos, roughnessFromMap, metalness, color, specularColor, shadowAmount);
+    }
+    else if (lightCulling == 2)
+    {
+        totalLight += CalculateListedLightPBR(lightCounts.x, entityLightCount, entityLightIndices, LightData, input.normal, surfaceToCamera, input.worldPos, roughnessFromMap, metalness, color, specularColor, shadowAmount);
+    }
+    else
+    {
+        totalLight += CalculateTotalLightPBR(lightCounts, LightData, input.normal, surfaceToCamera, input.worldPos, roughnessFromMap, metalness, color, specularColor, shadowAmount);
+    }
+	
+	//ambient from the sky: irradiance for diffuse (metals have none), prefiltered reflections for specular
+    float3 ambientDiffuse = IrradianceFromSH(irradianceSH, input.normal) * color * (1.0f - metalness);
+    float3 ambientSpecular = SpecularFromSky(SpecularIBL, BrdfLUT, BasicSampler, input.normal, surfaceToCamera, roughnessFromMap, specularColor, specularIBLMips);
+    totalLight += (ambientDiffuse + ambientSpecular) * iblIntensity;
 	
 	//return modified color
     return float4(GammaCorrect(totalLight), 1);
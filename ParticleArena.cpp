@@ -0,0 +1,362 @@
+#include "ParticleArena.h"
+#include "Emitter.h"
+#include "Graphics.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <map>
+
+using namespace DirectX;
+
+ParticleArena::ParticleArena(unsigned int initialCapacity) :
+	batching(true),
+	particleBufferCapacity(0),
+	emitterBufferCapacity(0),
+	drawRangeBufferCapacity(0),
+	sortedBufferCapacity(0)
+{
+	initialCapacity = max(initialCapacity, 1u);
+	particles.resize(initialCapacity);
+	freeRanges.push_back({ 0, initialCapacity });
+	stats.Capacity = initialCapacity;
+}
+
+// --------------------------------------------------------
+// First fit.  When nothing fits the array grows (at least
+// doubling) and the new space joins the free list.
+// --------------------------------------------------------
+ParticleArenaRange ParticleArena::Allocate(unsigned int count)
+{
+	count = max(count, 1u);
+
+	auto fit = std::find_if(freeRanges.begin(), freeRanges.end(),
+		[count](const ParticleArenaRange& range) { return range.Count >= count; });
+	if (fit == freeRanges.end())
+	{
+		unsigned int oldCapacity = (unsigned int)particles.size();
+		unsigned int newCapacity = max(oldCapacity * 2, oldCapacity + count);
+		particles.resize(newCapacity);
+		stats.Capacity = newCapacity;
+
+		if (!freeRanges.empty() && freeRanges.back().Start + freeRanges.back().Count == oldCapacity)
+			freeRanges.back().Count += newCapacity - oldCapacity;
+		else
+			freeRanges.push_back({ oldCapacity, newCapacity - oldCapacity });
+		fit = freeRanges.end() - 1;
+	}
+
+	ParticleArenaRange range = { fit->Start, count };
+	fit->Start += count;
+	fit->Count -= count;
+	if (fit->Count == 0)
+		freeRanges.erase(fit);
+
+	ZeroMemory(&particles[range.Start], sizeof(Particle) * count);
+	return range;
+}
+
+void ParticleArena::Free(ParticleArenaRange range)
+{
+	if (range.Count == 0)
+		return;
+
+	// Insert in order, then merge with the neighbors it touches
+	auto next = std::lower_bound(freeRanges.begin(), freeRanges.end(), range,
+		[](const ParticleArenaRange& a, const ParticleArenaRange& b) { return a.Start < b.Start; });
+	auto it = freeRanges.insert(next, range);
+
+	if (it + 1 != freeRanges.end() && it->Start + it->Count == (it + 1)->Start)
+	{
+		it->Count += (it + 1)->Count;
+		freeRanges.erase(it + 1);
+	}
+	if (it != freeRanges.begin() && (it - 1)->Start + (it - 1)->Count == it->Start)
+	{
+		(it - 1)->Count += it->Count;
+		freeRanges.erase(it);
+	}
+}
+
+Particle* ParticleArena::GetParticles()
+{
+	return particles.data();
+}
+
+unsigned int ParticleArena::AddEmitter()
+{
+	if (!freeEmitterRows.empty())
+	{
+		unsigned int row = freeEmitterRows.back();
+		freeEmitterRows.pop_back();
+		return row;
+	}
+
+	emitterTable.push_back({});
+	return (unsigned int)emitterTable.size() - 1;
+}
+
+void ParticleArena::RemoveEmitter(unsigned int emitterIndex)
+{
+	freeEmitterRows.push_back(emitterIndex);
+}
+
+void ParticleArena::UploadParticles(unsigned int first, unsigned int count)
+{
+	// A new (bigger) buffer gets everything on the next Draw() anyway
+	if (count == 0 || !particleBuffer || particleBufferCapacity != particles.size())
+		return;
+
+	Graphics::Renderer->UpdateBuffer(
+		particleBuffer.Get(),
+		sizeof(Particle) * first,	// Offset (in BYTES!)
+		&particles[first],
+		sizeof(Particle) * count);
+}
+
+void ParticleArena::SetBlendStates(ID3D11BlendState* additive, ID3D11BlendState* alphaBlend)
+{
+	additiveBlendState = additive;
+	alphaBlendState = alphaBlend;
+}
+
+// --------------------------------------------------------
+// Per frame: emitters upload their new particles and fill
+// their table rows, compatible emitters are grouped, and
+// each group is one draw of (particles in group * 6) verts
+// --------------------------------------------------------
+void ParticleArena::Draw(
+	const std::vector<std::shared_ptr<Emitter>>& emitters,
+	std::shared_ptr<Camera> camera,
+	bool debugWireframe)
+{
+	PROFILE_SCOPE("ParticleArena::Draw");
+
+	unsigned int capacity = (unsigned int)particles.size();
+	stats = {};
+	stats.Capacity = capacity;
+
+	// The particle buffer follows the array's size, and a new one
+	// starts with everything (emitters then only send what changed)
+	if (particleBufferCapacity != capacity)
+	{
+		CreateStructuredBuffer(sizeof(Particle), capacity, false, particleBuffer, particleSRV);
+		particleBufferCapacity = capacity;
+		UploadParticles(0, capacity);
+	}
+
+	// Group by material and blend mode (first come first served, so the
+	// order is stable), alpha blended groups first
+	std::vector<DrawGroup> groups;
+	std::map<std::pair<Material*, bool>, size_t> groupOfKind;
+	for (int sorted = 1; sorted >= 0; sorted--)
+	{
+		for (auto& emitter : emitters)
+		{
+			if (!emitter->visible || emitter->IsCulled() || emitter->GetLivingParticleCount() == 0 || emitter->alphaBlend != (sorted == 1))
+				continue;
+
+			unsigned int row = emitter->GetArenaEmitterIndex();
+			emitter->PrepareForDraw(emitterTable[row]);
+			stats.Emitters++;
+
+			std::pair<Material*, bool> kind(emitter->GetMaterial().get(), sorted == 1);
+			auto found = groupOfKind.find(kind);
+			if (!batching || found == groupOfKind.end())
+			{
+				groupOfKind[kind] = groups.size();
+				groups.push_back({});
+				groups.back().Sorted = sorted == 1;
+				groups.back().Emitters.push_back(emitter.get());
+			}
+			else
+			{
+				groups[found->second].Emitters.push_back(emitter.get());
+			}
+		}
+	}
+	if (groups.empty())
+		return;
+
+	// Draw ranges for every group, back to back
+	drawRanges.clear();
+	unsigned int sortedCount = 0;
+	for (DrawGroup& group : groups)
+	{
+		group.FirstRange = (unsigned int)drawRanges.size();
+		for (Emitter* emitter : group.Emitters)
+		{
+			drawRanges.push_back({ group.ParticleCount, emitter->GetArenaEmitterIndex() });
+			group.ParticleCount += emitter->GetLivingParticleCount();
+		}
+
+		if (group.Sorted)
+		{
+			group.FirstSorted = sortedCount;
+			sortedCount += group.ParticleCount;
+		}
+	}
+
+	// Back to front order for the alpha blended groups
+	if (sortedCount > 0)
+	{
+		uint64_t sortStart = Profiler::Now();
+		sortKeys.resize(sortedCount);
+		sortedParticles.resize(sortedCount);
+
+		XMFLOAT4X4 view = camera->GetView();
+		for (DrawGroup& group : groups)
+		{
+			if (group.Sorted)
+				SortGroup(group, view);
+		}
+
+		stats.ParticlesSorted = sortedCount;
+		stats.SortMs = Profiler::TicksToMilliseconds(Profiler::Now() - sortStart);
+	}
+
+	// These tables are small (one row per emitter) or only hold indices,
+	// so they're rewritten every frame
+	if (emitterBufferCapacity < emitterTable.size())
+	{
+		emitterBufferCapacity = max((unsigned int)emitterTable.size(), emitterBufferCapacity * 2);
+		CreateStructuredBuffer(sizeof(ParticleEmitterData), emitterBufferCapacity, true, emitterBuffer, emitterSRV);
+	}
+	if (drawRangeBufferCapacity < drawRanges.size())
+	{
+		drawRangeBufferCapacity = max((unsigned int)drawRanges.size(), drawRangeBufferCapacity * 2);
+		CreateStructuredBuffer(sizeof(DrawRange), drawRangeBufferCapacity, true, drawRangeBuffer, drawRangeSRV);
+	}
+	if (sortedBufferCapacity < max(sortedCount, 1u))
+	{
+		sortedBufferCapacity = max(max(sortedCount, 1u), sortedBufferCapacity * 2);
+		CreateStructuredBuffer(sizeof(uint32_t), sortedBufferCapacity, true, sortedBuffer, sortedSRV);
+	}
+	Graphics::Renderer->UploadDynamicBuffer(emitterBuffer.Get(), emitterTable.data(), sizeof(ParticleEmitterData) * emitterTable.size());
+	Graphics::Renderer->UploadDynamicBuffer(drawRangeBuffer.Get(), drawRanges.data(), sizeof(DrawRange) * drawRanges.size());
+	if (sortedCount > 0)
+		Graphics::Renderer->UploadDynamicBuffer(sortedBuffer.Get(), sortedParticles.data(), sizeof(uint32_t) * sortedCount);
+
+	// No vertex or index buffers - quads are made from SV_VertexID
+	Graphics::Renderer->SetVertexBuffer(0, 0);
+	Graphics::Renderer->SetIndexBuffer(0);
+
+	for (DrawGroup& group : groups)
+	{
+		Graphics::Renderer->SetBlendState(group.Sorted ? alphaBlendState.Get() : additiveBlendState.Get());
+
+		std::shared_ptr<Material> material = group.Emitters[0]->GetMaterial();
+		material->PrepareMaterial(transform, camera);
+
+		std::shared_ptr<SimpleVertexShader> vs = material->GetVertexShader();
+		vs->SetMatrix4x4("view", camera->GetView());
+		vs->SetMatrix4x4("projection", camera->GetProjection());
+		vs->SetInt("firstDrawRange", group.FirstRange);
+		vs->SetInt("drawRangeCount", (int)group.Emitters.size());
+		vs->SetInt("sorted", group.Sorted);
+		vs->SetInt("firstSorted", group.FirstSorted);
+		vs->CopyAllBufferData();
+
+		vs->SetShaderResourceView("ParticleData", particleSRV);
+		vs->SetShaderResourceView("EmitterData", emitterSRV);
+		vs->SetShaderResourceView("DrawRanges", drawRangeSRV);
+		vs->SetShaderResourceView("SortedParticles", sortedSRV);
+
+		std::shared_ptr<SimplePixelShader> ps = material->GetPixelShader();
+		ps->SetInt("debugWireframe", debugWireframe);
+		ps->CopyAllBufferData();
+
+		// Each particle = 6 vertices (two triangles)
+		Graphics::Renderer->Draw(group.ParticleCount * 6);
+		stats.DrawCalls++;
+		stats.ParticlesDrawn += group.ParticleCount;
+	}
+}
+
+// --------------------------------------------------------
+// Works out each particle's view depth where the vertex
+// shader will put it this frame, then radix sorts the
+// group's particle indices farthest first
+// --------------------------------------------------------
+void ParticleArena::SortGroup(DrawGroup& group, const XMFLOAT4X4& view)
+{
+	PROFILE_SCOPE("ParticleArena::SortGroup");
+
+	uint32_t* keys = &sortKeys[group.FirstSorted];
+	uint32_t* values = &sortedParticles[group.FirstSorted];
+
+	unsigned int offset = 0;
+	for (Emitter* emitter : group.Emitters)
+	{
+		const ParticleEmitterData& e = emitterTable[emitter->GetArenaEmitterIndex()];
+		unsigned int living = emitter->GetLivingParticleCount();
+
+		JobSystem::ParallelFor(living, [&, offset](unsigned int begin, unsigned int end) {
+			for (unsigned int i = begin; i < end; i++)
+			{
+				unsigned int slot = e.RangeStart + (e.FirstAlive + i) % e.RangeSize;
+				const Particle& p = particles[slot];
+
+				// Same motion as ParticleVS
+				float age = e.CurrentTime - p.EmitTime;
+				float halfAgeSquared = 0.5f * age * age;
+				float x = p.StartPosition.x + p.StartVelocity.x * age + e.Acceleration.x * halfAgeSquared;
+				float y = p.StartPosition.y + p.StartVelocity.y * age + e.Acceleration.y * halfAgeSquared;
+				float z = p.StartPosition.z + p.StartVelocity.z * age + e.Acceleration.z * halfAgeSquared;
+				float viewZ = x * view._13 + y * view._23 + z * view._33 + view._43;
+
+				// Smallest key first, so farthest (largest view z) gets the smallest key
+				keys[offset + i] = RadixSorter::FloatToKey(-viewZ);
+				values[offset + i] = slot;
+			}
+		}, 8192);
+
+		offset += living;
+	}
+
+	sorter.Sort(keys, values, group.ParticleCount);
+}
+
+bool ParticleArena::IsBatching()
+{
+	return batching;
+}
+
+void ParticleArena::SetBatching(bool batching)
+{
+	this->batching = batching;
+}
+
+const ParticleArenaStats& ParticleArena::GetStats()
+{
+	return stats;
+}
+
+void ParticleArena::CreateStructuredBuffer(
+	unsigned int stride,
+	unsigned int count,
+	bool dynamic,
+	Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer,
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv)
+{
+	buffer.Reset();
+	srv.Reset();
+
+	// Dynamic ones are rewritten with WRITE_DISCARD, the particle
+	// buffer is updated in pieces (UpdateSubresource)
+	D3D11_BUFFER_DESC desc = {};
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.CPUAccessFlags = dynamic ? D3D11_CPU_ACCESS_WRITE : 0;
+	desc.Usage = dynamic ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_DEFAULT;
+	desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	desc.StructureByteStride = stride;
+	desc.ByteWidth = stride * count;
+	Graphics::Device->CreateBuffer(&desc, 0, buffer.GetAddressOf());
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+	srvDesc.Buffer.FirstElement = 0;
+	srvDesc.Buffer.NumElements = count;
+	Graphics::Device->CreateShaderResourceView(buffer.Get(), &srvDesc, srv.GetAddressOf());
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <d3d11.h>
+#include <DirectXMath.h>
+#include <wrl/client.h>
+#include <memory>
+#include <vector>
+
+#include "Camera.h"
+#include "Transform.h"
+#include "ParticleSpawner.h"
+#include "RadixSort.h"
+
+class Emitter;
+
+// --------------------------------------------------------
+// One row of the emitter table (EmitterData in ParticleVS):
+// everything the same for all of one emitter's particles
+// --------------------------------------------------------
+struct ParticleEmitterData
+{
+	DirectX::XMFLOAT4 StartColor;
+	DirectX::XMFLOAT4 EndColor;
+
+	DirectX::XMFLOAT3 Acceleration;
+	float CurrentTime;
+
+	float Lifetime;
+	float StartSize;
+	float EndSize;
+	int ConstrainYAxis;
+
+	int SpriteSheetWidth;
+	int SpriteSheetHeight;
+	float SpriteSheetFrameWidth;
+	float SpriteSheetFrameHeight;
+
+	float SpriteSheetSpeedScale;
+	unsigned int RangeStart;	// The emitter's ring in the arena
+	unsigned int RangeSize;
+	unsigned int FirstAlive;
+};
+
+// Where in the arena an emitter's particles live
+struct ParticleArenaRange
+{
+	unsigned int Start = 0;
+	unsigned int Count = 0;
+};
+
+// --------------------------------------------------------
+// What the last Draw() did
+// --------------------------------------------------------
+struct ParticleArenaStats
+{
+	unsigned int Emitters = 0;		// Visible, with living particles
+	unsigned int DrawCalls = 0;
+	unsigned int ParticlesDrawn = 0;
+	unsigned int ParticlesSorted = 0;	// Alpha blended, back to front
+	double SortMs = 0.0;				// Depths + radix sort
+	unsigned int Capacity = 0;		// Particles the arena can hold
+};
+
+// --------------------------------------------------------
+// Shared storage for the particles of every emitter.
+//
+// Each emitter gets a sub-range of one big particle array
+// (mirrored in one GPU buffer) and a row in an emitter
+// table.  Particles store their emitter's row, so all
+// emitters using the same material are drawn with a
+// single draw call: ParticleVS finds each particle through
+// a small per-frame table of draw ranges and builds its
+// quad from SV_VertexID (no index buffer).
+//
+// Alpha blended emitters are drawn first, in their own
+// groups: every frame their particles are radix sorted by
+// view depth and the draw reads them through a list of
+// particle indices, farthest first.
+// --------------------------------------------------------
+class ParticleArena
+{
+public:
+	ParticleArena(unsigned int initialCapacity = 4096);
+
+	// Sub-ranges of the particle array.  Growing the arena moves
+	// the array, so don't hold on to GetParticles() across these.
+	ParticleArenaRange Allocate(unsigned int count);
+	void Free(ParticleArenaRange range);
+	Particle* GetParticles();
+
+	// Rows of the emitter table
+	unsigned int AddEmitter();
+	void RemoveEmitter(unsigned int emitterIndex);
+
+	// Copies particles [first, first + count) of the array to the GPU
+	void UploadParticles(unsigned int first, unsigned int count);
+
+	// Blend states for the two kinds of emitter (null = opaque)
+	void SetBlendStates(ID3D11BlendState* additive, ID3D11BlendState* alphaBlend);
+
+	// Draws every visible emitter, one draw per material and
+	// blend mode (or one per emitter with batching turned off)
+	void Draw(
+		const std::vector<std::shared_ptr<Emitter>>& emitters,
+		std::shared_ptr<Camera> camera,
+		bool debugWireframe);
+
+	bool IsBatching();
+	void SetBatching(bool batching);
+	const ParticleArenaStats& GetStats();
+
+private:
+	// Drawn particles [FirstDrawn, next range's FirstDrawn) belong to one emitter
+	struct DrawRange
+	{
+		unsigned int FirstDrawn;
+		unsigned int EmitterIndex;
+	};
+
+	// Emitters drawn together
+	struct DrawGroup
+	{
+		std::vector<Emitter*> Emitters;
+		bool Sorted = false;
+		unsigned int FirstRange = 0;
+		unsigned int FirstSorted = 0;
+		unsigned int ParticleCount = 0;
+	};
+
+	std::vector<Particle> particles;
+	std::vector<ParticleArenaRange> freeRanges;	// Sorted by start, never touching
+	std::vector<ParticleEmitterData> emitterTable;
+	std::vector<unsigned int> freeEmitterRows;
+	std::vector<DrawRange> drawRanges;
+	std::vector<uint32_t> sortKeys;
+	std::vector<uint32_t> sortedParticles;
+	RadixSorter sorter;
+	Microsoft::WRL::ComPtr<ID3D11BlendState> additiveBlendState;
+	Microsoft::WRL::ComPtr<ID3D11BlendState> alphaBlendState;
+	bool batching;
+	ParticleArenaStats stats;
+	Transform transform;	// Particles are already in world space
+
+	// GPU copies (recreated when they need to grow)
+	Microsoft::WRL::ComPtr<ID3D11Buffer> particleBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> particleSRV;
+	unsigned int particleBufferCapacity;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> emitterBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> emitterSRV;
+	unsigned int emitterBufferCapacity;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> drawRangeBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> drawRangeSRV;
+	unsigned int drawRangeBufferCapacity;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> sortedBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> sortedSRV;
+	unsigned int sortedBufferCapacity;
+
+	void SortGroup(DrawGroup& group, const DirectX::XMFLOAT4X4& view);
+
+	void CreateStructuredBuffer(
+		unsigned int stride,
+		unsigned int count,
+		bool dynamic,
+		Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer,
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv);
+};
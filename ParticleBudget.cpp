@@ -0,0 +1,78 @@
+#include "ParticleBudget.h"
+#include "Emitter.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+ParticleBudget::ParticleBudget(unsigned int maxParticles) :
+	fullDetailCoverage(0.25f),
+	culledDetail(0.25f),
+	maxParticles(maxParticles)
+{
+}
+
+void ParticleBudget::Update(const std::vector<std::shared_ptr<Emitter>>& emitters, std::shared_ptr<Camera> camera)
+{
+	PROFILE_SCOPE("ParticleBudget::Update");
+
+	XMVECTOR planes[6];
+	camera->GetFrustumPlanes(planes);
+	XMFLOAT3 position = camera->GetTransform().GetPosition();
+	XMVECTOR cameraPosition = XMLoadFloat3(&position);
+	float tanHalfFov = tanf(camera->GetFOV() * 0.5f);
+
+	stats = {};
+	stats.Emitters = (unsigned int)emitters.size();
+	detail.resize(emitters.size());
+
+	// Level of detail from how much of the screen each emitter can cover
+	float wanted = 0.0f;
+	for (size_t i = 0; i < emitters.size(); i++)
+	{
+		Emitter* emitter = emitters[i].get();
+		BoundingBox bounds = emitter->GetWorldBounds();
+
+		bool culled = !emitter->visible ||
+			bounds.ContainedBy(planes[0], planes[1], planes[2], planes[3], planes[4], planes[5]) == DISJOINT;
+		emitter->SetCulled(culled);
+		stats.Culled += culled;
+
+		// Bounding sphere's height on screen (the camera inside it = all of it)
+		float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Extents)));
+		float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Center) - cameraPosition));
+		float coverage = distance > radius ? radius / ((distance - radius) * tanHalfFov) : 1.0f;
+
+		detail[i] = (std::min)(coverage / fullDetailCoverage, 1.0f);
+		if (culled)
+			detail[i] *= culledDetail;
+
+		stats.Requested += emitter->GetMaxParticles();
+		wanted += emitter->GetMaxParticles() * detail[i];
+	}
+
+	// Same cut for everyone when that's still too many
+	stats.BudgetScale = wanted > maxParticles ? maxParticles / wanted : 1.0f;
+	for (size_t i = 0; i < emitters.size(); i++)
+	{
+		emitters[i]->SetEmissionScale(detail[i] * stats.BudgetScale);
+		stats.Allowed += (unsigned int)(emitters[i]->GetMaxParticles() * emitters[i]->GetEmissionScale());
+	}
+}
+
+unsigned int ParticleBudget::GetMaxParticles()
+{
+	return maxParticles;
+}
+
+void ParticleBudget::SetMaxParticles(unsigned int maxParticles)
+{
+	this->maxParticles = maxParticles;
+}
+
+const ParticleBudgetStats& ParticleBudget::GetStats()
+{
+	return stats;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <memory>
+#include <vector>
+
+#include "Camera.h"
+
+class Emitter;
+
+// --------------------------------------------------------
+// What the particle budget did this frame
+// --------------------------------------------------------
+struct ParticleBudgetStats
+{
+	unsigned int Emitters = 0;
+	unsigned int Culled = 0;		// Outside the frustum (or hidden)
+	unsigned int Requested = 0;		// Particles wanted at full detail
+	unsigned int Allowed = 0;		// After distance LOD and the budget
+	float BudgetScale = 1.0f;		// How much everything was scaled to fit
+};
+
+// --------------------------------------------------------
+// Keeps every emitter together under one particle budget.
+//
+// Each frame an emitter's world bounds are tested against
+// the camera's frustum (culled emitters keep simulating
+// but aren't uploaded or drawn) and measured on screen.
+// Emitters covering less than fullDetailCoverage of the
+// screen's height get a matching fraction of their rate
+// and max particles, culled ones a culledDetail fraction
+// on top of that (so they aren't empty when they come
+// back), and if the total is still over budget every
+// emitter is scaled down by the same amount.
+// --------------------------------------------------------
+class ParticleBudget
+{
+public:
+	ParticleBudget(unsigned int maxParticles = 20000);
+
+	// Culls and sets every emitter's emission scale (before emitters update)
+	void Update(const std::vector<std::shared_ptr<Emitter>>& emitters, std::shared_ptr<Camera> camera);
+
+	unsigned int GetMaxParticles();
+	void SetMaxParticles(unsigned int maxParticles);
+	const ParticleBudgetStats& GetStats();
+
+	float fullDetailCoverage;	// Fraction of the screen height
+	float culledDetail;
+
+private:
+	unsigned int maxParticles;
+	ParticleBudgetStats stats;
+	std::vector<float> detail;	// Per emitter, before fitting the budget
+};
@@ -0,0 +1,199 @@
+#include "ParticleSimulation.h"
+#include "CpuFeatures.h"
+
+#include <algorithm>
+#include <cmath>
+#include <immintrin.h>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	constexpr float PI = 3.14159265359f;
+	constexpr float TWO_PI = 6.28318530718f;
+
+	// --------------------------------------------------------
+	// sin() that both paths compute the same way: wrap to
+	// [-pi, pi], fold to [-pi/2, pi/2], then a 7th order
+	// polynomial (error < 0.0002, plenty for turbulence)
+	// --------------------------------------------------------
+	float FastSin(float x)
+	{
+		x -= std::nearbyint(x * (1.0f / TWO_PI)) * TWO_PI;
+		float folded = std::min(std::abs(x), PI - std::abs(x));
+		x = std::copysign(folded, x);
+		float x2 = x * x;
+		return x * (1.0f + x2 * (-1.0f / 6.0f + x2 * (1.0f / 120.0f + x2 * (-1.0f / 5040.0f))));
+	}
+
+	CPU_TARGET_AVX2_FMA __m256 FastSin(__m256 x)
+	{
+		const __m256 signMask = _mm256_set1_ps(-0.0f);
+		__m256 wraps = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.0f / TWO_PI)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		x = _mm256_fnmadd_ps(wraps, _mm256_set1_ps(TWO_PI), x);
+
+		__m256 sign = _mm256_and_ps(x, signMask);
+		__m256 absX = _mm256_andnot_ps(signMask, x);
+		x = _mm256_or_ps(_mm256_min_ps(absX, _mm256_sub_ps(_mm256_set1_ps(PI), absX)), sign);
+
+		__m256 x2 = _mm256_mul_ps(x, x);
+		__m256 poly = _mm256_fmadd_ps(x2, _mm256_set1_ps(-1.0f / 5040.0f), _mm256_set1_ps(1.0f / 120.0f));
+		poly = _mm256_fmadd_ps(x2, poly, _mm256_set1_ps(-1.0f / 6.0f));
+		poly = _mm256_fmadd_ps(x2, poly, _mm256_set1_ps(1.0f));
+		return _mm256_mul_ps(x, poly);
+	}
+}
+
+void ParticleSoA::Resize(unsigned int capacity)
+{
+	for (std::vector<float>* component : { &PositionX, &PositionY, &PositionZ, &VelocityX, &VelocityY, &VelocityZ, &Rotation, &RotationSpeed })
+		component->assign(capacity, 0.0f);
+}
+
+unsigned int ParticleSoA::Capacity() const
+{
+	return (unsigned int)PositionX.size();
+}
+
+void ParticleSimulation::Integrate(ParticleSoA& particles, unsigned int begin, unsigned int end, float dt, float time, const ParticleForces& forces)
+{
+	if (CpuFeatures::HasAVX2())
+		IntegrateAVX2(particles, begin, end, dt, time, forces);
+	else
+		IntegrateScalar(particles, begin, end, dt, time, forces);
+}
+
+// --------------------------------------------------------
+// Reference version, one particle at a time
+// --------------------------------------------------------
+void ParticleSimulation::IntegrateScalar(ParticleSoA& particles, unsigned int begin, unsigned int end, float dt, float time, const ParticleForces& forces)
+{
+	const float dragFactor = std::exp(-forces.Drag * dt);
+	const float turbulence = forces.TurbulenceStrength * 0.5f;
+	const float frequency = forces.TurbulenceFrequency;
+	const float keepHorizontal = 1.0f - forces.FloorFriction;
+
+	float* px = particles.PositionX.data();
+	float* py = particles.PositionY.data();
+	float* pz = particles.PositionZ.data();
+	float* vx = particles.VelocityX.data();
+	float* vy = particles.VelocityY.data();
+	float* vz = particles.VelocityZ.data();
+	float* rotation = particles.Rotation.data();
+	const float* rotationSpeed = particles.RotationSpeed.data();
+
+	for (unsigned int i = begin; i < end; i++)
+	{
+		float ax = forces.Acceleration.x;
+		float ay = forces.Acceleration.y;
+		float az = forces.Acceleration.z;
+
+		// Two waves per axis, each driven by the other axes, so
+		// neighbors drift together but the field never repeats quickly
+		if (turbulence != 0.0f)
+		{
+			ax += turbulence * (FastSin(pz[i] * frequency + time) + FastSin(py[i] * frequency * 1.7f + time * 1.3f));
+			ay += turbulence * (FastSin(px[i] * frequency + time * 1.1f) + FastSin(pz[i] * frequency * 1.3f + time * 0.7f));
+			az += turbulence * (FastSin(py[i] * frequency + time * 0.9f) + FastSin(px[i] * frequency * 1.9f + time * 1.7f));
+		}
+
+		vx[i] = (vx[i] + ax * dt) * dragFactor;
+		vy[i] = (vy[i] + ay * dt) * dragFactor;
+		vz[i] = (vz[i] + az * dt) * dragFactor;
+
+		px[i] += vx[i] * dt;
+		py[i] += vy[i] * dt;
+		pz[i] += vz[i] * dt;
+
+		// Push back up, bounce if moving down and rub off some sideways speed
+		if (forces.FloorCollision && py[i] < forces.FloorHeight)
+		{
+			py[i] = forces.FloorHeight;
+			vy[i] = std::max(vy[i], -forces.Bounciness * vy[i]);
+			vx[i] *= keepHorizontal;
+			vz[i] *= keepHorizontal;
+		}
+
+		rotation[i] += rotationSpeed[i] * dt;
+	}
+}
+
+// --------------------------------------------------------
+// Same math as IntegrateScalar, 8 particles at a time.
+// The leftover (< 8) particles go through the scalar path.
+// --------------------------------------------------------
+CPU_TARGET_AVX2_FMA void ParticleSimulation::IntegrateAVX2(ParticleSoA& particles, unsigned int begin, unsigned int end, float dt, float time, const ParticleForces& forces)
+{
+	const __m256 dtV = _mm256_set1_ps(dt);
+	const __m256 dragFactor = _mm256_set1_ps(std::exp(-forces.Drag * dt));
+	const __m256 accelerationX = _mm256_set1_ps(forces.Acceleration.x);
+	const __m256 accelerationY = _mm256_set1_ps(forces.Acceleration.y);
+	const __m256 accelerationZ = _mm256_set1_ps(forces.Acceleration.z);
+	const float turbulence = forces.TurbulenceStrength * 0.5f;
+	const __m256 turbulenceV = _mm256_set1_ps(turbulence);
+	const float frequency = forces.TurbulenceFrequency;
+	const __m256 floorHeight = _mm256_set1_ps(forces.FloorHeight);
+	const __m256 negBounciness = _mm256_set1_ps(-forces.Bounciness);
+	const __m256 keepHorizontal = _mm256_set1_ps(1.0f - forces.FloorFriction);
+
+	// Frequency and time offsets for each wave (see IntegrateScalar)
+	const __m256 f1 = _mm256_set1_ps(frequency), f17 = _mm256_set1_ps(frequency * 1.7f);
+	const __m256 f13 = _mm256_set1_ps(frequency * 1.3f), f19 = _mm256_set1_ps(frequency * 1.9f);
+	const __m256 t10 = _mm256_set1_ps(time), t13 = _mm256_set1_ps(time * 1.3f);
+	const __m256 t11 = _mm256_set1_ps(time * 1.1f), t07 = _mm256_set1_ps(time * 0.7f);
+	const __m256 t09 = _mm256_set1_ps(time * 0.9f), t17 = _mm256_set1_ps(time * 1.7f);
+
+	float* px = particles.PositionX.data();
+	float* py = particles.PositionY.data();
+	float* pz = particles.PositionZ.data();
+	float* vx = particles.VelocityX.data();
+	float* vy = particles.VelocityY.data();
+	float* vz = particles.VelocityZ.data();
+	float* rotation = particles.Rotation.data();
+	const float* rotationSpeed = particles.RotationSpeed.data();
+
+	unsigned int i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(px + i);
+		__m256 y = _mm256_loadu_ps(py + i);
+		__m256 z = _mm256_loadu_ps(pz + i);
+
+		__m256 ax = accelerationX;
+		__m256 ay = accelerationY;
+		__m256 az = accelerationZ;
+		if (turbulence != 0.0f)
+		{
+			ax = _mm256_fmadd_ps(turbulenceV, _mm256_add_ps(FastSin(_mm256_fmadd_ps(z, f1, t10)), FastSin(_mm256_fmadd_ps(y, f17, t13))), ax);
+			ay = _mm256_fmadd_ps(turbulenceV, _mm256_add_ps(FastSin(_mm256_fmadd_ps(x, f1, t11)), FastSin(_mm256_fmadd_ps(z, f13, t07))), ay);
+			az = _mm256_fmadd_ps(turbulenceV, _mm256_add_ps(FastSin(_mm256_fmadd_ps(y, f1, t09)), FastSin(_mm256_fmadd_ps(x, f19, t17))), az);
+		}
+
+		__m256 velX = _mm256_mul_ps(_mm256_fmadd_ps(ax, dtV, _mm256_loadu_ps(vx + i)), dragFactor);
+		__m256 velY = _mm256_mul_ps(_mm256_fmadd_ps(ay, dtV, _mm256_loadu_ps(vy + i)), dragFactor);
+		__m256 velZ = _mm256_mul_ps(_mm256_fmadd_ps(az, dtV, _mm256_loadu_ps(vz + i)), dragFactor);
+
+		x = _mm256_fmadd_ps(velX, dtV, x);
+		y = _mm256_fmadd_ps(velY, dtV, y);
+		z = _mm256_fmadd_ps(velZ, dtV, z);
+
+		if (forces.FloorCollision)
+		{
+			__m256 below = _mm256_cmp_ps(y, floorHeight, _CMP_LT_OQ);
+			y = _mm256_blendv_ps(y, floorHeight, below);
+			velY = _mm256_blendv_ps(velY, _mm256_max_ps(velY, _mm256_mul_ps(negBounciness, velY)), below);
+			velX = _mm256_blendv_ps(velX, _mm256_mul_ps(velX, keepHorizontal), below);
+			velZ = _mm256_blendv_ps(velZ, _mm256_mul_ps(velZ, keepHorizontal), below);
+		}
+
+		_mm256_storeu_ps(px + i, x);
+		_mm256_storeu_ps(py + i, y);
+		_mm256_storeu_ps(pz + i, z);
+		_mm256_storeu_ps(vx + i, velX);
+		_mm256_storeu_ps(vy + i, velY);
+		_mm256_storeu_ps(vz + i, velZ);
+		_mm256_storeu_ps(rotation + i, _mm256_fmadd_ps(_mm256_loadu_ps(rotationSpeed + i), dtV, _mm256_loadu_ps(rotation + i)));
+	}
+
+	IntegrateScalar(particles, i, end, dt, time, forces);
+}
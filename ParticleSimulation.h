@@ -0,0 +1,49 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// --------------------------------------------------------
+// Forces applied to CPU simulated particles each step
+// --------------------------------------------------------
+struct ParticleForces
+{
+	DirectX::XMFLOAT3 Acceleration = DirectX::XMFLOAT3(0, 0, 0);
+	float Drag = 0.0f;					// Fraction of velocity lost per second (exponential)
+	float TurbulenceStrength = 0.0f;	// Acceleration from the noise field
+	float TurbulenceFrequency = 1.0f;	// How tightly the noise field swirls
+	bool FloorCollision = false;
+	float FloorHeight = 0.0f;
+	float Bounciness = 0.5f;			// Vertical speed kept after hitting the floor
+	float FloorFriction = 0.2f;			// Horizontal speed lost after hitting the floor
+};
+
+// --------------------------------------------------------
+// Structure-of-arrays particle state, so the integration
+// kernels can load 8 particles of one component at a time
+// --------------------------------------------------------
+struct ParticleSoA
+{
+	std::vector<float> PositionX, PositionY, PositionZ;
+	std::vector<float> VelocityX, VelocityY, VelocityZ;
+	std::vector<float> Rotation;
+	std::vector<float> RotationSpeed;	// Radians per second
+
+	void Resize(unsigned int capacity);
+	unsigned int Capacity() const;
+};
+
+// --------------------------------------------------------
+// Integration kernels for ParticleSoA.  Each one advances
+// particles [begin, end) by dt with semi-implicit Euler:
+// forces -> velocity -> drag -> position -> floor.
+// --------------------------------------------------------
+namespace ParticleSimulation
+{
+	// Uses AVX2 when available, scalar otherwise
+	void Integrate(ParticleSoA& particles, unsigned int begin, unsigned int end, float dt, float time, const ParticleForces& forces);
+
+	// Specific paths (for comparing them)
+	void IntegrateScalar(ParticleSoA& particles, unsigned int begin, unsigned int end, float dt, float time, const ParticleForces& forces);
+	void IntegrateAVX2(ParticleSoA& particles, unsigned int begin, unsigned int end, float dt, float time, const ParticleForces& forces);
+}
@@ -0,0 +1,60 @@
+#include "ParticleSpawner.h"
+
+using namespace DirectX;
+
+ParticleSpawner::ParticleSpawner(uint64_t seed) :
+	random(seed)
+{
+}
+
+uint64_t ParticleSpawner::GetSeed() const
+{
+	return random.GetSeed();
+}
+
+void ParticleSpawner::SetSeed(uint64_t seed)
+{
+	random.SetSeed(seed);
+}
+
+// --------------------------------------------------------
+// The random numbers for every new particle are made in
+// one batch, then handed out 8 at a time in ring order.
+// --------------------------------------------------------
+void ParticleSpawner::Spawn(Particle* ring, int ringSize, int first, int count, float emitTime, const ParticleSpawnSettings& settings)
+{
+	if (count <= 0)
+		return;
+
+	randoms.resize((size_t)count * RandomsPerParticle);
+	random.FillUniform(randoms.data(), (unsigned int)randoms.size());
+
+	const XMFLOAT3& position = settings.Position;
+	const XMFLOAT3& positionRange = settings.PositionRandomRange;
+	const XMFLOAT3& velocity = settings.StartVelocity;
+	const XMFLOAT3& velocityRange = settings.VelocityRandomRange;
+	const float rotationStartRange = settings.RotationStartMinMax.y - settings.RotationStartMinMax.x;
+	const float rotationEndRange = settings.RotationEndMinMax.y - settings.RotationEndMinMax.x;
+
+	for (int i = 0; i < count; i++)
+	{
+		const float* r = &randoms[(size_t)i * RandomsPerParticle];
+		Particle& p = ring[(first + i) % ringSize];
+		p.EmitTime = emitTime;
+		p.EmitterIndex = settings.EmitterIndex;
+
+		// Adjust the particle start position based on the random range (box shape)
+		p.StartPosition.x = position.x + positionRange.x * (r[0] * 2.0f - 1.0f);
+		p.StartPosition.y = position.y + positionRange.y * (r[1] * 2.0f - 1.0f);
+		p.StartPosition.z = position.z + positionRange.z * (r[2] * 2.0f - 1.0f);
+
+		// Adjust particle start velocity based on random range
+		p.StartVelocity.x = velocity.x + velocityRange.x * (r[3] * 2.0f - 1.0f);
+		p.StartVelocity.y = velocity.y + velocityRange.y * (r[4] * 2.0f - 1.0f);
+		p.StartVelocity.z = velocity.z + velocityRange.z * (r[5] * 2.0f - 1.0f);
+
+		// Adjust start and end rotation values based on range
+		p.StartRotation = settings.RotationStartMinMax.x + r[6] * rotationStartRange;
+		p.EndRotation = settings.RotationEndMinMax.x + r[7] * rotationEndRange;
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+#include "Random.h"
+
+// We'll be mimicking this in HLSL
+// so we need to care about alignment!
+struct Particle
+{
+	float EmitTime;
+	DirectX::XMFLOAT3 StartPosition;
+
+	DirectX::XMFLOAT3 StartVelocity;
+	float StartRotation;
+
+	float EndRotation;
+	unsigned int EmitterIndex;	// Row of the emitter table
+	DirectX::XMFLOAT2 pad;
+};
+
+// --------------------------------------------------------
+// Where new particles start and how far each value can be
+// randomized (a box around the position, a box around the
+// velocity, and a [min, max] for each rotation)
+// --------------------------------------------------------
+struct ParticleSpawnSettings
+{
+	DirectX::XMFLOAT3 Position = DirectX::XMFLOAT3(0, 0, 0);
+	DirectX::XMFLOAT3 PositionRandomRange = DirectX::XMFLOAT3(0, 0, 0);
+	DirectX::XMFLOAT3 StartVelocity = DirectX::XMFLOAT3(0, 0, 0);
+	DirectX::XMFLOAT3 VelocityRandomRange = DirectX::XMFLOAT3(0, 0, 0);
+	DirectX::XMFLOAT2 RotationStartMinMax = DirectX::XMFLOAT2(0, 0);
+	DirectX::XMFLOAT2 RotationEndMinMax = DirectX::XMFLOAT2(0, 0);
+	unsigned int EmitterIndex = 0;
+};
+
+// --------------------------------------------------------
+// Fills in new particles from a seeded random stream, with
+// no graphics API dependencies (Emitter spawns through one,
+// and it can be checked anywhere).
+//
+// Every particle takes 8 random numbers in a fixed order
+// (3 position, 3 velocity, 2 rotation), so a seed gives the
+// same particles however the spawns were batched.
+// --------------------------------------------------------
+class ParticleSpawner
+{
+public:
+	static constexpr unsigned int RandomsPerParticle = 8;
+
+	ParticleSpawner(uint64_t seed = 1);
+
+	uint64_t GetSeed() const;
+	void SetSeed(uint64_t seed);
+
+	// Fills count particles of a ring of ringSize starting at
+	// first, wrapping around to 0 past the end of the ring
+	void Spawn(Particle* ring, int ringSize, int first, int count, float emitTime, const ParticleSpawnSettings& settings);
+
+private:
+	RandomGenerator random;
+	std::vector<float> randoms;
+};
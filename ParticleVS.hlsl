@@ -5,60 +5,114 @@ cbuffer externalData : register(b0)
     matrix view;
     matrix projection;
     
+    uint firstDrawRange; // This draw's ranges in DrawRanges
+    uint drawRangeCount;
+    
+    int sorted; // Alpha blended: particles come from SortedParticles
+    uint firstSorted;
+};
+
+struct Particle
+{
+    float emitTime;
+    float3 startPos;
+    float3 startVelocity;
+    float startRotation;
+    float endRotation;
+    uint emitterIndex;
+    float2 padding;
+};
+
+// Everything shared by one emitter's particles (see ParticleEmitterData)
+struct Emitter
+{
     float4 startColor;
     float4 endColor;
     
-    float currentTime;
     float3 acceleration;
-   
+    float currentTime;
+    
+    float lifetime;
+    float startSize;
+    float endSize;
+    int constrainYAxis;
+    
     int spriteSheetWidth;
     int spriteSheetHeight;
     float spriteSheetFrameWidth;
     float spriteSheetFrameHeight;
     
     float spriteSheetSpeedScale;
-    float startSize;
-    float endSize;
-    float lifetime;
-    
-    int constrainYAxis;
-    float3 colorTint;
+    uint rangeStart; // The emitter's particle ring in ParticleData
+    uint rangeSize;
+    uint firstAlive;
 };
 
-struct Particle
+// Drawn particles from firstDrawn up to the next range's firstDrawn
+struct DrawRange
 {
-    float emitTime;
-    float3 startPos;
-    float3 startVelocity;
-    float startRotation;
-    float endRotation;
-    float3 padding;
+    uint firstDrawn;
+    uint emitterIndex;
 };
 
-// Buffer of particle data
+// Particles of every emitter, the emitter table and this frame's draw ranges
 StructuredBuffer<Particle> ParticleData : register(t0);
+StructuredBuffer<Emitter> EmitterData : register(t1);
+StructuredBuffer<DrawRange> DrawRanges : register(t2);
+
+// Indices into ParticleData, farthest first (alpha blended groups)
+StructuredBuffer<uint> SortedParticles : register(t3);
+
 // Take in an ID for the vertex
 VertexToPixel_Particle main(uint id : SV_VertexID)
 {
 	// Set up output
     VertexToPixel_Particle output;
     
-    // Get ID information
-    uint particleID = id / 4; // 4 verts = 1 particle (quads)
-    uint cornerID = id % 4; // the corner of the quad
+    // Get ID information - 6 verts = 1 particle (two triangles)
+    uint drawnID = id / 6;
+    const uint cornerIDs[6] = { 0, 1, 2, 0, 2, 3 };
+    uint cornerID = cornerIDs[id % 6]; // the corner of the quad
+    
+    uint particleID;
+    if (sorted)
+    {
+        // Already sorted back to front on the CPU
+        particleID = SortedParticles[firstSorted + drawnID];
+    }
+    else
+    {
+        // Which emitter's range is this in?  (last one starting at or before it)
+        uint low = firstDrawRange;
+        uint high = firstDrawRange + drawRangeCount - 1;
+        while (low < high)
+        {
+            uint middle = (low + high + 1) / 2;
+            if (DrawRanges[middle].firstDrawn <= drawnID)
+                low = middle;
+            else
+                high = middle - 1;
+        }
+        DrawRange range = DrawRanges[low];
+    
+        // Living particles start at firstAlive and wrap around the emitter's ring
+        Emitter ringOwner = EmitterData[range.emitterIndex];
+        particleID = ringOwner.rangeStart + (ringOwner.firstAlive + drawnID - range.firstDrawn) % ringOwner.rangeSize;
+    }
     
-    // Get the particle
+    // Get the particle and the emitter it came from
     Particle p = ParticleData.Load(particleID);
+    Emitter e = EmitterData[p.emitterIndex];
     
     // Calculate age
-    float age = currentTime - p.emitTime;
-    float agePercent = age / lifetime;
+    float age = e.currentTime - p.emitTime;
+    float agePercent = age / e.lifetime;
     
     // Get position based on velocity and acceleration
-    float3 pos = acceleration * age * age * 0.5f + p.startVelocity * age + p.startPos;
+    float3 pos = e.acceleration * age * age * 0.5f + p.startVelocity * age + p.startPos;
     
     // Interpolate size
-    float size = lerp(startSize, endSize, agePercent);
+    float size = lerp(e.startSize, e.endSize, agePercent);
     
     // Offsets for the 4 corners of a quad - we'll only
 	// use one for each vertex, but which one depends
@@ -83,33 +137,33 @@ VertexToPixel_Particle main(uint id : SV_VertexID)
 
 	// Offset the position based on the camera's right and up vectors (billboarding)
     pos += float3(view._11, view._12, view._13) * rotatedOffset.x; // RIGHT
-    pos += (constrainYAxis ? float3(0, 1, 0) : float3(view._21, view._22, view._23)) * rotatedOffset.y; // UP
+    pos += (e.constrainYAxis ? float3(0, 1, 0) : float3(view._21, view._22, view._23)) * rotatedOffset.y; // UP
 
 	// Calculate output position
     matrix viewProj = mul(projection, view);
     output.screenPosition = mul(viewProj, float4(pos, 1.0f));
 
 	// Sprite sheet animation calculations
-    float animPercent = fmod(agePercent * spriteSheetSpeedScale, 1.0f);
-    uint ssIndex = (uint) floor(animPercent * (spriteSheetWidth * spriteSheetHeight));
+    float animPercent = fmod(agePercent * e.spriteSheetSpeedScale, 1.0f);
+    uint ssIndex = (uint) floor(animPercent * (e.spriteSheetWidth * e.spriteSheetHeight));
 
 	// Get the U/V indices (basically column & row index across the sprite sheet)
-    uint uIndex = ssIndex % spriteSheetWidth;
-    uint vIndex = ssIndex / spriteSheetWidth; // Integer division is important here!
+    uint uIndex = ssIndex % e.spriteSheetWidth;
+    uint vIndex = ssIndex / e.spriteSheetWidth; // Integer division is important here!
 
 	// Convert to a top-left corner in uv space (0-1)
-    float u = uIndex / (float) spriteSheetWidth;
-    float v = vIndex / (float) spriteSheetHeight;
+    float u = uIndex / (float) e.spriteSheetWidth;
+    float v = vIndex / (float) e.spriteSheetHeight;
 
     float2 uvs[4];
     uvs[0] = float2(u, v); //TL
-    uvs[1] = float2(u + spriteSheetFrameWidth, v); //TR
-    uvs[2] = float2(u + spriteSheetFrameWidth, v + spriteSheetFrameHeight); //BR
-    uvs[3] = float2(u, v + spriteSheetFrameHeight); //BL
+    uvs[1] = float2(u + e.spriteSheetFrameWidth, v); //TR
+    uvs[2] = float2(u + e.spriteSheetFrameWidth, v + e.spriteSheetFrameHeight); //BR
+    uvs[3] = float2(u, v + e.spriteSheetFrameHeight); //BL
 	
 	// Finalize output
     output.uv = saturate(uvs[cornerID]);
-    output.color = lerp(startColor, endColor, agePercent);
+    output.color = lerp(e.startColor, e.endColor, agePercent);
     
     return output;
 }
\ No newline at end of file
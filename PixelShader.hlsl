@@ -14,14 +14,12 @@ cbuffer ShaderData : register(b0)
     float3 cameraPos; //helps with specular + diffuse lighting
     
     //light data
-    int numLights;
     float3 ambientColor;
-    
-    //light objects
-    Lights lights[MAX_LIGHTS];
+    uint3 lightCounts; //directional, point and spot lights in LightData (in that order)
 };
 
 Texture2D SurfaceTexture : register(t0); // "t" registers for textures
+StructuredBuffer<PackedLight> LightData : register(t1); //every light, packed once per frame (see LightPacker)
 SamplerState BasicSampler : register(s0); // "s" registers for samplers
 
 // --------------------------------------------------------
@@ -55,7 +53,7 @@ float4 main(VertexToPixel input) : SV_TARGET
     float3 surfaceToCamera = normalize(cameraPos - input.worldPos);
 
     //apply the total lighting
-    totalLight += CalculateTotalLight(numLights, lights, input.normal, surfaceToCamera, input.worldPos, roughness, color);
+    totalLight += CalculateTotalLight(lightCounts, LightData, input.normal, surfaceToCamera, input.worldPos, roughness, color);
 
 	//return modified color
     return float4(GammaCorrect(totalLight), 1);
@@ -0,0 +1,614 @@
+#include "PngDecoder.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Codes up to this long are decoded with one table lookup
+	constexpr int FastBits = 10;
+	constexpr unsigned int FastMask = (1 << FastBits) - 1;
+
+	const uint16_t LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const uint8_t LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const uint16_t DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const uint8_t DistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	const uint8_t CodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	bool Fail(std::string* error, const char* message)
+	{
+		if (error)
+			*error = message;
+		return false;
+	}
+
+	uint32_t ReadBigEndian32(const uint8_t* p)
+	{
+		return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+	}
+
+	uint32_t ReverseBits(uint32_t code, int length)
+	{
+		uint32_t reversed = 0;
+		for (int i = 0; i < length; i++)
+		{
+			reversed = (reversed << 1) | (code & 1);
+			code >>= 1;
+		}
+		return reversed;
+	}
+
+	// --------------------------------------------------------
+	// Deflate bits come least significant first.  Up to 64 are
+	// kept in a buffer; past the end of the data it fills with
+	// zeros and Overran() says so.
+	// --------------------------------------------------------
+	struct BitReader
+	{
+		const uint8_t* next;
+		const uint8_t* end;
+		uint64_t bits = 0;
+		int count = 0;
+		size_t zerosAdded = 0;
+
+		BitReader(const uint8_t* data, size_t size) : next(data), end(data + size) {}
+
+		void Refill()
+		{
+			if (end - next >= 8)
+			{
+				// Whole bytes that fit, read 8 at a time
+				uint64_t word;
+				memcpy(&word, next, sizeof(word));
+				bits |= word << count;
+				next += (63 - count) >> 3;
+				count |= 56;
+			}
+			else
+			{
+				while (count <= 56)
+				{
+					if (next < end)
+						bits |= (uint64_t)*next++ << count;
+					else
+						zerosAdded++;
+					count += 8;
+				}
+			}
+		}
+
+		uint32_t Peek(int n)
+		{
+			if (count < n)
+				Refill();
+			return (uint32_t)(bits & ((1ull << n) - 1));
+		}
+
+		void Consume(int n)
+		{
+			bits >>= n;
+			count -= n;
+		}
+
+		uint32_t Read(int n)
+		{
+			uint32_t value = Peek(n);
+			Consume(n);
+			return value;
+		}
+
+		void AlignToByte()
+		{
+			Consume(count & 7);
+		}
+
+		// More bits were used than the data had
+		bool Overran() const
+		{
+			return zerosAdded * 8 > (size_t)count;
+		}
+	};
+
+	// --------------------------------------------------------
+	// Canonical Huffman code.  Short codes come straight out
+	// of the fast table (symbol | length << 9); longer ones are
+	// found by comparing against each length's last code.
+	// --------------------------------------------------------
+	struct Huffman
+	{
+		uint16_t fast[1 << FastBits];
+		uint32_t maxCode[17];		// One past each length's codes, left aligned to 16 bits
+		uint16_t firstCode[16];
+		uint16_t firstSymbol[16];
+		uint16_t symbols[288];		// Sorted by length, then symbol
+
+		bool Build(const uint8_t* lengths, int count)
+		{
+			int lengthCounts[16] = {};
+			for (int i = 0; i < count; i++)
+				lengthCounts[lengths[i]]++;
+			lengthCounts[0] = 0;
+
+			memset(fast, 0, sizeof(fast));
+
+			int code = 0;
+			int symbol = 0;
+			for (int length = 1; length < 16; length++)
+			{
+				firstCode[length] = (uint16_t)code;
+				firstSymbol[length] = (uint16_t)symbol;
+				code += lengthCounts[length];
+				if (code > (1 << length))
+					return false;	// Over-subscribed
+				maxCode[length] = (uint32_t)code << (16 - length);
+				code <<= 1;
+				symbol += lengthCounts[length];
+			}
+			maxCode[16] = 0x10000;
+
+			// Place every symbol and fill the fast table for short codes
+			uint16_t nextIndex[16];
+			memcpy(nextIndex, firstSymbol, sizeof(nextIndex));
+			for (int i = 0; i < count; i++)
+			{
+				int length = lengths[i];
+				if (length == 0)
+					continue;
+
+				int index = nextIndex[length]++;
+				symbols[index] = (uint16_t)i;
+
+				if (length <= FastBits)
+				{
+					uint32_t canonical = firstCode[length] + (index - firstSymbol[length]);
+					uint16_t entry = (uint16_t)(i | (length << 9));
+					for (uint32_t j = ReverseBits(canonical, length); j < (1u << FastBits); j += 1u << length)
+						fast[j] = entry;
+				}
+			}
+			return true;
+		}
+
+		// -1 for codes that don't exist
+		int Decode(BitReader& reader) const
+		{
+			uint32_t bits = reader.Peek(16);
+			uint16_t entry = fast[bits & FastMask];
+			if (entry)
+			{
+				reader.Consume(entry >> 9);
+				return entry & 511;
+			}
+
+			uint32_t reversed = ReverseBits(bits, 16);
+			int length = FastBits + 1;
+			while (length < 16 && reversed >= maxCode[length])
+				length++;
+			if (length == 16)
+				return -1;
+
+			int index = (reversed >> (16 - length)) - firstCode[length] + firstSymbol[length];
+			if (index < 0 || index >= 288)
+				return -1;
+			reader.Consume(length);
+			return symbols[index];
+		}
+	};
+
+	// The fixed codes of block type 1
+	void BuildFixedCodes(Huffman& literals, Huffman& distances)
+	{
+		uint8_t lengths[288];
+		memset(lengths, 8, 144);
+		memset(lengths + 144, 9, 112);
+		memset(lengths + 256, 7, 24);
+		memset(lengths + 280, 8, 8);
+		literals.Build(lengths, 288);
+
+		memset(lengths, 5, 30);
+		distances.Build(lengths, 30);
+	}
+
+	bool ReadDynamicCodes(BitReader& reader, Huffman& literals, Huffman& distances)
+	{
+		int literalCount = reader.Read(5) + 257;
+		int distanceCount = reader.Read(5) + 1;
+		int codeLengthCount = reader.Read(4) + 4;
+
+		uint8_t codeLengthLengths[19] = {};
+		for (int i = 0; i < codeLengthCount; i++)
+			codeLengthLengths[CodeLengthOrder[i]] = (uint8_t)reader.Read(3);
+
+		Huffman codeLengths;
+		if (!codeLengths.Build(codeLengthLengths, 19))
+			return false;
+
+		// Literal and distance lengths are one run (repeats can cross over)
+		uint8_t lengths[288 + 32] = {};
+		int total = literalCount + distanceCount;
+		int i = 0;
+		while (i < total)
+		{
+			int symbol = codeLengths.Decode(reader);
+			if (symbol < 0)
+				return false;
+
+			if (symbol < 16)
+			{
+				lengths[i++] = (uint8_t)symbol;
+				continue;
+			}
+
+			int repeat;
+			uint8_t value = 0;
+			if (symbol == 16)
+			{
+				if (i == 0)
+					return false;
+				value = lengths[i - 1];
+				repeat = 3 + reader.Read(2);
+			}
+			else if (symbol == 17)
+				repeat = 3 + reader.Read(3);
+			else
+				repeat = 11 + reader.Read(7);
+
+			if (i + repeat > total)
+				return false;
+			memset(lengths + i, value, repeat);
+			i += repeat;
+		}
+
+		if (lengths[256] == 0)
+			return false;	// No end of block code
+		return literals.Build(lengths, literalCount) && distances.Build(lengths + literalCount, distanceCount);
+	}
+
+	// Reverses one row's filter in place (bytesPerPixel is at least 1)
+	void Unfilter(uint8_t filter, uint8_t* row, const uint8_t* previous, unsigned int length, unsigned int bytesPerPixel)
+	{
+		switch (filter)
+		{
+		case 1: // Sub
+			for (unsigned int i = bytesPerPixel; i < length; i++)
+				row[i] += row[i - bytesPerPixel];
+			break;
+
+		case 2: // Up
+			if (previous)
+				for (unsigned int i = 0; i < length; i++)
+					row[i] += previous[i];
+			break;
+
+		case 3: // Average
+			for (unsigned int i = 0; i < length; i++)
+			{
+				unsigned int left = i >= bytesPerPixel ? row[i - bytesPerPixel] : 0;
+				unsigned int up = previous ? previous[i] : 0;
+				row[i] += (uint8_t)((left + up) >> 1);
+			}
+			break;
+
+		case 4: // Paeth
+			for (unsigned int i = 0; i < length; i++)
+			{
+				int a = i >= bytesPerPixel ? row[i - bytesPerPixel] : 0;
+				int b = previous ? previous[i] : 0;
+				int c = (previous && i >= bytesPerPixel) ? previous[i - bytesPerPixel] : 0;
+				int p = a + b - c;
+				int pa = abs(p - a);
+				int pb = abs(p - b);
+				int pc = abs(p - c);
+				row[i] += (uint8_t)((pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c));
+			}
+			break;
+		}
+	}
+}
+
+unsigned int CpuImage::BytesPerPixel() const
+{
+	switch (Format)
+	{
+	case CpuImageFormat::R8: return 1;
+	case CpuImageFormat::R16: return 2;
+	case CpuImageFormat::RG8: return 2;
+	default: return 4;
+	}
+}
+
+size_t CpuImage::RowPitch() const
+{
+	return (size_t)Width * BytesPerPixel();
+}
+
+// --------------------------------------------------------
+// Stored, fixed and dynamic Huffman blocks (RFC 1950/1951)
+// --------------------------------------------------------
+bool PngDecoder::Inflate(const uint8_t* data, size_t size, uint8_t* output, size_t outputSize, std::string* error)
+{
+	if (size < 2 || (data[0] & 15) != 8 || ((data[0] << 8) | data[1]) % 31 != 0)
+		return Fail(error, "bad zlib header");
+	if (data[1] & 32)
+		return Fail(error, "zlib preset dictionaries aren't supported");
+
+	BitReader reader(data + 2, size - 2);
+	Huffman literals, distances;
+	uint8_t* out = output;
+	uint8_t* outEnd = output + outputSize;
+
+	bool lastBlock = false;
+	while (!lastBlock)
+	{
+		lastBlock = reader.Read(1) != 0;
+		uint32_t type = reader.Read(2);
+
+		if (type == 0)
+		{
+			// Stored: byte aligned length, its complement, then raw bytes
+			reader.AlignToByte();
+			uint32_t length = reader.Read(16);
+			uint32_t complement = reader.Read(16);
+			if ((length ^ 0xFFFF) != complement)
+				return Fail(error, "corrupt stored block");
+			if (length > (size_t)(outEnd - out))
+				return Fail(error, "more data than expected");
+
+			// Whatever's left in the bit buffer first, then straight from the data
+			while (length > 0 && reader.count >= 8)
+			{
+				*out++ = (uint8_t)reader.Read(8);
+				length--;
+			}
+			if (length > (size_t)(reader.end - reader.next))
+				return Fail(error, "truncated stored block");
+			if (length > 0)
+				reader.bits = 0;	// Drop the read-ahead bits, reading restarts after the copy
+			memcpy(out, reader.next, length);
+			out += length;
+			reader.next += length;
+			continue;
+		}
+
+		if (type == 1)
+			BuildFixedCodes(literals, distances);
+		else if (type == 2)
+		{
+			if (!ReadDynamicCodes(reader, literals, distances))
+				return Fail(error, "corrupt Huffman codes");
+		}
+		else
+			return Fail(error, "bad block type");
+
+		for (;;)
+		{
+			int symbol = literals.Decode(reader);
+			if (symbol < 256)
+			{
+				if (symbol < 0)
+					return Fail(error, "bad literal/length code");
+				if (out == outEnd)
+					return Fail(error, "more data than expected");
+				*out++ = (uint8_t)symbol;
+				continue;
+			}
+			if (symbol == 256)
+				break;
+
+			symbol -= 257;
+			if (symbol >= 29)
+				return Fail(error, "bad length code");
+			size_t length = LengthBase[symbol] + reader.Read(LengthExtra[symbol]);
+
+			int distanceSymbol = distances.Decode(reader);
+			if (distanceSymbol < 0 || distanceSymbol >= 30)
+				return Fail(error, "bad distance code");
+			size_t distance = DistanceBase[distanceSymbol] + reader.Read(DistanceExtra[distanceSymbol]);
+
+			if (distance > (size_t)(out - output))
+				return Fail(error, "distance before the start of the data");
+			if (length > (size_t)(outEnd - out))
+				return Fail(error, "more data than expected");
+
+			// Overlapping copies repeat the last few bytes
+			const uint8_t* from = out - distance;
+			if (distance == 1)
+				memset(out, *from, length);
+			else if (distance >= length)
+				memcpy(out, from, length);
+			else
+				for (size_t i = 0; i < length; i++)
+					out[i] = from[i];
+			out += length;
+		}
+
+		if (reader.Overran())
+			return Fail(error, "truncated data");
+	}
+
+	if (out != outEnd)
+		return Fail(error, "less data than expected");
+	return true;
+}
+
+bool PngDecoder::Decode(const uint8_t* data, size_t size, CpuImage& image, std::string* error)
+{
+	static const uint8_t Signature[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+	if (size < 8 || memcmp(data, Signature, 8) != 0)
+		return Fail(error, "not a PNG");
+
+	unsigned int width = 0, height = 0;
+	uint8_t bitDepth = 0, colorType = 0, interlace = 0;
+	uint8_t palette[256][4] = {};
+	unsigned int paletteSize = 0;
+	std::vector<uint8_t> compressed;
+
+	// Walk the chunks, gathering what's needed
+	size_t offset = 8;
+	bool sawHeader = false, sawEnd = false;
+	while (!sawEnd)
+	{
+		if (size - offset < 12)
+			return Fail(error, "truncated chunk");
+		uint32_t length = ReadBigEndian32(data + offset);
+		const uint8_t* type = data + offset + 4;
+		const uint8_t* body = data + offset + 8;
+		if (length > size - offset - 12)
+			return Fail(error, "truncated chunk");
+
+		if (memcmp(type, "IHDR", 4) == 0)
+		{
+			if (length < 13)
+				return Fail(error, "bad header");
+			width = ReadBigEndian32(body);
+			height = ReadBigEndian32(body + 4);
+			bitDepth = body[8];
+			colorType = body[9];
+			interlace = body[12];
+			sawHeader = true;
+		}
+		else if (memcmp(type, "PLTE", 4) == 0)
+		{
+			paletteSize = std::min(length / 3, 256u);
+			for (unsigned int i = 0; i < paletteSize; i++)
+			{
+				palette[i][0] = body[i * 3 + 0];
+				palette[i][1] = body[i * 3 + 1];
+				palette[i][2] = body[i * 3 + 2];
+				palette[i][3] = 255;
+			}
+		}
+		else if (memcmp(type, "tRNS", 4) == 0 && colorType == 3)
+		{
+			for (unsigned int i = 0; i < length && i < 256; i++)
+				palette[i][3] = body[i];
+		}
+		else if (memcmp(type, "IDAT", 4) == 0)
+		{
+			compressed.insert(compressed.end(), body, body + length);
+		}
+		else if (memcmp(type, "IEND", 4) == 0)
+		{
+			sawEnd = true;
+		}
+
+		offset += 12 + (size_t)length;
+	}
+
+	if (!sawHeader || width == 0 || height == 0)
+		return Fail(error, "missing header");
+	if (width > MaxDimension || height > MaxDimension)
+		return Fail(error, "image too large");
+	if (interlace != 0)
+		return Fail(error, "interlaced PNGs aren't supported");
+
+	unsigned int channels;
+	switch (colorType)
+	{
+	case 0: channels = 1; break;	// Gray
+	case 2: channels = 3; break;	// RGB
+	case 3: channels = 1; break;	// Palette
+	case 4: channels = 2; break;	// Gray + alpha
+	case 6: channels = 4; break;	// RGBA
+	default: return Fail(error, "bad color type");
+	}
+	if (bitDepth != 8 && !(bitDepth == 16 && colorType == 0))
+		return Fail(error, "only 8 bit (and 16 bit gray) PNGs are supported");
+	if (colorType == 3 && paletteSize == 0)
+		return Fail(error, "missing palette");
+
+	// Every row starts with its filter type
+	unsigned int bytesPerPixel = channels * bitDepth / 8;
+	size_t stride = (size_t)width * bytesPerPixel;
+	std::vector<uint8_t> filtered((stride + 1) * height);
+	if (!Inflate(compressed.data(), compressed.size(), filtered.data(), filtered.size(), error))
+		return false;
+
+	image.Width = width;
+	image.Height = height;
+	image.Format = colorType == 0 ? (bitDepth == 16 ? CpuImageFormat::R16 : CpuImageFormat::R8) : CpuImageFormat::RGBA8;
+	image.Pixels.resize(image.RowPitch() * height);
+
+	uint8_t* previous = 0;
+	for (unsigned int y = 0; y < height; y++)
+	{
+		uint8_t* row = &filtered[y * (stride + 1)];
+		uint8_t filter = row[0];
+		if (filter > 4)
+			return Fail(error, "bad filter type");
+		row++;
+		Unfilter(filter, row, previous, (unsigned int)stride, bytesPerPixel);
+		previous = row;
+
+		uint8_t* out = &image.Pixels[y * image.RowPitch()];
+		switch (colorType)
+		{
+		case 0:
+			if (bitDepth == 8)
+				memcpy(out, row, stride);
+			else
+				for (unsigned int x = 0; x < width; x++)
+				{
+					// PNG is big endian
+					out[x * 2 + 0] = row[x * 2 + 1];
+					out[x * 2 + 1] = row[x * 2 + 0];
+				}
+			break;
+
+		case 2:
+			for (unsigned int x = 0; x < width; x++)
+			{
+				out[x * 4 + 0] = row[x * 3 + 0];
+				out[x * 4 + 1] = row[x * 3 + 1];
+				out[x * 4 + 2] = row[x * 3 + 2];
+				out[x * 4 + 3] = 255;
+			}
+			break;
+
+		case 3:
+			for (unsigned int x = 0; x < width; x++)
+				memcpy(out + x * 4, palette[row[x]], 4);
+			break;
+
+		case 4:
+			for (unsigned int x = 0; x < width; x++)
+			{
+				out[x * 4 + 0] = row[x * 2];
+				out[x * 4 + 1] = row[x * 2];
+				out[x * 4 + 2] = row[x * 2];
+				out[x * 4 + 3] = row[x * 2 + 1];
+			}
+			break;
+
+		case 6:
+			memcpy(out, row, stride);
+			break;
+		}
+	}
+
+	return true;
+}
+
+bool PngDecoder::ReadFile(const std::filesystem::path& path, std::vector<uint8_t>& bytes)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+		return false;
+
+	std::streamsize size = file.tellg();
+	file.seekg(0);
+	bytes.resize((size_t)size);
+	return (bool)file.read((char*)bytes.data(), size);
+}
+
+bool PngDecoder::DecodeFile(const std::filesystem::path& path, CpuImage& image, std::string* error)
+{
+	std::vector<uint8_t> bytes;
+	if (!ReadFile(path, bytes))
+		return Fail(error, "can't open file");
+	return Decode(bytes.data(), bytes.size(), image, error);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Pixel layouts a decoded image can come out in (same as
+// what the WIC loader picks for the same file)
+enum class CpuImageFormat
+{
+	R8,		// 8 bit grayscale
+	R16,	// 16 bit grayscale (height maps)
+	RGBA8,	// Everything else
+	RG8		// Never decoded, only made by packing two maps together
+};
+
+// --------------------------------------------------------
+// An image in CPU memory, rows tightly packed top to bottom
+// --------------------------------------------------------
+struct CpuImage
+{
+	unsigned int Width = 0;
+	unsigned int Height = 0;
+	CpuImageFormat Format = CpuImageFormat::RGBA8;
+	std::vector<uint8_t> Pixels;
+
+	unsigned int BytesPerPixel() const;
+	size_t RowPitch() const;
+};
+
+// --------------------------------------------------------
+// PNG decoding with no OS or graphics API dependencies, so
+// textures can be decoded on any thread (and benchmarked
+// anywhere).
+//
+// Handles non-interlaced 8 bit gray, gray + alpha, RGB,
+// RGBA and palette images, plus 16 bit gray.  Anything else
+// fails with an error, so callers can fall back to WIC.
+// Chunk CRCs and the zlib checksum aren't checked.
+// --------------------------------------------------------
+namespace PngDecoder
+{
+	// Largest width or height accepted (D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION)
+	constexpr unsigned int MaxDimension = 16384;
+
+	bool Decode(const uint8_t* data, size_t size, CpuImage& image, std::string* error = 0);
+	bool DecodeFile(const std::filesystem::path& path, CpuImage& image, std::string* error = 0);
+
+	// Whole file into memory (false if it can't be opened)
+	bool ReadFile(const std::filesystem::path& path, std::vector<uint8_t>& bytes);
+
+	// Decompresses a zlib stream into exactly outputSize bytes
+	bool Inflate(const uint8_t* data, size_t size, uint8_t* output, size_t outputSize, std::string* error = 0);
+}
@@ -0,0 +1,128 @@
+#include "PostProcessChain.h"
+
+#include <algorithm>
+#include <cmath>
+
+unsigned int PostProcessChain::AddPass(const PostProcessPass& pass)
+{
+	passes.push_back(pass);
+	return (unsigned int)passes.size() - 1;
+}
+
+PostProcessPass& PostProcessChain::GetPass(unsigned int pass)
+{
+	return passes[pass];
+}
+
+unsigned int PostProcessChain::GetPassCount() const
+{
+	return (unsigned int)passes.size();
+}
+
+void PostProcessChain::Schedule(unsigned int width, unsigned int height, RenderTargetPool& pool, std::vector<ScheduledPass>& schedule)
+{
+	schedule.clear();
+
+	// Which enabled pass (or the scene) really draws what each pass
+	// would have: itself, or for disabled ones, whatever they read
+	std::vector<int> producer(passes.size(), Scene);
+	std::vector<std::vector<int>> inputs(passes.size());
+	int previous = Scene;
+	for (int i = 0; i < (int)passes.size(); i++)
+	{
+		const PostProcessPass& pass = passes[i];
+		if (pass.Inputs.empty())
+			inputs[i].push_back(previous);
+		for (int input : pass.Inputs)
+			inputs[i].push_back(input >= 0 && input < i ? producer[input] : Scene);
+
+		producer[i] = pass.Enabled ? i : inputs[i][0];
+		if (pass.Enabled)
+			previous = i;
+	}
+
+	// Last pass reading each pass, to know when its target is free
+	std::vector<int> order;
+	std::vector<int> lastReader(passes.size(), -1);
+	for (int i = 0; i < (int)passes.size(); i++)
+	{
+		if (!passes[i].Enabled)
+			continue;
+		for (int input : inputs[i])
+			if (input >= 0)
+				lastReader[input] = i;
+		order.push_back(i);
+	}
+
+	std::vector<int> target(passes.size(), Scene);
+	for (size_t k = 0; k < order.size(); k++)
+	{
+		int i = order[k];
+		const PostProcessPass& pass = passes[i];
+
+		ScheduledPass scheduled;
+		scheduled.Pass = i;
+		scheduled.Width = std::max((unsigned int)lroundf(width * pass.Scale), 1u);
+		scheduled.Height = std::max((unsigned int)lroundf(height * pass.Scale), 1u);
+		for (int input : inputs[i])
+			scheduled.Inputs.push_back(input >= 0 ? target[input] : Scene);
+
+		// Acquired before the inputs are released, so a pass never
+		// draws into something it's reading
+		if (k + 1 == order.size() && !pass.Compute)
+		{
+			scheduled.Output = BackBuffer;
+		}
+		else
+		{
+			RenderTargetDesc desc;
+			desc.Width = scheduled.Width;
+			desc.Height = scheduled.Height;
+			desc.Format = pass.Format;
+			desc.UnorderedAccess = pass.Compute;
+			scheduled.Output = (int)pool.Acquire(desc);
+			target[i] = scheduled.Output;
+		}
+
+		for (int input : inputs[i])
+			if (input >= 0 && lastReader[input] == i && target[input] >= 0)
+			{
+				pool.Release(target[input]);
+				target[input] = Scene;
+			}
+
+		// Nobody reads it, but it still has to exist while it's drawn
+		if (lastReader[i] < 0 && scheduled.Output >= 0)
+			pool.Release(scheduled.Output);
+
+		schedule.push_back(scheduled);
+	}
+
+	// Inputs to unbind after each pass: ones whose target is next
+	// drawn to, read somewhere else or by the other shader stage,
+	// or not used again this frame (next frame it could be anything)
+	for (size_t k = 0; k < schedule.size(); k++)
+	{
+		ScheduledPass& scheduled = schedule[k];
+		bool compute = passes[scheduled.Pass].Compute;
+		for (unsigned int slot = 0; slot < scheduled.Inputs.size(); slot++)
+		{
+			int input = scheduled.Inputs[slot];
+			bool stillBound = false;
+			for (size_t j = k + 1; j < schedule.size(); j++)
+			{
+				const ScheduledPass& next = schedule[j];
+				bool written = next.Output == input;
+				bool readThere = std::find(next.Inputs.begin(), next.Inputs.end(), input) != next.Inputs.end();
+				if (!written && !readThere)
+					continue;
+
+				stillBound = !written && passes[next.Pass].Compute == compute &&
+					slot < next.Inputs.size() && next.Inputs[slot] == input;
+				break;
+			}
+			if (!stillBound)
+				scheduled.UnbindAfter = slot + 1;
+		}
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "RenderTargetPool.h"
+
+// --------------------------------------------------------
+// One step of post processing: what it draws into and
+// which earlier passes (or the scene) it reads
+// --------------------------------------------------------
+struct PostProcessPass
+{
+	std::string Name;
+	RenderTargetFormat Format = RenderTargetFormat::RGBA8;
+	float Scale = 1.0f;			// Of the screen size
+	bool Compute = false;		// Writes through a UAV, so never straight to the back buffer
+	bool Enabled = true;
+
+	// Indices of earlier passes, or PostProcessChain::Scene.  Empty
+	// reads whatever the previous enabled pass drew (or the scene).
+	std::vector<int> Inputs;
+};
+
+// --------------------------------------------------------
+// Where an enabled pass reads from and draws to this frame
+// --------------------------------------------------------
+struct ScheduledPass
+{
+	unsigned int Pass = 0;
+	std::vector<int> Inputs;	// Pool targets, or PostProcessChain::Scene
+	int Output = 0;				// Pool target, or PostProcessChain::BackBuffer
+	unsigned int Width = 0;
+	unsigned int Height = 0;
+	unsigned int UnbindAfter = 0;	// Shader resource slots to clear once it's done (input i is slot i)
+};
+
+// --------------------------------------------------------
+// An ordered list of post processing passes, and the
+// scheduling that gives each one render targets from a
+// RenderTargetPool, with no GPU work (see PostProcessor
+// for that) so it can be tested on its own.
+//
+// Disabled passes are skipped: anything reading one reads
+// its first input instead.  The last enabled pass draws to
+// the back buffer (unless it's a compute pass).  Every
+// other pass gets a target matching its format and scale,
+// which goes back to the pool once its last reader is
+// done, so a chain of full screen passes ping-pongs
+// between two targets.  Like a RenderGraph, it also works
+// out which inputs to unbind after each pass, instead of
+// clearing every slot every time.
+// --------------------------------------------------------
+class PostProcessChain
+{
+public:
+	static constexpr int Scene = -1;
+	static constexpr int BackBuffer = -2;
+
+	unsigned int AddPass(const PostProcessPass& pass);
+	PostProcessPass& GetPass(unsigned int pass);
+	unsigned int GetPassCount() const;
+
+	// Acquires (and releases) targets from the pool for one frame at
+	// this screen size.  The pool should be between BeginFrame() and
+	// EndFrame().
+	void Schedule(unsigned int width, unsigned int height, RenderTargetPool& pool, std::vector<ScheduledPass>& schedule);
+
+private:
+	std::vector<PostProcessPass> passes;
+};
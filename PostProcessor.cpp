@@ -0,0 +1,111 @@
+#include "PostProcessor.h"
+#include "Graphics.h"
+#include "Profiler.h"
+
+PostProcessor::PostProcessor(std::shared_ptr<SimpleVertexShader> fullscreenVS) :
+	fullscreenVS(fullscreenVS)
+{
+	// Shared by every pass, no matter the size
+	D3D11_SAMPLER_DESC samplerDesc = {};
+	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	Graphics::Device->CreateSamplerState(&samplerDesc, clampSampler.GetAddressOf());
+}
+
+unsigned int PostProcessor::AddPass(const PostProcessPass& pass, DrawPass draw)
+{
+	draws.push_back(draw);
+	return chain.AddPass(pass);
+}
+
+PostProcessPass& PostProcessor::GetPass(unsigned int pass)
+{
+	return chain.GetPass(pass);
+}
+
+void PostProcessor::Draw(ID3D11ShaderResourceView* scene, unsigned int width, unsigned int height, ID3D11RenderTargetView* backBuffer)
+{
+	PROFILE_SCOPE("PostProcessor::Draw");
+
+	targets.GetPool().BeginFrame();
+	chain.Schedule(width, height, targets.GetPool(), schedule);
+	for (const ScheduledPass& scheduled : schedule)
+	{
+		PostProcessContext context;
+		context.Width = scheduled.Width;
+		context.Height = scheduled.Height;
+		context.FullscreenVS = fullscreenVS;
+		context.ClampSampler = clampSampler.Get();
+		for (int input : scheduled.Inputs)
+		{
+			if (input == PostProcessChain::Scene)
+			{
+				context.Inputs.push_back(scene);
+				if (context.InputWidth == 0)
+				{
+					context.InputWidth = width;
+					context.InputHeight = height;
+				}
+				continue;
+			}
+
+			RenderTargetViews& views = targets.GetViews(input);
+			context.Inputs.push_back(views.SRV.Get());
+			if (context.InputWidth == 0)
+			{
+				context.InputWidth = views.Desc.Width;
+				context.InputHeight = views.Desc.Height;
+			}
+		}
+
+		// Nothing being read can still be bound for drawing
+		ID3D11RenderTargetView* output = scheduled.Output == PostProcessChain::BackBuffer ? backBuffer : 0;
+		if (scheduled.Output >= 0)
+		{
+			RenderTargetViews& views = targets.GetViews(scheduled.Output);
+			output = views.RTV.Get();
+			context.OutputUAV = views.UAV.Get();
+		}
+
+		if (chain.GetPass(scheduled.Pass).Compute)
+		{
+			Graphics::Renderer->SetRenderTargets(1, &backBuffer, 0);
+			draws[scheduled.Pass](context);
+
+			// The output is always read next, the inputs only if the chain says
+			Graphics::Renderer->UnbindComputeUnorderedAccessViews(1);
+			if (scheduled.UnbindAfter > 0)
+				Graphics::Renderer->UnbindComputeShaderResources(scheduled.UnbindAfter);
+		}
+		else
+		{
+			Graphics::Renderer->SetRenderTargets(1, &output, 0);
+			Graphics::Renderer->SetViewport((float)scheduled.Width, (float)scheduled.Height);
+			draws[scheduled.Pass](context);
+			if (scheduled.UnbindAfter > 0)
+				Graphics::Renderer->UnbindPixelShaderResources(scheduled.UnbindAfter);
+		}
+	}
+
+	// Back to the full screen
+	Graphics::Renderer->SetViewport((float)width, (float)height);
+	targets.EndFrame();
+}
+
+const std::vector<ScheduledPass>& PostProcessor::GetSchedule() const
+{
+	return schedule;
+}
+
+const RenderTargetPool& PostProcessor::GetPool() const
+{
+	return targets.GetPool();
+}
+
+ID3D11SamplerState* PostProcessor::GetClampSampler()
+{
+	return clampSampler.Get();
+}
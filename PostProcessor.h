@@ -0,0 +1,62 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "PostProcessChain.h"
+#include "RenderTargetCache.h"
+#include "SimpleShader.h"
+
+// --------------------------------------------------------
+// What a pass gets to draw with.  Pixel passes already
+// have their output bound (with a viewport of its size)
+// when they're called, compute passes bind OutputUAV.
+// --------------------------------------------------------
+struct PostProcessContext
+{
+	std::vector<ID3D11ShaderResourceView*> Inputs;	// Bind input i to slot i (t0, t1...)
+	ID3D11UnorderedAccessView* OutputUAV = 0;
+	unsigned int Width = 0;			// Of the output
+	unsigned int Height = 0;
+	unsigned int InputWidth = 0;	// Of the first input
+	unsigned int InputHeight = 0;
+	std::shared_ptr<SimpleVertexShader> FullscreenVS;	// One triangle, no buffers (Draw(3))
+	ID3D11SamplerState* ClampSampler = 0;
+};
+
+// --------------------------------------------------------
+// Runs a PostProcessChain on the GPU over a drawn scene,
+// with render targets from a RenderTargetCache: each pass
+// draws into whatever target the chain gave it.  Nothing
+// needs to be recreated on resize, the pool just stops
+// handing out the old size.
+// --------------------------------------------------------
+class PostProcessor
+{
+public:
+	using DrawPass = std::function<void(const PostProcessContext& context)>;
+
+	PostProcessor(std::shared_ptr<SimpleVertexShader> fullscreenVS);
+
+	unsigned int AddPass(const PostProcessPass& pass, DrawPass draw);
+	PostProcessPass& GetPass(unsigned int pass);
+
+	// Runs every enabled pass over the scene (width x height)
+	void Draw(ID3D11ShaderResourceView* scene, unsigned int width, unsigned int height, ID3D11RenderTargetView* backBuffer);
+
+	// Getters
+	const std::vector<ScheduledPass>& GetSchedule() const;
+	const RenderTargetPool& GetPool() const;
+	ID3D11SamplerState* GetClampSampler();
+
+private:
+	PostProcessChain chain;
+	RenderTargetCache targets;
+	std::vector<DrawPass> draws;
+	std::vector<ScheduledPass> schedule;
+	std::shared_ptr<SimpleVertexShader> fullscreenVS;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> clampSampler;
+};
@@ -0,0 +1,239 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <fstream>
+
+namespace Profiler
+{
+	// Annonymous namespace to hold variables
+	// only accessible in this file
+	namespace
+	{
+		constexpr unsigned int MaxThreads = 32;
+		constexpr unsigned int RingSize = 4096; // Power of 2
+		constexpr unsigned int MaxDepth = 64;
+		constexpr size_t FrameHistory = 120;	// Frames kept for trace export
+
+		// --------------------------------------------------------
+		// Single producer (the owning thread), single consumer
+		// (the main thread in EndFrame) ring of finished events
+		// --------------------------------------------------------
+		struct ThreadLog
+		{
+			ProfileEvent ring[RingSize];
+			std::atomic<uint64_t> writeIndex = 0;
+			uint64_t readIndex = 0;
+
+			// Producer-only stack of open markers
+			uint32_t depth = 0;
+			const char* openNames[MaxDepth] = {};
+			uint64_t openStarts[MaxDepth] = {};
+		};
+
+		ThreadLog logs[MaxThreads];
+		std::atomic<unsigned int> registeredThreads = 0;
+		std::atomic<uint64_t> droppedEvents = 0;
+		thread_local int localSlot = -1;
+
+		uint64_t frameCounter = 0;
+		uint64_t frameStart = 0;
+		ProfileFrame lastFrame;
+		std::deque<ProfileFrame> history;
+
+		ThreadLog* LocalLog()
+		{
+			if (localSlot < 0)
+			{
+				unsigned int slot = registeredThreads.fetch_add(1, std::memory_order_relaxed);
+				if (slot >= MaxThreads)
+				{
+					// Out of slots - this thread just won't be profiled
+					registeredThreads.store(MaxThreads, std::memory_order_relaxed);
+					return 0;
+				}
+				localSlot = (int)slot;
+			}
+			return &logs[localSlot];
+		}
+
+		// Moves everything a thread has finished into the frame
+		void Drain(uint32_t slot, ThreadLog& log, std::vector<ProfileEvent>& out)
+		{
+			uint64_t write = log.writeIndex.load(std::memory_order_acquire);
+
+			// Producer lapped us - skip what was overwritten
+			if (write - log.readIndex > RingSize)
+			{
+				droppedEvents.fetch_add(write - RingSize - log.readIndex, std::memory_order_relaxed);
+				log.readIndex = write - RingSize;
+			}
+
+			for (uint64_t i = log.readIndex; i < write; i++)
+			{
+				ProfileEvent e = log.ring[i & (RingSize - 1)];
+
+				// If the producer has since wrapped onto this slot the copy
+				// may be torn, so throw it away.  It fills a slot before
+				// publishing it, so at exactly RingSize ahead it may be
+				// writing this one right now.
+				if (log.writeIndex.load(std::memory_order_acquire) - i >= RingSize)
+				{
+					droppedEvents.fetch_add(1, std::memory_order_relaxed);
+					continue;
+				}
+
+				e.Thread = slot;
+				out.push_back(e);
+			}
+			log.readIndex = write;
+		}
+
+		void WriteEscaped(std::ofstream& file, const char* text)
+		{
+			for (const char* c = text; *c; c++)
+			{
+				if (*c == '"' || *c == '\\') file << '\\';
+				file << *c;
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Steady clock in nanoseconds.  Portable and cheap enough
+// for markers around whole systems.
+// --------------------------------------------------------
+uint64_t Profiler::Now()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double Profiler::TicksToMilliseconds(uint64_t ticks) { return (double)ticks / 1000000.0; }
+const ProfileFrame& Profiler::LastFrame() { return lastFrame; }
+unsigned int Profiler::ThreadCount() { return std::min(registeredThreads.load(), MaxThreads); }
+uint64_t Profiler::DroppedEvents() { return droppedEvents.load(); }
+
+void Profiler::BeginEvent(const char* name)
+{
+	ThreadLog* log = LocalLog();
+	if (!log)
+		return;
+
+	// Still count depth past the limit so End stays balanced
+	if (log->depth < MaxDepth)
+	{
+		log->openNames[log->depth] = name;
+		log->openStarts[log->depth] = Now();
+	}
+	log->depth++;
+}
+
+void Profiler::EndEvent()
+{
+	ThreadLog* log = LocalLog();
+	if (!log || log->depth == 0)
+		return;
+
+	log->depth--;
+	if (log->depth >= MaxDepth)
+		return;
+
+	uint64_t write = log->writeIndex.load(std::memory_order_relaxed);
+	ProfileEvent& e = log->ring[write & (RingSize - 1)];
+	e.Name = log->openNames[log->depth];
+	e.Start = log->openStarts[log->depth];
+	e.End = Now();
+	e.Depth = log->depth;
+	log->writeIndex.store(write + 1, std::memory_order_release);
+}
+
+// --------------------------------------------------------
+// Marks the start of a frame.  Call before any frame work.
+// --------------------------------------------------------
+void Profiler::BeginFrame()
+{
+	// Make sure the main thread claims slot 0
+	LocalLog();
+	frameStart = Now();
+}
+
+// --------------------------------------------------------
+// Collects everything recorded since the last EndFrame()
+// into LastFrame() and the export history.
+// --------------------------------------------------------
+void Profiler::EndFrame()
+{
+	ProfileFrame frame;
+	frame.FrameIndex = frameCounter++;
+	frame.Start = frameStart;
+	frame.End = Now();
+
+	unsigned int threads = ThreadCount();
+	for (unsigned int i = 0; i < threads; i++)
+		Drain(i, logs[i], frame.Events);
+
+	std::sort(frame.Events.begin(), frame.Events.end(), [](const ProfileEvent& a, const ProfileEvent& b) {
+		if (a.Thread != b.Thread) return a.Thread < b.Thread;
+		if (a.Start != b.Start) return a.Start < b.Start;
+		return a.Depth < b.Depth;
+	});
+
+	history.push_back(frame);
+	if (history.size() > FrameHistory)
+		history.pop_front();
+
+	lastFrame = std::move(frame);
+}
+
+// --------------------------------------------------------
+// Writes the frame history in the Chrome trace_event format
+// using complete ("X") events with microsecond times.
+//
+// path - File to create (overwritten if it exists)
+// --------------------------------------------------------
+bool Profiler::ExportChromeTrace(const std::string& path)
+{
+	std::ofstream file(path);
+	if (!file.is_open())
+		return false;
+
+	// Times are relative to the oldest frame so the numbers stay small
+	uint64_t origin = history.empty() ? 0 : history.front().Start;
+	bool first = true;
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	file.precision(3);
+	file << std::fixed;
+
+	for (unsigned int t = 0; t < ThreadCount(); t++)
+	{
+		file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << t
+			<< ",\"args\":{\"name\":\"" << (t == 0 ? "Main" : "Thread ") << (t == 0 ? "" : std::to_string(t)) << "\"}}";
+		first = false;
+	}
+
+	for (const ProfileFrame& frame : history)
+	{
+		// One marker per frame so frames are easy to spot
+		file << (first ? "" : ",") << "\n{\"name\":\"Frame " << frame.FrameIndex << "\",\"ph\":\"X\",\"pid\":0,\"tid\":0"
+			<< ",\"ts\":" << (frame.Start - origin) / 1000.0
+			<< ",\"dur\":" << (frame.End - frame.Start) / 1000.0 << "}";
+		first = false;
+
+		for (const ProfileEvent& e : frame.Events)
+		{
+			file << ",\n{\"name\":\"";
+			WriteEscaped(file, e.Name);
+			file << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << e.Thread
+				<< ",\"ts\":" << (e.Start - std::min(e.Start, origin)) / 1000.0
+				<< ",\"dur\":" << (e.End - e.Start) / 1000.0 << "}";
+		}
+	}
+
+	file << "\n]}\n";
+	return file.good();
+}
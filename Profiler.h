@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Markers are only compiled into debug builds unless
+// PROFILING_ENABLED is defined ahead of time
+#if !defined(PROFILING_ENABLED)
+#if defined(DEBUG) || defined(_DEBUG)
+#define PROFILING_ENABLED 1
+#else
+#define PROFILING_ENABLED 0
+#endif
+#endif
+
+// --------------------------------------------------------
+// A single finished marker (times are in Profiler ticks)
+// --------------------------------------------------------
+struct ProfileEvent
+{
+	const char* Name;		// Must be a string literal (or otherwise live forever)
+	uint64_t Start;
+	uint64_t End;
+	uint32_t Thread;		// Profiler thread slot, 0 is whoever recorded first
+	uint32_t Depth;			// Nesting level on that thread
+};
+
+// --------------------------------------------------------
+// Every event that finished during one frame, sorted by
+// thread and then start time (so children follow parents)
+// --------------------------------------------------------
+struct ProfileFrame
+{
+	uint64_t FrameIndex = 0;
+	uint64_t Start = 0;
+	uint64_t End = 0;
+	std::vector<ProfileEvent> Events;
+};
+
+// --------------------------------------------------------
+// Low overhead CPU profiler
+//
+// - Each thread writes into its own lock-free ring buffer
+// - The main thread drains every ring once per frame
+// - The last few frames can be exported as a Chrome trace
+//   (load the file in chrome://tracing or ui.perfetto.dev)
+// --------------------------------------------------------
+namespace Profiler
+{
+	// Frame boundaries (main thread only)
+	void BeginFrame();
+	void EndFrame();
+
+	// Markers - use PROFILE_SCOPE() rather than calling these directly
+	void BeginEvent(const char* name);
+	void EndEvent();
+
+	// Timing
+	uint64_t Now();
+	double TicksToMilliseconds(uint64_t ticks);
+
+	// Results
+	const ProfileFrame& LastFrame();
+	unsigned int ThreadCount();
+	uint64_t DroppedEvents();
+
+	// Writes the stored frame history as Chrome trace_event JSON
+	bool ExportChromeTrace(const std::string& path);
+}
+
+// Opens a marker now and closes it when it leaves scope
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name) { Profiler::BeginEvent(name); }
+	~ProfileScope() { Profiler::EndEvent(); }
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+#if PROFILING_ENABLED
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+#endif
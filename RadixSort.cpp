@@ -0,0 +1,105 @@
+#include "RadixSort.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <utility>
+
+void RadixSorter::Sort(uint32_t* keys, uint32_t* values, unsigned int count)
+{
+	if (count < 2)
+		return;
+
+	keyScratch.resize(count);
+	valueScratch.resize(count);
+
+	unsigned int chunks = count < ParallelThreshold ? 1 : std::max(1u, std::min(JobSystem::ThreadCount(), count / (ParallelThreshold / 4)));
+	unsigned int chunkSize = (count + chunks - 1) / chunks;
+	chunkOffsets.resize((size_t)chunks * Buckets);
+
+	// Runs body(chunk) for every chunk, spread across the job system when there are several
+	auto forEachChunk = [&](const std::function<void(unsigned int chunk)>& body) {
+		if (chunks == 1)
+			body(0);
+		else
+			JobSystem::ParallelFor(chunks, [&](unsigned int begin, unsigned int end) {
+				for (unsigned int c = begin; c < end; c++)
+					body(c);
+			}, 1);
+	};
+
+	uint32_t* keysIn = keys;
+	uint32_t* valuesIn = values;
+	uint32_t* keysOut = keyScratch.data();
+	uint32_t* valuesOut = valueScratch.data();
+
+	for (unsigned int shift = 0; shift < 32; shift += DigitBits)
+	{
+		// Count this digit in each chunk
+		forEachChunk([&](unsigned int chunk) {
+			uint32_t* histogram = &chunkOffsets[(size_t)chunk * Buckets];
+			memset(histogram, 0, sizeof(uint32_t) * Buckets);
+
+			unsigned int end = std::min(count, (chunk + 1) * chunkSize);
+			for (unsigned int i = chunk * chunkSize; i < end; i++)
+				histogram[(keysIn[i] >> shift) & (Buckets - 1)]++;
+		});
+
+		// Turn counts into where each chunk writes each digit: all of
+		// digit 0 (chunk by chunk), then all of digit 1, ...
+		bool allSameDigit = false;
+		uint32_t running = 0;
+		for (unsigned int digit = 0; digit < Buckets; digit++)
+		{
+			uint32_t digitStart = running;
+			for (unsigned int chunk = 0; chunk < chunks; chunk++)
+			{
+				uint32_t& slot = chunkOffsets[(size_t)chunk * Buckets + digit];
+				uint32_t digitCount = slot;
+				slot = running;
+				running += digitCount;
+			}
+			if (running - digitStart == count)
+				allSameDigit = true;
+		}
+
+		// Already in order for this digit
+		if (allSameDigit)
+			continue;
+
+		forEachChunk([&](unsigned int chunk) {
+			uint32_t* offsets = &chunkOffsets[(size_t)chunk * Buckets];
+
+			unsigned int end = std::min(count, (chunk + 1) * chunkSize);
+			for (unsigned int i = chunk * chunkSize; i < end; i++)
+			{
+				uint32_t destination = offsets[(keysIn[i] >> shift) & (Buckets - 1)]++;
+				keysOut[destination] = keysIn[i];
+				valuesOut[destination] = valuesIn[i];
+			}
+		});
+
+		std::swap(keysIn, keysOut);
+		std::swap(valuesIn, valuesOut);
+	}
+
+	// An odd number of passes leaves the result in the scratch arrays
+	if (keysIn != keys)
+	{
+		memcpy(keys, keysIn, sizeof(uint32_t) * count);
+		memcpy(values, valuesIn, sizeof(uint32_t) * count);
+	}
+}
+
+// --------------------------------------------------------
+// Flips the sign bit of positive floats and every bit of
+// negative ones, so comparing the bits as unsigned ints
+// gives the same order as comparing the floats
+// --------------------------------------------------------
+uint32_t RadixSorter::FloatToKey(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
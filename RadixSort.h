@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// --------------------------------------------------------
+// LSD radix sort of 32 bit keys, 11 bits per pass (three
+// passes), carrying a 32 bit value (usually an index)
+// along with each key.
+//
+// Big arrays are split into one chunk per job thread: each
+// pass counts digits per chunk in parallel, works out where
+// every chunk's digits go, then scatters in parallel.
+// Passes where every key has the same digit are skipped.
+// --------------------------------------------------------
+class RadixSorter
+{
+public:
+	// Sorts by key, smallest first.  Stable.
+	void Sort(uint32_t* keys, uint32_t* values, unsigned int count);
+
+	// Same order as the floats they came from (-inf ... +inf)
+	static uint32_t FloatToKey(float value);
+
+	// Below this many keys everything happens on the calling thread
+	static constexpr unsigned int ParallelThreshold = 32768;
+
+private:
+	static constexpr unsigned int DigitBits = 11;
+	static constexpr unsigned int Buckets = 1 << DigitBits;
+
+	std::vector<uint32_t> keyScratch;
+	std::vector<uint32_t> valueScratch;
+	std::vector<uint32_t> chunkOffsets;	// Buckets per chunk
+};
@@ -0,0 +1,161 @@
+#include "Random.h"
+#include "CpuFeatures.h"
+
+#include <immintrin.h>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Top 24 bits -> [0, 1), exact in a float
+	constexpr float UIntToFloat = 1.0f / 16777216.0f;
+
+	uint32_t RotateLeft(uint32_t x, int k)
+	{
+		return (x << k) | (x >> (32 - k));
+	}
+
+	// Spreads one 64 bit seed into well mixed state words
+	uint64_t SplitMix64(uint64_t& state)
+	{
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+}
+
+RandomGenerator::RandomGenerator(uint64_t seed)
+{
+	SetSeed(seed);
+}
+
+void RandomGenerator::SetSeed(uint64_t seed, uint64_t stream)
+{
+	this->seed = seed;
+
+	uint64_t mix = seed ^ (stream * 0xD1B54A32D192ED03ull);
+	for (unsigned int lane = 0; lane < Lanes; lane++)
+	{
+		uint64_t a = SplitMix64(mix);
+		uint64_t b = SplitMix64(mix);
+		s0[lane] = (uint32_t)a;
+		s1[lane] = (uint32_t)(a >> 32);
+		s2[lane] = (uint32_t)b;
+		s3[lane] = (uint32_t)(b >> 32);
+
+		// xoshiro never leaves the all zero state
+		if ((s0[lane] | s1[lane] | s2[lane] | s3[lane]) == 0)
+			s0[lane] = 1;
+	}
+
+	// Nothing buffered yet
+	bufferIndex = Lanes;
+}
+
+uint64_t RandomGenerator::GetSeed() const
+{
+	return seed;
+}
+
+uint32_t RandomGenerator::NextUInt()
+{
+	if (bufferIndex == Lanes)
+	{
+		Step(buffer);
+		bufferIndex = 0;
+	}
+	return buffer[bufferIndex++];
+}
+
+float RandomGenerator::NextFloat()
+{
+	return (NextUInt() >> 8) * UIntToFloat;
+}
+
+float RandomGenerator::NextFloat(float min, float max)
+{
+	return min + NextFloat() * (max - min);
+}
+
+// --------------------------------------------------------
+// Uses up anything left from the last step, then whole
+// steps straight into the output (8 at a time with AVX2),
+// then single values for the tail
+// --------------------------------------------------------
+void RandomGenerator::FillUniform(float* values, unsigned int count, float min, float max)
+{
+	const float range = max - min;
+	unsigned int i = 0;
+
+	while (i < count && bufferIndex < Lanes)
+		values[i++] = min + ((buffer[bufferIndex++] >> 8) * UIntToFloat) * range;
+
+	if (CpuFeatures::HasAVX2())
+	{
+		for (; i + Lanes <= count; i += Lanes)
+			StepAVX2(values + i, min, range);
+	}
+	else
+	{
+		uint32_t step[Lanes];
+		for (; i + Lanes <= count; i += Lanes)
+		{
+			Step(step);
+			for (unsigned int lane = 0; lane < Lanes; lane++)
+				values[i + lane] = min + ((step[lane] >> 8) * UIntToFloat) * range;
+		}
+	}
+
+	for (; i < count; i++)
+		values[i] = NextFloat(min, max);
+}
+
+// --------------------------------------------------------
+// One xoshiro128+ step of every lane
+// --------------------------------------------------------
+void RandomGenerator::Step(uint32_t output[Lanes])
+{
+	for (unsigned int lane = 0; lane < Lanes; lane++)
+	{
+		output[lane] = s0[lane] + s3[lane];
+
+		uint32_t t = s1[lane] << 9;
+		s2[lane] ^= s0[lane];
+		s3[lane] ^= s1[lane];
+		s1[lane] ^= s2[lane];
+		s0[lane] ^= s3[lane];
+		s2[lane] ^= t;
+		s3[lane] = RotateLeft(s3[lane], 11);
+	}
+}
+
+// --------------------------------------------------------
+// Same as Step(), all lanes at once, converted to floats.
+// Multiply then add (no FMA) so it rounds like the scalar path.
+// --------------------------------------------------------
+CPU_TARGET_AVX2 void RandomGenerator::StepAVX2(float* values, float min, float range)
+{
+	__m256i a = _mm256_load_si256((const __m256i*)s0);
+	__m256i b = _mm256_load_si256((const __m256i*)s1);
+	__m256i c = _mm256_load_si256((const __m256i*)s2);
+	__m256i d = _mm256_load_si256((const __m256i*)s3);
+
+	__m256i result = _mm256_add_epi32(a, d);
+
+	__m256i t = _mm256_slli_epi32(b, 9);
+	c = _mm256_xor_si256(c, a);
+	d = _mm256_xor_si256(d, b);
+	b = _mm256_xor_si256(b, c);
+	a = _mm256_xor_si256(a, d);
+	c = _mm256_xor_si256(c, t);
+	d = _mm256_or_si256(_mm256_slli_epi32(d, 11), _mm256_srli_epi32(d, 21));
+
+	_mm256_store_si256((__m256i*)s0, a);
+	_mm256_store_si256((__m256i*)s1, b);
+	_mm256_store_si256((__m256i*)s2, c);
+	_mm256_store_si256((__m256i*)s3, d);
+
+	__m256 unit = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(result, 8)), _mm256_set1_ps(UIntToFloat));
+	_mm256_storeu_ps(values, _mm256_add_ps(_mm256_set1_ps(min), _mm256_mul_ps(unit, _mm256_set1_ps(range))));
+}
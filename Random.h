@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+
+// --------------------------------------------------------
+// Seeded random number generator: 8 interleaved xoshiro128+
+// lanes, so FillUniform() can make 8 numbers per AVX2 step.
+//
+// The stream only depends on the seed - single calls and
+// batches (AVX2 or scalar) hand out exactly the same values
+// in the same order, so a seed replays the same particles.
+// Not thread safe; give each emitter/thread its own.
+// --------------------------------------------------------
+class RandomGenerator
+{
+public:
+	static constexpr unsigned int Lanes = 8;
+
+	RandomGenerator(uint64_t seed = 1);
+
+	// Restarts the stream.  Different streams of one seed are
+	// independent (e.g. one per worker when spawning in parallel)
+	void SetSeed(uint64_t seed, uint64_t stream = 0);
+	uint64_t GetSeed() const;
+
+	// Single values
+	uint32_t NextUInt();
+	float NextFloat();							// [0, 1)
+	float NextFloat(float min, float max);		// [min, max)
+
+	// Batch of count values in [min, max)
+	void FillUniform(float* values, unsigned int count, float min = 0.0f, float max = 1.0f);
+
+private:
+	uint64_t seed;
+
+	// Lane state, one column per lane
+	alignas(32) uint32_t s0[Lanes];
+	alignas(32) uint32_t s1[Lanes];
+	alignas(32) uint32_t s2[Lanes];
+	alignas(32) uint32_t s3[Lanes];
+
+	// Last step's output, handed out one at a time
+	alignas(32) uint32_t buffer[Lanes];
+	unsigned int bufferIndex;
+
+	void Step(uint32_t output[Lanes]);
+	void StepAVX2(float* values, float min, float range);
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "RenderDevice.h"
+
+// --------------------------------------------------------
+// Null backend used for headless runs.  Nothing reaches
+// a GPU - calls are only counted, so the CPU side of the
+// frame can be timed on machines without a display.
+// --------------------------------------------------------
+class RecordingRenderDevice : public IRenderDevice
+{
+public:
+	void SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) override { stats.StateBinds++; }
+	void SetVertexBuffer(ID3D11Buffer* buffer, unsigned int stride) override { stats.ResourceBinds++; }
+	void SetIndexBuffer(ID3D11Buffer* buffer) override { stats.ResourceBinds++; }
+
+	void SetBlendState(ID3D11BlendState* state) override { stats.StateBinds++; }
+	void SetDepthStencilState(ID3D11DepthStencilState* state) override { stats.StateBinds++; }
+	void SetRasterizerState(ID3D11RasterizerState* state) override { stats.StateBinds++; }
+	void SetViewport(float width, float height) override { stats.StateBinds++; }
+
+	void SetRenderTargets(unsigned int count, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv) override { stats.ResourceBinds++; }
+	void ClearRenderTarget(ID3D11RenderTargetView* rtv, const float color[4]) override { stats.Clears++; }
+	void ClearDepth(ID3D11DepthStencilView* dsv, float depth) override { stats.Clears++; }
+	void UnbindPixelShader() override { stats.StateBinds++; }
+	void UnbindPixelShaderResources(unsigned int count) override { stats.ResourceBinds++; }
+	void UnbindComputeShaderResources(unsigned int count) override { stats.ResourceBinds++; }
+	void UnbindComputeUnorderedAccessViews(unsigned int count) override { stats.ResourceBinds++; }
+
+	void UploadDynamicBuffer(ID3D11Buffer* buffer, const void* dataA, size_t bytesA, const void* dataB, size_t bytesB) override
+	{
+		stats.BytesUploaded += bytesA + bytesB;
+	}
+
+	void UpdateBuffer(ID3D11Buffer* buffer, unsigned int offset, const void* data, size_t bytes) override
+	{
+		stats.BytesUploaded += bytes;
+	}
+
+	void UpdateSubresource(ID3D11Resource* resource, unsigned int subresource, const void* data, unsigned int rowPitch, size_t bytes) override
+	{
+		stats.BytesUploaded += bytes;
+	}
+
+	void CopySubresourceRegion(ID3D11Resource* dest, unsigned int destSubresource, ID3D11Resource* source, unsigned int sourceSubresource) override { stats.Copies++; }
+	void GenerateMips(ID3D11ShaderResourceView* srv) override { stats.Copies++; }
+
+	void Draw(unsigned int vertexCount) override
+	{
+		stats.DrawCalls++;
+		stats.IndicesSubmitted += vertexCount;
+	}
+
+	void DrawIndexed(unsigned int indexCount) override
+	{
+		stats.DrawCalls++;
+		stats.IndicesSubmitted += indexCount;
+	}
+
+	void Dispatch(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ) override { stats.Dispatches++; }
+
+	void Present(bool vsync) override { stats.Presents++; }
+};
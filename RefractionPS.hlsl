@@ -5,10 +5,6 @@
 
 cbuffer ExternalData : register(b0)
 {
-	// Scene related
-    Lights lights[MAX_LIGHTS];
-    int lightCount;
-	
 	// Camera related
     float3 cameraPosition;
 	
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <d3d11.h>
+
+// --------------------------------------------------------
+// Running totals of everything submitted through a device
+// --------------------------------------------------------
+struct RenderDeviceStats
+{
+	unsigned long long DrawCalls = 0;
+	unsigned long long IndicesSubmitted = 0;	// Vertices for non-indexed draws
+	unsigned long long StateBinds = 0;			// Blend/depth/raster states, viewports, topology, shaders
+	unsigned long long ResourceBinds = 0;		// Vertex/index buffers, render targets, SRVs
+	unsigned long long Clears = 0;
+	unsigned long long Dispatches = 0;
+	unsigned long long Copies = 0;				// GPU side copies and mip generation
+	unsigned long long BytesUploaded = 0;
+	unsigned long long Presents = 0;
+};
+
+// --------------------------------------------------------
+// The per-frame command side of the graphics API.
+//
+// Resource creation still goes through Graphics::Device,
+// but everything the frame loop submits goes through here
+// so it can be swapped for a backend that only records.
+// --------------------------------------------------------
+class IRenderDevice
+{
+public:
+	virtual ~IRenderDevice() = default;
+
+	// Input assembler
+	virtual void SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) = 0;
+	virtual void SetVertexBuffer(ID3D11Buffer* buffer, unsigned int stride) = 0;
+	virtual void SetIndexBuffer(ID3D11Buffer* buffer) = 0;
+
+	// Fixed function state (null = API default)
+	virtual void SetBlendState(ID3D11BlendState* state) = 0;
+	virtual void SetDepthStencilState(ID3D11DepthStencilState* state) = 0;
+	virtual void SetRasterizerState(ID3D11RasterizerState* state) = 0;
+	virtual void SetViewport(float width, float height) = 0;
+
+	// Targets and resources
+	virtual void SetRenderTargets(unsigned int count, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv) = 0;
+	virtual void ClearRenderTarget(ID3D11RenderTargetView* rtv, const float color[4]) = 0;
+	virtual void ClearDepth(ID3D11DepthStencilView* dsv, float depth) = 0;
+	virtual void UnbindPixelShader() = 0;
+	virtual void UnbindPixelShaderResources(unsigned int count) = 0;
+	virtual void UnbindComputeShaderResources(unsigned int count) = 0;
+	virtual void UnbindComputeUnorderedAccessViews(unsigned int count) = 0;
+
+	// Overwrites the start of a dynamic buffer (WRITE_DISCARD)
+	// with up to two chunks of data, one after the other
+	virtual void UploadDynamicBuffer(ID3D11Buffer* buffer, const void* dataA, size_t bytesA, const void* dataB = 0, size_t bytesB = 0) = 0;
+
+	// Overwrites part of a default usage buffer (UpdateSubresource),
+	// leaving the rest of its contents alone
+	virtual void UpdateBuffer(ID3D11Buffer* buffer, unsigned int offset, const void* data, size_t bytes) = 0;
+
+	// Overwrites a whole subresource of a default usage texture.
+	// bytes is the size of the data (also passed as the depth pitch)
+	virtual void UpdateSubresource(ID3D11Resource* resource, unsigned int subresource, const void* data, unsigned int rowPitch, size_t bytes) = 0;
+
+	// Copies a whole subresource into the top left corner of another
+	virtual void CopySubresourceRegion(ID3D11Resource* dest, unsigned int destSubresource, ID3D11Resource* source, unsigned int sourceSubresource) = 0;
+	virtual void GenerateMips(ID3D11ShaderResourceView* srv) = 0;
+
+	// Drawing
+	virtual void Draw(unsigned int vertexCount) = 0;
+	virtual void DrawIndexed(unsigned int indexCount) = 0;
+	virtual void Dispatch(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ) = 0;
+	virtual void Present(bool vsync) = 0;
+
+	// Stats
+	const RenderDeviceStats& Stats() const { return stats; }
+	void ResetStats() { stats = {}; }
+
+protected:
+	RenderDeviceStats stats;
+};
@@ -0,0 +1,195 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+
+unsigned int RenderGraph::CreateTexture(const std::string& name, const RenderTargetDesc& desc)
+{
+	Resource resource;
+	resource.Name = name;
+	resource.Desc = desc;
+	resources.push_back(resource);
+	return (unsigned int)resources.size() - 1;
+}
+
+unsigned int RenderGraph::ImportTexture(const std::string& name)
+{
+	Resource resource;
+	resource.Name = name;
+	resource.Imported = true;
+	resources.push_back(resource);
+	return (unsigned int)resources.size() - 1;
+}
+
+void RenderGraph::SetTextureDesc(unsigned int resource, const RenderTargetDesc& desc)
+{
+	resources[resource].Desc = desc;
+}
+
+unsigned int RenderGraph::AddPass(const std::string& name)
+{
+	Pass pass;
+	pass.Name = name;
+	passes.push_back(pass);
+	return (unsigned int)passes.size() - 1;
+}
+
+void RenderGraph::Read(unsigned int pass, unsigned int resource, unsigned int slot)
+{
+	ShaderRead read;
+	read.Resource = resource;
+	read.Slot = slot;
+	passes[pass].Reads.push_back(read);
+}
+
+void RenderGraph::Write(unsigned int pass, unsigned int resource)
+{
+	passes[pass].RenderTargets.push_back(resource);
+}
+
+void RenderGraph::WriteDepth(unsigned int pass, unsigned int resource)
+{
+	passes[pass].DepthTarget = (int)resource;
+}
+
+void RenderGraph::Compile(RenderTargetPool& pool, CompiledRenderGraph& compiled) const
+{
+	compiled.Passes.clear();
+	compiled.Culled.assign(passes.size(), true);
+	compiled.Physical.assign(resources.size(), Unused);
+	compiled.FirstUse.assign(resources.size(), -1);
+	compiled.LastUse.assign(resources.size(), -1);
+
+	// Backwards from what leaves the frame (imported resources):
+	// a pass is needed if it writes something needed
+	std::vector<bool> needed(resources.size());
+	for (size_t r = 0; r < resources.size(); r++)
+		needed[r] = resources[r].Imported;
+	for (int p = (int)passes.size() - 1; p >= 0; p--)
+	{
+		const Pass& pass = passes[p];
+		bool keep = pass.DepthTarget >= 0 && needed[pass.DepthTarget];
+		for (unsigned int r : pass.RenderTargets)
+			keep = keep || needed[r];
+		if (!keep)
+			continue;
+
+		compiled.Culled[p] = false;
+		for (const ShaderRead& read : pass.Reads)
+			needed[read.Resource] = true;
+	}
+
+	// What every kept pass uses, and over which passes each resource lives
+	std::vector<std::vector<unsigned int>> uses;
+	for (unsigned int p = 0; p < passes.size(); p++)
+	{
+		if (compiled.Culled[p])
+			continue;
+		const Pass& pass = passes[p];
+
+		CompiledRenderPass compiledPass;
+		compiledPass.Pass = p;
+		compiledPass.RenderTargets = pass.RenderTargets;
+		compiledPass.DepthTarget = pass.DepthTarget;
+		std::vector<unsigned int> used = pass.RenderTargets;
+		if (pass.DepthTarget >= 0)
+			used.push_back(pass.DepthTarget);
+		for (const ShaderRead& read : pass.Reads)
+		{
+			compiledPass.Reads.push_back(read.Resource);
+			used.push_back(read.Resource);
+		}
+
+		int index = (int)compiled.Passes.size();
+		for (unsigned int r : used)
+		{
+			if (compiled.FirstUse[r] < 0)
+				compiled.FirstUse[r] = index;
+			compiled.LastUse[r] = index;
+		}
+		compiled.Passes.push_back(compiledPass);
+		uses.push_back(used);
+	}
+
+	// Targets for transient resources, only held while they're alive.
+	// Everything a pass uses is acquired before anything is released,
+	// so a pass never gets a texture it's also using for something else.
+	for (int k = 0; k < (int)compiled.Passes.size(); k++)
+	{
+		for (unsigned int r : uses[k])
+			if (!resources[r].Imported && compiled.FirstUse[r] == k && compiled.Physical[r] == Unused)
+				compiled.Physical[r] = (int)pool.Acquire(resources[r].Desc);
+		for (unsigned int r = 0; r < resources.size(); r++)
+			if (!resources[r].Imported && compiled.LastUse[r] == k && compiled.Physical[r] >= 0)
+				pool.Release(compiled.Physical[r]);
+	}
+	for (unsigned int r = 0; r < resources.size(); r++)
+		if (resources[r].Imported && compiled.FirstUse[r] >= 0)
+			compiled.Physical[r] = Imported;
+
+	// Same texture: same target, or the same imported resource
+	auto sameTexture = [&](unsigned int a, unsigned int b) {
+		if (resources[a].Imported || resources[b].Imported)
+			return a == b;
+		return compiled.Physical[a] == compiled.Physical[b];
+	};
+
+	// Reads to unbind after each pass: ones whose texture is next
+	// drawn to, read somewhere else, or not used again this frame
+	// (next frame it could be anything)
+	for (size_t k = 0; k < compiled.Passes.size(); k++)
+	{
+		CompiledRenderPass& compiledPass = compiled.Passes[k];
+		for (const ShaderRead& read : passes[compiledPass.Pass].Reads)
+		{
+			bool stillBound = false;
+			for (size_t j = k + 1; j < compiled.Passes.size(); j++)
+			{
+				const Pass& next = passes[compiled.Passes[j].Pass];
+				bool written = next.DepthTarget >= 0 && sameTexture(read.Resource, next.DepthTarget);
+				for (unsigned int r : next.RenderTargets)
+					written = written || sameTexture(read.Resource, r);
+				bool readThere = false;
+				for (const ShaderRead& nextRead : next.Reads)
+					readThere = readThere || sameTexture(read.Resource, nextRead.Resource);
+				if (!written && !readThere)
+					continue;
+
+				for (const ShaderRead& nextRead : next.Reads)
+					stillBound = stillBound || (!written && nextRead.Slot == read.Slot && sameTexture(read.Resource, nextRead.Resource));
+				break;
+			}
+			if (!stillBound)
+				compiledPass.UnbindAfter = std::max(compiledPass.UnbindAfter, read.Slot + 1);
+		}
+	}
+}
+
+unsigned int RenderGraph::GetPassCount() const
+{
+	return (unsigned int)passes.size();
+}
+
+unsigned int RenderGraph::GetResourceCount() const
+{
+	return (unsigned int)resources.size();
+}
+
+const std::string& RenderGraph::GetPassName(unsigned int pass) const
+{
+	return passes[pass].Name;
+}
+
+const std::string& RenderGraph::GetResourceName(unsigned int resource) const
+{
+	return resources[resource].Name;
+}
+
+const RenderTargetDesc& RenderGraph::GetResourceDesc(unsigned int resource) const
+{
+	return resources[resource].Desc;
+}
+
+bool RenderGraph::IsImported(unsigned int resource) const
+{
+	return resources[resource].Imported;
+}
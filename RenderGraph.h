@@ -0,0 +1,112 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "RenderTargetPool.h"
+
+// --------------------------------------------------------
+// A pass as it runs this frame: what to bind before it
+// and what to unbind after it
+// --------------------------------------------------------
+struct CompiledRenderPass
+{
+	unsigned int Pass = 0;
+	std::vector<unsigned int> Reads;			// Resources, in the order they were declared
+	std::vector<unsigned int> RenderTargets;	// Resources
+	int DepthTarget = -1;						// Resource, or -1 for none
+	unsigned int UnbindAfter = 0;				// Shader resource slots to clear once it's done
+};
+
+// --------------------------------------------------------
+// What compiling a RenderGraph decided for one frame
+// --------------------------------------------------------
+struct CompiledRenderGraph
+{
+	std::vector<CompiledRenderPass> Passes;		// Ones that weren't culled, in order
+	std::vector<bool> Culled;					// By pass
+
+	// By resource: a pool target for transient ones, or
+	// RenderGraph::Imported / RenderGraph::Unused
+	std::vector<int> Physical;
+	std::vector<int> FirstUse;					// Index into Passes, -1 if unused
+	std::vector<int> LastUse;
+};
+
+// --------------------------------------------------------
+// The passes of a frame and the textures they read and
+// write, declared up front instead of bound by hand, and
+// compiled with no GPU work (see RenderGraphExecutor for
+// that) so it can be tested on its own.
+//
+// Compiling:
+//  - Culls passes whose writes nothing kept ever reads.
+//    Imported resources (the back buffer, say) are always
+//    read.  Writes keep what was there, so every earlier
+//    writer of something needed is needed too.
+//  - Gives each transient resource a RenderTargetPool
+//    target for just the passes between its first and last
+//    use, so ones that don't overlap (and look alike) share
+//    the same texture.
+//  - Works out which shader resource slots to clear after
+//    each pass: a read is unbound unless the next use of its
+//    texture is a read at the same slot, so nothing is ever
+//    drawn to while it's still bound for reading.
+//
+// Passes run in the order they're added.
+// --------------------------------------------------------
+class RenderGraph
+{
+public:
+	static constexpr int Imported = -1;
+	static constexpr int Unused = -2;
+
+	// Made (and aliased) by the graph, only alive during the frame
+	unsigned int CreateTexture(const std::string& name, const RenderTargetDesc& desc);
+	// Made elsewhere, bound by the graph but never aliased or culled
+	unsigned int ImportTexture(const std::string& name);
+	// For a transient texture, from the next Compile() on (a resize, say)
+	void SetTextureDesc(unsigned int resource, const RenderTargetDesc& desc);
+
+	unsigned int AddPass(const std::string& name);
+	void Read(unsigned int pass, unsigned int resource, unsigned int slot);
+	void Write(unsigned int pass, unsigned int resource);		// As a render target
+	void WriteDepth(unsigned int pass, unsigned int resource);
+
+	// Acquires (and releases) the transient textures' targets from the
+	// pool.  The pool should be between BeginFrame() and EndFrame().
+	void Compile(RenderTargetPool& pool, CompiledRenderGraph& compiled) const;
+
+	// Getters
+	unsigned int GetPassCount() const;
+	unsigned int GetResourceCount() const;
+	const std::string& GetPassName(unsigned int pass) const;
+	const std::string& GetResourceName(unsigned int resource) const;
+	const RenderTargetDesc& GetResourceDesc(unsigned int resource) const;
+	bool IsImported(unsigned int resource) const;
+
+private:
+	struct Resource
+	{
+		std::string Name;
+		RenderTargetDesc Desc;
+		bool Imported = false;
+	};
+
+	struct ShaderRead
+	{
+		unsigned int Resource = 0;
+		unsigned int Slot = 0;
+	};
+
+	struct Pass
+	{
+		std::string Name;
+		std::vector<ShaderRead> Reads;
+		std::vector<unsigned int> RenderTargets;
+		int DepthTarget = -1;
+	};
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+};
@@ -0,0 +1,105 @@
+#include "RenderGraphExecutor.h"
+#include "Graphics.h"
+#include "Profiler.h"
+
+RenderGraph& RenderGraphExecutor::GetGraph()
+{
+	return graph;
+}
+
+unsigned int RenderGraphExecutor::AddPass(const std::string& name, DrawPass draw)
+{
+	draws.push_back(draw);
+	return graph.AddPass(name);
+}
+
+void RenderGraphExecutor::Import(unsigned int resource, ID3D11RenderTargetView* rtv, ID3D11DepthStencilView* dsv, ID3D11ShaderResourceView* srv, unsigned int width, unsigned int height)
+{
+	if (resource >= imported.size())
+		imported.resize(resource + 1);
+
+	ResourceViews& views = imported[resource];
+	views.RTV = rtv;
+	views.DSV = dsv;
+	views.SRV = srv;
+	views.Width = width;
+	views.Height = height;
+}
+
+void RenderGraphExecutor::Execute()
+{
+	PROFILE_SCOPE("RenderGraphExecutor::Execute");
+
+	targets.GetPool().BeginFrame();
+	graph.Compile(targets.GetPool(), compiled);
+	for (const CompiledRenderPass& pass : compiled.Passes)
+	{
+		RenderGraphContext context;
+		for (unsigned int r : pass.Reads)
+			context.Reads.push_back(GetViews(r).SRV);
+		for (unsigned int r : pass.RenderTargets)
+		{
+			ResourceViews views = GetViews(r);
+			context.RenderTargets.push_back(views.RTV);
+			context.Width = views.Width;
+			context.Height = views.Height;
+		}
+		if (pass.DepthTarget >= 0)
+		{
+			ResourceViews views = GetViews(pass.DepthTarget);
+			context.DepthTarget = views.DSV;
+			context.Width = views.Width;
+			context.Height = views.Height;
+		}
+
+		// Depth only passes still need a (null) render target bound over the last one
+		ID3D11RenderTargetView* noRTV = 0;
+		if (context.RenderTargets.empty())
+			Graphics::Renderer->SetRenderTargets(1, &noRTV, context.DepthTarget);
+		else
+			Graphics::Renderer->SetRenderTargets((unsigned int)context.RenderTargets.size(), context.RenderTargets.data(), context.DepthTarget);
+		if (context.Width > 0)
+			Graphics::Renderer->SetViewport((float)context.Width, (float)context.Height);
+
+		draws[pass.Pass](context);
+
+		if (pass.UnbindAfter > 0)
+			Graphics::Renderer->UnbindPixelShaderResources(pass.UnbindAfter);
+	}
+
+	targets.EndFrame();
+}
+
+// Views of a resource, imported or transient
+RenderGraphExecutor::ResourceViews RenderGraphExecutor::GetViews(unsigned int resource)
+{
+	int physical = resource < compiled.Physical.size() ? compiled.Physical[resource] : RenderGraph::Unused;
+	if (physical == RenderGraph::Imported)
+		return resource < imported.size() ? imported[resource] : ResourceViews();
+	if (physical < 0)
+		return ResourceViews();
+
+	RenderTargetViews& target = targets.GetViews(physical);
+	ResourceViews views;
+	views.RTV = target.RTV.Get();
+	views.DSV = target.DSV.Get();
+	views.SRV = target.SRV.Get();
+	views.Width = target.Desc.Width;
+	views.Height = target.Desc.Height;
+	return views;
+}
+
+ID3D11ShaderResourceView* RenderGraphExecutor::GetSRV(unsigned int resource)
+{
+	return GetViews(resource).SRV;
+}
+
+const CompiledRenderGraph& RenderGraphExecutor::GetCompiled() const
+{
+	return compiled;
+}
+
+const RenderTargetPool& RenderGraphExecutor::GetPool() const
+{
+	return targets.GetPool();
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <d3d11.h>
+#include <functional>
+#include <vector>
+
+#include "RenderGraph.h"
+#include "RenderTargetCache.h"
+
+// --------------------------------------------------------
+// What a pass gets to draw with.  Its render targets and
+// depth target are already bound (with a viewport of
+// their size) when it's called.
+// --------------------------------------------------------
+struct RenderGraphContext
+{
+	std::vector<ID3D11ShaderResourceView*> Reads;		// In the order they were declared
+	std::vector<ID3D11RenderTargetView*> RenderTargets;
+	ID3D11DepthStencilView* DepthTarget = 0;
+	unsigned int Width = 0;
+	unsigned int Height = 0;
+};
+
+// --------------------------------------------------------
+// Runs a RenderGraph on the GPU: compiles it every frame,
+// makes the textures behind its transient resources (from
+// a RenderTargetCache, so they carry over between frames),
+// binds each pass's targets, calls it, and clears the
+// shader resource slots the graph says to.
+//
+// Usage, every frame:
+//   Import() each imported resource -> Execute()
+// --------------------------------------------------------
+class RenderGraphExecutor
+{
+public:
+	using DrawPass = std::function<void(const RenderGraphContext& context)>;
+
+	RenderGraph& GetGraph();
+	unsigned int AddPass(const std::string& name, DrawPass draw);
+
+	// Views of something made elsewhere for this frame (any can be null
+	// if the graph never uses it that way)
+	void Import(unsigned int resource, ID3D11RenderTargetView* rtv, ID3D11DepthStencilView* dsv, ID3D11ShaderResourceView* srv, unsigned int width, unsigned int height);
+
+	void Execute();
+
+	// Getters
+	// What a resource was last frame (null if it was culled or unused)
+	ID3D11ShaderResourceView* GetSRV(unsigned int resource);
+	const CompiledRenderGraph& GetCompiled() const;
+	const RenderTargetPool& GetPool() const;
+
+private:
+	struct ResourceViews
+	{
+		ID3D11RenderTargetView* RTV = 0;
+		ID3D11DepthStencilView* DSV = 0;
+		ID3D11ShaderResourceView* SRV = 0;
+		unsigned int Width = 0;
+		unsigned int Height = 0;
+	};
+
+	ResourceViews GetViews(unsigned int resource);
+
+	RenderGraph graph;
+	RenderTargetCache targets;
+	std::vector<DrawPass> draws;
+	std::vector<ResourceViews> imported;	// By resource
+	CompiledRenderGraph compiled;
+};
@@ -0,0 +1,96 @@
+#include "RenderTargetCache.h"
+#include "Graphics.h"
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	DXGI_FORMAT ToDXGI(RenderTargetFormat format)
+	{
+		switch (format)
+		{
+		case RenderTargetFormat::RGBA16F: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+		case RenderTargetFormat::R11G11B10F: return DXGI_FORMAT_R11G11B10_FLOAT;
+		case RenderTargetFormat::R8: return DXGI_FORMAT_R8_UNORM;
+		case RenderTargetFormat::D32: return DXGI_FORMAT_R32_TYPELESS; // Viewed as depth or as a float
+		default: return DXGI_FORMAT_R8G8B8A8_UNORM;
+		}
+	}
+}
+
+RenderTargetCache::RenderTargetCache(unsigned int maxIdleFrames) :
+	pool(maxIdleFrames)
+{
+}
+
+RenderTargetPool& RenderTargetCache::GetPool()
+{
+	return pool;
+}
+
+const RenderTargetPool& RenderTargetCache::GetPool() const
+{
+	return pool;
+}
+
+RenderTargetViews& RenderTargetCache::GetViews(unsigned int target)
+{
+	if (target >= views.size())
+		views.resize(target + 1);
+
+	RenderTargetViews& v = views[target];
+	const RenderTargetDesc& desc = pool.GetDesc(target);
+	if (v.SRV && v.Desc == desc)
+		return v;
+
+	v = RenderTargetViews();
+	v.Desc = desc;
+	bool depth = desc.Format == RenderTargetFormat::D32;
+
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = desc.Width;
+	textureDesc.Height = desc.Height;
+	textureDesc.ArraySize = 1;
+	textureDesc.MipLevels = 1;
+	textureDesc.Format = ToDXGI(desc.Format);
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | (depth ? D3D11_BIND_DEPTH_STENCIL : D3D11_BIND_RENDER_TARGET);
+	if (desc.UnorderedAccess && !depth)
+		textureDesc.BindFlags |= D3D11_BIND_UNORDERED_ACCESS;
+
+	// No need to track the texture, the views keep it alive
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	Graphics::Device->CreateTexture2D(&textureDesc, 0, texture.GetAddressOf());
+	if (!texture)
+		return v;
+
+	if (depth)
+	{
+		D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+		dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
+		dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+		Graphics::Device->CreateDepthStencilView(texture.Get(), &dsvDesc, v.DSV.GetAddressOf());
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MipLevels = 1;
+		Graphics::Device->CreateShaderResourceView(texture.Get(), &srvDesc, v.SRV.GetAddressOf());
+		return v;
+	}
+
+	Graphics::Device->CreateRenderTargetView(texture.Get(), 0, v.RTV.GetAddressOf());
+	Graphics::Device->CreateShaderResourceView(texture.Get(), 0, v.SRV.GetAddressOf());
+	if (desc.UnorderedAccess)
+		Graphics::Device->CreateUnorderedAccessView(texture.Get(), 0, v.UAV.GetAddressOf());
+	return v;
+}
+
+void RenderTargetCache::EndFrame()
+{
+	pool.EndFrame(destroyed);
+	for (unsigned int target : destroyed)
+		if (target < views.size())
+			views[target] = RenderTargetViews();
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <vector>
+
+#include "RenderTargetPool.h"
+
+// --------------------------------------------------------
+// The views of a pooled render target its format allows:
+// depth targets get a DSV and no RTV, anything else an RTV
+// (and a UAV if it asked for one).  All can be read.
+// --------------------------------------------------------
+struct RenderTargetViews
+{
+	RenderTargetDesc Desc;
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> RTV;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> DSV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SRV;
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> UAV;
+};
+
+// --------------------------------------------------------
+// A RenderTargetPool with the GPU textures behind it: a
+// texture is made the first time its target is asked for
+// (or when the pool hands the index out again with another
+// description), and freed once the pool drops it.
+//
+// Usage, every frame:
+//   GetPool().BeginFrame() -> Acquire() / GetViews() ... ->
+//   EndFrame()
+// --------------------------------------------------------
+class RenderTargetCache
+{
+public:
+	RenderTargetCache(unsigned int maxIdleFrames = 30);
+
+	RenderTargetPool& GetPool();
+	const RenderTargetPool& GetPool() const;
+
+	// Views of a target the pool has handed out
+	RenderTargetViews& GetViews(unsigned int target);
+
+	// Ends the pool's frame, then frees what it dropped
+	void EndFrame();
+
+private:
+	RenderTargetPool pool;
+	std::vector<RenderTargetViews> views;	// By pool index
+	std::vector<unsigned int> destroyed;
+};
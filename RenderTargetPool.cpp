@@ -0,0 +1,136 @@
+#include "RenderTargetPool.h"
+
+#include <algorithm>
+
+bool RenderTargetDesc::operator==(const RenderTargetDesc& other) const
+{
+	return Width == other.Width && Height == other.Height && Format == other.Format && UnorderedAccess == other.UnorderedAccess;
+}
+
+size_t RenderTargetDesc::Bytes() const
+{
+	size_t pixel = 4;
+	switch (Format)
+	{
+	case RenderTargetFormat::RGBA16F: pixel = 8; break;
+	case RenderTargetFormat::R8: pixel = 1; break;
+	default: break;
+	}
+	return (size_t)Width * Height * pixel;
+}
+
+RenderTargetPool::RenderTargetPool(unsigned int maxIdleFrames) :
+	maxIdleFrames(maxIdleFrames),
+	frame(0)
+{
+}
+
+void RenderTargetPool::BeginFrame()
+{
+	frame++;
+	stats.PeakInUse = stats.InUse;
+}
+
+unsigned int RenderTargetPool::Acquire(const RenderTargetDesc& desc, bool* created)
+{
+	// The most recently used free match, so the same targets keep being picked
+	int best = -1;
+	int empty = -1;
+	for (int i = 0; i < (int)targets.size(); i++)
+	{
+		const Target& t = targets[i];
+		if (!t.Alive)
+		{
+			if (empty < 0)
+				empty = i;
+			continue;
+		}
+		if (!t.InUse && t.Desc == desc && (best < 0 || t.LastUsed > targets[best].LastUsed))
+			best = i;
+	}
+
+	bool isNew = best < 0;
+	if (isNew)
+	{
+		if (empty < 0)
+		{
+			empty = (int)targets.size();
+			targets.emplace_back();
+		}
+		best = empty;
+
+		Target& t = targets[best];
+		t.Desc = desc;
+		t.Alive = true;
+		stats.Targets++;
+		stats.Created++;
+		stats.Bytes += desc.Bytes();
+	}
+
+	Target& t = targets[best];
+	t.InUse = true;
+	t.LastUsed = frame;
+	stats.InUse++;
+	stats.PeakInUse = std::max(stats.PeakInUse, stats.InUse);
+	if (created)
+		*created = isNew;
+	return (unsigned int)best;
+}
+
+void RenderTargetPool::Release(unsigned int target)
+{
+	Target& t = targets[target];
+	if (!t.InUse)
+		return;
+	t.InUse = false;
+	stats.InUse--;
+}
+
+void RenderTargetPool::EndFrame(std::vector<unsigned int>& destroyed)
+{
+	destroyed.clear();
+	for (unsigned int i = 0; i < targets.size(); i++)
+	{
+		Release(i);
+		if (targets[i].Alive && frame - targets[i].LastUsed > maxIdleFrames)
+			Destroy(i, destroyed);
+	}
+}
+
+void RenderTargetPool::Clear(std::vector<unsigned int>& destroyed)
+{
+	destroyed.clear();
+	for (unsigned int i = 0; i < targets.size(); i++)
+		if (targets[i].Alive && !targets[i].InUse)
+			Destroy(i, destroyed);
+}
+
+void RenderTargetPool::Destroy(unsigned int target, std::vector<unsigned int>& destroyed)
+{
+	Target& t = targets[target];
+	t.Alive = false;
+	stats.Targets--;
+	stats.Destroyed++;
+	stats.Bytes -= t.Desc.Bytes();
+	destroyed.push_back(target);
+}
+
+unsigned int RenderTargetPool::GetTargetSlots() const
+{
+	return (unsigned int)targets.size();
+}
+
+bool RenderTargetPool::IsAlive(unsigned int target) const
+{
+	return target < targets.size() && targets[target].Alive;
+}
+
+const RenderTargetDesc& RenderTargetPool::GetDesc(unsigned int target) const
+{
+	return targets[target].Desc;
+}
+
+const RenderTargetPoolStats& RenderTargetPool::GetStats() const
+{
+	return stats;
+}
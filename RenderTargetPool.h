@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Formats pooled render targets can have (see
+// RenderTargetCache for the DXGI formats they turn into)
+enum class RenderTargetFormat
+{
+	RGBA8,
+	RGBA16F,
+	R11G11B10F,
+	R8,
+	D32		// Depth, drawn to as a depth buffer rather than a render target
+};
+
+// --------------------------------------------------------
+// What a render target looks like.  Targets with the same
+// description can stand in for each other.
+// --------------------------------------------------------
+struct RenderTargetDesc
+{
+	unsigned int Width = 0;
+	unsigned int Height = 0;
+	RenderTargetFormat Format = RenderTargetFormat::RGBA8;
+	bool UnorderedAccess = false;	// Also written by compute shaders
+
+	bool operator==(const RenderTargetDesc& other) const;
+	size_t Bytes() const;
+};
+
+// --------------------------------------------------------
+// Totals for a RenderTargetPool
+// --------------------------------------------------------
+struct RenderTargetPoolStats
+{
+	unsigned int Targets = 0;		// Alive right now
+	unsigned int InUse = 0;			// Acquired and not released yet
+	unsigned int PeakInUse = 0;		// Most at once this frame
+	size_t Bytes = 0;				// Of every target alive
+
+	// Since the start
+	unsigned int Created = 0;
+	unsigned int Destroyed = 0;
+};
+
+// --------------------------------------------------------
+// Hands out render targets by description, reusing ones
+// that are free instead of making new ones, without
+// touching the GPU itself (the owner creates a texture for
+// each target it's told is new and frees it once it's
+// told it's gone), so it can be tested on its own.
+//
+// Within a frame a target is free again as soon as it's
+// released, so passes that don't overlap share targets.
+// Across frames targets stay alive while they're used, and
+// ones nobody has acquired for maxIdleFrames are dropped
+// (after a resize, for instance).
+//
+// Usage:
+//   BeginFrame() -> Acquire() / Release() ... -> EndFrame()
+// --------------------------------------------------------
+class RenderTargetPool
+{
+public:
+	RenderTargetPool(unsigned int maxIdleFrames = 30);
+
+	void BeginFrame();
+
+	// Index of a free target like desc.  "created" is set if it's new
+	// (the index may be one that was dropped before).
+	unsigned int Acquire(const RenderTargetDesc& desc, bool* created = 0);
+	void Release(unsigned int target);
+
+	// Releases whatever is still acquired, then fills "destroyed" with
+	// targets that have been idle too long
+	void EndFrame(std::vector<unsigned int>& destroyed);
+
+	// Drops every target that isn't acquired right now
+	void Clear(std::vector<unsigned int>& destroyed);
+
+	// Getters
+	unsigned int GetTargetSlots() const;	// Highest index + 1
+	bool IsAlive(unsigned int target) const;
+	const RenderTargetDesc& GetDesc(unsigned int target) const;
+	const RenderTargetPoolStats& GetStats() const;
+
+	unsigned int maxIdleFrames;
+
+private:
+	struct Target
+	{
+		RenderTargetDesc Desc;
+		uint64_t LastUsed = 0;	// Frame
+		bool Alive = false;
+		bool InUse = false;
+	};
+
+	void Destroy(unsigned int target, std::vector<unsigned int>& destroyed);
+
+	std::vector<Target> targets;
+	uint64_t frame;
+	RenderTargetPoolStats stats;
+};
@@ -0,0 +1,256 @@
+#include "ResourceRegistry.h"
+#include "Graphics.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+
+// Annonymous namespace to hold variables
+// only accessible in this file
+namespace
+{
+	struct Entry
+	{
+		ResourceType Type = ResourceType::Texture;
+		std::wstring Path;
+		uint64_t Hash = 0;
+		size_t Bytes = 0;
+		std::shared_ptr<void> Object;	// Meshes and shaders
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SRV;	// Textures
+	};
+
+	// Entries by their first path, and every path and content
+	// hash that leads to one of them
+	std::unordered_map<std::wstring, Entry> entries;
+	std::unordered_map<std::wstring, std::wstring> paths;
+	std::unordered_map<uint64_t, std::wstring> contents;
+	ResourceStats stats;
+
+	// The same file gets the same key however the path was written
+	std::wstring Normalize(const std::wstring& path)
+	{
+		return std::filesystem::path(path).lexically_normal().wstring();
+	}
+
+	void Add(ResourceType type, const std::wstring& key, uint64_t hash, size_t bytes, std::shared_ptr<void> object, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+	{
+		Entry& entry = entries[key];
+		entry.Type = type;
+		entry.Path = key;
+		entry.Hash = hash;
+		entry.Bytes = bytes;
+		entry.Object = object;
+		entry.SRV = srv;
+
+		paths[key] = key;
+		contents[hash] = key;
+		stats.Loads++;
+	}
+
+	Entry* FindByContent(uint64_t hash, const std::wstring& key)
+	{
+		auto found = contents.find(hash);
+		if (found == contents.end())
+			return 0;
+
+		// Next time this path goes straight to the entry
+		paths[key] = found->second;
+		stats.ContentHits++;
+		return &entries[found->second];
+	}
+
+	// Looks for a mesh or shader by path, then by what's in the
+	// file.  False (and nothing to register) if it can't be read.
+	bool FindFile(const std::wstring& key, ResourceType type, std::shared_ptr<void>& existing, uint64_t& hash, size_t& fileBytes)
+	{
+		auto found = paths.find(key);
+		if (found != paths.end())
+		{
+			stats.PathHits++;
+			existing = entries[found->second].Object;
+			return true;
+		}
+
+		std::ifstream file(key, std::ios::binary);
+		if (!file)
+			return false;
+		std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		fileBytes = bytes.size();
+
+		// Type is mixed in so different kinds of resource never match
+		uint64_t typeValue = (uint64_t)type;
+		hash = ResourceRegistry::HashBytes(bytes.data(), bytes.size(), ResourceRegistry::HashBytes(&typeValue, sizeof(typeValue)));
+		if (Entry* entry = FindByContent(hash, key))
+			existing = entry->Object;
+		return true;
+	}
+
+	long References(const Entry& entry)
+	{
+		if (entry.SRV)
+		{
+			// COM has no getter, but AddRef() and Release() return the new count
+			entry.SRV->AddRef();
+			return (long)entry.SRV->Release() - 1;
+		}
+		return entry.Object.use_count() - 1;
+	}
+}
+
+std::shared_ptr<Mesh> ResourceRegistry::GetMesh(const std::wstring& path)
+{
+	std::wstring key = Normalize(path);
+	std::shared_ptr<void> existing;
+	uint64_t hash = 0;
+	size_t fileBytes = 0;
+	bool readable = FindFile(key, ResourceType::Mesh, existing, hash, fileBytes);
+	if (existing)
+		return std::static_pointer_cast<Mesh>(existing);
+
+	// Throws if the file is missing, same as making the mesh directly
+	std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(std::filesystem::path(key).string().c_str());
+	if (readable)
+		Add(ResourceType::Mesh, key, hash, mesh->GetVertexCount() * sizeof(Vertex) + mesh->GetIndexCount() * sizeof(unsigned int), mesh, 0);
+	return mesh;
+}
+
+std::shared_ptr<SimpleVertexShader> ResourceRegistry::GetVertexShader(const std::wstring& path)
+{
+	std::wstring key = Normalize(path);
+	std::shared_ptr<void> existing;
+	uint64_t hash = 0;
+	size_t fileBytes = 0;
+	bool readable = FindFile(key, ResourceType::VertexShader, existing, hash, fileBytes);
+	if (existing)
+		return std::static_pointer_cast<SimpleVertexShader>(existing);
+
+	std::shared_ptr<SimpleVertexShader> shader = std::make_shared<SimpleVertexShader>(Graphics::Device, Graphics::Context, key.c_str());
+	if (readable)
+		Add(ResourceType::VertexShader, key, hash, fileBytes, shader, 0);
+	return shader;
+}
+
+std::shared_ptr<SimplePixelShader> ResourceRegistry::GetPixelShader(const std::wstring& path)
+{
+	std::wstring key = Normalize(path);
+	std::shared_ptr<void> existing;
+	uint64_t hash = 0;
+	size_t fileBytes = 0;
+	bool readable = FindFile(key, ResourceType::PixelShader, existing, hash, fileBytes);
+	if (existing)
+		return std::static_pointer_cast<SimplePixelShader>(existing);
+
+	std::shared_ptr<SimplePixelShader> shader = std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, key.c_str());
+	if (readable)
+		Add(ResourceType::PixelShader, key, hash, fileBytes, shader, 0);
+	return shader;
+}
+
+bool ResourceRegistry::HasTexture(const std::wstring& path)
+{
+	return paths.count(Normalize(path)) > 0;
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> ResourceRegistry::FindTexture(const std::wstring& path)
+{
+	auto found = paths.find(Normalize(path));
+	if (found == paths.end())
+		return 0;
+
+	stats.PathHits++;
+	return entries[found->second].SRV;
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> ResourceRegistry::FindTextureByContent(uint64_t hash, const std::wstring& path)
+{
+	Entry* entry = FindByContent(hash, Normalize(path));
+	return entry ? entry->SRV : 0;
+}
+
+void ResourceRegistry::AddTexture(const std::wstring& path, uint64_t hash, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv, size_t bytes)
+{
+	Add(ResourceType::Texture, Normalize(path), hash, bytes, 0, srv);
+}
+
+bool ResourceRegistry::Unload(const std::wstring& path)
+{
+	auto found = paths.find(Normalize(path));
+	if (found == paths.end())
+		return false;
+
+	// Every path that led here goes too
+	std::wstring key = found->second;
+	contents.erase(entries[key].Hash);
+	entries.erase(key);
+	std::erase_if(paths, [&](const auto& alias) { return alias.second == key; });
+	stats.Unloaded++;
+	return true;
+}
+
+unsigned int ResourceRegistry::UnloadUnused()
+{
+	std::vector<std::wstring> unused;
+	for (const auto& [key, entry] : entries)
+		if (References(entry) == 0)
+			unused.push_back(key);
+
+	for (const std::wstring& key : unused)
+		Unload(key);
+	return (unsigned int)unused.size();
+}
+
+void ResourceRegistry::Clear()
+{
+	entries.clear();
+	paths.clear();
+	contents.clear();
+}
+
+ResourceStats ResourceRegistry::GetStats()
+{
+	ResourceStats current = stats;
+	current.Resources = (unsigned int)entries.size();
+	for (const auto& [key, entry] : entries)
+		current.ResidentBytes += entry.Bytes;
+	return current;
+}
+
+std::vector<ResourceInfo> ResourceRegistry::GetResources()
+{
+	std::vector<ResourceInfo> resources;
+	for (const auto& [key, entry] : entries)
+	{
+		ResourceInfo info;
+		info.Type = entry.Type;
+		info.Path = entry.Path;
+		info.Hash = entry.Hash;
+		info.Bytes = entry.Bytes;
+		info.References = References(entry);
+		resources.push_back(info);
+	}
+
+	for (const auto& [path, key] : paths)
+		if (path != key)
+			for (ResourceInfo& info : resources)
+				if (info.Path == key)
+					info.Aliases++;
+
+	std::sort(resources.begin(), resources.end(), [](const ResourceInfo& a, const ResourceInfo& b)
+		{
+			return a.Type != b.Type ? a.Type < b.Type : a.Path < b.Path;
+		});
+	return resources;
+}
+
+uint64_t ResourceRegistry::HashBytes(const void* data, size_t size, uint64_t hash)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
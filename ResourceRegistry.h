@@ -0,0 +1,86 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Mesh.h"
+#include "SimpleShader.h"
+
+enum class ResourceType
+{
+	Texture,
+	Mesh,
+	VertexShader,
+	PixelShader
+};
+
+// --------------------------------------------------------
+// One loaded resource, as reported by GetResources()
+// --------------------------------------------------------
+struct ResourceInfo
+{
+	ResourceType Type = ResourceType::Texture;
+	std::wstring Path;			// First path it was loaded from
+	unsigned int Aliases = 0;	// Other paths with the same contents
+	uint64_t Hash = 0;
+	size_t Bytes = 0;			// Texture mips, mesh buffers or shader bytecode
+	long References = 0;		// Holders other than the registry
+};
+
+// --------------------------------------------------------
+// Totals for everything in the registry
+// --------------------------------------------------------
+struct ResourceStats
+{
+	unsigned int Resources = 0;
+	unsigned int Loads = 0;			// Actually read from disk and created
+	unsigned int PathHits = 0;		// Same path asked for again
+	unsigned int ContentHits = 0;	// Different path, same bytes
+	unsigned int Unloaded = 0;
+	size_t ResidentBytes = 0;
+};
+
+// --------------------------------------------------------
+// Every mesh, shader and texture loaded from a file, keyed
+// by path and by a hash of the file's contents, so the same
+// thing is never created twice.  Getters return shared
+// handles to whatever is already loaded.
+//
+// References are whatever holds the handle besides the
+// registry: shared_ptr owners for meshes and shaders, and
+// COM references on the view for textures (materials keep
+// ComPtrs).  Unloading only drops the registry's handle, so
+// anything still in use stays alive.
+//
+// Textures get here through TextureLoader, which checks the
+// registry before decoding anything.  Main thread only.
+// --------------------------------------------------------
+namespace ResourceRegistry
+{
+	// Loading (or finding)
+	std::shared_ptr<Mesh> GetMesh(const std::wstring& path);
+	std::shared_ptr<SimpleVertexShader> GetVertexShader(const std::wstring& path);
+	std::shared_ptr<SimplePixelShader> GetPixelShader(const std::wstring& path);
+
+	// Textures (see TextureLoader)
+	bool HasTexture(const std::wstring& path);
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> FindTexture(const std::wstring& path);
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> FindTextureByContent(uint64_t hash, const std::wstring& path);
+	void AddTexture(const std::wstring& path, uint64_t hash, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv, size_t bytes);
+
+	// Unloading
+	bool Unload(const std::wstring& path);
+	unsigned int UnloadUnused();
+	void Clear();
+
+	// Reporting
+	ResourceStats GetStats();
+	std::vector<ResourceInfo> GetResources();
+
+	// 64 bit FNV-1a, used for the content keys
+	uint64_t HashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull);
+}
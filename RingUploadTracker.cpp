@@ -0,0 +1,84 @@
+#include "RingUploadTracker.h"
+
+RingUploadTracker::RingUploadTracker(unsigned int capacity)
+{
+	Reset(capacity);
+}
+
+void RingUploadTracker::Reset(unsigned int capacity)
+{
+	this->capacity = capacity;
+	changedFirst = 0;
+	changedCount = capacity;
+}
+
+// --------------------------------------------------------
+// Keeps a single changed span.  New particles are always
+// added right after the last ones, so appending is the
+// common case; anything else grows the span (forward,
+// around the ring) until it covers both.
+// --------------------------------------------------------
+void RingUploadTracker::MarkChanged(unsigned int first, unsigned int count)
+{
+	if (count == 0 || capacity == 0)
+		return;
+
+	first %= capacity;
+	if (count > capacity)
+		count = capacity;
+
+	if (changedCount == 0)
+	{
+		changedFirst = first;
+		changedCount = count;
+		return;
+	}
+
+	// Cover both by growing the current span forward, or by
+	// starting at the new one and running to the end of the
+	// current one - whichever is shorter
+	unsigned long long start = (first + capacity - changedFirst) % capacity;
+	unsigned long long forward = start + count > changedCount ? start + count : changedCount;
+	unsigned long long backward = (capacity - start) + (start + count > capacity + changedCount ? start + count - capacity : changedCount);
+
+	if (backward < forward)
+	{
+		changedFirst = first;
+		changedCount = (unsigned int)(backward > capacity ? capacity : backward);
+	}
+	else
+	{
+		changedCount = (unsigned int)(forward > capacity ? capacity : forward);
+	}
+}
+
+bool RingUploadTracker::HasChanges() const
+{
+	return changedCount > 0;
+}
+
+void RingUploadTracker::Flush(const std::function<void(unsigned int first, unsigned int count)>& upload)
+{
+	if (changedCount == 0)
+		return;
+
+	if (changedCount == capacity)
+	{
+		// Everything, in one go
+		upload(0, capacity);
+	}
+	else
+	{
+		unsigned int firstSpan = capacity - changedFirst < changedCount ? capacity - changedFirst : changedCount;
+		upload(changedFirst, firstSpan);
+		if (firstSpan < changedCount)
+			upload(0, changedCount - firstSpan);
+	}
+
+	changedCount = 0;
+}
+
+unsigned int RingUploadTracker::GetCapacity() const
+{
+	return capacity;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <functional>
+
+// --------------------------------------------------------
+// Keeps track of which part of a ring buffer has changed
+// on the CPU since it was last copied to a GPU mirror of
+// the same size (same indices on both sides).
+//
+// Changes are marked as [first, first + count) ring spans
+// (count may run past the end and wrap).  Flush() then
+// hands out at most two contiguous spans to copy.  No
+// graphics API in here, so the upload function can just
+// as well copy into a plain array.
+// --------------------------------------------------------
+class RingUploadTracker
+{
+public:
+	RingUploadTracker(unsigned int capacity = 0);
+
+	// Forget everything and mark the whole ring as changed
+	void Reset(unsigned int capacity);
+
+	void MarkChanged(unsigned int first, unsigned int count);
+	bool HasChanges() const;
+
+	// Calls upload(first, count) for each contiguous span that
+	// changed since the last flush, then clears the changes
+	void Flush(const std::function<void(unsigned int first, unsigned int count)>& upload);
+
+	unsigned int GetCapacity() const;
+
+private:
+	unsigned int capacity;
+	unsigned int changedFirst;
+	unsigned int changedCount;	// Clamped to capacity
+};
@@ -2,6 +2,11 @@
 #include "Graphics.h"
 #include "WicTextureLoader.h"
 #include "PathHelpers.h"
+#include "ResourceRegistry.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
 using namespace DirectX;
 
 Sky::Sky(std::shared_ptr<Mesh> mesh,
@@ -30,8 +35,24 @@ Sky::Sky(std::shared_ptr<Mesh> mesh,
 	skySRV = CreateCubemap(right,left,up,down,front,back);
 	//create shaders
 	//uses default skybox shaders
-	vs = std::make_shared<SimpleVertexShader>(Graphics::Device, Graphics::Context, FixPath(L"SkyVS.cso").c_str());
-	ps = std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"SkyPS.cso").c_str());
+	vs = ResourceRegistry::GetVertexShader(FixPath(L"SkyVS.cso"));
+	ps = ResourceRegistry::GetPixelShader(FixPath(L"SkyPS.cso"));
+
+	//Create initial render states
+	CreateInitialRenderStates();
+}
+
+Sky::Sky(std::shared_ptr<Mesh> mesh,
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler,
+	const Microsoft::WRL::ComPtr<ID3D11Texture2D> faces[6])
+	: cubeMesh(mesh), sampler(sampler)
+{
+	//faces were loaded elsewhere (e.g. by a TextureLoader)
+	skySRV = CreateCubemap(faces);
+	//create shaders
+	//uses default skybox shaders
+	vs = ResourceRegistry::GetVertexShader(FixPath(L"SkyVS.cso"));
+	ps = ResourceRegistry::GetPixelShader(FixPath(L"SkyPS.cso"));
 
 	//Create initial render states
 	CreateInitialRenderStates();
@@ -63,10 +84,26 @@ Sky::Sky(std::shared_ptr<Mesh> mesh,
 	CreateWICTextureFromFile(Graphics::Device.Get(), front, (ID3D11Resource**)textures[4].GetAddressOf(), 0);
 	CreateWICTextureFromFile(Graphics::Device.Get(), back, (ID3D11Resource**)textures[5].GetAddressOf(), 0);
 
+	return CreateCubemap(textures);
+}
+
+// --------------------------------------------------------
+// Creates a blank cube map and copies each of the six
+// textures to another face, then creates a shader resource
+// view for it.  Faces that failed to load are skipped.
+// --------------------------------------------------------
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(
+	const Microsoft::WRL::ComPtr<ID3D11Texture2D> faces[6])
+{
 	// We'll assume all of the textures are the same color format and resolution,
-	// so get the description of the first texture
+	// so get the description of the first one that loaded
+	const Microsoft::WRL::ComPtr<ID3D11Texture2D>* firstFace = std::find_if(faces, faces + 6,
+		[](const Microsoft::WRL::ComPtr<ID3D11Texture2D>& face) { return face != 0; });
+	if (firstFace == faces + 6)
+		return 0;
+
 	D3D11_TEXTURE2D_DESC faceDesc = {};
-	textures[0]->GetDesc(&faceDesc);
+	(*firstFace)->GetDesc(&faceDesc);
 
 	// Describe the resource for the cube map, which is simply 
 	// a "texture 2d array" with the TEXTURECUBE flag set.  
@@ -93,6 +130,9 @@ Sky::Sky(std::shared_ptr<Mesh> mesh,
 	// one at a time, to the cube map texure
 	for (int i = 0; i < 6; i++)
 	{
+		if (!faces[i])
+			continue;
+
 		// Calculate the subresource position to copy into
 		unsigned int subresource = D3D11CalcSubresource(
 			0,  // Which mip (zero, since there's only one)
@@ -100,13 +140,12 @@ Sky::Sky(std::shared_ptr<Mesh> mesh,
 			1); // How many mip levels are in the texture?
 
 		// Copy from one resource (texture) to another
-		Graphics::Context->CopySubresourceRegion(
+		// (the whole face, to the top left corner of that array element)
+		Graphics::Renderer->CopySubresourceRegion(
 			cubeMapTexture.Get(),  // Destination resource
 			subresource,           // Dest subresource index (one of the array elements)
-			0, 0, 0,               // XYZ location of copy
-			textures[i].Get(),     // Source resource
-			0,                     // Source subresource index (we're assuming there's only one)
-			0);                    // Source subresource "box" of data to copy (zero means the whole thing)
+			faces[i].Get(),        // Source resource
+			0);                    // Source subresource index (we're assuming there's only one)
 	}
 
 	// At this point, all of the faces have been copied into the 
@@ -143,8 +182,8 @@ Sky::Sky(std::shared_ptr<Mesh> mesh,
 	void Sky::Draw(std::shared_ptr<Camera> activeCam) 
 	{
 		//set skybox specific states
-		Graphics::Context->RSSetState(rasterState.Get());
-		Graphics::Context->OMSetDepthStencilState(depthState.Get(), 0);
+		Graphics::Renderer->SetRasterizerState(rasterState.Get());
+		Graphics::Renderer->SetDepthStencilState(depthState.Get());
 
 		//set shaders
 		vs->SetShader();
@@ -164,11 +203,111 @@ Sky::Sky(std::shared_ptr<Mesh> mesh,
 		cubeMesh->Draw();
 
 		//reset states using null/0
-		Graphics::Context->RSSetState(0);
-		Graphics::Context->OMSetDepthStencilState(0, 0);
+		Graphics::Renderer->SetRasterizerState(0);
+		Graphics::Renderer->SetDepthStencilState(0);
 	}
 
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::GetSkySRV()
 	{
 		return skySRV;
 	}
+
+	// --------------------------------------------------------
+	// Uploads baked image based lighting: the prefiltered
+	// specular cube (every mip, half floats) and the BRDF
+	// lookup table.  The irradiance SH just gets copied, it
+	// goes to shaders as constants.
+	// --------------------------------------------------------
+	void Sky::SetIBL(const IBLData& ibl)
+	{
+		memcpy(irradianceSH, ibl.IrradianceSH, sizeof(irradianceSH));
+		specularIBLSRV.Reset();
+		brdfLutSRV.Reset();
+		specularIBLMips = 0;
+
+		if (ibl.SpecularSize > 0 && ibl.Specular.size() == ibl.SpecularOffset(6, 0))
+		{
+			D3D11_TEXTURE2D_DESC cubeDesc = {};
+			cubeDesc.Width = ibl.SpecularSize;
+			cubeDesc.Height = ibl.SpecularSize;
+			cubeDesc.MipLevels = ibl.SpecularMips;
+			cubeDesc.ArraySize = 6;
+			cubeDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+			cubeDesc.SampleDesc.Count = 1;
+			cubeDesc.Usage = D3D11_USAGE_IMMUTABLE; //never changes after baking
+			cubeDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+			cubeDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+
+			//one subresource per mip per face, in the order they're stored
+			std::vector<D3D11_SUBRESOURCE_DATA> initial;
+			for (unsigned int face = 0; face < 6; face++)
+			{
+				for (unsigned int mip = 0; mip < ibl.SpecularMips; mip++)
+				{
+					D3D11_SUBRESOURCE_DATA data = {};
+					data.pSysMem = ibl.Specular.data() + ibl.SpecularOffset(face, mip);
+					data.SysMemPitch = (std::max)(ibl.SpecularSize >> mip, 1u) * 4 * sizeof(uint16_t);
+					initial.push_back(data);
+				}
+			}
+
+			Microsoft::WRL::ComPtr<ID3D11Texture2D> cube;
+			Graphics::Device->CreateTexture2D(&cubeDesc, initial.data(), cube.GetAddressOf());
+			if (cube)
+			{
+				D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+				srvDesc.Format = cubeDesc.Format;
+				srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+				srvDesc.TextureCube.MipLevels = ibl.SpecularMips;
+				Graphics::Device->CreateShaderResourceView(cube.Get(), &srvDesc, specularIBLSRV.GetAddressOf());
+				specularIBLMips = ibl.SpecularMips;
+			}
+		}
+
+		if (ibl.LutSize > 0 && ibl.BrdfLut.size() == (size_t)ibl.LutSize * ibl.LutSize * 2)
+		{
+			D3D11_TEXTURE2D_DESC lutDesc = {};
+			lutDesc.Width = ibl.LutSize;
+			lutDesc.Height = ibl.LutSize;
+			lutDesc.MipLevels = 1;
+			lutDesc.ArraySize = 1;
+			lutDesc.Format = DXGI_FORMAT_R16G16_FLOAT;
+			lutDesc.SampleDesc.Count = 1;
+			lutDesc.Usage = D3D11_USAGE_IMMUTABLE;
+			lutDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+			D3D11_SUBRESOURCE_DATA data = {};
+			data.pSysMem = ibl.BrdfLut.data();
+			data.SysMemPitch = ibl.LutSize * 2 * sizeof(uint16_t);
+
+			Microsoft::WRL::ComPtr<ID3D11Texture2D> lut;
+			Graphics::Device->CreateTexture2D(&lutDesc, &data, lut.GetAddressOf());
+			if (lut)
+				Graphics::Device->CreateShaderResourceView(lut.Get(), 0, brdfLutSRV.GetAddressOf());
+		}
+	}
+
+	bool Sky::HasIBL()
+	{
+		return specularIBLSRV && brdfLutSRV;
+	}
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::GetSpecularIBLSRV()
+	{
+		return specularIBLSRV;
+	}
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::GetBrdfLutSRV()
+	{
+		return brdfLutSRV;
+	}
+
+	const float* Sky::GetIrradianceSH()
+	{
+		return &irradianceSH[0][0];
+	}
+
+	unsigned int Sky::GetSpecularIBLMips()
+	{
+		return specularIBLMips;
+	}
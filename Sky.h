@@ -4,6 +4,7 @@
 #include "Mesh.h"
 #include "SimpleShader.h" //shader info
 #include "Camera.h"
+#include "IBLBaker.h" //baked lighting data
 
 #pragma once
 class Sky
@@ -53,10 +54,27 @@ public:
 		const wchar_t* front,
 		const wchar_t* back);
 
+	//with faces that are already loaded (+X, -X, +Y, -Y, +Z, -Z)
+	Sky(std::shared_ptr<Mesh> mesh,
+		Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler,
+		const Microsoft::WRL::ComPtr<ID3D11Texture2D> faces[6]);
+
+	//copies six loaded faces into a cube map (missing faces stay black)
+	static Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateCubemap(
+		const Microsoft::WRL::ComPtr<ID3D11Texture2D> faces[6]);
+
 	void Draw(std::shared_ptr<Camera> activeCam);
 
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetSkySRV();
 
+	//image based lighting baked from this sky (see IBLBaker)
+	void SetIBL(const IBLData& ibl);
+	bool HasIBL();
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetSpecularIBLSRV(); //prefiltered cube, roughness by mip
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetBrdfLutSRV();
+	const float* GetIrradianceSH(); //9 float4s
+	unsigned int GetSpecularIBLMips();
+
 private:
 	//Fields
 	//d3d11 objs
@@ -64,6 +82,10 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> skySRV; //cube map texture
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> depthState; //depth buffer comparison type
 	Microsoft::WRL::ComPtr<ID3D11RasterizerState> rasterState; //rasterizer options
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> specularIBLSRV; //baked lighting
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> brdfLutSRV;
+	float irradianceSH[9][4] = {};
+	unsigned int specularIBLMips = 0;
 	//shaders
 	std::shared_ptr<SimpleVertexShader> vs;
 	std::shared_ptr<SimplePixelShader> ps;
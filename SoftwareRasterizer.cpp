@@ -0,0 +1,784 @@
+#include "SoftwareRasterizer.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <emmintrin.h>
+#include <fstream>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	constexpr unsigned int NoTriangle = 0xFFFFFFFF;
+
+	// Triangles per job when setting up and binning
+	constexpr unsigned int TriangleGrain = 256;
+	constexpr unsigned int VertexGrain = 1024;
+
+	// Same constants as Lighting.hlsli
+	constexpr float F0_NON_METAL = 0.04f;
+	constexpr float MIN_ROUGHNESS = 0.0000001f;
+	constexpr float PI = 3.14159265359f;
+
+	// --------------------------------------------------------
+	// Small float3 helpers so the lighting reads like the HLSL
+	// --------------------------------------------------------
+	XMFLOAT3 operator+(XMFLOAT3 a, XMFLOAT3 b) { return XMFLOAT3(a.x + b.x, a.y + b.y, a.z + b.z); }
+	XMFLOAT3 operator-(XMFLOAT3 a, XMFLOAT3 b) { return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z); }
+	XMFLOAT3 operator*(XMFLOAT3 a, XMFLOAT3 b) { return XMFLOAT3(a.x * b.x, a.y * b.y, a.z * b.z); }
+	XMFLOAT3 operator*(XMFLOAT3 a, float s) { return XMFLOAT3(a.x * s, a.y * s, a.z * s); }
+	XMFLOAT3 operator-(XMFLOAT3 a) { return XMFLOAT3(-a.x, -a.y, -a.z); }
+	XMFLOAT3 Splat(float s) { return XMFLOAT3(s, s, s); }
+	float Dot(XMFLOAT3 a, XMFLOAT3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	float Saturate(float v) { return std::clamp(v, 0.0f, 1.0f); }
+
+	XMFLOAT3 Normalize(XMFLOAT3 v)
+	{
+		float length = std::sqrt(Dot(v, v));
+		return length > 0.0f ? v * (1.0f / length) : v;
+	}
+
+	XMFLOAT3 Lerp(XMFLOAT3 a, XMFLOAT3 b, float t) { return a + (b - a) * t; }
+
+	// Row vector * matrix, same as the shaders' mul(matrix, vector)
+	// with our row-major upload
+	XMFLOAT4 Transform(XMFLOAT3 v, float w, const XMFLOAT4X4& m)
+	{
+		return XMFLOAT4(
+			v.x * m._11 + v.y * m._21 + v.z * m._31 + w * m._41,
+			v.x * m._12 + v.y * m._22 + v.z * m._32 + w * m._42,
+			v.x * m._13 + v.y * m._23 + v.z * m._33 + w * m._43,
+			v.x * m._14 + v.y * m._24 + v.z * m._34 + w * m._44);
+	}
+
+	XMFLOAT4X4 Multiply(const XMFLOAT4X4& a, const XMFLOAT4X4& b)
+	{
+		XMFLOAT4X4 result;
+		for (int r = 0; r < 4; r++)
+			for (int c = 0; c < 4; c++)
+				result.m[r][c] = a.m[r][0] * b.m[0][c] + a.m[r][1] * b.m[1][c] + a.m[r][2] * b.m[2][c] + a.m[r][3] * b.m[3][c];
+		return result;
+	}
+
+	// --------------------------------------------------------
+	// C++ port of the PBR functions in Lighting.hlsli
+	// --------------------------------------------------------
+	float Attenuate(const PackedLight& light, XMFLOAT3 worldPos)
+	{
+		XMFLOAT3 toLight = light.Position - worldPos;
+		float attenuation = Saturate(1.0f - Dot(toLight, toLight) * light.InvRangeSq);
+		return attenuation * attenuation;
+	}
+
+	float SpotTerm(const PackedLight& light, XMFLOAT3 surfaceToLight)
+	{
+		float angle = Saturate(Dot(-surfaceToLight, light.Direction));
+		return Saturate((angle - light.CosOuter) * light.SpotScale);
+	}
+
+	float D_GGX(XMFLOAT3 n, XMFLOAT3 h, float roughness)
+	{
+		float NdotH = Saturate(Dot(n, h));
+		float NdotH2 = NdotH * NdotH;
+		float a = roughness * roughness;
+		float a2 = std::max(a * a, MIN_ROUGHNESS);
+		float denomToSquare = NdotH2 * (a2 - 1) + 1;
+		return a2 / (PI * denomToSquare * denomToSquare);
+	}
+
+	XMFLOAT3 F_Schlick(XMFLOAT3 v, XMFLOAT3 h, XMFLOAT3 f0)
+	{
+		float VdotH = Saturate(Dot(v, h));
+		return f0 + (Splat(1.0f) - f0) * std::pow(1 - VdotH, 5.0f);
+	}
+
+	float G_SchlickGGX(XMFLOAT3 n, XMFLOAT3 v, float roughness)
+	{
+		float k = std::pow(roughness + 1, 2.0f) / 8.0f;
+		float NdotV = Saturate(Dot(n, v));
+		return 1 / (NdotV * (1 - k) + k);
+	}
+
+	XMFLOAT3 MicrofacetBRDF(XMFLOAT3 n, XMFLOAT3 l, XMFLOAT3 v, float roughness, XMFLOAT3 f0)
+	{
+		XMFLOAT3 h = Normalize(v + l);
+		float D = D_GGX(n, h, roughness);
+		XMFLOAT3 F = F_Schlick(v, h, f0);
+		float G = G_SchlickGGX(n, v, roughness) * G_SchlickGGX(n, l, roughness);
+		return F * (D * G / 4) * std::max(Dot(n, l), 0.0f);
+	}
+
+	// The shader hands the specular result (not F) to DiffuseEnergyConserve,
+	// so this does too - the point is to match the GPU, not to fix it here
+	XMFLOAT3 DiffuseEnergyConserve(float diffuse, XMFLOAT3 specular, float metalness)
+	{
+		return (Splat(1.0f) - specular) * (diffuse * (1 - metalness));
+	}
+
+	XMFLOAT3 DirectionLightPBR(const PackedLight& light, XMFLOAT3 normal, XMFLOAT3 surfaceToCamera, float roughness, float metalness, XMFLOAT3 surfaceColor, XMFLOAT3 specularColor)
+	{
+		XMFLOAT3 surfaceToLight = -light.Direction;
+		float diffuse = Saturate(Dot(normal, surfaceToLight));
+		XMFLOAT3 specular = MicrofacetBRDF(normal, surfaceToLight, surfaceToCamera, roughness, specularColor);
+		XMFLOAT3 balancedDiffuse = DiffuseEnergyConserve(diffuse, specular, metalness);
+		return (balancedDiffuse * surfaceColor + specular) * light.Color;
+	}
+
+	XMFLOAT3 PointLightPBR(const PackedLight& light, XMFLOAT3 normal, XMFLOAT3 surfaceToCamera, XMFLOAT3 worldPos, float roughness, float metalness, XMFLOAT3 surfaceColor, XMFLOAT3 specularColor)
+	{
+		XMFLOAT3 surfaceToLight = Normalize(light.Position - worldPos);
+		float diffuse = Saturate(Dot(normal, surfaceToLight));
+		XMFLOAT3 specular = MicrofacetBRDF(normal, surfaceToLight, surfaceToCamera, roughness, specularColor);
+		float attenuation = Attenuate(light, worldPos);
+		XMFLOAT3 balancedDiffuse = DiffuseEnergyConserve(diffuse, specular, metalness);
+		return (balancedDiffuse * surfaceColor + specular) * light.Color * attenuation;
+	}
+
+	XMFLOAT3 SpotLightPBR(const PackedLight& light, XMFLOAT3 normal, XMFLOAT3 surfaceToCamera, XMFLOAT3 worldPos, float roughness, float metalness, XMFLOAT3 surfaceColor, XMFLOAT3 specularColor)
+	{
+		XMFLOAT3 surfaceToLight = Normalize(light.Position - worldPos);
+		float spotTerm = SpotTerm(light, surfaceToLight);
+		return PointLightPBR(light, normal, surfaceToCamera, worldPos, roughness, metalness, surfaceColor, specularColor) * spotTerm;
+	}
+
+	// Every packed light, a type at a time like the shader (no cap on
+	// how many).  The first directional light is the shadow caster.
+	XMFLOAT3 CalculateTotalLightPBR(const std::vector<PackedLight>& lights, const PackedLightCounts& lightCounts, XMFLOAT3 normal, XMFLOAT3 surfaceToCamera, XMFLOAT3 worldPos, float roughness, float metalness, XMFLOAT3 surfaceColor, XMFLOAT3 specularColor, float shadowAmount)
+	{
+		XMFLOAT3 totalLight = Splat(0.0f);
+		size_t i = 0;
+		for (; i < lightCounts.Directional; i++)
+		{
+			XMFLOAT3 directionLight = DirectionLightPBR(lights[i], normal, surfaceToCamera, roughness, metalness, surfaceColor, specularColor);
+			totalLight = totalLight + (i == 0 ? directionLight * shadowAmount : directionLight);
+		}
+		for (; i < lightCounts.Directional + lightCounts.Point; i++)
+			totalLight = totalLight + PointLightPBR(lights[i], normal, surfaceToCamera, worldPos, roughness, metalness, surfaceColor, specularColor);
+		for (; i < lightCounts.Directional + lightCounts.Point + lightCounts.Spot; i++)
+			totalLight = totalLight + SpotLightPBR(lights[i], normal, surfaceToCamera, worldPos, roughness, metalness, surfaceColor, specularColor);
+		return totalLight;
+	}
+
+	unsigned char ToByte(float v) { return (unsigned char)(Saturate(v) * 255.0f + 0.5f); }
+
+	// --------------------------------------------------------
+	// PNG helpers - the image is written with uncompressed
+	// ("stored") deflate blocks, which every decoder accepts
+	// --------------------------------------------------------
+	unsigned int Crc32(const unsigned char* data, size_t length, unsigned int crc = 0)
+	{
+		static unsigned int table[256] = {};
+		if (table[1] == 0)
+		{
+			for (unsigned int n = 0; n < 256; n++)
+			{
+				unsigned int c = n;
+				for (int k = 0; k < 8; k++)
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				table[n] = c;
+			}
+		}
+
+		crc = ~crc;
+		for (size_t i = 0; i < length; i++)
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	void PushBigEndian(std::vector<unsigned char>& out, unsigned int value)
+	{
+		out.push_back((unsigned char)(value >> 24));
+		out.push_back((unsigned char)(value >> 16));
+		out.push_back((unsigned char)(value >> 8));
+		out.push_back((unsigned char)value);
+	}
+
+	void WriteChunk(std::ofstream& file, const char* type, const std::vector<unsigned char>& data)
+	{
+		std::vector<unsigned char> chunk;
+		PushBigEndian(chunk, (unsigned int)data.size());
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		PushBigEndian(chunk, Crc32(chunk.data() + 4, chunk.size() - 4));
+		file.write((const char*)chunk.data(), chunk.size());
+	}
+}
+
+SoftwareRasterizer::SoftwareRasterizer(unsigned int width, unsigned int height) :
+	width(0),
+	height(0),
+	tilesX(0),
+	tilesY(0),
+	paddedWidth(0),
+	binChunks(0)
+{
+	Resize(width, height);
+}
+
+// Getters
+unsigned int SoftwareRasterizer::GetWidth() const { return width; }
+unsigned int SoftwareRasterizer::GetHeight() const { return height; }
+const std::vector<unsigned char>& SoftwareRasterizer::GetPixels() const { return pixels; }
+const SoftwareRasterTimings& SoftwareRasterizer::GetTimings() const { return timings; }
+
+void SoftwareRasterizer::Resize(unsigned int width, unsigned int height)
+{
+	this->width = std::max(1u, width);
+	this->height = std::max(1u, height);
+	tilesX = (this->width + TileSize - 1) / TileSize;
+	tilesY = (this->height + TileSize - 1) / TileSize;
+	paddedWidth = tilesX * TileSize;
+
+	size_t paddedPixels = (size_t)paddedWidth * tilesY * TileSize;
+	depth.assign(paddedPixels, 1.0f);
+	triangleIDs.assign(paddedPixels, NoTriangle);
+	blockMaxDepth.assign((size_t)tilesX * tilesY * (TileSize / BlockSize) * (TileSize / BlockSize), 1.0f);
+	pixels.assign((size_t)this->width * this->height * 3, 0);
+}
+
+// --------------------------------------------------------
+// Draws the whole frame.  Each stage is spread across the
+// job system and timed separately.
+// --------------------------------------------------------
+void SoftwareRasterizer::Render(
+	const std::vector<SoftwareRasterDraw>& draws,
+	const XMFLOAT4X4& view,
+	const XMFLOAT4X4& projection,
+	XMFLOAT3 cameraPosition,
+	const std::vector<PackedLight>& lights,
+	const PackedLightCounts& lightCounts,
+	XMFLOAT3 clearColor)
+{
+	PROFILE_SCOPE("SoftwareRasterizer::Render");
+	timings = {};
+	uint64_t frameStart = Profiler::Now();
+
+	uint64_t stageStart = frameStart;
+	TransformVertices(draws, Multiply(view, projection));
+	timings.VertexMs = Profiler::TicksToMilliseconds(Profiler::Now() - stageStart);
+
+	stageStart = Profiler::Now();
+	SetupTriangles(draws);
+	timings.SetupMs = Profiler::TicksToMilliseconds(Profiler::Now() - stageStart);
+
+	stageStart = Profiler::Now();
+	BinTriangles();
+	timings.BinMs = Profiler::TicksToMilliseconds(Profiler::Now() - stageStart);
+
+	// One job per tile from here on - tiles never share pixels
+	unsigned int tileCount = tilesX * tilesY;
+	std::vector<unsigned long long> tileRejects(tileCount, 0);
+
+	stageStart = Profiler::Now();
+	JobSystem::ParallelFor(tileCount, [&](unsigned int begin, unsigned int end) {
+		for (unsigned int tile = begin; tile < end; tile++)
+			tileRejects[tile] = RasterizeTile(tile);
+	}, 1);
+	timings.RasterMs = Profiler::TicksToMilliseconds(Profiler::Now() - stageStart);
+
+	stageStart = Profiler::Now();
+	JobSystem::ParallelFor(tileCount, [&](unsigned int begin, unsigned int end) {
+		for (unsigned int tile = begin; tile < end; tile++)
+			ShadeTile(tile, draws, cameraPosition, lights, lightCounts, clearColor);
+	}, 1);
+	timings.ShadeMs = Profiler::TicksToMilliseconds(Profiler::Now() - stageStart);
+
+	for (unsigned long long rejects : tileRejects)
+		timings.BlocksRejectedByDepth += rejects;
+	timings.TrianglesRasterized = (unsigned int)triangles.size();
+	timings.TotalMs = Profiler::TicksToMilliseconds(Profiler::Now() - frameStart);
+}
+
+// --------------------------------------------------------
+// Every vertex of every draw into clip and world space
+// (same math as NormalMapVS)
+// --------------------------------------------------------
+void SoftwareRasterizer::TransformVertices(const std::vector<SoftwareRasterDraw>& draws, const XMFLOAT4X4& viewProjection)
+{
+	PROFILE_SCOPE("SoftwareRasterizer::TransformVertices");
+
+	// Where each draw's vertices and triangles start in the shared lists
+	drawFirstVertex.resize(draws.size() + 1);
+	drawFirstTriangle.resize(draws.size() + 1);
+	drawFirstVertex[0] = 0;
+	drawFirstTriangle[0] = 0;
+	for (size_t i = 0; i < draws.size(); i++)
+	{
+		drawFirstVertex[i + 1] = drawFirstVertex[i] + draws[i].VertexCount;
+		drawFirstTriangle[i + 1] = drawFirstTriangle[i] + draws[i].IndexCount / 3;
+	}
+	timings.TrianglesSubmitted = drawFirstTriangle.back();
+
+	std::vector<XMFLOAT4X4> worldViewProjection(draws.size());
+	for (size_t i = 0; i < draws.size(); i++)
+		worldViewProjection[i] = Multiply(draws[i].World, viewProjection);
+
+	vertices.resize(drawFirstVertex.back());
+	JobSystem::ParallelFor((unsigned int)vertices.size(), [&](unsigned int begin, unsigned int end) {
+		// Find the draw this range starts in, then walk forward
+		size_t d = std::upper_bound(drawFirstVertex.begin(), drawFirstVertex.end(), begin) - drawFirstVertex.begin() - 1;
+		for (unsigned int i = begin; i < end; i++)
+		{
+			while (i >= drawFirstVertex[d + 1])
+				d++;
+
+			const SoftwareRasterDraw& draw = draws[d];
+			const Vertex& v = draw.Vertices[i - drawFirstVertex[d]];
+			XMFLOAT4 world = Transform(v.Position, 1.0f, draw.World);
+			XMFLOAT4 normal = Transform(v.Normal, 0.0f, draw.WorldInverseTranspose);
+
+			vertices[i].Clip = Transform(v.Position, 1.0f, worldViewProjection[d]);
+			vertices[i].World = XMFLOAT3(world.x, world.y, world.z);
+			vertices[i].Normal = XMFLOAT3(normal.x, normal.y, normal.z);
+		}
+	}, VertexGrain);
+}
+
+// --------------------------------------------------------
+// Clips against the near plane, culls back faces and builds
+// the edge and depth equations for every triangle
+// --------------------------------------------------------
+void SoftwareRasterizer::SetupTriangles(const std::vector<SoftwareRasterDraw>& draws)
+{
+	PROFILE_SCOPE("SoftwareRasterizer::SetupTriangles");
+
+	unsigned int triangleCount = drawFirstTriangle.back();
+	unsigned int chunks = (triangleCount + TriangleGrain - 1) / TriangleGrain;
+	chunkTriangles.resize(chunks);
+
+	JobSystem::ParallelFor(triangleCount, [&](unsigned int begin, unsigned int end) {
+		size_t d = std::upper_bound(drawFirstTriangle.begin(), drawFirstTriangle.end(), begin) - drawFirstTriangle.begin() - 1;
+		for (unsigned int t = begin; t < end; t++)
+		{
+			// Chunks line up with the grain, so each one is only touched by one job
+			std::vector<RasterTriangle>& output = chunkTriangles[t / TriangleGrain];
+			if (t % TriangleGrain == 0)
+				output.clear();
+
+			while (t >= drawFirstTriangle[d + 1])
+				d++;
+
+			const SoftwareRasterDraw& draw = draws[d];
+			const unsigned int* index = draw.Indices + (t - drawFirstTriangle[d]) * 3;
+			const RasterVertex* base = &vertices[drawFirstVertex[d]];
+			RasterVertex in[3] = { base[index[0]], base[index[1]], base[index[2]] };
+
+			// Entirely outside one of the side/far planes
+			bool outside = false;
+			for (int axis = 0; axis < 2 && !outside; axis++)
+			{
+				auto coord = [axis](const RasterVertex& v) { return axis == 0 ? v.Clip.x : v.Clip.y; };
+				outside =
+					(coord(in[0]) > in[0].Clip.w && coord(in[1]) > in[1].Clip.w && coord(in[2]) > in[2].Clip.w) ||
+					(coord(in[0]) < -in[0].Clip.w && coord(in[1]) < -in[1].Clip.w && coord(in[2]) < -in[2].Clip.w);
+			}
+			if (outside || (in[0].Clip.z > in[0].Clip.w && in[1].Clip.z > in[1].Clip.w && in[2].Clip.z > in[2].Clip.w))
+				continue;
+
+			// Near plane (z >= 0) - leaves 0, 3 or 4 vertices
+			RasterVertex clipped[4];
+			int clippedCount = 0;
+			for (int i = 0; i < 3; i++)
+			{
+				const RasterVertex& a = in[i];
+				const RasterVertex& b = in[(i + 1) % 3];
+				if (a.Clip.z >= 0.0f)
+					clipped[clippedCount++] = a;
+
+				if ((a.Clip.z >= 0.0f) != (b.Clip.z >= 0.0f))
+				{
+					float s = a.Clip.z / (a.Clip.z - b.Clip.z);
+					RasterVertex& v = clipped[clippedCount++];
+					v.Clip = XMFLOAT4(
+						a.Clip.x + (b.Clip.x - a.Clip.x) * s,
+						a.Clip.y + (b.Clip.y - a.Clip.y) * s,
+						a.Clip.z + (b.Clip.z - a.Clip.z) * s,
+						a.Clip.w + (b.Clip.w - a.Clip.w) * s);
+					v.World = Lerp(a.World, b.World, s);
+					v.Normal = Lerp(a.Normal, b.Normal, s);
+				}
+			}
+
+			// Fan out whatever survived
+			for (int fan = 1; fan + 1 < clippedCount; fan++)
+			{
+				const RasterVertex* v[3] = { &clipped[0], &clipped[fan], &clipped[fan + 1] };
+				RasterTriangle tri;
+				float x[3], y[3], z[3];
+				for (int i = 0; i < 3; i++)
+				{
+					float invW = 1.0f / v[i]->Clip.w;
+					x[i] = (v[i]->Clip.x * invW * 0.5f + 0.5f) * width;
+					y[i] = (0.5f - v[i]->Clip.y * invW * 0.5f) * height;
+					z[i] = v[i]->Clip.z * invW;
+					tri.InverseW[i] = invW;
+					tri.World[i] = v[i]->World;
+					tri.Normal[i] = v[i]->Normal;
+				}
+
+				// Clockwise on screen is front facing (D3D default), anything else is culled
+				float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+				if (!(area > 0.0f))
+					continue;
+
+				tri.MinX = std::max(0, (int)std::floor(std::min({ x[0], x[1], x[2] })));
+				tri.MinY = std::max(0, (int)std::floor(std::min({ y[0], y[1], y[2] })));
+				tri.MaxX = std::min((int)width - 1, (int)std::ceil(std::max({ x[0], x[1], x[2] })));
+				tri.MaxY = std::min((int)height - 1, (int)std::ceil(std::max({ y[0], y[1], y[2] })));
+				if (tri.MinX > tri.MaxX || tri.MinY > tri.MaxY)
+					continue;
+
+				// Edge i runs between the other two vertices, so E_i / area
+				// is the barycentric weight of vertex i
+				for (int i = 0; i < 3; i++)
+				{
+					int a = (i + 1) % 3;
+					int b = (i + 2) % 3;
+					tri.EdgeA[i] = y[a] - y[b];
+					tri.EdgeB[i] = x[b] - x[a];
+					tri.EdgeC[i] = -(tri.EdgeA[i] * x[a] + tri.EdgeB[i] * y[a]);
+
+					// Pixels exactly on an edge belong to top or left edges only
+					bool topLeft = tri.EdgeA[i] > 0.0f || (tri.EdgeA[i] == 0.0f && tri.EdgeB[i] > 0.0f);
+					tri.EdgeThreshold[i] = topLeft ? -1e-30f : 0.0f;
+				}
+
+				tri.InverseArea = 1.0f / area;
+				tri.DepthA = (tri.EdgeA[0] * z[0] + tri.EdgeA[1] * z[1] + tri.EdgeA[2] * z[2]) * tri.InverseArea;
+				tri.DepthB = (tri.EdgeB[0] * z[0] + tri.EdgeB[1] * z[1] + tri.EdgeB[2] * z[2]) * tri.InverseArea;
+				tri.DepthC = (tri.EdgeC[0] * z[0] + tri.EdgeC[1] * z[1] + tri.EdgeC[2] * z[2]) * tri.InverseArea;
+				tri.MinDepth = std::max(0.0f, std::min({ z[0], z[1], z[2] }));
+				tri.Draw = (unsigned int)d;
+				output.push_back(tri);
+			}
+		}
+	}, TriangleGrain);
+
+	// Flatten in submission order so results don't depend on thread timing
+	triangles.clear();
+	for (unsigned int c = 0; c < chunks; c++)
+		triangles.insert(triangles.end(), chunkTriangles[c].begin(), chunkTriangles[c].end());
+}
+
+// --------------------------------------------------------
+// Sorts triangles into the tiles their bounds touch.  Each
+// chunk of triangles gets its own bins so no locks are needed.
+// --------------------------------------------------------
+void SoftwareRasterizer::BinTriangles()
+{
+	PROFILE_SCOPE("SoftwareRasterizer::BinTriangles");
+
+	unsigned int tileCount = tilesX * tilesY;
+	unsigned int triangleCount = (unsigned int)triangles.size();
+	binChunks = (triangleCount + TriangleGrain - 1) / TriangleGrain;
+	bins.resize((size_t)binChunks * tileCount);
+
+	JobSystem::ParallelFor(triangleCount, [&](unsigned int begin, unsigned int end) {
+		for (unsigned int t = begin; t < end; t++)
+		{
+			unsigned int chunk = t / TriangleGrain;
+			std::vector<unsigned int>* chunkBins = &bins[(size_t)chunk * tileCount];
+			if (t % TriangleGrain == 0)
+			{
+				for (unsigned int tile = 0; tile < tileCount; tile++)
+					chunkBins[tile].clear();
+			}
+
+			const RasterTriangle& tri = triangles[t];
+			for (int ty = tri.MinY / (int)TileSize; ty <= tri.MaxY / (int)TileSize; ty++)
+				for (int tx = tri.MinX / (int)TileSize; tx <= tri.MaxX / (int)TileSize; tx++)
+					chunkBins[ty * tilesX + tx].push_back(t);
+		}
+	}, TriangleGrain);
+}
+
+// --------------------------------------------------------
+// Coverage and depth for one tile.  Writes depth and the
+// visible triangle per pixel, returns how many 8x8 blocks
+// were skipped by the depth hierarchy.
+// --------------------------------------------------------
+unsigned long long SoftwareRasterizer::RasterizeTile(unsigned int tile)
+{
+	const unsigned int blocksPerSide = TileSize / BlockSize;
+	const int tileX = (int)((tile % tilesX) * TileSize);
+	const int tileY = (int)((tile / tilesX) * TileSize);
+	float* blockMax = &blockMaxDepth[(size_t)tile * blocksPerSide * blocksPerSide];
+	unsigned long long rejected = 0;
+
+	// Clear this tile
+	for (unsigned int row = 0; row < TileSize; row++)
+	{
+		size_t start = (size_t)(tileY + row) * paddedWidth + tileX;
+		std::fill_n(&depth[start], TileSize, 1.0f);
+		std::fill_n(&triangleIDs[start], TileSize, NoTriangle);
+	}
+	std::fill_n(blockMax, blocksPerSide * blocksPerSide, 1.0f);
+	float tileMax = 1.0f;
+
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const unsigned int tileCount = tilesX * tilesY;
+
+	for (unsigned int chunk = 0; chunk < binChunks; chunk++)
+	{
+		for (unsigned int t : bins[(size_t)chunk * tileCount + tile])
+		{
+			const RasterTriangle& tri = triangles[t];
+
+			// Behind everything in the tile already
+			if (tri.MinDepth >= tileMax)
+			{
+				rejected += blocksPerSide * blocksPerSide;
+				continue;
+			}
+
+			// Blocks of this tile that the triangle's bounds touch
+			int bx0 = (std::max(tri.MinX, tileX) - tileX) / (int)BlockSize;
+			int by0 = (std::max(tri.MinY, tileY) - tileY) / (int)BlockSize;
+			int bx1 = (std::min(tri.MaxX, tileX + (int)TileSize - 1) - tileX) / (int)BlockSize;
+			int by1 = (std::min(tri.MaxY, tileY + (int)TileSize - 1) - tileY) / (int)BlockSize;
+
+			__m128 edgeA[3], edgeThreshold[3];
+			for (int e = 0; e < 3; e++)
+			{
+				edgeA[e] = _mm_set1_ps(tri.EdgeA[e]);
+				edgeThreshold[e] = _mm_set1_ps(tri.EdgeThreshold[e]);
+			}
+			__m128 depthA = _mm_set1_ps(tri.DepthA);
+			__m128i id = _mm_set1_epi32((int)t);
+			bool wroteAny = false;
+
+			for (int by = by0; by <= by1; by++)
+			{
+				for (int bx = bx0; bx <= bx1; bx++)
+				{
+					float px0 = (float)(tileX + bx * (int)BlockSize) + 0.5f;
+					float py0 = (float)(tileY + by * (int)BlockSize) + 0.5f;
+					float px1 = px0 + (BlockSize - 1);
+					float py1 = py0 + (BlockSize - 1);
+
+					// Block entirely outside an edge? (the edge functions are
+					// linear, so the largest value is at one of the corners)
+					bool outside = false;
+					for (int e = 0; e < 3 && !outside; e++)
+					{
+						float best = tri.EdgeA[e] * (tri.EdgeA[e] > 0 ? px1 : px0) + tri.EdgeB[e] * (tri.EdgeB[e] > 0 ? py1 : py0) + tri.EdgeC[e];
+						outside = best <= tri.EdgeThreshold[e];
+					}
+					if (outside)
+						continue;
+
+					// Nearest the triangle gets in this block vs the farthest
+					// depth already stored there
+					float& maxDepth = blockMax[by * blocksPerSide + bx];
+					float nearest = tri.DepthA * (tri.DepthA > 0 ? px0 : px1) + tri.DepthB * (tri.DepthB > 0 ? py0 : py1) + tri.DepthC;
+					if (std::max(nearest, tri.MinDepth) >= maxDepth)
+					{
+						rejected++;
+						continue;
+					}
+
+					bool wroteBlock = false;
+					for (unsigned int row = 0; row < BlockSize; row++)
+					{
+						float py = py0 + row;
+						size_t rowStart = (size_t)(py - 0.5f) * paddedWidth;
+
+						for (unsigned int half = 0; half < BlockSize; half += 4)
+						{
+							float px = px0 - 0.5f + half;
+							__m128 xs = _mm_add_ps(_mm_set1_ps(px), laneOffsets);
+
+							__m128 mask = _mm_castsi128_ps(_mm_set1_epi32(-1));
+							for (int e = 0; e < 3; e++)
+							{
+								__m128 value = _mm_add_ps(_mm_mul_ps(edgeA[e], xs), _mm_set1_ps(tri.EdgeB[e] * py + tri.EdgeC[e]));
+								mask = _mm_and_ps(mask, _mm_cmpgt_ps(value, edgeThreshold[e]));
+							}
+							if (_mm_movemask_ps(mask) == 0)
+								continue;
+
+							size_t index = rowStart + (size_t)px;
+							__m128 z = _mm_add_ps(_mm_mul_ps(depthA, xs), _mm_set1_ps(tri.DepthB * py + tri.DepthC));
+							__m128 stored = _mm_loadu_ps(&depth[index]);
+							mask = _mm_and_ps(mask, _mm_cmplt_ps(z, stored));
+							if (_mm_movemask_ps(mask) == 0)
+								continue;
+
+							// Blend the passing lanes in
+							_mm_storeu_ps(&depth[index], _mm_or_ps(_mm_and_ps(mask, z), _mm_andnot_ps(mask, stored)));
+							__m128i maskI = _mm_castps_si128(mask);
+							__m128i ids = _mm_loadu_si128((const __m128i*)&triangleIDs[index]);
+							_mm_storeu_si128((__m128i*)&triangleIDs[index], _mm_or_si128(_mm_and_si128(maskI, id), _mm_andnot_si128(maskI, ids)));
+							wroteBlock = true;
+						}
+					}
+
+					if (!wroteBlock)
+						continue;
+
+					// Refresh the block's farthest depth
+					__m128 farthest = _mm_setzero_ps();
+					for (unsigned int row = 0; row < BlockSize; row++)
+					{
+						const float* rowDepth = &depth[(size_t)(py0 - 0.5f + row) * paddedWidth + (size_t)(px0 - 0.5f)];
+						farthest = _mm_max_ps(farthest, _mm_max_ps(_mm_loadu_ps(rowDepth), _mm_loadu_ps(rowDepth + 4)));
+					}
+					farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(1, 0, 3, 2)));
+					farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(2, 3, 0, 1)));
+					maxDepth = _mm_cvtss_f32(farthest);
+					wroteAny = true;
+				}
+			}
+
+			if (wroteAny)
+				tileMax = *std::max_element(blockMax, blockMax + blocksPerSide * blocksPerSide);
+		}
+	}
+
+	return rejected;
+}
+
+// --------------------------------------------------------
+// Lights every covered pixel of a tile using the triangle
+// stored for it, then writes the gamma corrected result
+// --------------------------------------------------------
+void SoftwareRasterizer::ShadeTile(
+	unsigned int tile,
+	const std::vector<SoftwareRasterDraw>& draws,
+	XMFLOAT3 cameraPosition,
+	const std::vector<PackedLight>& lights,
+	const PackedLightCounts& lightCounts,
+	XMFLOAT3 clearColor)
+{
+	const unsigned int tileX = (tile % tilesX) * TileSize;
+	const unsigned int tileY = (tile / tilesX) * TileSize;
+	const unsigned int endX = std::min(tileX + TileSize, width);
+	const unsigned int endY = std::min(tileY + TileSize, height);
+
+	for (unsigned int y = tileY; y < endY; y++)
+	{
+		for (unsigned int x = tileX; x < endX; x++)
+		{
+			unsigned char* out = &pixels[((size_t)y * width + x) * 3];
+			unsigned int t = triangleIDs[(size_t)y * paddedWidth + x];
+			if (t == NoTriangle)
+			{
+				out[0] = ToByte(clearColor.x);
+				out[1] = ToByte(clearColor.y);
+				out[2] = ToByte(clearColor.z);
+				continue;
+			}
+
+			// Perspective correct barycentrics at the pixel center
+			const RasterTriangle& tri = triangles[t];
+			float px = x + 0.5f;
+			float py = y + 0.5f;
+			float weights[3];
+			float weightSum = 0.0f;
+			for (int i = 0; i < 3; i++)
+			{
+				float screenWeight = (tri.EdgeA[i] * px + tri.EdgeB[i] * py + tri.EdgeC[i]) * tri.InverseArea;
+				weights[i] = screenWeight * tri.InverseW[i];
+				weightSum += weights[i];
+			}
+			for (int i = 0; i < 3; i++)
+				weights[i] /= weightSum;
+
+			XMFLOAT3 worldPos = tri.World[0] * weights[0] + tri.World[1] * weights[1] + tri.World[2] * weights[2];
+			XMFLOAT3 normal = Normalize(tri.Normal[0] * weights[0] + tri.Normal[1] * weights[1] + tri.Normal[2] * weights[2]);
+
+			// Same inputs PBRPixelShader builds, minus the textures: the
+			// material color stands in for the (gamma encoded) albedo map
+			const SoftwareRasterDraw& draw = draws[tri.Draw];
+			XMFLOAT3 color(
+				std::pow(draw.Color.x, 2.2f),
+				std::pow(draw.Color.y, 2.2f),
+				std::pow(draw.Color.z, 2.2f));
+			XMFLOAT3 specularColor = Lerp(Splat(F0_NON_METAL), color, draw.Metalness);
+			XMFLOAT3 surfaceToCamera = Normalize(cameraPosition - worldPos);
+
+			XMFLOAT3 totalLight = CalculateTotalLightPBR(lights, lightCounts, normal, surfaceToCamera, worldPos, draw.Roughness, draw.Metalness, color, specularColor, 1.0f);
+
+			out[0] = ToByte(std::pow(std::max(totalLight.x, 0.0f), 1.0f / 2.2f));
+			out[1] = ToByte(std::pow(std::max(totalLight.y, 0.0f), 1.0f / 2.2f));
+			out[2] = ToByte(std::pow(std::max(totalLight.z, 0.0f), 1.0f / 2.2f));
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Binary PPM (P6) - trivial to diff or convert
+// --------------------------------------------------------
+bool SoftwareRasterizer::SavePPM(const std::string& path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	file << "P6\n" << width << " " << height << "\n255\n";
+	file.write((const char*)pixels.data(), pixels.size());
+	return file.good();
+}
+
+// --------------------------------------------------------
+// 8-bit RGB PNG with no compression
+// --------------------------------------------------------
+bool SoftwareRasterizer::SavePNG(const std::string& path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	file.write((const char*)signature, 8);
+
+	std::vector<unsigned char> header;
+	PushBigEndian(header, width);
+	PushBigEndian(header, height);
+	header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8 bit, RGB, deflate, no filter, no interlace
+	WriteChunk(file, "IHDR", header);
+
+	// Each row is a "no filter" byte followed by the pixels
+	std::vector<unsigned char> raw;
+	size_t rowBytes = (size_t)width * 3;
+	raw.reserve((rowBytes + 1) * height);
+	for (unsigned int y = 0; y < height; y++)
+	{
+		raw.push_back(0);
+		raw.insert(raw.end(), pixels.begin() + y * rowBytes, pixels.begin() + (y + 1) * rowBytes);
+	}
+
+	// zlib stream made of stored blocks (max 65535 bytes each)
+	std::vector<unsigned char> zlib = { 0x78, 0x01 };
+	for (size_t offset = 0; offset < raw.size() || offset == 0; )
+	{
+		size_t length = std::min<size_t>(65535, raw.size() - offset);
+		bool last = offset + length == raw.size();
+		zlib.push_back(last ? 1 : 0);
+		zlib.push_back((unsigned char)(length & 0xFF));
+		zlib.push_back((unsigned char)(length >> 8));
+		zlib.push_back((unsigned char)(~length & 0xFF));
+		zlib.push_back((unsigned char)((~length >> 8) & 0xFF));
+		zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+		offset += length;
+		if (last)
+			break;
+	}
+
+	unsigned int a = 1, b = 0;
+	for (unsigned char c : raw)
+	{
+		a = (a + c) % 65521;
+		b = (b + a) % 65521;
+	}
+	PushBigEndian(zlib, (b << 16) | a);
+	WriteChunk(file, "IDAT", zlib);
+
+	WriteChunk(file, "IEND", {});
+	return file.good();
+}
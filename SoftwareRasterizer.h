@@ -0,0 +1,150 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+
+#include "Vertex.h"
+#include "LightPacker.h"
+
+// --------------------------------------------------------
+// One mesh instance to draw (everything is borrowed, so it
+// must stay alive until Render() returns)
+// --------------------------------------------------------
+struct SoftwareRasterDraw
+{
+	const Vertex* Vertices = 0;
+	unsigned int VertexCount = 0;
+	const unsigned int* Indices = 0;
+	unsigned int IndexCount = 0;
+
+	DirectX::XMFLOAT4X4 World;
+	DirectX::XMFLOAT4X4 WorldInverseTranspose;
+
+	// Surface values fed to the PBR lighting
+	DirectX::XMFLOAT3 Color;
+	float Roughness = 0.5f;
+	float Metalness = 0.0f;
+};
+
+// --------------------------------------------------------
+// Time spent in each stage of the last Render() call
+// --------------------------------------------------------
+struct SoftwareRasterTimings
+{
+	double VertexMs = 0.0;		// Transforming vertices
+	double SetupMs = 0.0;		// Clipping, culling and edge equations
+	double BinMs = 0.0;			// Sorting triangles into tiles
+	double RasterMs = 0.0;		// Coverage + depth into the visibility buffer
+	double ShadeMs = 0.0;		// Lighting each visible pixel once
+	double TotalMs = 0.0;
+
+	unsigned int TrianglesSubmitted = 0;
+	unsigned int TrianglesRasterized = 0;	// Left after clipping and culling
+	unsigned long long BlocksRejectedByDepth = 0;
+};
+
+// --------------------------------------------------------
+// CPU reference renderer for golden images and CPU cost
+// tracking, using the same meshes, matrices and lighting
+// as the GPU path.
+//
+// - Screen is split into 64x64 tiles, processed in parallel
+// - Coverage uses SSE edge functions, 4 pixels at a time
+// - Each tile keeps a max depth per 8x8 block so triangles
+//   fully behind what's already drawn are skipped early
+// - Rasterizing only stores depth + triangle id; shading
+//   runs afterwards so every pixel is lit exactly once
+//
+// Shading is a port of CalculateTotalLightPBR() from
+// Lighting.hlsli with no textures or shadows, over the
+// same lights LightPacker hands the shaders.  Every
+// packed light is used, however many there are.
+// --------------------------------------------------------
+class SoftwareRasterizer
+{
+public:
+	static constexpr unsigned int TileSize = 64;
+	static constexpr unsigned int BlockSize = 8;
+
+	SoftwareRasterizer(unsigned int width, unsigned int height);
+
+	void Resize(unsigned int width, unsigned int height);
+	void Render(
+		const std::vector<SoftwareRasterDraw>& draws,
+		const DirectX::XMFLOAT4X4& view,
+		const DirectX::XMFLOAT4X4& projection,
+		DirectX::XMFLOAT3 cameraPosition,
+		const std::vector<PackedLight>& lights,
+		const PackedLightCounts& lightCounts,
+		DirectX::XMFLOAT3 clearColor);
+
+	// Getters
+	unsigned int GetWidth() const;
+	unsigned int GetHeight() const;
+	const std::vector<unsigned char>& GetPixels() const; // RGB, top row first
+	const SoftwareRasterTimings& GetTimings() const;
+
+	// Output
+	bool SavePPM(const std::string& path) const;
+	bool SavePNG(const std::string& path) const;
+
+private:
+	// Post-transform vertex
+	struct RasterVertex
+	{
+		DirectX::XMFLOAT4 Clip;
+		DirectX::XMFLOAT3 World;
+		DirectX::XMFLOAT3 Normal;
+	};
+
+	// Screen space triangle, ready to rasterize and shade
+	struct RasterTriangle
+	{
+		float EdgeA[3], EdgeB[3], EdgeC[3];	// Edge i is opposite vertex i
+		float EdgeThreshold[3];				// Top-left fill rule bias
+		float DepthA, DepthB, DepthC;		// z = A*x + B*y + C
+		float InverseArea;
+		float InverseW[3];
+		float MinDepth;
+		int MinX, MinY, MaxX, MaxY;			// Pixel bounds, clamped to the screen
+		DirectX::XMFLOAT3 World[3];
+		DirectX::XMFLOAT3 Normal[3];
+		unsigned int Draw;
+	};
+
+	unsigned int width;
+	unsigned int height;
+	unsigned int tilesX;
+	unsigned int tilesY;
+	unsigned int paddedWidth;	// Multiple of TileSize so tiles never go out of bounds
+
+	// Frame buffers (padded width)
+	std::vector<float> depth;
+	std::vector<unsigned int> triangleIDs;
+	std::vector<float> blockMaxDepth;	// One per 8x8 block
+	std::vector<unsigned char> pixels;	// Unpadded RGB output
+
+	// Per-frame work lists
+	std::vector<unsigned int> drawFirstVertex;
+	std::vector<unsigned int> drawFirstTriangle;
+	std::vector<RasterVertex> vertices;
+	std::vector<std::vector<RasterTriangle>> chunkTriangles;
+	std::vector<RasterTriangle> triangles;
+	std::vector<std::vector<unsigned int>> bins;	// [chunk * tileCount + tile]
+	unsigned int binChunks;
+
+	SoftwareRasterTimings timings;
+
+	void TransformVertices(const std::vector<SoftwareRasterDraw>& draws, const DirectX::XMFLOAT4X4& viewProjection);
+	void SetupTriangles(const std::vector<SoftwareRasterDraw>& draws);
+	void BinTriangles();
+	unsigned long long RasterizeTile(unsigned int tile);
+	void ShadeTile(
+		unsigned int tile,
+		const std::vector<SoftwareRasterDraw>& draws,
+		DirectX::XMFLOAT3 cameraPosition,
+		const std::vector<PackedLight>& lights,
+		const PackedLightCounts& lightCounts,
+		DirectX::XMFLOAT3 clearColor);
+};
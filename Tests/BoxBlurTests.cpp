@@ -0,0 +1,130 @@
+#include "Tests.h"
+
+#include "BoxBlur.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// A bundled texture (noise if it's missing), tiled across width x height
+	void TiledTexture(unsigned int width, unsigned int height, FloatImage& image)
+	{
+		CpuImage texture;
+		FloatImage tile;
+		if (PngDecoder::DecodeFile(Tests::AssetPath("Textures/paint_albedo.png"), texture))
+			BoxBlur::FromCpuImage(texture, tile);
+		else
+		{
+			tile.Resize(64, 64);
+			RandomGenerator random(1);
+			for (float& value : tile.Pixels)
+				value = random.NextFloat();
+		}
+
+		image.Resize(width, height);
+		for (unsigned int y = 0; y < height; y++)
+			for (unsigned int x = 0; x < width; x++)
+				for (int c = 0; c < 4; c++)
+					image.Pixels[((size_t)y * width + x) * 4 + c] = tile.Pixels[((size_t)(y % tile.Height) * tile.Width + x % tile.Width) * 4 + c];
+	}
+
+	// Best of a few runs, in ms
+	double Time(void (*blur)(const FloatImage&, int, FloatImage&), const FloatImage& image, int radius, unsigned int runs)
+	{
+		FloatImage blurred;
+		double best = 1e30;
+		for (unsigned int run = 0; run < runs; run++)
+		{
+			uint64_t start = Profiler::Now();
+			blur(image, radius, blurred);
+			best = std::min(best, Profiler::TicksToMilliseconds(Profiler::Now() - start));
+		}
+		return best;
+	}
+}
+
+// --------------------------------------------------------
+// Every box blur has to match the brute force one to well
+// under one step of 8 bit color, for radius 0 to 12 and
+// for 40 (bigger than the image's edge margins), and the
+// separable blur's taps have to add up to the whole box.
+// --------------------------------------------------------
+TEST_SUITE(BoxBlurMatch)
+{
+	JobSystem::Initialize(3);
+
+	FloatImage image;
+	TiledTexture(160, 90, image);
+
+	float worst[3] = {};
+	bool tapsAddUp = true;
+	for (int radius = 0; radius <= 40; radius = radius < 12 ? radius + 1 : radius + 28)
+	{
+		FloatImage reference, blurred;
+		BoxBlur::Reference(image, radius, reference);
+		BoxBlur::Separable(image, radius, blurred);
+		worst[0] = std::max(worst[0], BoxBlur::MaxDifference(reference, blurred));
+		BoxBlur::SlidingWindow(image, radius, blurred);
+		worst[1] = std::max(worst[1], BoxBlur::MaxDifference(reference, blurred));
+		BoxBlur::SummedArea(image, radius, blurred);
+		worst[2] = std::max(worst[2], BoxBlur::MaxDifference(reference, blurred));
+
+		float weights = 0.0f;
+		for (const BlurTap& tap : BoxBlur::LinearTaps(radius))
+			weights += tap.Weight;
+		tapsAddUp = tapsAddUp && fabsf(weights - (2 * radius + 1)) < 1e-4f;
+	}
+
+	const char* names[3] = { "Separable", "Sliding window", "Summed area" };
+	for (int i = 0; i < 3; i++)
+	{
+		printf("  %-16s largest difference from brute force %.2e\n", names[i], worst[i]);
+		Tests::Check((std::string(names[i]) + " matches brute force").c_str(), worst[i] < 1e-4f);
+	}
+	Tests::Check("Separable taps add up to the box", tapsAddUp);
+
+	JobSystem::ShutDown();
+}
+
+// --------------------------------------------------------
+// Times each box blur at 1280x720 across radii on every
+// core.  The separable blur's cost should grow with the
+// radius, half as fast as taps are paired, and the sliding
+// window and summed area ones shouldn't grow.
+// --------------------------------------------------------
+BENCHMARK(BoxBlurSpeed)
+{
+	JobSystem::Initialize();
+
+	FloatImage frame;
+	TiledTexture(1280, 720, frame);
+
+	printf("  1280x720 on %u job threads, ms (MPixel/s)\n", JobSystem::ThreadCount());
+	printf("  %6s %7s %18s %18s %18s %18s\n", "radius", "taps", "brute force", "separable", "sliding window", "summed area");
+	double megapixels = frame.Width * frame.Height / 1e6;
+	for (int radius : { 1, 2, 5, 10, 20, 40 })
+	{
+		// The brute force one takes too long past a few pixels
+		double brute = radius <= 5 ? Time(BoxBlur::Reference, frame, radius, 1) : 0.0;
+		double separable = Time(BoxBlur::Separable, frame, radius, 3);
+		double sliding = Time(BoxBlur::SlidingWindow, frame, radius, 3);
+		double summed = Time(BoxBlur::SummedArea, frame, radius, 3);
+
+		char bruteText[32] = "-";
+		if (brute > 0.0)
+			snprintf(bruteText, sizeof(bruteText), "%.1f (%.0f)", brute, megapixels / (brute / 1000.0));
+		printf("  %6d %7zu %18s %9.1f (%6.0f) %9.1f (%6.0f) %9.1f (%6.0f)\n", radius, BoxBlur::LinearTaps(radius).size() * 2, bruteText,
+			separable, megapixels / (separable / 1000.0), sliding, megapixels / (sliding / 1000.0), summed, megapixels / (summed / 1000.0));
+	}
+
+	JobSystem::ShutDown();
+}
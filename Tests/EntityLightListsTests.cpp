@@ -0,0 +1,170 @@
+#include "Tests.h"
+
+#include "EntityLightLists.h"
+#include "JobSystem.h"
+#include "LightPacker.h"
+#include "Profiler.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	const unsigned int EntityCount = 5000;
+
+	// Point and spot lights spread over the scene, plus one
+	// directional light that lights everything
+	std::vector<Lights> Scatter(RandomGenerator& random, unsigned int count)
+	{
+		std::vector<Lights> lights(count);
+		for (Lights& light : lights)
+		{
+			light = {};
+			light.type = random.NextFloat() < 0.5f ? LIGHT_TYPE_POINT : LIGHT_TYPE_SPOT;
+			light.position = XMFLOAT3(random.NextFloat(-100.0f, 100.0f), random.NextFloat(-2.0f, 8.0f), random.NextFloat(-100.0f, 100.0f));
+			light.range = random.NextFloat(1.0f, 5.0f);
+			XMStoreFloat3(&light.direction, XMVector3Normalize(XMVectorSet(random.NextFloat(-1.0f, 1.0f), random.NextFloat(-1.0f, 0.2f), random.NextFloat(-1.0f, 1.0f), 0)));
+			light.spotOuterAngle = XMConvertToRadians(random.NextFloat(10.0f, 60.0f));
+			light.color = XMFLOAT3(random.NextFloat(), random.NextFloat(), random.NextFloat());
+			light.intensity = random.NextFloat(0.5f, 2.0f);
+		}
+		lights[0].type = LIGHT_TYPE_DIRECTIONAL;
+		return lights;
+	}
+
+	// Random boxes over the same area, most of them visible
+	void Entities(RandomGenerator& random, std::vector<BoundingBox>& bounds, std::vector<unsigned char>& visible)
+	{
+		bounds.resize(EntityCount);
+		visible.resize(EntityCount);
+		for (unsigned int e = 0; e < EntityCount; e++)
+		{
+			bounds[e].Center = XMFLOAT3(random.NextFloat(-100.0f, 100.0f), random.NextFloat(-2.0f, 8.0f), random.NextFloat(-100.0f, 100.0f));
+			bounds[e].Extents = XMFLOAT3(random.NextFloat(0.1f, 2.0f), random.NextFloat(0.1f, 2.0f), random.NextFloat(0.1f, 2.0f));
+			visible[e] = random.NextFloat() < 0.8f;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Builds light lists for 5000 random boxes and 2000 random
+// lights, which must match testing one light at a time,
+// and checks every light reaching a random point inside a
+// box is in its list (unless the list was full).
+// --------------------------------------------------------
+TEST_SUITE(EntityLightBuild)
+{
+	JobSystem::Initialize(3);
+
+	RandomGenerator random(11);
+	std::vector<BoundingBox> bounds;
+	std::vector<unsigned char> visible;
+	Entities(random, bounds, visible);
+
+	std::vector<Lights> lights = Scatter(random, 2000);
+	LightPacker packer;
+	packer.Pack(lights.data(), (unsigned int)lights.size());
+	const std::vector<PackedLight>& packed = packer.GetLights();
+
+	EntityLightLists lists;
+	lists.BuildReference(packed.data(), (unsigned int)packed.size(), bounds.data(), EntityCount, visible.data());
+	std::vector<std::vector<uint32_t>> reference(EntityCount);
+	for (unsigned int e = 0; e < EntityCount; e++)
+		reference[e].assign(lists.GetLights(e), lists.GetLights(e) + lists.GetCount(e));
+	lists.Build(packed.data(), (unsigned int)packed.size(), bounds.data(), EntityCount, visible.data());
+	bool matches = true;
+	for (unsigned int e = 0; e < EntityCount; e++)
+		matches = matches && std::vector<uint32_t>(lists.GetLights(e), lists.GetLights(e) + lists.GetCount(e)) == reference[e];
+	Tests::Check("SIMD build matches one light at a time", matches);
+
+	// Every light lighting a point in a box with room in its list is in it
+	unsigned int missing = 0, lit = 0, full = 0;
+	for (unsigned int e = 0; e < EntityCount; e++)
+	{
+		if (!visible[e])
+			continue;
+		if (lists.GetCount(e) == EntityLightLists::MaxLights)
+		{
+			full++;
+			continue;
+		}
+
+		const uint32_t* begin = lists.GetLights(e);
+		const uint32_t* end = begin + lists.GetCount(e);
+		for (unsigned int p = 0; p < 8; p++)
+		{
+			XMVECTOR point = XMVectorSet(
+				bounds[e].Center.x + random.NextFloat(-1.0f, 1.0f) * bounds[e].Extents.x,
+				bounds[e].Center.y + random.NextFloat(-1.0f, 1.0f) * bounds[e].Extents.y,
+				bounds[e].Center.z + random.NextFloat(-1.0f, 1.0f) * bounds[e].Extents.z, 1);
+			for (uint32_t i = 1; i < lights.size(); i++)
+			{
+				// What the shaders would light it with
+				const Lights& light = lights[i];
+				XMVECTOR toPoint = point - XMLoadFloat3(&light.position);
+				float distance = XMVectorGetX(XMVector3Length(toPoint));
+				if (distance >= light.range)
+					continue;
+				if (light.type == LIGHT_TYPE_SPOT && distance > 0.0f &&
+					XMVectorGetX(XMVector3Dot(toPoint / distance, XMLoadFloat3(&light.direction))) <= cosf(light.spotOuterAngle))
+					continue;
+				lit++;
+				if (std::find(begin, end, packer.GetPackedIndices()[i]) == end)
+					missing++;
+			}
+		}
+	}
+	printf("  Lights reaching random points in boxes: %u, missing from their list: %u (%u full lists skipped)\n", lit, missing, full);
+	Tests::Check("Lights reaching a box are in its list", lit > 0 && missing == 0);
+
+	JobSystem::ShutDown();
+}
+
+// --------------------------------------------------------
+// Builds light lists for 5000 random boxes with 1k to 10k
+// random point and spot lights on every core, against one
+// light at a time, and prints how many were kept.
+// --------------------------------------------------------
+BENCHMARK(EntityLightSpeed)
+{
+	JobSystem::Initialize();
+
+	RandomGenerator random(11);
+	std::vector<BoundingBox> bounds;
+	std::vector<unsigned char> visible;
+	Entities(random, bounds, visible);
+	LightPacker packer;
+	EntityLightLists lists;
+
+	printf("  %u boxes, up to %u lights each, on %u job threads\n", EntityCount, EntityLightLists::MaxLights, JobSystem::ThreadCount());
+	printf("  %7s %10s %12s %10s %10s %10s\n", "lights", "build ms", "one at a time", "touching", "kept", "capped");
+	for (unsigned int count : { 1000, 2000, 5000, 10000 })
+	{
+		std::vector<Lights> lights = Scatter(random, count);
+		packer.Pack(lights.data(), count);
+		const std::vector<PackedLight>& packed = packer.GetLights();
+		double best = 1e30;
+		for (int run = 0; run < 5; run++)
+		{
+			uint64_t start = Profiler::Now();
+			lists.Build(packed.data(), count, bounds.data(), EntityCount, visible.data());
+			best = std::min(best, Profiler::TicksToMilliseconds(Profiler::Now() - start));
+		}
+		const EntityLightStats stats = lists.GetStats();
+
+		uint64_t start = Profiler::Now();
+		lists.BuildReference(packed.data(), count, bounds.data(), EntityCount, visible.data());
+		double single = Profiler::TicksToMilliseconds(Profiler::Now() - start);
+
+		printf("  %7u %10.3f %12.1f %10u %10u %10u\n", count, best, single, stats.Hits, stats.Kept, stats.Capped);
+	}
+
+	JobSystem::ShutDown();
+}
@@ -0,0 +1,123 @@
+#include "Tests.h"
+
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Nearest rank worked out with integers: the smallest value with at
+	// least percent% of the values at or below it
+	float NearestRank(std::vector<float> values, unsigned int percent)
+	{
+		std::sort(values.begin(), values.end());
+		size_t rank = (percent * values.size() + 99) / 100;
+		return values[std::max<size_t>(rank, 1) - 1];
+	}
+
+	// Every whole percentile of the history against NearestRank()
+	bool PercentilesMatch(const FrameStats& stats, const std::vector<float>& values)
+	{
+		bool match = true;
+		for (unsigned int percent = 0; percent <= 100; percent++)
+			match = match && stats.Percentile((float)percent) == NearestRank(values, percent);
+		return match;
+	}
+
+	std::string ReadFile(const std::filesystem::path& path)
+	{
+		std::ifstream file(path);
+		std::stringstream text;
+		text << file.rdbuf();
+		return text.str();
+	}
+}
+
+// --------------------------------------------------------
+// Nearest-rank percentiles for empty, single, odd and even
+// sized histories (before and after the ring wraps), hitch
+// counting and the CSV export.
+// --------------------------------------------------------
+TEST_SUITE(FrameStatsPercentiles)
+{
+	FrameStats stats(8);
+	const FrameStatsSummary& empty = stats.Summary();
+	Tests::Check("Empty history has zero percentiles", stats.Percentile(50.0f) == 0.0f && stats.Percentile(100.0f) == 0.0f);
+	Tests::Check("Empty history has a zero summary", empty.Average == 0.0f && empty.P50 == 0.0f && empty.P99 == 0.0f && empty.Max == 0.0f);
+
+	stats.AddFrame(16.0f);
+	Tests::Check("One frame is every percentile", stats.Percentile(0.0f) == 16.0f && stats.Percentile(50.0f) == 16.0f && stats.Percentile(100.0f) == 16.0f);
+
+	// Odd count: the median is the middle value
+	std::vector<float> odd = { 5.0f, 1.0f, 4.0f, 2.0f, 3.0f };
+	stats.Clear();
+	for (float ms : odd)
+		stats.AddFrame(ms);
+	Tests::Check("Odd count: median is the middle value", stats.Percentile(50.0f) == 3.0f);
+	Tests::Check("Odd count: every percentile is a nearest rank", PercentilesMatch(stats, odd));
+
+	// Even count: nearest rank picks the lower middle value, it doesn't average
+	std::vector<float> even = { 40.0f, 10.0f, 30.0f, 20.0f };
+	stats.Clear();
+	for (float ms : even)
+		stats.AddFrame(ms);
+	Tests::Check("Even count: median is the lower middle value", stats.Percentile(50.0f) == 20.0f && stats.Percentile(51.0f) == 30.0f);
+	Tests::Check("Even count: every percentile is a nearest rank", PercentilesMatch(stats, even));
+	const FrameStatsSummary& summary = stats.Summary();
+	Tests::Check("Summary matches", summary.Average == 25.0f && summary.P50 == 20.0f && summary.P95 == 40.0f && summary.Max == 40.0f);
+
+	// Bigger histories, where rounding percent / 100 * count could go wrong
+	for (unsigned int count : { 100u, 101u, 1000u, 4096u })
+	{
+		FrameStats big(count);
+		std::vector<float> values(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			values[i] = (float)((i * 7919) % count) * 0.25f;
+			big.AddFrame(values[i]);
+		}
+		std::string name = std::to_string(count) + " frames: every percentile is a nearest rank";
+		Tests::Check(name.c_str(), PercentilesMatch(big, values));
+	}
+
+	// Once the ring wraps, only the newest frames count
+	FrameStats ring(4);
+	for (float ms : { 100.0f, 200.0f, 1.0f, 2.0f, 3.0f, 4.0f })
+		ring.AddFrame(ms);
+	Tests::Check("Wrapped ring only keeps the newest frames", ring.Count() == 4 && ring.TotalFrames() == 6 && ring.Summary().Max == 4.0f);
+	Tests::Check("Wrapped ring starts at the oldest frame", ring.Data()[ring.Offset()] == 1.0f);
+
+	ring.Clear();
+	Tests::Check("Cleared history has zero percentiles", ring.Percentile(50.0f) == 0.0f && ring.Summary().Max == 0.0f);
+
+	// Hitches are frames over the threshold
+	FrameStats hitches(16, 33.3f);
+	bool flagged = hitches.AddFrame(40.0f) && !hitches.AddFrame(33.3f) && !hitches.AddFrame(10.0f);
+	Tests::Check("Frames over the threshold are hitches", flagged && hitches.HitchCount() == 1);
+}
+
+TEST_SUITE(FrameStatsCSV)
+{
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "FrameStatsTest.csv";
+
+	// Frame numbers carry on from the start of the run once the ring wraps
+	FrameStats stats(3, 33.3f);
+	for (float ms : { 1.0f, 2.0f, 50.0f, 16.5f })
+		stats.AddFrame(ms);
+	bool written = stats.ExportCSV(path.string());
+	Tests::Check("CSV is written", written);
+	Tests::Check("CSV has a header and the newest frames, oldest first",
+		ReadFile(path) == "frame,milliseconds,hitch\n1,2,0\n2,50,1\n3,16.5,0\n");
+
+	FrameStats none;
+	Tests::Check("Empty history writes just the header", none.ExportCSV(path.string()) && ReadFile(path) == "frame,milliseconds,hitch\n");
+
+	std::filesystem::remove(path);
+	Tests::Check("Unwritable paths fail", !stats.ExportCSV((std::filesystem::temp_directory_path() / "missing folder" / "stats.csv").string()));
+}
@@ -0,0 +1,125 @@
+#include "Tests.h"
+
+#include "IBLBaker.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// The bundled Pink sky's faces, in D3D order
+	void PinkFaces(std::filesystem::path faces[6])
+	{
+		const char* names[6] = { "right", "left", "up", "down", "front", "back" };
+		for (int i = 0; i < 6; i++)
+			faces[i] = Tests::AssetPath(std::string("Skyboxes/Pink/") + names[i] + ".png");
+	}
+}
+
+// --------------------------------------------------------
+// A sky of one color must come out as that color
+// everywhere (irradiance and every specular mip), the BRDF
+// table must never reflect more than comes in, and a saved
+// bake must read back the same, but only for the same
+// source files.
+// --------------------------------------------------------
+TEST_SUITE(IBLBake)
+{
+	JobSystem::Initialize(3);
+
+	// Furnace test: a uniform sky must come out unchanged
+	const float furnace[3] = { 0.5f, 0.25f, 1.0f };
+	CubeImage uniform;
+	uniform.Resize(64);
+	for (std::vector<float>& face : uniform.Faces)
+		for (size_t i = 0; i < face.size(); i += 4)
+			for (int c = 0; c < 4; c++)
+				face[i + c] = c < 3 ? furnace[c] : 1.0f;
+
+	IBLData baked;
+	IBLBaker::Bake(uniform, baked, 32, 6, 32);
+	float shError = 0.0f, specularError = 0.0f;
+	for (int i = 0; i < 64; i++)
+	{
+		float z = 1.0f - (i + 0.5f) / 32.0f;
+		float r = sqrtf(1.0f - z * z);
+		float rgb[3];
+		IBLBaker::EvaluateSH(baked.IrradianceSH, r * cosf(i * 2.4f), r * sinf(i * 2.4f), z, rgb);
+		for (int c = 0; c < 3; c++)
+			shError = std::max(shError, fabsf(rgb[c] - furnace[c]));
+	}
+	for (size_t i = 0; i < baked.Specular.size(); i += 4)
+		for (int c = 0; c < 3; c++)
+			specularError = std::max(specularError, fabsf(IBLBaker::HalfToFloat(baked.Specular[i + c]) - furnace[c]));
+	printf("  Furnace: irradiance error %.4f, specular error %.4f\n", shError, specularError);
+	Tests::Check("A uniform sky lights with its own color", shError < 0.01f && specularError < 0.01f);
+
+	// Scale + bias can't be more than 1, and a smooth surface seen
+	// head on reflects (almost) everything that comes in
+	float maxEnergy = 0.0f;
+	for (size_t i = 0; i < baked.BrdfLut.size(); i += 2)
+		maxEnergy = std::max(maxEnergy, IBLBaker::HalfToFloat(baked.BrdfLut[i]) + IBLBaker::HalfToFloat(baked.BrdfLut[i + 1]));
+	size_t smoothHeadOn = (size_t)baked.LutSize - 1;
+	float headOn = IBLBaker::HalfToFloat(baked.BrdfLut[smoothHeadOn * 2]) + IBLBaker::HalfToFloat(baked.BrdfLut[smoothHeadOn * 2 + 1]);
+	printf("  BRDF table: most energy %.3f, smooth head on %.3f\n", maxEnergy, headOn);
+	Tests::Check("The BRDF table never adds energy", maxEnergy <= 1.01f && headOn > 0.95f);
+
+	Tests::Check("Halves round trip", IBLBaker::HalfToFloat(IBLBaker::FloatToHalf(0.25f)) == 0.25f &&
+		IBLBaker::HalfToFloat(IBLBaker::FloatToHalf(-3.5f)) == -3.5f && IBLBaker::HalfToFloat(IBLBaker::FloatToHalf(0.0f)) == 0.0f);
+
+	// Through a cache file and back, stamped with the real sky's files
+	std::filesystem::path faces[6];
+	PinkFaces(faces);
+	uint64_t stamp = IBLBaker::SourceStamp(faces);
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "IBLBakerTest.bin";
+	IBLData reloaded;
+	bool cacheOK = IBLBaker::Save(path, baked, stamp) && IBLBaker::Load(path, stamp, reloaded) &&
+		reloaded.Specular == baked.Specular && reloaded.BrdfLut == baked.BrdfLut &&
+		memcmp(reloaded.IrradianceSH, baked.IrradianceSH, sizeof(baked.IrradianceSH)) == 0;
+	Tests::Check("Saved bakes read back the same", cacheOK);
+	Tests::Check("Bakes from other sources are ignored", !IBLBaker::Load(path, stamp + 1, reloaded));
+	std::filesystem::remove(path);
+	Tests::Check("Missing caches fail", !IBLBaker::Load(path, stamp, reloaded));
+
+	JobSystem::ShutDown();
+}
+
+// --------------------------------------------------------
+// Bakes image based lighting for the bundled Pink sky the
+// way the game does on every core, timing each step.
+// --------------------------------------------------------
+BENCHMARK(IBLBakeSpeed)
+{
+	JobSystem::Initialize();
+
+	std::filesystem::path faces[6];
+	PinkFaces(faces);
+
+	IBLData ibl;
+	CubeImage sky;
+	uint64_t start = Profiler::Now();
+	IBLBaker::LoadFaces(faces, 256, sky);
+	uint64_t loaded = Profiler::Now();
+	IBLBaker::ProjectSH(sky, ibl.IrradianceSH);
+	uint64_t projected = Profiler::Now();
+	IBLBaker::PrefilterSpecular(sky, 128, 6, 256, ibl);
+	uint64_t prefiltered = Profiler::Now();
+	IBLBaker::BakeBrdfLut(64, 512, ibl);
+	uint64_t baked = Profiler::Now();
+
+	printf("  Pink sky on %u job threads:\n", JobSystem::ThreadCount());
+	printf("  %-28s %8.1f ms\n", "faces (decode + 256^2)", Profiler::TicksToMilliseconds(loaded - start));
+	printf("  %-28s %8.1f ms\n", "irradiance (L2 SH)", Profiler::TicksToMilliseconds(projected - loaded));
+	printf("  %-28s %8.1f ms\n", "specular (128^2, 6 mips)", Profiler::TicksToMilliseconds(prefiltered - projected));
+	printf("  %-28s %8.1f ms\n", "BRDF table (64^2)", Profiler::TicksToMilliseconds(baked - prefiltered));
+
+	JobSystem::ShutDown();
+}
@@ -0,0 +1,163 @@
+#include "Tests.h"
+
+#include "JobSystem.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// 1, 2, 4, ... threads, up to at least "most"
+	std::vector<unsigned int> ThreadCounts(unsigned int most)
+	{
+		std::vector<unsigned int> counts;
+		for (unsigned int threads = 1; threads < most; threads *= 2)
+			counts.push_back(threads);
+		counts.push_back(most > 0 ? most : 1);
+		return counts;
+	}
+
+	// Busy work that the compiler can't throw away
+	float Work(unsigned int i, unsigned int rounds)
+	{
+		float value = (float)i;
+		for (unsigned int r = 0; r < rounds; r++)
+			value = sqrtf(value + (float)r);
+		return value;
+	}
+
+	// Each job starts "width" children and waits for them, "depth" levels down
+	void Spawn(unsigned int depth, unsigned int width, std::atomic<unsigned int>& leaves)
+	{
+		if (depth == 0)
+		{
+			leaves.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		JobCounter children;
+		for (unsigned int i = 0; i < width; i++)
+			JobSystem::Run(children, [depth, width, &leaves]() { Spawn(depth - 1, width, leaves); });
+		JobSystem::Wait(children);
+	}
+}
+
+// --------------------------------------------------------
+// Runs the scheduler hard at several thread counts: jobs
+// that wait on jobs of their own, a parallel for with one
+// item per job, and more jobs in flight than a thread's
+// job pool and deque can hold (on one thread, then on
+// every thread at once).  Every job has to run exactly
+// once and nothing may hang.
+// --------------------------------------------------------
+TEST_SUITE(JobSystemStress)
+{
+	// More threads than cores is fine here, it only shuffles things more
+	for (unsigned int threads : ThreadCounts(std::max(std::thread::hardware_concurrency(), 8u)))
+	{
+		JobSystem::Initialize(threads - 1);
+		printf("  %u threads\n", JobSystem::ThreadCount());
+
+		// 4^6 leaves under 1365 jobs that each wait on their children
+		bool nestedOK = true;
+		for (int repeat = 0; repeat < 20; repeat++)
+		{
+			std::atomic<unsigned int> leaves = 0;
+			Spawn(6, 4, leaves);
+			nestedOK = nestedOK && leaves == 4096;
+		}
+		Tests::Check("Nested Run/Wait reaches every leaf", nestedOK);
+
+		// One item per job, so far more jobs than fit in a pool
+		const unsigned int count = 50000;
+		std::vector<std::atomic<unsigned int>> visits(count);
+		JobSystem::ParallelFor(count, [&](unsigned int begin, unsigned int end) {
+			for (unsigned int i = begin; i < end; i++)
+				visits[i].fetch_add(1, std::memory_order_relaxed);
+		}, 1);
+		bool once = true;
+		for (auto& visit : visits)
+			once = once && visit == 1;
+		Tests::Check("ParallelFor with a grain of 1 visits each item once", once);
+
+		// Three pools' worth of jobs from one thread, faster than they finish
+		std::atomic<unsigned int> ran = 0;
+		std::atomic<float> sink = 0.0f;
+		JobCounter flood;
+		for (unsigned int i = 0; i < 3 * 4096; i++)
+			JobSystem::Run(flood, [&ran, &sink, i]() { sink.store(Work(i, 64), std::memory_order_relaxed); ran.fetch_add(1, std::memory_order_relaxed); });
+		JobSystem::Wait(flood);
+		Tests::Check("Runs past a full job pool (one thread)", ran == 3 * 4096 && flood.pending == 0);
+
+		// Every thread fills its own pool at the same time, so none of
+		// them can count on another to free a slot
+		ran = 0;
+		JobSystem::ParallelFor(JobSystem::ThreadCount() * 2, [&](unsigned int begin, unsigned int end) {
+			for (unsigned int chunk = begin; chunk < end; chunk++)
+			{
+				JobCounter own;
+				for (unsigned int i = 0; i < 5000; i++)
+					JobSystem::Run(own, [&ran, &sink, i]() { sink.store(Work(i, 16), std::memory_order_relaxed); ran.fetch_add(1, std::memory_order_relaxed); });
+				JobSystem::Wait(own);
+			}
+		}, 1);
+		Tests::Check("Runs past a full job pool (every thread)", ran == JobSystem::ThreadCount() * 2 * 5000);
+
+		JobSystem::ShutDown();
+	}
+}
+
+// --------------------------------------------------------
+// Times the same work at 1, 2, 4, ... threads: a parallel
+// for over heavy items (should scale with cores) and lots
+// of tiny jobs (mostly scheduling overhead).
+// --------------------------------------------------------
+BENCHMARK(JobSystemScaling)
+{
+	const unsigned int items = 1 << 20;
+	const unsigned int tinyJobs = 100000;
+	std::vector<float> results(items);
+
+	printf("  %8s %14s %10s %16s %10s\n", "threads", "parallel ms", "speedup", "tiny jobs / ms", "speedup");
+	double singleFor = 0.0, singleJobs = 0.0;
+	for (unsigned int threads : ThreadCounts(std::thread::hardware_concurrency()))
+	{
+		JobSystem::Initialize(threads - 1);
+
+		double bestFor = 1e30, bestJobs = 1e30;
+		for (int run = 0; run < 5; run++)
+		{
+			uint64_t start = Profiler::Now();
+			JobSystem::ParallelFor(items, [&](unsigned int begin, unsigned int end) {
+				for (unsigned int i = begin; i < end; i++)
+					results[i] = Work(i, 32);
+			});
+			bestFor = std::min(bestFor, Profiler::TicksToMilliseconds(Profiler::Now() - start));
+
+			std::atomic<unsigned int> ran = 0;
+			JobCounter counter;
+			start = Profiler::Now();
+			for (unsigned int i = 0; i < tinyJobs; i++)
+				JobSystem::Run(counter, [&ran]() { ran.fetch_add(1, std::memory_order_relaxed); });
+			JobSystem::Wait(counter);
+			bestJobs = std::min(bestJobs, Profiler::TicksToMilliseconds(Profiler::Now() - start));
+		}
+
+		if (threads == 1)
+		{
+			singleFor = bestFor;
+			singleJobs = bestJobs;
+		}
+		printf("  %8u %14.2f %9.2fx %16.0f %9.2fx\n", JobSystem::ThreadCount(), bestFor, singleFor / bestFor,
+			tinyJobs / bestJobs, singleJobs / bestJobs);
+
+		JobSystem::ShutDown();
+	}
+}
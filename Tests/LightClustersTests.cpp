@@ -0,0 +1,156 @@
+#include "Tests.h"
+
+#include "JobSystem.h"
+#include "LightClusters.h"
+#include "LightPacker.h"
+#include "Profiler.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	const float Width = 1280.0f;
+	const float Height = 720.0f;
+
+	// Spread through (and past) the view, half point and half spot,
+	// plus one directional light that lights everything
+	std::vector<Lights> Scatter(RandomGenerator& random, unsigned int count)
+	{
+		std::vector<Lights> lights(count);
+		for (Lights& light : lights)
+		{
+			light = {};
+			light.type = random.NextFloat() < 0.5f ? LIGHT_TYPE_POINT : LIGHT_TYPE_SPOT;
+			light.position = XMFLOAT3(random.NextFloat(-50.0f, 50.0f), random.NextFloat(-2.0f, 8.0f), random.NextFloat(-10.0f, 100.0f));
+			light.range = random.NextFloat(1.0f, 5.0f);
+			XMStoreFloat3(&light.direction, XMVector3Normalize(XMVectorSet(random.NextFloat(-1.0f, 1.0f), random.NextFloat(-1.0f, 0.2f), random.NextFloat(-1.0f, 1.0f), 0)));
+			light.spotOuterAngle = XMConvertToRadians(random.NextFloat(10.0f, 60.0f));
+			light.intensity = 1.0f;
+		}
+		lights[0].type = LIGHT_TYPE_DIRECTIONAL;
+		return lights;
+	}
+
+	// A 720p camera a little above the ground, looking down +z
+	void Camera(XMFLOAT4X4& view, XMFLOAT4X4& projection)
+	{
+		XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV4, Width / Height, 0.01f, 100.0f));
+		XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorSet(0, 2, -5, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0)));
+	}
+}
+
+// --------------------------------------------------------
+// Builds clusters for 2000 random lights, which must give
+// the same lists as testing every light against every
+// cluster, and checks every light that reaches a random
+// point in view is in that point's cluster.
+// --------------------------------------------------------
+TEST_SUITE(LightClusterBuild)
+{
+	JobSystem::Initialize(3);
+
+	XMFLOAT4X4 view, projection;
+	Camera(view, projection);
+	LightClusters clusters;
+	clusters.SetProjection(projection, 0.5f, 100.0f);
+
+	RandomGenerator random(7);
+	std::vector<Lights> lights = Scatter(random, 2000);
+	LightPacker packer;
+	packer.Pack(lights.data(), (unsigned int)lights.size());
+	const std::vector<PackedLight>& packed = packer.GetLights();
+
+	clusters.BuildReference(packed.data(), (unsigned int)packed.size(), view);
+	std::vector<ClusterRange> referenceRanges = clusters.GetRanges();
+	std::vector<uint32_t> referenceIndices = clusters.GetIndices();
+	clusters.Build(packed.data(), (unsigned int)packed.size(), view);
+	bool matches = clusters.GetIndices() == referenceIndices;
+	for (size_t c = 0; c < referenceRanges.size(); c++)
+		matches = matches && clusters.GetRanges()[c].Offset == referenceRanges[c].Offset && clusters.GetRanges()[c].Count == referenceRanges[c].Count;
+	Tests::Check("SIMD build matches brute force", matches);
+
+	// Every light lighting a point is in the point's cluster
+	XMMATRIX inverseView = XMMatrixInverse(0, XMLoadFloat4x4(&view));
+	unsigned int missing = 0, lit = 0;
+	for (unsigned int p = 0; p < 20000; p++)
+	{
+		float x = random.NextFloat(0.0f, Width), y = random.NextFloat(0.0f, Height);
+		float depth = 0.01f * powf(100.0f / 0.01f, random.NextFloat());
+		XMVECTOR viewPoint = XMVectorSet((x / Width * 2.0f - 1.0f) * depth / projection._11, (1.0f - y / Height * 2.0f) * depth / projection._22, depth, 1);
+		XMVECTOR worldPoint = XMVector3Transform(viewPoint, inverseView);
+
+		const ClusterRange& range = clusters.GetRanges()[clusters.ClusterIndex(x, y, depth, Width, Height)];
+		const uint32_t* begin = clusters.GetIndices().data() + range.Offset;
+		const uint32_t* end = begin + range.Count;
+		for (uint32_t i = 1; i < lights.size(); i++)
+		{
+			// What the shaders would light it with
+			const Lights& light = lights[i];
+			XMVECTOR toPoint = worldPoint - XMLoadFloat3(&light.position);
+			float distance = XMVectorGetX(XMVector3Length(toPoint));
+			if (distance >= light.range)
+				continue;
+			if (light.type == LIGHT_TYPE_SPOT && distance > 0.0f &&
+				XMVectorGetX(XMVector3Dot(toPoint / distance, XMLoadFloat3(&light.direction))) <= cosf(light.spotOuterAngle))
+				continue;
+			lit++;
+			if (!std::binary_search(begin, end, packer.GetPackedIndices()[i]))
+				missing++;
+		}
+	}
+	printf("  Lights reaching 20000 random points: %u, missing from their cluster: %u\n", lit, missing);
+	Tests::Check("Lights reaching a point are in its cluster", lit > 0 && missing == 0);
+
+	JobSystem::ShutDown();
+}
+
+// --------------------------------------------------------
+// Builds clusters for 1k to 10k random point and spot
+// lights on every core, against testing every light
+// against every cluster, and prints how full they are.
+// --------------------------------------------------------
+BENCHMARK(LightClusterSpeed)
+{
+	JobSystem::Initialize();
+
+	XMFLOAT4X4 view, projection;
+	Camera(view, projection);
+	LightClusters clusters;
+	clusters.SetProjection(projection, 0.5f, 100.0f);
+	RandomGenerator random(7);
+	LightPacker packer;
+
+	printf("  %u x %u x %u clusters on %u job threads\n", clusters.GetTilesX(), clusters.GetTilesY(), clusters.GetSlices(), JobSystem::ThreadCount());
+	printf("  %7s %10s %14s %10s %12s %12s\n", "lights", "build ms", "brute force ms", "visible", "per cluster", "max");
+	for (unsigned int count : { 1000, 2000, 5000, 10000 })
+	{
+		std::vector<Lights> lights = Scatter(random, count);
+		packer.Pack(lights.data(), count);
+		const std::vector<PackedLight>& packed = packer.GetLights();
+		double best = 1e30;
+		for (int run = 0; run < 5; run++)
+		{
+			uint64_t start = Profiler::Now();
+			clusters.Build(packed.data(), count, view);
+			best = std::min(best, Profiler::TicksToMilliseconds(Profiler::Now() - start));
+		}
+		const LightClusterStats stats = clusters.GetStats();
+
+		uint64_t start = Profiler::Now();
+		clusters.BuildReference(packed.data(), count, view);
+		double brute = Profiler::TicksToMilliseconds(Profiler::Now() - start);
+
+		printf("  %7u %10.3f %14.1f %10u %12.2f %12u\n", count, best, brute, stats.Visible,
+			(double)stats.Indices / clusters.GetClusterCount(), stats.MaxPerCluster);
+	}
+
+	JobSystem::ShutDown();
+}
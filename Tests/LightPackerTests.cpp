@@ -0,0 +1,153 @@
+#include "Tests.h"
+
+#include "LightPacker.h"
+#include "Profiler.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Random lights of every type, with one of an unknown type at 17
+	std::vector<Lights> RandomLights(RandomGenerator& random, unsigned int count)
+	{
+		std::vector<Lights> lights(count);
+		for (Lights& light : lights)
+		{
+			light = {};
+			light.type = (int)(random.NextFloat() * 3.0f);
+			light.position = XMFLOAT3(random.NextFloat(-20.0f, 20.0f), random.NextFloat(-20.0f, 20.0f), random.NextFloat(-20.0f, 20.0f));
+			light.direction = XMFLOAT3(random.NextFloat(-2.0f, 2.0f), random.NextFloat(-2.0f, 2.0f), random.NextFloat(-2.0f, 2.0f));
+			light.range = random.NextFloat(0.5f, 10.0f);
+			light.color = XMFLOAT3(random.NextFloat(), random.NextFloat(), random.NextFloat());
+			light.intensity = random.NextFloat(0.0f, 3.0f);
+			light.spotOuterAngle = XMConvertToRadians(random.NextFloat(5.0f, 80.0f));
+			light.spotInnerAngle = light.spotOuterAngle * random.NextFloat(0.1f, 0.9f);
+		}
+		lights[17].type = 7;
+		return lights;
+	}
+
+	float Saturate(float value)
+	{
+		return std::clamp(value, 0.0f, 1.0f);
+	}
+}
+
+// --------------------------------------------------------
+// Packs 5000 random lights: the layout the shaders read,
+// sorting by type, index maps both ways, and the
+// precomputed terms against what the shaders used to work
+// out for every pixel.
+// --------------------------------------------------------
+TEST_SUITE(LightPack)
+{
+	// Shared with the shaders, which read it with no padding of their own
+	Tests::Check("Packed lights are 64 bytes", sizeof(PackedLight) == 64);
+
+	RandomGenerator random(11);
+	std::vector<Lights> lights = RandomLights(random, 5000);
+	LightPacker packer;
+	packer.Pack(lights.data(), (unsigned int)lights.size());
+	const std::vector<PackedLight>& packed = packer.GetLights();
+	const PackedLightCounts& counts = packer.GetCounts();
+
+	bool sorted = counts.Directional + counts.Point + counts.Spot == packed.size();
+	for (size_t i = 0; i < packed.size(); i++)
+	{
+		int expected = i < counts.Directional ? LIGHT_TYPE_DIRECTIONAL : i < counts.Directional + counts.Point ? LIGHT_TYPE_POINT : LIGHT_TYPE_SPOT;
+		sorted = sorted && packed[i].Type == expected;
+	}
+	Tests::Check("Sorted by type, with counts per type", sorted);
+
+	bool stable = true, roundTrip = true;
+	for (size_t i = 1; i < packed.size(); i++)
+		if (packed[i].Type == packed[i - 1].Type)
+			stable = stable && packer.GetSourceIndices()[i] > packer.GetSourceIndices()[i - 1];
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		uint32_t slot = packer.GetPackedIndices()[i];
+		if (slot != LightPacker::NotPacked)
+			roundTrip = roundTrip && packer.GetSourceIndices()[slot] == i;
+	}
+	Tests::Check("Order within a type is kept", stable);
+	Tests::Check("Packed and source indices map both ways", roundTrip);
+	Tests::Check("Unknown types are left out", packer.GetPackedIndices()[17] == LightPacker::NotPacked && packed.size() == lights.size() - 1);
+
+	// What the shaders used to work out for every pixel, against the
+	// same thing from the packed terms, at points around each light
+	float worstDirection = 0.0f, worstColor = 0.0f, worstAttenuation = 0.0f, worstSpot = 0.0f;
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		uint32_t slot = packer.GetPackedIndices()[i];
+		if (slot == LightPacker::NotPacked)
+			continue;
+		const Lights& light = lights[i];
+		const PackedLight& p = packed[slot];
+
+		XMFLOAT3 direction;
+		XMStoreFloat3(&direction, XMVector3Normalize(XMLoadFloat3(&light.direction)));
+		worstDirection = std::max({ worstDirection, fabsf(direction.x - p.Direction.x), fabsf(direction.y - p.Direction.y), fabsf(direction.z - p.Direction.z) });
+		worstColor = std::max(worstColor, fabsf(light.color.x * light.intensity - p.Color.x));
+
+		for (int s = 0; s < 8; s++)
+		{
+			XMFLOAT3 offset(random.NextFloat(-1.0f, 1.0f) * light.range, random.NextFloat(-1.0f, 1.0f) * light.range, random.NextFloat(-1.0f, 1.0f) * light.range);
+			float distanceSq = offset.x * offset.x + offset.y * offset.y + offset.z * offset.z;
+
+			float before = Saturate(1.0f - distanceSq / (light.range * light.range));
+			float after = Saturate(1.0f - distanceSq * p.InvRangeSq);
+			worstAttenuation = std::max(worstAttenuation, fabsf(before * before - after * after));
+
+			// Cosine between the light's direction and the way to the point
+			float angle = std::max((offset.x * direction.x + offset.y * direction.y + offset.z * direction.z) / sqrtf(distanceSq), 0.0f);
+			float cosInner = cosf(light.spotInnerAngle), cosOuter = cosf(light.spotOuterAngle);
+			float spotBefore = Saturate((cosOuter - angle) / (cosOuter - cosInner));
+			float spotAfter = Saturate((angle - p.CosOuter) * p.SpotScale);
+			worstSpot = std::max(worstSpot, fabsf(spotBefore - spotAfter));
+		}
+	}
+	printf("  Worst differences: direction %g, color %g, attenuation %g, spot falloff %g\n", worstDirection, worstColor, worstAttenuation, worstSpot);
+	Tests::Check("Directions are normalized the same way", worstDirection < 1e-5f);
+	Tests::Check("Color is premultiplied by intensity", worstColor < 1e-5f);
+	Tests::Check("Attenuation matches", worstAttenuation < 1e-4f);
+	Tests::Check("Spot falloff matches", worstSpot < 1e-3f);
+
+	Lights same = lights[0];
+	same.type = LIGHT_TYPE_SPOT;
+	same.spotInnerAngle = same.spotOuterAngle;
+	same.range = 0.0f;
+	PackedLight edge = LightPacker::PackLight(same);
+	Tests::Check("Equal spot angles and no range stay finite", std::isfinite(edge.SpotScale) && std::isfinite(edge.InvRangeSq));
+}
+
+// --------------------------------------------------------
+// Packs 1k to 10k random lights, best of a few runs.  It
+// happens once a frame, so it only has to be cheap next to
+// everything else.
+// --------------------------------------------------------
+BENCHMARK(LightPackSpeed)
+{
+	RandomGenerator random(11);
+	LightPacker packer;
+	printf("  %7s %10s %12s\n", "lights", "ms", "upload KB");
+	for (unsigned int count : { 1000, 2000, 5000, 10000 })
+	{
+		std::vector<Lights> lights = RandomLights(random, count);
+		double best = 1e30;
+		for (int run = 0; run < 5; run++)
+		{
+			uint64_t start = Profiler::Now();
+			packer.Pack(lights.data(), count);
+			best = std::min(best, Profiler::TicksToMilliseconds(Profiler::Now() - start));
+		}
+		printf("  %7u %10.3f %12.1f\n", count, best, packer.GetLights().size() * sizeof(PackedLight) / 1024.0);
+	}
+}
@@ -0,0 +1,159 @@
+#include "Tests.h"
+
+#include "JobSystem.h"
+#include "OcclusionCuller.h"
+#include "Profiler.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// A 10x10 wall 10 units in front of the camera, facing it
+	const float WallHalfSize = 5.0f;
+	const float WallDistance = 10.0f;
+
+	void Wall(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+	{
+		const float s = WallHalfSize;
+		for (XMFLOAT3 corner : { XMFLOAT3(-s, s, WallDistance), XMFLOAT3(s, s, WallDistance), XMFLOAT3(s, -s, WallDistance), XMFLOAT3(-s, -s, WallDistance) })
+		{
+			Vertex vertex = {};
+			vertex.Position = corner;
+			vertex.Normal = XMFLOAT3(0, 0, -1);
+			vertices.push_back(vertex);
+		}
+		indices = { 0, 1, 2, 0, 2, 3 };
+	}
+
+	BoundingBox Box(XMFLOAT3 center, float extent)
+	{
+		BoundingBox box;
+		box.Center = center;
+		box.Extents = XMFLOAT3(extent, extent, extent);
+		return box;
+	}
+
+	// Camera at the origin looking down +z with a 90 degree vertical field of view
+	void BeginFrame(OcclusionCuller& culler)
+	{
+		XMFLOAT4X4 view, projection;
+		XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorSet(0, 0, 0, 1), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0)));
+		XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV2, (float)culler.GetWidth() / culler.GetHeight(), 0.1f, 100.0f));
+		culler.BeginFrame(view, projection);
+	}
+
+	// Whether a box really is behind the wall: every corner is past
+	// it, and the line from the camera to each corner goes through it
+	bool BehindWall(const BoundingBox& box)
+	{
+		for (int i = 0; i < 8; i++)
+		{
+			float x = box.Center.x + (i & 1 ? box.Extents.x : -box.Extents.x);
+			float y = box.Center.y + (i & 2 ? box.Extents.y : -box.Extents.y);
+			float z = box.Center.z + (i & 4 ? box.Extents.z : -box.Extents.z);
+			if (z <= WallDistance || fabsf(x) * WallDistance / z > WallHalfSize || fabsf(y) * WallDistance / z > WallHalfSize)
+				return false;
+		}
+		return true;
+	}
+}
+
+// --------------------------------------------------------
+// Draws a wall into the occlusion buffer and tests boxes
+// around it.  Boxes behind it are hidden; boxes in front,
+// peeking past its edge or crossing the near plane are
+// not.  Then random boxes check that nothing that can be
+// seen is ever reported hidden.
+// --------------------------------------------------------
+TEST_SUITE(OcclusionCull)
+{
+	JobSystem::Initialize(3);
+
+	OcclusionCuller culler(320, 180);
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	Wall(vertices, indices);
+	XMFLOAT4X4 world;
+	XMStoreFloat4x4(&world, XMMatrixIdentity());
+
+	BeginFrame(culler);
+	culler.RasterizeOccluders();
+	Tests::Check("Without occluders everything is visible", culler.IsVisible(Box(XMFLOAT3(0, 0, 20), 1.0f)));
+
+	BeginFrame(culler);
+	culler.AddOccluder(vertices, indices, world);
+	culler.RasterizeOccluders();
+	Tests::Check("Boxes behind an occluder are hidden", !culler.IsVisible(Box(XMFLOAT3(0, 0, 20), 1.0f)));
+	Tests::Check("Boxes in front of it are visible", culler.IsVisible(Box(XMFLOAT3(0, 0, 5), 1.0f)));
+	Tests::Check("Boxes peeking past its edge are visible", culler.IsVisible(Box(XMFLOAT3(10.5f, 0, 20), 1.0f)));
+	Tests::Check("Boxes crossing the near plane are visible", culler.IsVisible(Box(XMFLOAT3(0, 0, 0), 1.0f)));
+
+	OcclusionStats stats = culler.GetStats();
+	Tests::Check("Stats count occluders and tests", stats.Occluders == 1 && stats.OccluderTriangles == 2 && stats.Tested == 4 && stats.Occluded == 1);
+
+	// Conservative: hidden only when really behind the wall
+	RandomGenerator random(5);
+	unsigned int hidden = 0, reallyHidden = 0;
+	bool neverWrong = true;
+	for (unsigned int i = 0; i < 10000; i++)
+	{
+		BoundingBox box = Box(XMFLOAT3(random.NextFloat(-15, 15), random.NextFloat(-15, 15), random.NextFloat(2, 40)), random.NextFloat(0.1f, 3.0f));
+		bool behind = BehindWall(box);
+		bool visible = culler.IsVisible(box);
+		neverWrong = neverWrong && (visible || behind);
+		hidden += visible ? 0 : 1;
+		reallyHidden += behind ? 1 : 0;
+	}
+	printf("  %u of %u random boxes hidden, %u really behind the wall\n", hidden, 10000u, reallyHidden);
+	Tests::Check("Nothing that can be seen is hidden", neverWrong && hidden > 0);
+
+	JobSystem::ShutDown();
+}
+
+// --------------------------------------------------------
+// Times drawing the wall and testing lots of boxes against
+// it on every core, the way Game culls entities.
+// --------------------------------------------------------
+BENCHMARK(OcclusionCullSpeed)
+{
+	JobSystem::Initialize();
+
+	const unsigned int boxCount = 100000;
+	std::vector<BoundingBox> boxes(boxCount);
+	RandomGenerator random(5);
+	for (BoundingBox& box : boxes)
+		box = Box(XMFLOAT3(random.NextFloat(-15, 15), random.NextFloat(-15, 15), random.NextFloat(2, 40)), random.NextFloat(0.1f, 3.0f));
+
+	OcclusionCuller culler(320, 180);
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	Wall(vertices, indices);
+	XMFLOAT4X4 world;
+	XMStoreFloat4x4(&world, XMMatrixIdentity());
+
+	BeginFrame(culler);
+	culler.AddOccluder(vertices, indices, world);
+	culler.RasterizeOccluders();
+
+	uint64_t start = Profiler::Now();
+	JobSystem::ParallelFor(boxCount, [&](unsigned int begin, unsigned int end) {
+		for (unsigned int i = begin; i < end; i++)
+			culler.IsVisible(boxes[i]);
+	});
+	double testMs = Profiler::TicksToMilliseconds(Profiler::Now() - start);
+
+	OcclusionStats stats = culler.GetStats();
+	printf("  %ux%u buffer, %u job threads\n", culler.GetWidth(), culler.GetHeight(), JobSystem::ThreadCount());
+	printf("  raster %.3f ms, %u boxes tested in %.3f ms (%.1f ns each), %u occluded\n",
+		stats.RasterMs, stats.Tested, testMs, testMs * 1e6 / stats.Tested, stats.Occluded);
+
+	JobSystem::ShutDown();
+}
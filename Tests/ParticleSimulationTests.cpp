@@ -0,0 +1,147 @@
+#include "Tests.h"
+
+#include "CpuFeatures.h"
+#include "JobSystem.h"
+#include "ParticleSimulation.h"
+#include "Profiler.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Gravity, drag, turbulence and a floor: every branch of the kernels
+	ParticleForces Forces()
+	{
+		ParticleForces forces;
+		forces.Acceleration = DirectX::XMFLOAT3(0.0f, -9.8f, 0.0f);
+		forces.Drag = 0.5f;
+		forces.TurbulenceStrength = 2.0f;
+		forces.FloorCollision = true;
+		forces.FloorHeight = -2.0f;
+		return forces;
+	}
+
+	// A cloud of particles above the floor, the same every time
+	ParticleSoA Cloud(unsigned int count)
+	{
+		ParticleSoA particles;
+		particles.Resize(count);
+		RandomGenerator random(1234);
+		random.FillUniform(particles.PositionX.data(), count, -5.0f, 5.0f);
+		random.FillUniform(particles.PositionY.data(), count, 0.0f, 10.0f);
+		random.FillUniform(particles.PositionZ.data(), count, -5.0f, 5.0f);
+		random.FillUniform(particles.VelocityY.data(), count, 0.0f, 5.0f);
+		particles.RotationSpeed.assign(count, 1.0f);
+		return particles;
+	}
+
+	float MaxDifference(const std::vector<float>& a, const std::vector<float>& b)
+	{
+		float worst = 0.0f;
+		for (size_t i = 0; i < a.size(); i++)
+			worst = std::max(worst, fabsf(a[i] - b[i]));
+		return worst;
+	}
+}
+
+// --------------------------------------------------------
+// Steps a cloud of particles for a second with the scalar
+// and AVX2 kernels (a count that leaves a few over for the
+// scalar tail), which must end up in the same place, then
+// checks the floor holds and that a range only touches
+// the particles in it.
+// --------------------------------------------------------
+TEST_SUITE(ParticleKernels)
+{
+	const unsigned int count = 1003;
+	const float dt = 1.0f / 60.0f;
+	const ParticleForces forces = Forces();
+
+	ParticleSoA scalar = Cloud(count);
+	ParticleSoA simd = Cloud(count);
+	for (unsigned int step = 0; step < 60; step++)
+	{
+		ParticleSimulation::IntegrateScalar(scalar, 0, count, dt, step * dt, forces);
+		ParticleSimulation::Integrate(simd, 0, count, dt, step * dt, forces);
+	}
+
+	// FMA rounds differently, so close rather than equal
+	float worst = std::max({ MaxDifference(scalar.PositionX, simd.PositionX), MaxDifference(scalar.PositionY, simd.PositionY),
+		MaxDifference(scalar.PositionZ, simd.PositionZ), MaxDifference(scalar.Rotation, simd.Rotation) });
+	printf("  AVX2 %s, largest difference from scalar after 60 steps %.2e\n", CpuFeatures::HasAVX2() ? "used" : "not available", worst);
+	Tests::Check("AVX2 and scalar kernels agree", worst < 1e-3f);
+
+	bool aboveFloor = true;
+	for (unsigned int i = 0; i < count; i++)
+		aboveFloor = aboveFloor && scalar.PositionY[i] >= forces.FloorHeight && simd.PositionY[i] >= forces.FloorHeight;
+	Tests::Check("Nothing falls through the floor", aboveFloor);
+
+	ParticleSoA partial = Cloud(count);
+	const ParticleSoA untouched = partial;
+	ParticleSimulation::Integrate(partial, 100, 205, dt, 0.0f, forces);
+	bool outside = true, inside = true;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		bool same = partial.PositionY[i] == untouched.PositionY[i] && partial.VelocityY[i] == untouched.VelocityY[i];
+		if (i >= 100 && i < 205)
+			inside = inside && !same;
+		else
+			outside = outside && same;
+	}
+	Tests::Check("Only particles in the range move", inside && outside);
+}
+
+// --------------------------------------------------------
+// Times the particle kernels at a few particle counts and
+// prints particles/ms for scalar, AVX2 and AVX2 spread
+// across the job system.
+// --------------------------------------------------------
+BENCHMARK(ParticleKernelSpeed)
+{
+	JobSystem::Initialize();
+
+	const ParticleForces forces = Forces();
+	const float dt = 1.0f / 60.0f;
+	const unsigned int steps = 60;
+
+	printf("  %u steps, %u job threads, AVX2 %s\n", steps, JobSystem::ThreadCount(),
+		CpuFeatures::HasAVX2() ? "available" : "NOT available (AVX2 rows use scalar)");
+	printf("  %10s %16s %16s %16s\n", "particles", "scalar p/ms", "AVX2 p/ms", "AVX2 MT p/ms");
+
+	for (unsigned int count : { 10000u, 100000u, 1000000u })
+	{
+		// Same starting cloud for every mode
+		const ParticleSoA start = Cloud(count);
+
+		double rates[3] = {};
+		for (int mode = 0; mode < 3; mode++)
+		{
+			ParticleSoA particles = start;
+			uint64_t begin = Profiler::Now();
+			for (unsigned int step = 0; step < steps; step++)
+			{
+				float time = step * dt;
+				if (mode == 0)
+					ParticleSimulation::IntegrateScalar(particles, 0, count, dt, time, forces);
+				else if (mode == 1)
+					ParticleSimulation::Integrate(particles, 0, count, dt, time, forces);
+				else
+					JobSystem::ParallelFor(count, [&](unsigned int b, unsigned int e) {
+						ParticleSimulation::Integrate(particles, b, e, dt, time, forces);
+					}, 8192);
+			}
+			double ms = Profiler::TicksToMilliseconds(Profiler::Now() - begin);
+			rates[mode] = (double)count * steps / ms;
+		}
+
+		printf("  %10u %16.0f %16.0f %16.0f\n", count, rates[0], rates[1], rates[2]);
+	}
+
+	JobSystem::ShutDown();
+}
@@ -0,0 +1,110 @@
+#include "Tests.h"
+
+#include "ParticleSpawner.h"
+#include "Random.h"
+
+#include <cstring>
+#include <vector>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	const int RingSize = 1000;
+
+	// Spawn counts like a few frames of an emitter plus some bursts,
+	// adding up to more than the ring so it wraps around
+	const int SpawnCounts[] = { 1, 7, 300, 64, 8, 450, 3, 999, 1, 120 };
+
+	ParticleSpawnSettings Settings()
+	{
+		ParticleSpawnSettings settings;
+		settings.Position = XMFLOAT3(1.0f, 2.0f, 3.0f);
+		settings.PositionRandomRange = XMFLOAT3(0.5f, 0.25f, 2.0f);
+		settings.StartVelocity = XMFLOAT3(0.0f, 4.0f, -1.0f);
+		settings.VelocityRandomRange = XMFLOAT3(1.0f, 0.5f, 1.0f);
+		settings.RotationStartMinMax = XMFLOAT2(-1.0f, 1.0f);
+		settings.RotationEndMinMax = XMFLOAT2(2.0f, 5.0f);
+		settings.EmitterIndex = 3;
+		return settings;
+	}
+
+	// Runs the spawn counts through a ring the way an emitter does, one
+	// spawn after another at the next dead particle, batched per spawn
+	// or one particle at a time
+	std::vector<Particle> SpawnAll(uint64_t seed, bool oneAtATime)
+	{
+		std::vector<Particle> ring(RingSize);
+		ParticleSpawner spawner(seed);
+		int first = 0;
+		for (int count : SpawnCounts)
+		{
+			float emitTime = first * 0.01f;
+			if (oneAtATime)
+				for (int i = 0; i < count; i++)
+					spawner.Spawn(ring.data(), RingSize, (first + i) % RingSize, 1, emitTime, Settings());
+			else
+				spawner.Spawn(ring.data(), RingSize, first, count, emitTime, Settings());
+			first = (first + count) % RingSize;
+		}
+		return ring;
+	}
+
+	bool Same(const std::vector<Particle>& a, const std::vector<Particle>& b)
+	{
+		return a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(Particle)) == 0;
+	}
+}
+
+// --------------------------------------------------------
+// Spawns particles the way Emitter does and checks a seed
+// replays them byte for byte, whether they come in the
+// same spawns or one at a time, and that each particle
+// takes the next 8 randoms of the seed's stream in order.
+// --------------------------------------------------------
+TEST_SUITE(ParticleSpawn)
+{
+	const uint64_t seed = 42;
+
+	std::vector<Particle> first = SpawnAll(seed, false);
+	std::vector<Particle> second = SpawnAll(seed, false);
+	Tests::Check("Same seed and spawn counts give identical particles", Same(first, second));
+	Tests::Check("Spawning one at a time gives identical particles", Same(first, SpawnAll(seed, true)));
+	Tests::Check("Other seeds give other particles", !Same(first, SpawnAll(seed + 1, false)));
+
+	// Position 0 and ranges of 1 turn each random r into exactly r * 2 - 1
+	// (or r for rotations), so the particles show which randoms they took
+	ParticleSpawnSettings unit;
+	unit.PositionRandomRange = XMFLOAT3(1, 1, 1);
+	unit.VelocityRandomRange = XMFLOAT3(1, 1, 1);
+	unit.RotationStartMinMax = XMFLOAT2(0, 1);
+	unit.RotationEndMinMax = XMFLOAT2(0, 1);
+	unit.EmitterIndex = 7;
+
+	const int count = 100;
+	std::vector<Particle> ring(RingSize);
+	ParticleSpawner spawner(seed);
+	spawner.Spawn(ring.data(), RingSize, RingSize - count / 2, count, 1.5f, unit);
+
+	std::vector<float> randoms(count * ParticleSpawner::RandomsPerParticle);
+	RandomGenerator(seed).FillUniform(randoms.data(), (unsigned int)randoms.size());
+	bool inOrder = true;
+	for (int i = 0; i < count; i++)
+	{
+		const Particle& p = ring[(RingSize - count / 2 + i) % RingSize];
+		const float* r = &randoms[(size_t)i * ParticleSpawner::RandomsPerParticle];
+		const float taken[8] = { p.StartPosition.x, p.StartPosition.y, p.StartPosition.z,
+			p.StartVelocity.x, p.StartVelocity.y, p.StartVelocity.z, p.StartRotation, p.EndRotation };
+		for (int j = 0; j < 8; j++)
+			inOrder = inOrder && taken[j] == (j < 6 ? r[j] * 2.0f - 1.0f : r[j]);
+		inOrder = inOrder && p.EmitTime == 1.5f && p.EmitterIndex == 7;
+	}
+	Tests::Check("Each particle takes the next 8 randoms in order", inOrder);
+
+	bool untouched = true;
+	for (int i = count / 2; i < RingSize - count / 2; i++)
+		untouched = untouched && ring[i].EmitTime == 0.0f && ring[i].EmitterIndex == 0;
+	Tests::Check("Spawns wrap around the ring and touch nothing else", untouched);
+}
@@ -0,0 +1,181 @@
+#include "Tests.h"
+
+#include "JobSystem.h"
+#include "PngDecoder.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Every PNG in the bundled textures and sky, sorted by name
+	std::vector<std::filesystem::path> BundledPNGs()
+	{
+		std::vector<std::filesystem::path> files;
+		for (const char* folder : { "Textures", "Skyboxes/Pink" })
+		{
+			std::error_code error;
+			for (const auto& entry : std::filesystem::directory_iterator(Tests::AssetPath(folder), error))
+				if (entry.path().extension() == ".png")
+					files.push_back(entry.path());
+		}
+		std::sort(files.begin(), files.end());
+		return files;
+	}
+
+	// Size straight from the IHDR chunk (big endian, just past the signature)
+	bool HeaderSize(const std::vector<uint8_t>& bytes, unsigned int& width, unsigned int& height)
+	{
+		if (bytes.size() < 24)
+			return false;
+		auto read = [&](size_t at) { return (unsigned int)bytes[at] << 24 | bytes[at + 1] << 16 | bytes[at + 2] << 8 | bytes[at + 3]; };
+		width = read(16);
+		height = read(20);
+		return true;
+	}
+
+	// Signature, an 8 bit RGBA IHDR of the given size and IEND, with no
+	// pixel data (the decoder doesn't check CRCs, so those are left 0)
+	std::vector<uint8_t> HeaderOnlyPNG(unsigned int width, unsigned int height)
+	{
+		std::vector<uint8_t> bytes = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n', 0, 0, 0, 13, 'I', 'H', 'D', 'R' };
+		for (unsigned int value : { width, height })
+			for (int shift = 24; shift >= 0; shift -= 8)
+				bytes.push_back((uint8_t)(value >> shift));
+		bytes.insert(bytes.end(), { 8, 6, 0, 0, 0, 0, 0, 0, 0 });
+		bytes.insert(bytes.end(), { 0, 0, 0, 0, 'I', 'E', 'N', 'D', 0, 0, 0, 0 });
+		return bytes;
+	}
+}
+
+// --------------------------------------------------------
+// Decodes every bundled PNG (one at a time, then all at
+// once on the job system, which must give the same pixels)
+// and checks the sizes against the files' headers.  Broken
+// files have to fail with an error rather than crash.
+// --------------------------------------------------------
+TEST_SUITE(PngDecode)
+{
+	std::vector<std::filesystem::path> files = BundledPNGs();
+	unsigned int count = (unsigned int)files.size();
+	Tests::Check("Bundled PNGs found", count > 0);
+
+	std::vector<CpuImage> images(count);
+	bool decoded = true, sized = true;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		std::vector<uint8_t> bytes;
+		std::string error;
+		unsigned int width = 0, height = 0;
+		bool read = PngDecoder::ReadFile(files[i], bytes) && HeaderSize(bytes, width, height);
+		bool ok = read && PngDecoder::Decode(bytes.data(), bytes.size(), images[i], &error);
+		if (!ok)
+			printf("  %s: %s\n", files[i].filename().string().c_str(), read ? error.c_str() : "can't read");
+
+		decoded = decoded && ok;
+		sized = sized && images[i].Width == width && images[i].Height == height &&
+			images[i].Pixels.size() == (size_t)images[i].RowPitch() * images[i].Height;
+	}
+	Tests::Check("Every bundled PNG decodes", decoded);
+	Tests::Check("Sizes match the headers", sized);
+
+	JobSystem::Initialize(3);
+	std::vector<CpuImage> parallelImages(count);
+	JobCounter counter;
+	for (unsigned int i = 0; i < count; i++)
+		JobSystem::Run(counter, [&, i]() { PngDecoder::DecodeFile(files[i], parallelImages[i]); });
+	JobSystem::Wait(counter);
+	JobSystem::ShutDown();
+	bool same = true;
+	for (unsigned int i = 0; i < count; i++)
+		same = same && parallelImages[i].Pixels == images[i].Pixels;
+	Tests::Check("Decoding on job threads gives the same pixels", same);
+
+	// Broken files fail with a reason
+	std::vector<uint8_t> bytes;
+	PngDecoder::ReadFile(files.empty() ? std::filesystem::path() : files[0], bytes);
+	CpuImage broken;
+	std::string error;
+	bool truncated = !bytes.empty() && !PngDecoder::Decode(bytes.data(), bytes.size() / 2, broken, &error) && !error.empty();
+	Tests::Check("Truncated files fail", truncated);
+	const uint8_t notPng[] = { 'G', 'I', 'F', '8', '9', 'a', 0, 0 };
+	error.clear();
+	Tests::Check("Other formats fail", !PngDecoder::Decode(notPng, sizeof(notPng), broken, &error) && !error.empty());
+	Tests::Check("Missing files fail", !PngDecoder::DecodeFile(Tests::AssetPath("Textures/missing.png"), broken));
+
+	// Headers too big for a texture (the first would wrap a 32 bit row pitch to 0)
+	bool tooLarge = true;
+	for (auto [width, height] : { std::pair(0x40000000u, 1u), std::pair(1u, 0x40000000u), std::pair(PngDecoder::MaxDimension + 1, 1u) })
+	{
+		std::vector<uint8_t> header = HeaderOnlyPNG(width, height);
+		error.clear();
+		tooLarge = tooLarge && !PngDecoder::Decode(header.data(), header.size(), broken, &error) && error == "image too large";
+	}
+	Tests::Check("Oversized headers fail", tooLarge);
+
+	// A zlib stream holding one stored (uncompressed) block
+	const uint8_t stored[] = { 0x78, 0x01, 0x01, 0x05, 0x00, 0xFA, 0xFF, 'h', 'e', 'l', 'l', 'o', 0, 0, 0, 0 };
+	uint8_t inflated[5] = {};
+	bool inflatedOK = PngDecoder::Inflate(stored, sizeof(stored), inflated, sizeof(inflated));
+	Tests::Check("Stored blocks inflate", inflatedOK && std::string((const char*)inflated, 5) == "hello");
+}
+
+// --------------------------------------------------------
+// Reads and decodes every bundled PNG, first one at a time
+// and then all at once on the job system, and prints the
+// time per texture and for the whole set.
+// --------------------------------------------------------
+BENCHMARK(PngDecodeSpeed)
+{
+	JobSystem::Initialize();
+
+	std::vector<std::filesystem::path> files = BundledPNGs();
+	unsigned int count = (unsigned int)files.size();
+
+	// One at a time, timing each stage
+	std::vector<double> readMs(count), decodeMs(count);
+	std::vector<size_t> fileBytes(count);
+	std::vector<CpuImage> images(count);
+	uint64_t serialStart = Profiler::Now();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		uint64_t start = Profiler::Now();
+		std::vector<uint8_t> bytes;
+		PngDecoder::ReadFile(files[i], bytes);
+		fileBytes[i] = bytes.size();
+
+		uint64_t read = Profiler::Now();
+		PngDecoder::Decode(bytes.data(), bytes.size(), images[i]);
+		readMs[i] = Profiler::TicksToMilliseconds(read - start);
+		decodeMs[i] = Profiler::TicksToMilliseconds(Profiler::Now() - read);
+	}
+	double serialMs = Profiler::TicksToMilliseconds(Profiler::Now() - serialStart);
+
+	// All at once, the way TextureLoader does it
+	std::vector<CpuImage> parallelImages(count);
+	uint64_t parallelStart = Profiler::Now();
+	JobCounter decoded;
+	for (unsigned int i = 0; i < count; i++)
+		JobSystem::Run(decoded, [&, i]() { PngDecoder::DecodeFile(files[i], parallelImages[i]); });
+	JobSystem::Wait(decoded);
+	double parallelMs = Profiler::TicksToMilliseconds(Profiler::Now() - parallelStart);
+
+	printf("  %-30s %10s %10s %10s %10s\n", "texture", "KB", "read ms", "decode ms", "MPixel/s");
+	for (unsigned int i = 0; i < count; i++)
+	{
+		double megapixels = (double)images[i].Width * images[i].Height / 1e6;
+		printf("  %-30s %10zu %10.2f %10.2f %10.1f\n", files[i].filename().string().c_str(), fileBytes[i] / 1024,
+			readMs[i], decodeMs[i], megapixels / (decodeMs[i] / 1000.0));
+	}
+	printf("  %u textures: %.1f ms one at a time, %.1f ms on %u job threads (%.1fx)\n",
+		count, serialMs, parallelMs, JobSystem::ThreadCount(), serialMs / parallelMs);
+
+	JobSystem::ShutDown();
+}
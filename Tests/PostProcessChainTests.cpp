@@ -0,0 +1,148 @@
+#include "Tests.h"
+
+#include "PostProcessChain.h"
+
+#include <string>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	const int B = PostProcessChain::BackBuffer;
+	const int S = PostProcessChain::Scene;
+
+	std::vector<int> Outputs(const std::vector<ScheduledPass>& schedule)
+	{
+		std::vector<int> result;
+		for (const ScheduledPass& scheduled : schedule)
+			result.push_back(scheduled.Output);
+		return result;
+	}
+
+	// One frame of the pool, returning the targets it destroyed
+	std::vector<unsigned int> Frame(PostProcessChain& chain, RenderTargetPool& pool, unsigned int width, unsigned int height, std::vector<ScheduledPass>& schedule)
+	{
+		std::vector<unsigned int> destroyed;
+		pool.BeginFrame();
+		chain.Schedule(width, height, pool, schedule);
+		pool.EndFrame(destroyed);
+		return destroyed;
+	}
+}
+
+// --------------------------------------------------------
+// Runs post processing chains through the scheduler and a
+// render target pool: full screen passes should ping-pong
+// between two targets, other sizes and formats shouldn't
+// share, disabled passes should be skipped, and later
+// frames shouldn't make new targets until a resize (whose
+// old targets go once they've been idle long enough), and
+// inputs should only be unbound when something needs them
+// to be.
+// --------------------------------------------------------
+TEST_SUITE(PostProcessSchedule)
+{
+	// Five full screen passes in a row
+	PostProcessChain chain;
+	PostProcessPass pass;
+	for (int i = 0; i < 5; i++)
+	{
+		pass.Name = "Pass " + std::to_string(i);
+		chain.AddPass(pass);
+	}
+	RenderTargetPool pool;
+	std::vector<ScheduledPass> schedule;
+	Frame(chain, pool, 1280, 720, schedule);
+	Tests::Check("Five passes ping-pong between two targets", Outputs(schedule) == std::vector<int>{ 0, 1, 0, 1, B } && pool.GetStats().Created == 2);
+	bool unbound = true;
+	for (const ScheduledPass& scheduled : schedule)
+		unbound = unbound && scheduled.UnbindAfter == 1;
+	Tests::Check("Inputs are unbound before they're drawn to", unbound);
+	Tests::Check("First pass reads the scene, the rest the last", schedule[0].Inputs == std::vector<int>{ S } && schedule[3].Inputs == std::vector<int>{ 0 });
+	Tests::Check("Pool reports its memory", pool.GetStats().Bytes == 2 * 1280 * 720 * 4);
+	Tests::Check("No more than two targets at once", pool.GetStats().PeakInUse == 2);
+
+	for (int i = 0; i < 10; i++)
+		Frame(chain, pool, 1280, 720, schedule);
+	Tests::Check("Later frames reuse the same targets", pool.GetStats().Created == 2 && Outputs(schedule) == std::vector<int>{ 0, 1, 0, 1, B });
+
+	// Disabled passes drop out, and whatever read them reads their input
+	chain.GetPass(1).Enabled = false;
+	chain.GetPass(4).Enabled = false;
+	Frame(chain, pool, 1280, 720, schedule);
+	Tests::Check("Disabled passes are skipped", schedule.size() == 3 && schedule[1].Pass == 2 && schedule[1].Inputs == std::vector<int>{ 0 } && schedule[2].Output == B);
+	chain.GetPass(1).Enabled = true;
+	chain.GetPass(4).Enabled = true;
+
+	// A resize leaves the old targets alone until they've been idle a while
+	bool destroyedEarly = false;
+	for (unsigned int i = 0; i < pool.maxIdleFrames; i++)
+		destroyedEarly = destroyedEarly || !Frame(chain, pool, 1920, 1080, schedule).empty();
+	std::vector<unsigned int> destroyed = Frame(chain, pool, 1920, 1080, schedule);
+	Tests::Check("Resized targets are made once", pool.GetStats().Created == 4);
+	Tests::Check("Old ones go after the idle frames", !destroyedEarly && destroyed.size() == 2 && pool.GetStats().Targets == 2);
+	Tests::Check("Memory follows", pool.GetStats().Bytes == 2 * 1920 * 1080 * 4);
+
+	// Different sizes and formats never stand in for each other
+	PostProcessChain mixed;
+	pass = PostProcessPass();
+	pass.Name = "Downsample";
+	pass.Scale = 0.5f;
+	pass.Format = RenderTargetFormat::RGBA16F;
+	mixed.AddPass(pass);
+	pass.Name = "Bloom";
+	mixed.AddPass(pass);
+	pass.Name = "Luminance";
+	pass.Scale = 0.25f;
+	pass.Format = RenderTargetFormat::R8;
+	mixed.AddPass(pass);
+	pass.Name = "Sharpen";
+	pass.Scale = 1.0f;
+	pass.Format = RenderTargetFormat::RGBA8;
+	mixed.AddPass(pass);
+	// Reads both the scene and the bloom, so the bloom outlives the luminance pass
+	pass.Name = "Composite";
+	pass.Inputs = { S, 1, 2 };
+	mixed.AddPass(pass);
+	RenderTargetPool mixedPool;
+	Frame(mixed, mixedPool, 1280, 720, schedule);
+	bool matching = true;
+	for (const ScheduledPass& scheduled : schedule)
+	{
+		if (scheduled.Output < 0)
+			continue;
+		const RenderTargetDesc& desc = mixedPool.GetDesc(scheduled.Output);
+		const PostProcessPass& scheduledPass = mixed.GetPass(scheduled.Pass);
+		matching = matching && desc.Format == scheduledPass.Format && desc.Width == scheduled.Width && desc.Height == scheduled.Height;
+	}
+	Tests::Check("Targets match their pass's size and format", matching && schedule[0].Width == 640 && schedule[2].Height == 180);
+	Tests::Check("Inputs stay alive until their last reader", schedule[4].Inputs == std::vector<int>{ S, schedule[1].Output, schedule[2].Output }
+		&& schedule[1].Output != schedule[0].Output && schedule[3].Output != schedule[1].Output);
+	Tests::Check("Unread passes still get a target", schedule[3].Output >= 0);
+	// The scene is read at slot 0 again by the composite, and nothing draws to it
+	Tests::Check("Inputs read again at the same slot stay bound", schedule[0].UnbindAfter == 0 && schedule[1].UnbindAfter == 1);
+	Tests::Check("The last pass unbinds everything it read", schedule[4].UnbindAfter == 3);
+
+	// Compute passes can't write to the back buffer, so they never do
+	PostProcessChain compute;
+	pass = PostProcessPass();
+	pass.Compute = true;
+	compute.AddPass(pass);
+	compute.AddPass(pass);
+	RenderTargetPool computePool;
+	Frame(compute, computePool, 1280, 720, schedule);
+	Tests::Check("Compute passes write to UAV targets", schedule[1].Output >= 0 && computePool.GetDesc(schedule[1].Output).UnorderedAccess);
+
+	// Compute and pixel shaders have their own slots, so a read by the
+	// other stage doesn't keep anything bound
+	PostProcessChain stages;
+	pass.Inputs = { S };
+	stages.AddPass(pass);
+	pass.Compute = false;
+	stages.AddPass(pass);
+	stages.AddPass(pass);
+	RenderTargetPool stagesPool;
+	Frame(stages, stagesPool, 1280, 720, schedule);
+	Tests::Check("Reads by the other stage don't keep inputs bound", schedule[0].UnbindAfter == 1 && schedule[1].UnbindAfter == 0 && schedule[2].UnbindAfter == 1);
+}
@@ -0,0 +1,141 @@
+#include "Tests.h"
+
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "RadixSort.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+#include <string>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Radix sorts the keys (values start as their indices) and
+	// compares with std::stable_sort, which must give the same order
+	bool SortsLikeStableSort(RadixSorter& sorter, std::vector<uint32_t> keys)
+	{
+		unsigned int count = (unsigned int)keys.size();
+		std::vector<uint32_t> order(count);
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+
+		std::vector<uint32_t> values(count);
+		std::iota(values.begin(), values.end(), 0);
+		std::vector<uint32_t> expectedKeys(count);
+		for (unsigned int i = 0; i < count; i++)
+			expectedKeys[i] = keys[order[i]];
+
+		sorter.Sort(keys.data(), values.data(), count);
+		return keys == expectedKeys && values == order;
+	}
+
+	// Back to front view depths, the way ParticleArena sorts
+	void DepthKeys(const std::vector<float>& depths, std::vector<uint32_t>& keys, std::vector<uint32_t>& values)
+	{
+		for (unsigned int i = 0; i < depths.size(); i++)
+		{
+			keys[i] = RadixSorter::FloatToKey(-depths[i]);
+			values[i] = i;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Sorts small (one thread) and big (split across the job
+// threads) arrays of random, few-valued and single-digit
+// keys against std::stable_sort, checks float keys keep
+// the floats' order, and that depths sort far to near.
+// --------------------------------------------------------
+TEST_SUITE(RadixSort)
+{
+	// Extra threads even on small machines, so big sorts always split
+	JobSystem::Initialize(3);
+
+	RadixSorter sorter;
+	for (unsigned int count : { 0u, 1u, 1000u, RadixSorter::ParallelThreshold - 1, RadixSorter::ParallelThreshold, 1000000u })
+	{
+		RandomGenerator random(count);
+		std::vector<uint32_t> keys(count), fewKeys(count), sameTop(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			keys[i] = random.NextUInt();
+			fewKeys[i] = random.NextUInt() % 16;			// Lots of ties
+			sameTop[i] = 0xABC00000u | (keys[i] & 0x7FF);	// Two passes have one digit
+		}
+
+		std::string size = std::to_string(count) + " keys";
+		Tests::Check((size + ": random keys sort").c_str(), SortsLikeStableSort(sorter, keys));
+		Tests::Check((size + ": ties keep their order").c_str(), SortsLikeStableSort(sorter, fewKeys));
+		Tests::Check((size + ": skipped passes still sort").c_str(), SortsLikeStableSort(sorter, sameTop));
+	}
+
+	// Keys in the same order as the floats, infinities included
+	const float floats[] = { -INFINITY, -1e30f, -2.5f, -1.0f, -1e-30f, 0.0f, 1e-30f, 1.0f, 2.5f, 1e30f, INFINITY };
+	bool ordered = true;
+	for (size_t i = 1; i < sizeof(floats) / sizeof(floats[0]); i++)
+		ordered = ordered && RadixSorter::FloatToKey(floats[i - 1]) < RadixSorter::FloatToKey(floats[i]);
+	Tests::Check("Float keys keep the floats' order", ordered);
+
+	// Far to near, like alpha blended particles.  Ties may come out in
+	// a different order than std::sort, so compare depths.
+	const unsigned int count = 100000;
+	std::vector<float> depths(count);
+	RandomGenerator(count).FillUniform(depths.data(), count, 0.1f, 100.0f);
+	std::vector<uint32_t> keys(count), values(count);
+	DepthKeys(depths, keys, values);
+	sorter.Sort(keys.data(), values.data(), count);
+	std::vector<float> expected = depths;
+	std::sort(expected.begin(), expected.end(), [](float a, float b) { return a > b; });
+	bool farToNear = true;
+	for (unsigned int i = 0; i < count; i++)
+		farToNear = farToNear && depths[values[i]] == expected[i];
+	Tests::Check("Depths sort far to near", farToNear);
+
+	JobSystem::ShutDown();
+}
+
+// --------------------------------------------------------
+// Sorts random view depths the way ParticleArena sorts
+// alpha blended particles (far to near, carrying indices)
+// with std::sort and RadixSorter on every core.
+// --------------------------------------------------------
+BENCHMARK(DepthSort)
+{
+	JobSystem::Initialize();
+
+	const unsigned int repeats = 10;
+	printf("  %u job threads, best of %u\n", JobSystem::ThreadCount(), repeats);
+	printf("  %10s %16s %16s\n", "particles", "std::sort ms", "radix ms");
+
+	RadixSorter sorter;
+	for (unsigned int count : { 10000u, 100000u, 1000000u })
+	{
+		std::vector<float> depths(count);
+		RandomGenerator(count).FillUniform(depths.data(), count, 0.1f, 100.0f);
+
+		double bestStd = 1e30, bestRadix = 1e30;
+		std::vector<uint32_t> stdOrder(count), keys(count), values(count);
+		for (unsigned int repeat = 0; repeat < repeats; repeat++)
+		{
+			uint64_t begin = Profiler::Now();
+			std::iota(stdOrder.begin(), stdOrder.end(), 0);
+			std::sort(stdOrder.begin(), stdOrder.end(), [&](uint32_t a, uint32_t b) { return depths[a] > depths[b]; });
+			bestStd = std::min(bestStd, Profiler::TicksToMilliseconds(Profiler::Now() - begin));
+
+			begin = Profiler::Now();
+			DepthKeys(depths, keys, values);
+			sorter.Sort(keys.data(), values.data(), count);
+			bestRadix = std::min(bestRadix, Profiler::TicksToMilliseconds(Profiler::Now() - begin));
+		}
+
+		printf("  %10u %16.3f %16.3f\n", count, bestStd, bestRadix);
+	}
+
+	JobSystem::ShutDown();
+}
@@ -0,0 +1,57 @@
+#include "Tests.h"
+
+#include "CpuFeatures.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// --------------------------------------------------------
+// Replays the random numbers an emitter would use for a
+// few thousand particles, drawn the ways the code draws
+// them (one at a time, 8 per particle like an emitter,
+// odd sized batches, one big batch), and checks every
+// replay of a seed matches the first one bit for bit.
+// --------------------------------------------------------
+TEST_SUITE(RandomReplay)
+{
+	const uint64_t seed = 1234;
+	const unsigned int count = 4096 * 8;
+	printf("  Batches use %s\n", CpuFeatures::HasAVX2() ? "AVX2" : "scalar steps (no AVX2)");
+
+	std::vector<float> expected(count);
+	RandomGenerator single(seed);
+	for (float& value : expected)
+		value = single.NextFloat(-1.0f, 1.0f);
+
+	std::vector<float> perParticle(count);
+	RandomGenerator emitterLike(seed);
+	for (unsigned int i = 0; i < count; i += 8)
+		emitterLike.FillUniform(&perParticle[i], 8, -1.0f, 1.0f);
+
+	std::vector<float> oddBatches(count);
+	RandomGenerator mixed(seed);
+	for (unsigned int i = 0, batch = 1; i < count; i += batch, batch = batch % 37 + 1)
+		mixed.FillUniform(&oddBatches[i], std::min(batch, count - i), -1.0f, 1.0f);
+
+	std::vector<float> oneBatch(count);
+	RandomGenerator bulk(seed);
+	bulk.FillUniform(oneBatch.data(), count, -1.0f, 1.0f);
+
+	std::vector<float> otherSeed(count);
+	RandomGenerator other(seed + 1);
+	other.FillUniform(otherSeed.data(), count, -1.0f, 1.0f);
+
+	size_t bytes = count * sizeof(float);
+	Tests::Check("8 per particle replays single values", memcmp(expected.data(), perParticle.data(), bytes) == 0);
+	Tests::Check("Odd sized batches replay single values", memcmp(expected.data(), oddBatches.data(), bytes) == 0);
+	Tests::Check("One big batch replays single values", memcmp(expected.data(), oneBatch.data(), bytes) == 0);
+	Tests::Check("Other seeds give other streams", memcmp(expected.data(), otherSeed.data(), bytes) != 0);
+
+	bool inRange = true;
+	for (float value : expected)
+		inRange = inRange && value >= -1.0f && value < 1.0f;
+	Tests::Check("Values stay in [min, max)", inRange);
+}
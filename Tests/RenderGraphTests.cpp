@@ -0,0 +1,119 @@
+#include "Tests.h"
+
+#include "RenderGraph.h"
+
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// One frame's compile, between the pool's BeginFrame() and EndFrame()
+	void Compile(const RenderGraph& graph, RenderTargetPool& pool, CompiledRenderGraph& compiled)
+	{
+		std::vector<unsigned int> destroyed;
+		pool.BeginFrame();
+		graph.Compile(pool, compiled);
+		pool.EndFrame(destroyed);
+	}
+}
+
+// --------------------------------------------------------
+// Compiles render graphs: passes nothing needs should be
+// culled, transient textures that don't overlap should
+// share a target (and ones that do, or don't look alike,
+// shouldn't), imported ones are never aliased, and reads
+// are unbound before their texture is drawn to.
+// --------------------------------------------------------
+TEST_SUITE(RenderGraphCompile)
+{
+	RenderTargetDesc full;
+	full.Width = 1280;
+	full.Height = 720;
+	RenderTargetDesc half = full;
+	half.Width /= 2;
+	half.Height /= 2;
+
+	// A chain of full screen passes, plus a debug pass nobody reads
+	RenderGraph chain;
+	unsigned int a = chain.CreateTexture("A", full);
+	unsigned int b = chain.CreateTexture("B", full);
+	unsigned int c = chain.CreateTexture("C", full);
+	unsigned int debug = chain.CreateTexture("Debug", half);
+	unsigned int backBuffer = chain.ImportTexture("Back Buffer");
+	unsigned int pass = chain.AddPass("Draw A");
+	chain.Write(pass, a);
+	pass = chain.AddPass("A to B");
+	chain.Read(pass, a, 0);
+	chain.Write(pass, b);
+	pass = chain.AddPass("Debug");
+	chain.Read(pass, a, 0);
+	chain.Write(pass, debug);
+	pass = chain.AddPass("B to C");
+	chain.Read(pass, b, 0);
+	chain.Write(pass, c);
+	pass = chain.AddPass("C to back buffer");
+	chain.Read(pass, c, 1);
+	chain.Write(pass, backBuffer);
+
+	RenderTargetPool pool;
+	CompiledRenderGraph compiled;
+	Compile(chain, pool, compiled);
+	Tests::Check("Passes nothing reads are culled", compiled.Culled[2] && compiled.Passes.size() == 4 && compiled.Physical[debug] == RenderGraph::Unused);
+	Tests::Check("Lifetimes span first to last use", compiled.FirstUse[a] == 0 && compiled.LastUse[a] == 1 && compiled.FirstUse[c] == 2 && compiled.LastUse[c] == 3);
+	Tests::Check("Textures that don't overlap share a target", compiled.Physical[a] == compiled.Physical[c] && pool.GetStats().Created == 2);
+	Tests::Check("Ones that overlap don't", compiled.Physical[a] != compiled.Physical[b] && compiled.Physical[b] != compiled.Physical[c]);
+	Tests::Check("Imported textures aren't pooled", compiled.Physical[backBuffer] == RenderGraph::Imported);
+	Tests::Check("Targets are bound per pass", compiled.Passes[3].RenderTargets == std::vector<unsigned int>{ backBuffer } && compiled.Passes[3].Reads == std::vector<unsigned int>{ c });
+	// A is read at slot 0, then its target is drawn to as C
+	Tests::Check("Reads are unbound before a write aliases them", compiled.Passes[1].UnbindAfter == 1 && compiled.Passes[3].UnbindAfter == 2);
+
+	for (int i = 0; i < 10; i++)
+		Compile(chain, pool, compiled);
+	Tests::Check("Later frames reuse the same targets", pool.GetStats().Created == 2);
+
+	// Turning the debug pass on (reading it into the back buffer) keeps it
+	pass = chain.AddPass("Debug to back buffer");
+	chain.Read(pass, debug, 0);
+	chain.Write(pass, backBuffer);
+	Compile(chain, pool, compiled);
+	Tests::Check("Debug pass kept once it's read", !compiled.Culled[2] && compiled.Physical[debug] >= 0);
+	Tests::Check("Different sizes never alias", compiled.Physical[debug] != compiled.Physical[a] && compiled.Physical[debug] != compiled.Physical[b]);
+
+	// Reads at the same slot, with no write between, stay bound
+	RenderGraph reads;
+	unsigned int shadow = reads.CreateTexture("Shadow", half);
+	unsigned int depth = reads.ImportTexture("Depth");
+	pass = reads.AddPass("Shadow");
+	reads.WriteDepth(pass, shadow);
+	pass = reads.AddPass("Opaque");
+	reads.Read(pass, shadow, 4);
+	reads.WriteDepth(pass, depth);
+	pass = reads.AddPass("Transparent");
+	reads.Read(pass, shadow, 4);
+	reads.WriteDepth(pass, depth);
+	RenderTargetPool readsPool;
+	Compile(reads, readsPool, compiled);
+	Tests::Check("Repeated reads stay bound", compiled.Passes[1].UnbindAfter == 0 && compiled.Passes[2].UnbindAfter == 5);
+	Tests::Check("Depth targets are bound as depth", compiled.Passes[0].DepthTarget == (int)shadow && compiled.Passes[0].RenderTargets.empty());
+
+	// Writes keep what was there, so earlier writers aren't culled
+	RenderGraph layers;
+	unsigned int scene = layers.CreateTexture("Scene", full);
+	unsigned int screen = layers.ImportTexture("Back Buffer");
+	pass = layers.AddPass("Opaque");
+	layers.Write(pass, scene);
+	pass = layers.AddPass("Sky");
+	layers.Write(pass, scene);
+	pass = layers.AddPass("Present");
+	layers.Read(pass, scene, 0);
+	layers.Write(pass, screen);
+	RenderTargetPool layersPool;
+	Compile(layers, layersPool, compiled);
+	Tests::Check("Every writer of a needed texture is kept", compiled.Passes.size() == 3);
+
+	// Resizing a transient texture moves it to a new target
+	layers.SetTextureDesc(scene, half);
+	Compile(layers, layersPool, compiled);
+	Tests::Check("Resized textures get a new target", layersPool.GetDesc(compiled.Physical[scene]) == half && layersPool.GetStats().Created == 2);
+}
@@ -0,0 +1,68 @@
+#include "Tests.h"
+
+#include "Random.h"
+#include "RingUploadTracker.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// --------------------------------------------------------
+// Runs a particle ring (spawns, bursts, deaths, all-changed
+// frames like CPU simulation) against a fake GPU buffer
+// fed only by RingUploadTracker, and checks every living
+// particle the shader would read matches the CPU copy.
+// --------------------------------------------------------
+TEST_SUITE(ParticleUploadRing)
+{
+	const unsigned int capacity = 1000;
+	std::vector<unsigned int> cpu(capacity, 0);
+	std::vector<unsigned int> gpu(capacity, ~0u);
+	RingUploadTracker tracker(capacity);
+	RandomGenerator random(99);
+
+	unsigned int firstAlive = 0, living = 0, nextValue = 1;
+	unsigned long long uploaded = 0, spawned = 0;
+	bool inRange = true, matches = true;
+
+	for (unsigned int frame = 0; frame < 10000 && matches; frame++)
+	{
+		// Oldest die first
+		unsigned int deaths = std::min(living, random.NextUInt() % 40);
+		firstAlive = (firstAlive + deaths) % capacity;
+		living -= deaths;
+
+		// Regular spawns, with the odd big burst
+		unsigned int count = random.NextUInt() % (frame % 50 == 0 ? capacity : 40);
+		count = std::min(count, capacity - living);
+		unsigned int firstDead = (firstAlive + living) % capacity;
+		for (unsigned int i = 0; i < count; i++)
+			cpu[(firstDead + i) % capacity] = nextValue++;
+		tracker.MarkChanged(firstDead, count);
+		living += count;
+		spawned += count;
+
+		// Now and then everything moves
+		if (frame % 97 == 0)
+		{
+			for (unsigned int i = 0; i < living; i++)
+				cpu[(firstAlive + i) % capacity] = nextValue++;
+			tracker.MarkChanged(firstAlive, living);
+		}
+
+		tracker.Flush([&](unsigned int first, unsigned int n) {
+			inRange = inRange && n > 0 && first + n <= capacity;
+			memcpy(&gpu[first], &cpu[first], n * sizeof(unsigned int));
+			uploaded += n;
+		});
+
+		// What the vertex shader reads: (firstParticle + i) % maxParticles
+		for (unsigned int i = 0; i < living; i++)
+			matches = matches && gpu[(firstAlive + i) % capacity] == cpu[(firstAlive + i) % capacity];
+	}
+
+	printf("  %llu particles spawned, %llu uploaded\n", spawned, uploaded);
+	Tests::Check("Uploads never run past the end of the buffer", inRange);
+	Tests::Check("Every living particle matches the CPU copy", matches);
+}
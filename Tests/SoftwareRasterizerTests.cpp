@@ -0,0 +1,234 @@
+#include "Tests.h"
+
+#include "JobSystem.h"
+#include "LightPacker.h"
+#include "Random.h"
+#include "SoftwareRasterizer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	const unsigned int Width = 128;
+	const unsigned int Height = 96;
+	const XMFLOAT3 ClearColor(1.0f, 0.0f, 1.0f);
+
+	// Vertices and indices for some quads, kept alive for the draws that borrow them
+	struct Geometry
+	{
+		std::vector<Vertex> Vertices;
+		std::vector<unsigned int> Indices;
+
+		// Corners clockwise as seen from the front, facing along the normal
+		void AddQuad(XMFLOAT3 a, XMFLOAT3 b, XMFLOAT3 c, XMFLOAT3 d, XMFLOAT3 normal)
+		{
+			unsigned int first = (unsigned int)Vertices.size();
+			for (XMFLOAT3 corner : { a, b, c, d })
+			{
+				Vertex vertex = {};
+				vertex.Position = corner;
+				vertex.Normal = normal;
+				Vertices.push_back(vertex);
+			}
+			for (unsigned int i : { 0u, 1u, 2u, 0u, 2u, 3u })
+				Indices.push_back(first + i);
+		}
+
+		// Facing a camera at the origin looking down +z
+		void AddWall(float left, float top, float right, float bottom, float z)
+		{
+			AddQuad(XMFLOAT3(left, top, z), XMFLOAT3(right, top, z), XMFLOAT3(right, bottom, z), XMFLOAT3(left, bottom, z), XMFLOAT3(0, 0, -1));
+		}
+	};
+
+	XMFLOAT4X4 Identity()
+	{
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		return identity;
+	}
+
+	SoftwareRasterDraw Draw(const Geometry& geometry, XMFLOAT3 color)
+	{
+		SoftwareRasterDraw draw;
+		draw.Vertices = geometry.Vertices.data();
+		draw.VertexCount = (unsigned int)geometry.Vertices.size();
+		draw.Indices = geometry.Indices.data();
+		draw.IndexCount = (unsigned int)geometry.Indices.size();
+		draw.World = Identity();
+		draw.WorldInverseTranspose = Identity();
+		draw.Color = color;
+		return draw;
+	}
+
+	Lights Light(int type, XMFLOAT3 position, XMFLOAT3 direction, float range)
+	{
+		Lights light = {};
+		light.type = type;
+		light.position = position;
+		light.direction = direction;
+		light.range = range;
+		light.intensity = 1.0f;
+		light.color = XMFLOAT3(1, 1, 1);
+		return light;
+	}
+
+	// Camera at the origin looking down +z with a 90 degree vertical field of view
+	void Render(SoftwareRasterizer& rasterizer, const std::vector<SoftwareRasterDraw>& draws, const std::vector<Lights>& lights)
+	{
+		XMFLOAT4X4 view, projection;
+		XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorSet(0, 0, 0, 1), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0)));
+		XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV2, (float)rasterizer.GetWidth() / rasterizer.GetHeight(), 0.1f, 100.0f));
+
+		LightPacker packer;
+		packer.Pack(lights.data(), (unsigned int)lights.size());
+		rasterizer.Render(draws, view, projection, XMFLOAT3(0, 0, 0), packer.GetLights(), packer.GetCounts(), ClearColor);
+	}
+
+	const unsigned char* Pixel(const SoftwareRasterizer& rasterizer, unsigned int x, unsigned int y)
+	{
+		return &rasterizer.GetPixels()[((size_t)y * rasterizer.GetWidth() + x) * 3];
+	}
+
+	bool IsClear(const unsigned char* pixel)
+	{
+		return pixel[0] == 255 && pixel[1] == 0 && pixel[2] == 255;
+	}
+
+	unsigned int ClearPixels(const SoftwareRasterizer& rasterizer)
+	{
+		unsigned int count = 0;
+		for (unsigned int y = 0; y < rasterizer.GetHeight(); y++)
+			for (unsigned int x = 0; x < rasterizer.GetWidth(); x++)
+				count += IsClear(Pixel(rasterizer, x, y)) ? 1 : 0;
+		return count;
+	}
+}
+
+// --------------------------------------------------------
+// Renders small scenes with the CPU reference renderer:
+// coverage with no cracks along shared edges, back face
+// culling, near plane clipping, depth that doesn't depend
+// on draw order, and lighting that uses every packed
+// light, however many there are.
+// --------------------------------------------------------
+TEST_SUITE(SoftwareRaster)
+{
+	JobSystem::Initialize(3);
+
+	SoftwareRasterizer rasterizer(Width, Height);
+	const Lights sun = Light(LIGHT_TYPE_DIRECTIONAL, XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 1), 0.0f);
+
+	Render(rasterizer, {}, { sun });
+	Tests::Check("Nothing drawn leaves the clear color", ClearPixels(rasterizer) == Width * Height);
+
+	// Two triangles sharing a diagonal, well past every edge of the screen
+	Geometry fullScreen;
+	fullScreen.AddWall(-20, 20, 20, -20, 5);
+	Render(rasterizer, { Draw(fullScreen, XMFLOAT3(0.5f, 0.5f, 0.5f)) }, { sun });
+	Tests::Check("A quad past the edges covers every pixel", ClearPixels(rasterizer) == 0 && rasterizer.GetTimings().TrianglesRasterized == 2);
+
+	Geometry backwards = fullScreen;
+	std::reverse(backwards.Indices.begin(), backwards.Indices.end());
+	Render(rasterizer, { Draw(backwards, XMFLOAT3(0.5f, 0.5f, 0.5f)) }, { sun });
+	Tests::Check("Back faces are culled", ClearPixels(rasterizer) == Width * Height && rasterizer.GetTimings().TrianglesSubmitted == 2 &&
+		rasterizer.GetTimings().TrianglesRasterized == 0);
+
+	// A floor running from behind the camera to past the far corner of the screen
+	Geometry floor;
+	floor.AddQuad(XMFLOAT3(-50, -1, -10), XMFLOAT3(-50, -1, 90), XMFLOAT3(50, -1, 90), XMFLOAT3(50, -1, -10), XMFLOAT3(0, 1, 0));
+	Render(rasterizer, { Draw(floor, XMFLOAT3(0.5f, 0.5f, 0.5f)) }, { Light(LIGHT_TYPE_DIRECTIONAL, XMFLOAT3(0, 0, 0), XMFLOAT3(0, -1, 0), 0.0f) });
+	bool topClear = true, bottomDrawn = true;
+	for (unsigned int x = 0; x < Width; x++)
+	{
+		topClear = topClear && IsClear(Pixel(rasterizer, x, 0));
+		bottomDrawn = bottomDrawn && !IsClear(Pixel(rasterizer, x, Height - 1));
+	}
+	Tests::Check("Triangles crossing the near plane are clipped, not dropped", topClear && bottomDrawn);
+
+	// A red wall in front of a green one, drawn both ways round
+	Geometry back, front;
+	back.AddWall(-20, 20, 20, -20, 10);
+	front.AddWall(-1, 1, 1, -1, 5);
+	SoftwareRasterDraw green = Draw(back, XMFLOAT3(0, 1, 0));
+	SoftwareRasterDraw red = Draw(front, XMFLOAT3(1, 0, 0));
+	Render(rasterizer, { green, red }, { sun });
+	std::vector<unsigned char> frontLast = rasterizer.GetPixels();
+	Render(rasterizer, { red, green }, { sun });
+	const unsigned char* center = Pixel(rasterizer, Width / 2, Height / 2);
+	const unsigned char* corner = Pixel(rasterizer, 0, 0);
+	Tests::Check("Nearer surfaces win in either draw order", rasterizer.GetPixels() == frontLast &&
+		center[0] > center[1] && corner[1] > corner[0]);
+
+	// Lights the shaders see past the old cap of 64: only the last one reaches the wall
+	std::vector<Lights> many(100, Light(LIGHT_TYPE_POINT, XMFLOAT3(0, 0, -50), XMFLOAT3(0, 0, 0), 1.0f));
+	many.back() = Light(LIGHT_TYPE_POINT, XMFLOAT3(0, 0, 3), XMFLOAT3(0, 0, 0), 10.0f);
+	Render(rasterizer, { Draw(fullScreen, XMFLOAT3(1, 1, 1)) }, many);
+	std::vector<unsigned char> manyLit = rasterizer.GetPixels();
+	center = Pixel(rasterizer, Width / 2, Height / 2);
+	bool lit = center[0] > 0;
+	Render(rasterizer, { Draw(fullScreen, XMFLOAT3(1, 1, 1)) }, { many.back() });
+	Tests::Check("Lights past the 64th still light the scene", lit && rasterizer.GetPixels() == manyLit);
+
+	// Spots light inside the cone and not outside it
+	Lights spot = Light(LIGHT_TYPE_SPOT, XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 1), 20.0f);
+	spot.spotInnerAngle = 0.1f;
+	spot.spotOuterAngle = 0.2f;
+	Render(rasterizer, { Draw(fullScreen, XMFLOAT3(1, 1, 1)) }, { spot });
+	center = Pixel(rasterizer, Width / 2, Height / 2);
+	corner = Pixel(rasterizer, 0, 0);
+	Tests::Check("Spot lights stop at the edge of the cone", center[0] > 0 && corner[0] == 0);
+
+	JobSystem::ShutDown();
+}
+
+// --------------------------------------------------------
+// Renders a few thousand overlapping quads at 1280x720
+// with a handful of lights on every core, and prints the
+// best time of each stage.
+// --------------------------------------------------------
+BENCHMARK(SoftwareRasterSpeed)
+{
+	JobSystem::Initialize();
+
+	const unsigned int quadCount = 5000;
+	const unsigned int repeats = 3;
+	RandomGenerator random(7);
+	Geometry quads;
+	for (unsigned int i = 0; i < quadCount; i++)
+	{
+		float z = random.NextFloat(5.0f, 50.0f);
+		float x = random.NextFloat(-z, z) * 1.5f;
+		float y = random.NextFloat(-z, z);
+		float size = random.NextFloat(0.2f, 2.0f);
+		quads.AddWall(x - size, y + size, x + size, y - size, z);
+	}
+
+	std::vector<Lights> lights = { Light(LIGHT_TYPE_DIRECTIONAL, XMFLOAT3(0, 0, 0), XMFLOAT3(0.3f, -0.5f, 1.0f), 0.0f) };
+	for (unsigned int i = 0; i < 16; i++)
+		lights.push_back(Light(LIGHT_TYPE_POINT, XMFLOAT3(random.NextFloat(-20, 20), random.NextFloat(-10, 10), random.NextFloat(5, 40)), XMFLOAT3(0, 0, 0), 15.0f));
+
+	SoftwareRasterizer rasterizer(1280, 720);
+	SoftwareRasterTimings best;
+	best.TotalMs = 1e30;
+	for (unsigned int repeat = 0; repeat < repeats; repeat++)
+	{
+		Render(rasterizer, { Draw(quads, XMFLOAT3(0.8f, 0.6f, 0.4f)) }, lights);
+		if (rasterizer.GetTimings().TotalMs < best.TotalMs)
+			best = rasterizer.GetTimings();
+	}
+
+	printf("  %u triangles (%u drawn), %zu lights, %u job threads, best of %u\n",
+		best.TrianglesSubmitted, best.TrianglesRasterized, lights.size(), JobSystem::ThreadCount(), repeats);
+	printf("  %10s %10s %10s %10s %10s %10s\n", "vertex ms", "setup ms", "bin ms", "raster ms", "shade ms", "total ms");
+	printf("  %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n", best.VertexMs, best.SetupMs, best.BinMs, best.RasterMs, best.ShadeMs, best.TotalMs);
+	printf("  %llu 8x8 blocks skipped by depth\n", best.BlocksRejectedByDepth);
+
+	JobSystem::ShutDown();
+}
@@ -0,0 +1,84 @@
+#include "Tests.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Annonymous namespace to hold variables
+// only accessible in this file
+namespace
+{
+	struct Suite
+	{
+		const char* Name;
+		Tests::Function Run;
+		bool Benchmark;
+	};
+
+	// Function static so suites in other files can register
+	// during static initialization in any order
+	std::vector<Suite>& Suites()
+	{
+		static std::vector<Suite> suites;
+		return suites;
+	}
+
+	unsigned int checks = 0;
+	unsigned int failures = 0;
+}
+
+bool Tests::Register(const char* name, Function run, bool benchmark)
+{
+	Suites().push_back({ name, run, benchmark });
+	return true;
+}
+
+void Tests::Check(const char* name, bool passed)
+{
+	printf("  %-60s %s\n", name, passed ? "ok" : "FAILED");
+	checks++;
+	if (!passed)
+		failures++;
+}
+
+std::string Tests::AssetPath(const std::string& relative)
+{
+	return std::string(ASSETS_DIR) + "/" + relative;
+}
+
+int main(int argc, char* argv[])
+{
+	bool benchmarks = false;
+	std::vector<const char*> filters;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-bench") == 0)
+			benchmarks = true;
+		else
+			filters.push_back(argv[i]);
+	}
+
+	// Suites asked for by name run whether they're benchmarks or not
+	unsigned int ran = 0;
+	for (const Suite& suite : Suites())
+	{
+		bool selected = filters.empty() ? suite.Benchmark == benchmarks : false;
+		for (const char* filter : filters)
+			selected = selected || strncmp(suite.Name, filter, strlen(filter)) == 0;
+		if (!selected)
+			continue;
+
+		printf("%s\n", suite.Name);
+		suite.Run();
+		printf("\n");
+		ran++;
+	}
+
+	if (ran == 0)
+	{
+		printf("No suites match\n");
+		return 1;
+	}
+	printf("%u suites, %u checks, %u failed\n", ran, checks, failures);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+
+// --------------------------------------------------------
+// A small runner for the parts of the framework that don't
+// need Windows or a GPU, so they build and run anywhere
+// (see CMakeLists.txt).  Suites register themselves with
+// TEST_SUITE() or BENCHMARK() and report through Check().
+//
+// Usage:
+//   Tests             every test suite (what ctest runs)
+//   Tests -bench      every benchmark
+//   Tests JobSystem   suites and benchmarks whose names
+//                     start with "JobSystem"
+// --------------------------------------------------------
+namespace Tests
+{
+	using Function = void(*)();
+
+	bool Register(const char* name, Function run, bool benchmark);
+
+	// Prints one row for a check, remembering if it failed
+	void Check(const char* name, bool passed);
+
+	// Full path of a file under Assets/
+	std::string AssetPath(const std::string& relative);
+}
+
+#define TEST_SUITE(name) \
+	static void name(); \
+	static const bool name##Registered = Tests::Register(#name, name, false); \
+	static void name()
+
+#define BENCHMARK(name) \
+	static void name(); \
+	static const bool name##Registered = Tests::Register(#name, name, true); \
+	static void name()
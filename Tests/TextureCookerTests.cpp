@@ -0,0 +1,175 @@
+#include "Tests.h"
+
+#include "DdsFile.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "TextureCooker.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	struct CookCase
+	{
+		const char* File;		// Under Assets/Textures
+		DdsFormat Format;
+	};
+
+	// One texture per format the cooker picks
+	const CookCase Cases[] = {
+		{ "paint_albedo.png", DdsFormat::BC7 },
+		{ "paint_albedo.png", DdsFormat::BC1 },
+		{ "paint_normals.png", DdsFormat::BC5 },
+		{ "paint_roughness.png", DdsFormat::BC4 },
+	};
+
+	const char* FormatName(DdsFormat format)
+	{
+		return format == DdsFormat::BC1 ? "BC1" : format == DdsFormat::BC4 ? "BC4" : format == DdsFormat::BC5 ? "BC5" : "BC7";
+	}
+
+	// The middle size x size pixels, so the checks stay quick
+	void Crop(const CpuImage& image, unsigned int size, CpuImage& cropped)
+	{
+		cropped.Width = std::min(size, image.Width);
+		cropped.Height = std::min(size, image.Height);
+		cropped.Format = image.Format;
+		unsigned int bytes = image.BytesPerPixel();
+		unsigned int left = (image.Width - cropped.Width) / 2, top = (image.Height - cropped.Height) / 2;
+		cropped.Pixels.resize((size_t)cropped.RowPitch() * cropped.Height);
+		for (unsigned int y = 0; y < cropped.Height; y++)
+			std::copy_n(&image.Pixels[(size_t)(top + y) * image.RowPitch() + left * bytes], cropped.RowPitch(), &cropped.Pixels[(size_t)y * cropped.RowPitch()]);
+	}
+
+	// Mip 0 of a cooked texture against the original, over the channels it keeps
+	double CookedPSNR(const CpuImage& image, const DdsImage& cooked)
+	{
+		CpuImage original, decoded;
+		TextureCooker::ToRGBA8(image, original);
+		TextureCooker::DecodeMip(cooked, 0, decoded);
+		return TextureCooker::PSNR(original, decoded, TextureCooker::ChannelCount(cooked.Format));
+	}
+}
+
+// --------------------------------------------------------
+// Cooks part of a bundled texture to each block format,
+// which should keep a PSNR of at least 30 dB with a full
+// mip chain, writes one to a DDS file and reads it back,
+// and checks textures are told apart by file name and
+// single channel maps pack together.
+// --------------------------------------------------------
+TEST_SUITE(TextureCook)
+{
+	JobSystem::Initialize(3);
+
+	DdsImage written;
+	for (const CookCase& test : Cases)
+	{
+		CpuImage image, cropped;
+		bool decoded = PngDecoder::DecodeFile(Tests::AssetPath(std::string("Textures/") + test.File), image);
+		Crop(image, 256, cropped);
+
+		DdsImage cooked;
+		std::string error;
+		bool cookedOK = decoded && TextureCooker::Cook(cropped, TextureCooker::KindFromFileName(test.File), test.Format, cooked, &error);
+		double psnr = cookedOK ? CookedPSNR(cropped, cooked) : 0.0;
+		printf("  %-24s %s PSNR %.2f %s\n", test.File, FormatName(test.Format), psnr, error.c_str());
+
+		std::string name = std::string(FormatName(test.Format)) + ": ";
+		Tests::Check((name + "cooks with a PSNR of 30 or more").c_str(), cookedOK && psnr >= 30.0);
+		Tests::Check((name + "full mip chain down to 1x1").c_str(), cooked.MipLevels == 9 && cooked.Format == test.Format &&
+			cooked.MipWidth(cooked.MipLevels - 1) == 1 && cooked.Data.size() == cooked.MipOffset(cooked.MipLevels));
+		if (test.Format == DdsFormat::BC7)
+			written = cooked;
+	}
+
+	// Through a file and back
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "TextureCookerTest.dds";
+	std::vector<uint8_t> bytes;
+	DdsImage read, header;
+	size_t dataOffset = 0;
+	bool roundTrip = DdsFile::Write(path, written) && PngDecoder::ReadFile(path, bytes) && DdsFile::Read(bytes.data(), bytes.size(), read);
+	Tests::Check("DDS files read back what was written", roundTrip && read.Width == written.Width && read.Height == written.Height &&
+		read.MipLevels == written.MipLevels && read.Format == written.Format && read.Data == written.Data);
+	bool headerOK = bytes.size() >= DdsFile::HeaderSize && DdsFile::ReadHeader(bytes.data(), DdsFile::HeaderSize, header, dataOffset);
+	Tests::Check("Headers alone give the size and where the mips are", headerOK && header.Width == written.Width &&
+		header.Data.empty() && dataOffset + header.MipOffset(header.MipLevels) == bytes.size());
+	std::string error;
+	Tests::Check("Truncated DDS files fail", !bytes.empty() && !DdsFile::Read(bytes.data(), bytes.size() - 1, read, &error) && !error.empty());
+
+	// Corrupt headers: a mip count past 1x1 (which would shift by 32 or
+	// more and walk billions of mips) and sizes too big for a texture.
+	// Width is 16 bytes into the file and the mip count 28.
+	bool corruptFail = bytes.size() >= DdsFile::HeaderSize;
+	for (auto [at, value] : { std::pair(28, written.MipLevels + 1), std::pair(28, 0xFFFFFFFFu), std::pair(16, DdsFile::MaxDimension + 1), std::pair(16, 0x40000000u) })
+	{
+		std::vector<uint8_t> corrupt(bytes.begin(), bytes.begin() + std::min(bytes.size(), DdsFile::HeaderSize));
+		if (corrupt.size() == DdsFile::HeaderSize)
+			memcpy(&corrupt[at], &value, 4);
+		error.clear();
+		corruptFail = corruptFail && !DdsFile::ReadHeader(corrupt.data(), corrupt.size(), header, dataOffset, &error) && !error.empty();
+	}
+	Tests::Check("Corrupt DDS headers fail", corruptFail);
+	std::filesystem::remove(path);
+
+	Tests::Check("Kinds come from the file name",
+		TextureCooker::KindFromFileName("wood_Normals.png") == TextureKind::Normal &&
+		TextureCooker::KindFromFileName("rough_albedo.png") == TextureKind::Color &&
+		TextureCooker::KindFromFileName("floor_metal.png") == TextureKind::Single &&
+		TextureCooker::KindFromFileName("generic_heightmap.png") == TextureKind::Single);
+
+	// Roughness and metalness pack into BC5, a missing height keeps it BC7.
+	// The smaller metalness map is point sampled, so 0/1 stays 0/1.
+	CpuImage roughness, metalness, packed;
+	roughness.Width = roughness.Height = 4;
+	roughness.Format = CpuImageFormat::R8;
+	for (unsigned int i = 0; i < 16; i++)
+		roughness.Pixels.push_back((uint8_t)(i * 16));
+	metalness.Width = metalness.Height = 2;
+	metalness.Format = CpuImageFormat::R8;
+	metalness.Pixels = { 0, 255, 255, 0 };
+	const CpuImage* sources[] = { &roughness, &metalness, 0 };
+	TextureCooker::PackChannels(sources, 2, packed);
+	Tests::Check("Two maps pack into RG for BC5", packed.Format == CpuImageFormat::RG8 && TextureCooker::PackedFormat(packed) == DdsFormat::BC5 &&
+		packed.Width == 4 && packed.Pixels[(1 * 4 + 2) * 2] == 96 && packed.Pixels[(1 * 4 + 2) * 2 + 1] == 255 && packed.Pixels[(3 * 4 + 3) * 2 + 1] == 0);
+	TextureCooker::PackChannels(sources, 3, packed);
+	Tests::Check("Three maps pack into RGBA for BC7", packed.Format == CpuImageFormat::RGBA8 && TextureCooker::PackedFormat(packed) == DdsFormat::BC7 &&
+		packed.Pixels[2] == 0 && packed.Pixels[3] == 255);
+
+	JobSystem::ShutDown();
+}
+
+// --------------------------------------------------------
+// Cooks whole bundled textures to each block format on
+// every core and prints the time, throughput and PSNR.
+// --------------------------------------------------------
+BENCHMARK(TextureCookSpeed)
+{
+	JobSystem::Initialize();
+
+	printf("  %u job threads\n", JobSystem::ThreadCount());
+	printf("  %-24s %6s %10s %10s %8s\n", "texture", "format", "ms", "MPixel/s", "PSNR");
+	for (const CookCase& test : Cases)
+	{
+		CpuImage image;
+		if (!PngDecoder::DecodeFile(Tests::AssetPath(std::string("Textures/") + test.File), image))
+			continue;
+
+		DdsImage cooked;
+		uint64_t start = Profiler::Now();
+		TextureCooker::Cook(image, TextureCooker::KindFromFileName(test.File), test.Format, cooked);
+		double ms = Profiler::TicksToMilliseconds(Profiler::Now() - start);
+		printf("  %-24s %6s %10.1f %10.1f %8.2f\n", test.File, FormatName(test.Format), ms,
+			(double)image.Width * image.Height / 1e6 / (ms / 1000.0), CookedPSNR(image, cooked));
+	}
+
+	JobSystem::ShutDown();
+}
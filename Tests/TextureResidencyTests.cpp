@@ -0,0 +1,166 @@
+#include "Tests.h"
+
+#include "TextureResidency.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// 2048x2048 BC7 with mips is about 5.3 MB
+	DdsImage WallLayout()
+	{
+		DdsImage layout;
+		layout.Width = 2048;
+		layout.Height = 2048;
+		layout.MipLevels = 12;
+		layout.Format = DdsFormat::BC7;
+		return layout;
+	}
+
+	struct CorridorResult
+	{
+		bool WithinBudget = true;
+		bool Settled = false;		// Nothing starved, loaded or evicted once the camera stopped
+	};
+
+	// --------------------------------------------------------
+	// Flies a camera down a corridor of textured walls and
+	// runs texture residency on what it sees, with loads
+	// that take a few frames to arrive.  With print set, it
+	// prints what's resident along the way.
+	// --------------------------------------------------------
+	CorridorResult FlyCorridor(bool print)
+	{
+		const DdsImage layout = WallLayout();
+		const unsigned int wallCount = 32;
+		const float wallSpacing = 6.0f;
+		const float wallRadius = 2.0f;			// 4x4 walls
+		const float uvPerUnit = 0.25f;			// One copy of the texture per wall
+		const float tanHalfFov = tanf(3.14159265f / 4.0f);
+		const float screenHeight = 720.0f;
+		const unsigned int loadFrames = 3;		// Frames from a load starting to it arriving
+		const unsigned int moveFrames = 1200;
+		const unsigned int stopFrames = 120;
+		const size_t budget = 48 * 1024 * 1024;
+
+		TextureResidency residency(budget);
+		for (unsigned int i = 0; i < wallCount; i++)
+			residency.Add(layout);
+
+		std::vector<unsigned int> arrives(wallCount, 0);
+		std::vector<MipChange> evictions;
+		std::vector<MipChange> loads;
+		CorridorResult result;
+		unsigned int settledLoads = 0;
+		unsigned int settledEvictions = 0;
+
+		if (print)
+		{
+			printf("  %u walls of %ux%u BC7 (%.1f MB each, %.1f MB in all), %.1f MB budget\n",
+				wallCount, layout.Width, layout.Height,
+				residency.GetBytes(0, 0) / (1024.0 * 1024.0), wallCount * residency.GetBytes(0, 0) / (1024.0 * 1024.0), budget / (1024.0 * 1024.0));
+			printf("  %6s %8s %8s %12s %12s %8s %8s %10s\n", "frame", "camera z", "visible", "resident MB", "loading MB", "starved", "loads", "evictions");
+		}
+
+		for (unsigned int frame = 0; frame < moveFrames + stopFrames; frame++)
+		{
+			// Down the middle of the corridor, looking along +z
+			float cameraZ = -10.0f + wallSpacing * wallCount * std::min(frame, moveFrames) / moveFrames;
+
+			// Loads that have had time to arrive
+			for (unsigned int i = 0; i < wallCount; i++)
+				if (residency.IsLoading(i) && frame >= arrives[i])
+					residency.FinishLoad(i);
+
+			// Walls alternate sides, 3 units either side of the camera
+			unsigned int visible = 0;
+			for (unsigned int i = 0; i < wallCount; i++)
+			{
+				float x = (i % 2 == 0) ? -3.0f : 3.0f;
+				float z = i * wallSpacing - cameraZ;
+				if (z < -wallRadius || fabsf(x) > z * tanHalfFov + wallRadius)
+					continue;
+
+				float distance = std::max(sqrtf(x * x + z * z) - wallRadius, 0.0f);
+				float mip = TextureResidency::MipForDistance((float)layout.Width, uvPerUnit, distance, tanHalfFov, screenHeight);
+				residency.Request(i, (unsigned int)std::min(mip, (float)(layout.MipLevels - 1)));
+				visible++;
+			}
+
+			residency.Update(evictions, loads);
+			for (const MipChange& load : loads)
+				arrives[load.Texture] = frame + loadFrames;
+
+			const TextureResidencyStats& stats = residency.GetStats();
+			result.WithinBudget = result.WithinBudget && stats.ResidentBytes + stats.PendingBytes <= budget;
+			if (frame >= moveFrames + stopFrames / 2)
+			{
+				settledLoads += (unsigned int)loads.size();
+				settledEvictions += (unsigned int)evictions.size();
+			}
+
+			if (print && (frame % 100 == 0 || frame == moveFrames + stopFrames - 1))
+				printf("  %6u %8.1f %8u %12.1f %12.1f %8u %8u %10u\n", frame, cameraZ, visible,
+					stats.ResidentBytes / (1024.0 * 1024.0), stats.PendingBytes / (1024.0 * 1024.0),
+					stats.Starved, stats.Loads, stats.Evictions);
+		}
+
+		const TextureResidencyStats& stats = residency.GetStats();
+		result.Settled = stats.Starved == 0 && settledLoads == 0 && settledEvictions == 0;
+		if (print)
+			printf("  Streamed %.1f MB in %u loads, dropped %.1f MB in %u evictions\n",
+				stats.BytesLoaded / (1024.0 * 1024.0), stats.Loads, stats.BytesEvicted / (1024.0 * 1024.0), stats.Evictions);
+		return result;
+	}
+}
+
+// --------------------------------------------------------
+// Texture residency on its own: tails are always resident,
+// requests load the finest mip first and failed loads
+// leave what was there.  Then a camera flies down a
+// corridor of walls, which must never go over the budget
+// and must settle once the camera stops.
+// --------------------------------------------------------
+TEST_SUITE(TextureStreaming)
+{
+	// Twice as far away needs half the detail: one mip coarser
+	float nearMip = TextureResidency::MipForDistance(2048.0f, 0.25f, 10.0f, 1.0f, 720.0f);
+	float farMip = TextureResidency::MipForDistance(2048.0f, 0.25f, 20.0f, 1.0f, 720.0f);
+	Tests::Check("Twice as far is one mip coarser", fabsf(farMip - nearMip - 1.0f) < 1e-3f);
+
+	// Mips of 128 and smaller (4 down from 2048) are always there
+	TextureResidency residency(64 * 1024 * 1024);
+	unsigned int wall = residency.Add(WallLayout());
+	unsigned int other = residency.Add(WallLayout());
+	Tests::Check("Only the tail is resident to start with", residency.GetTailMip(wall) == 4 && residency.GetResidentMip(wall) == 4);
+
+	std::vector<MipChange> evictions, loads;
+	residency.Request(wall, 1);
+	residency.Request(wall, 0);
+	residency.Request(other, 2);
+	residency.Update(evictions, loads);
+	Tests::Check("Finest wanted detail loads first", !loads.empty() && loads[0].Texture == wall && loads[0].ToMip == 0 && residency.IsLoading(wall));
+	Tests::Check("Loads count against the budget right away", residency.GetStats().PendingBytes >= residency.GetBytes(wall, 0) - residency.GetBytes(wall, 4));
+
+	residency.FinishLoad(wall, false);
+	Tests::Check("Failed loads keep what was resident", residency.GetResidentMip(wall) == 4 && !residency.IsLoading(wall));
+
+	CorridorResult corridor = FlyCorridor(false);
+	Tests::Check("The corridor never goes over the budget", corridor.WithinBudget);
+	Tests::Check("It settles once the camera stops", corridor.Settled);
+}
+
+// --------------------------------------------------------
+// The corridor fly-through, printing what's resident and
+// loading every 100 frames
+// --------------------------------------------------------
+BENCHMARK(TextureStreamingCorridor)
+{
+	CorridorResult corridor = FlyCorridor(true);
+	printf("  Budget: %s, settled after stopping: %s\n", corridor.WithinBudget ? "OK" : "EXCEEDED", corridor.Settled ? "OK" : "NO");
+}
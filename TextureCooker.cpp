@@ -0,0 +1,842 @@
+#include "TextureCooker.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// BC7 weights for 4 bit indices (out of 64)
+	const int Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// A 4x4 block of an RGBA8 image, as floats
+	struct Block
+	{
+		float Pixels[16][4];
+	};
+
+	// Fills up a block's bits from the lowest one up
+	struct BlockWriter
+	{
+		uint8_t* Output;
+		unsigned int Position = 0;
+
+		void Write(uint32_t value, unsigned int bits)
+		{
+			for (unsigned int i = 0; i < bits; i++, Position++)
+				if ((value >> i) & 1)
+					Output[Position >> 3] |= (uint8_t)(1 << (Position & 7));
+		}
+	};
+
+	struct BlockReader
+	{
+		const uint8_t* Input;
+		unsigned int Position = 0;
+
+		uint32_t Read(unsigned int bits)
+		{
+			uint32_t value = 0;
+			for (unsigned int i = 0; i < bits; i++, Position++)
+				value |= (uint32_t)((Input[Position >> 3] >> (Position & 7)) & 1) << i;
+			return value;
+		}
+	};
+
+	bool Fail(std::string* error, const char* message)
+	{
+		if (error)
+			*error = message;
+		return false;
+	}
+
+	uint8_t ToByte(float value)
+	{
+		return (uint8_t)std::clamp((int)(value + 0.5f), 0, 255);
+	}
+
+	// Red (or gray) of any CpuImage, as 8 bits
+	uint8_t FirstChannel(const CpuImage& image, size_t pixel)
+	{
+		switch (image.Format)
+		{
+		case CpuImageFormat::R16:
+		{
+			uint16_t value;
+			memcpy(&value, &image.Pixels[pixel * 2], 2);
+			return (uint8_t)((value + 128) / 257);
+		}
+		default:
+			return image.Pixels[pixel * image.BytesPerPixel()];
+		}
+	}
+
+	// --------------------------------------------------------
+	// Mip generation
+	// --------------------------------------------------------
+
+	// Box filters an RGBA8 image down to half size.  Normal maps
+	// are renormalized so mips don't get flatter as they shrink.
+	void Downsample(const CpuImage& source, CpuImage& mip, bool normals)
+	{
+		mip.Width = std::max(source.Width / 2, 1u);
+		mip.Height = std::max(source.Height / 2, 1u);
+		mip.Format = CpuImageFormat::RGBA8;
+		mip.Pixels.resize((size_t)mip.Width * mip.Height * 4);
+
+		for (unsigned int y = 0; y < mip.Height; y++)
+		{
+			// Clamped, for sides that were already 1 pixel
+			unsigned int rows[2] = { std::min(y * 2, source.Height - 1), std::min(y * 2 + 1, source.Height - 1) };
+			for (unsigned int x = 0; x < mip.Width; x++)
+			{
+				unsigned int columns[2] = { std::min(x * 2, source.Width - 1), std::min(x * 2 + 1, source.Width - 1) };
+
+				float sum[4] = {};
+				for (unsigned int row : rows)
+					for (unsigned int column : columns)
+						for (int c = 0; c < 4; c++)
+							sum[c] += source.Pixels[((size_t)row * source.Width + column) * 4 + c];
+
+				float average[4] = { sum[0] / 4, sum[1] / 4, sum[2] / 4, sum[3] / 4 };
+				if (normals)
+				{
+					float n[3];
+					for (int c = 0; c < 3; c++)
+						n[c] = average[c] / 127.5f - 1.0f;
+					float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+					if (length > 0.0f)
+						for (int c = 0; c < 3; c++)
+							average[c] = (n[c] / length * 0.5f + 0.5f) * 255.0f;
+				}
+
+				uint8_t* pixel = &mip.Pixels[((size_t)y * mip.Width + x) * 4];
+				for (int c = 0; c < 4; c++)
+					pixel[c] = ToByte(average[c]);
+			}
+		}
+	}
+
+	void ReadBlock(const CpuImage& image, unsigned int blockX, unsigned int blockY, Block& block)
+	{
+		for (unsigned int y = 0; y < 4; y++)
+		{
+			for (unsigned int x = 0; x < 4; x++)
+			{
+				// Mips smaller than a block repeat their edge
+				unsigned int pixelX = std::min(blockX * 4 + x, image.Width - 1);
+				unsigned int pixelY = std::min(blockY * 4 + y, image.Height - 1);
+				const uint8_t* pixel = &image.Pixels[((size_t)pixelY * image.Width + pixelX) * 4];
+				for (int c = 0; c < 4; c++)
+					block.Pixels[y * 4 + x][c] = pixel[c];
+			}
+		}
+	}
+
+	// --------------------------------------------------------
+	// Endpoint fitting shared by BC1 and BC7
+	// --------------------------------------------------------
+
+	// Endpoints at the furthest projections of the block onto the
+	// principal axis of its colors (the first "channels" channels)
+	void AxisEndpoints(const Block& block, int channels, float start[4], float end[4])
+	{
+		float mean[4] = {};
+		for (int i = 0; i < 16; i++)
+			for (int c = 0; c < channels; c++)
+				mean[c] += block.Pixels[i][c] / 16.0f;
+
+		float covariance[4][4] = {};
+		for (int i = 0; i < 16; i++)
+			for (int a = 0; a < channels; a++)
+				for (int b = 0; b < channels; b++)
+					covariance[a][b] += (block.Pixels[i][a] - mean[a]) * (block.Pixels[i][b] - mean[b]);
+
+		// Power iteration, starting from the channel that varies most
+		int widest = 0;
+		for (int c = 1; c < channels; c++)
+			if (covariance[c][c] > covariance[widest][widest])
+				widest = c;
+
+		float axis[4] = {};
+		for (int c = 0; c < channels; c++)
+			axis[c] = covariance[widest][c];
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[4] = {};
+			float largest = 0.0f;
+			for (int a = 0; a < channels; a++)
+			{
+				for (int b = 0; b < channels; b++)
+					next[a] += covariance[a][b] * axis[b];
+				largest = std::max(largest, fabsf(next[a]));
+			}
+			if (largest == 0.0f)
+				break;
+			for (int c = 0; c < channels; c++)
+				axis[c] = next[c] / largest;
+		}
+
+		float length = 0.0f;
+		for (int c = 0; c < channels; c++)
+			length += axis[c] * axis[c];
+		length = sqrtf(length);
+
+		float minT = 0.0f, maxT = 0.0f;
+		if (length > 0.0f)
+		{
+			for (int c = 0; c < channels; c++)
+				axis[c] /= length;
+
+			minT = FLT_MAX;
+			maxT = -FLT_MAX;
+			for (int i = 0; i < 16; i++)
+			{
+				float t = 0.0f;
+				for (int c = 0; c < channels; c++)
+					t += (block.Pixels[i][c] - mean[c]) * axis[c];
+				minT = std::min(minT, t);
+				maxT = std::max(maxT, t);
+			}
+		}
+
+		for (int c = 0; c < channels; c++)
+		{
+			start[c] = std::clamp(mean[c] + axis[c] * minT, 0.0f, 255.0f);
+			end[c] = std::clamp(mean[c] + axis[c] * maxT, 0.0f, 255.0f);
+		}
+	}
+
+	// Least squares endpoints for fixed per-pixel weights (0 is all
+	// start, 1 is all end).  False if every weight is the same.
+	bool FitEndpoints(const Block& block, int channels, const float weights[16], float start[4], float end[4])
+	{
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[4] = {}, bx[4] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			float a = 1.0f - weights[i];
+			float b = weights[i];
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int c = 0; c < channels; c++)
+			{
+				ax[c] += a * block.Pixels[i][c];
+				bx[c] += b * block.Pixels[i][c];
+			}
+		}
+
+		float determinant = aa * bb - ab * ab;
+		if (fabsf(determinant) < 1e-6f)
+			return false;
+
+		for (int c = 0; c < channels; c++)
+		{
+			start[c] = std::clamp((bb * ax[c] - ab * bx[c]) / determinant, 0.0f, 255.0f);
+			end[c] = std::clamp((aa * bx[c] - ab * ax[c]) / determinant, 0.0f, 255.0f);
+		}
+		return true;
+	}
+
+	// --------------------------------------------------------
+	// BC1
+	// --------------------------------------------------------
+	uint16_t To565(const float color[4])
+	{
+		int r = std::clamp((int)(color[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+		int g = std::clamp((int)(color[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+		int b = std::clamp((int)(color[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+		return (uint16_t)(r << 11 | g << 5 | b);
+	}
+
+	void Bc1Palette(uint16_t color0, uint16_t color1, int palette[4][3])
+	{
+		for (int i = 0; i < 2; i++)
+		{
+			uint16_t color = i == 0 ? color0 : color1;
+			int r = color >> 11, g = (color >> 5) & 63, b = color & 31;
+			palette[i][0] = r << 3 | r >> 2;
+			palette[i][1] = g << 2 | g >> 4;
+			palette[i][2] = b << 3 | b >> 2;
+		}
+
+		for (int c = 0; c < 3; c++)
+		{
+			if (color0 > color1)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			else
+			{
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+	}
+
+	float Bc1Indices(const Block& block, uint16_t color0, uint16_t color1, uint32_t& indices)
+	{
+		int palette[4][3];
+		Bc1Palette(color0, color1, palette);
+
+		float total = 0.0f;
+		indices = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			float bestError = FLT_MAX;
+			uint32_t best = 0;
+			for (uint32_t p = 0; p < 4; p++)
+			{
+				float error = 0.0f;
+				for (int c = 0; c < 3; c++)
+					error += (block.Pixels[i][c] - palette[p][c]) * (block.Pixels[i][c] - palette[p][c]);
+				if (error < bestError)
+				{
+					bestError = error;
+					best = p;
+				}
+			}
+			indices |= best << (i * 2);
+			total += bestError;
+		}
+		return total;
+	}
+
+	void EncodeBC1(const Block& block, uint8_t* output)
+	{
+		float start[4], end[4];
+		AxisEndpoints(block, 3, start, end);
+
+		uint16_t bestColors[2] = {};
+		uint32_t bestIndices = 0;
+		float bestError = FLT_MAX;
+		for (int pass = 0; pass < 3; pass++)
+		{
+			// Largest first picks the 4 color (opaque) mode
+			uint16_t color0 = To565(start), color1 = To565(end);
+			if (color0 < color1)
+				std::swap(color0, color1);
+
+			uint32_t indices;
+			float error = Bc1Indices(block, color0, color1, indices);
+			if (error < bestError)
+			{
+				bestError = error;
+				bestColors[0] = color0;
+				bestColors[1] = color1;
+				bestIndices = indices;
+			}
+			if (color0 == color1)
+				break;
+
+			// How far each pixel sits from color0 to color1
+			const float indexWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+			float weights[16];
+			for (int i = 0; i < 16; i++)
+				weights[i] = indexWeights[(indices >> (i * 2)) & 3];
+
+			if (!FitEndpoints(block, 3, weights, start, end))
+				break;
+		}
+
+		memcpy(output, &bestColors[0], 2);
+		memcpy(output + 2, &bestColors[1], 2);
+		memcpy(output + 4, &bestIndices, 4);
+	}
+
+	// --------------------------------------------------------
+	// BC4 (and BC5, which is two of them)
+	// --------------------------------------------------------
+	void Bc4Palette(int value0, int value1, float palette[8])
+	{
+		palette[0] = (float)value0;
+		palette[1] = (float)value1;
+		for (int i = 2; i < 8; i++)
+		{
+			if (value0 > value1)
+				palette[i] = ((8 - i) * value0 + (i - 1) * value1) / 7.0f;
+			else if (i < 6)
+				palette[i] = ((6 - i) * value0 + (i - 1) * value1) / 5.0f;
+			else
+				palette[i] = i == 6 ? 0.0f : 255.0f;
+		}
+	}
+
+	void EncodeBC4(const Block& block, int channel, uint8_t* output)
+	{
+		float low = 255.0f, high = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			low = std::min(low, block.Pixels[i][channel]);
+			high = std::max(high, block.Pixels[i][channel]);
+		}
+
+		// Largest first picks the 8 value mode
+		int value0 = (int)high, value1 = (int)low;
+		float palette[8];
+		Bc4Palette(value0, value1, palette);
+
+		uint64_t indices = 0;
+		if (value0 > value1)
+		{
+			for (int i = 0; i < 16; i++)
+			{
+				float bestError = FLT_MAX;
+				uint64_t best = 0;
+				for (uint64_t p = 0; p < 8; p++)
+				{
+					float error = fabsf(block.Pixels[i][channel] - palette[p]);
+					if (error < bestError)
+					{
+						bestError = error;
+						best = p;
+					}
+				}
+				indices |= best << (i * 3);
+			}
+		}
+
+		output[0] = (uint8_t)value0;
+		output[1] = (uint8_t)value1;
+		for (int i = 0; i < 6; i++)
+			output[2 + i] = (uint8_t)(indices >> (i * 8));
+	}
+
+	// --------------------------------------------------------
+	// BC7 (mode 6)
+	// --------------------------------------------------------
+
+	// 7 bits per channel plus a p-bit shared by the endpoint,
+	// whichever p-bit lands closer
+	void QuantizeMode6(const float endpoint[4], int quantized[4], int& pBit)
+	{
+		float bestError = FLT_MAX;
+		for (int p = 0; p < 2; p++)
+		{
+			int candidate[4];
+			float error = 0.0f;
+			for (int c = 0; c < 4; c++)
+			{
+				candidate[c] = std::clamp((int)((endpoint[c] - p) / 2.0f + 0.5f), 0, 127);
+				float value = (float)(candidate[c] << 1 | p);
+				error += (value - endpoint[c]) * (value - endpoint[c]);
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				pBit = p;
+				memcpy(quantized, candidate, sizeof(candidate));
+			}
+		}
+	}
+
+	void Mode6Palette(const int quantized[2][4], const int pBits[2], int palette[16][4])
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			int start = quantized[0][c] << 1 | pBits[0];
+			int end = quantized[1][c] << 1 | pBits[1];
+			for (int i = 0; i < 16; i++)
+				palette[i][c] = ((64 - Weights4[i]) * start + Weights4[i] * end + 32) >> 6;
+		}
+	}
+
+	float Mode6Indices(const Block& block, const int quantized[2][4], const int pBits[2], uint8_t indices[16])
+	{
+		int palette[16][4];
+		Mode6Palette(quantized, pBits, palette);
+
+		// Pixels are projected onto the endpoint line to find the
+		// closest weight, then only it and its neighbours are tried
+		float line[4];
+		float lineLengthSquared = 0.0f;
+		for (int c = 0; c < 4; c++)
+		{
+			line[c] = (float)(palette[15][c] - palette[0][c]);
+			lineLengthSquared += line[c] * line[c];
+		}
+
+		float total = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			int nearest = 0;
+			if (lineLengthSquared > 0.0f)
+			{
+				float t = 0.0f;
+				for (int c = 0; c < 4; c++)
+					t += (block.Pixels[i][c] - palette[0][c]) * line[c];
+				float weight = std::clamp(t / lineLengthSquared, 0.0f, 1.0f) * 64.0f;
+				while (nearest < 15 && Weights4[nearest + 1] <= weight)
+					nearest++;
+			}
+
+			float bestError = FLT_MAX;
+			for (int p = std::max(nearest - 1, 0); p <= std::min(nearest + 2, 15); p++)
+			{
+				float error = 0.0f;
+				for (int c = 0; c < 4; c++)
+					error += (block.Pixels[i][c] - palette[p][c]) * (block.Pixels[i][c] - palette[p][c]);
+				if (error < bestError)
+				{
+					bestError = error;
+					indices[i] = (uint8_t)p;
+				}
+			}
+			total += bestError;
+		}
+		return total;
+	}
+
+	void EncodeBC7(const Block& block, uint8_t* output)
+	{
+		float endpoints[2][4];
+		AxisEndpoints(block, 4, endpoints[0], endpoints[1]);
+
+		int bestQuantized[2][4] = {};
+		int bestPBits[2] = {};
+		uint8_t bestIndices[16] = {};
+		float bestError = FLT_MAX;
+		for (int pass = 0; pass < 3; pass++)
+		{
+			int quantized[2][4], pBits[2];
+			QuantizeMode6(endpoints[0], quantized[0], pBits[0]);
+			QuantizeMode6(endpoints[1], quantized[1], pBits[1]);
+
+			uint8_t indices[16];
+			float error = Mode6Indices(block, quantized, pBits, indices);
+			if (error < bestError)
+			{
+				bestError = error;
+				memcpy(bestQuantized, quantized, sizeof(quantized));
+				memcpy(bestPBits, pBits, sizeof(pBits));
+				memcpy(bestIndices, indices, sizeof(indices));
+			}
+
+			float weights[16];
+			for (int i = 0; i < 16; i++)
+				weights[i] = Weights4[indices[i]] / 64.0f;
+			if (!FitEndpoints(block, 4, weights, endpoints[0], endpoints[1]))
+				break;
+		}
+
+		// The first pixel's index is stored without its top bit,
+		// so it has to be in the lower half - flip the block if not
+		if (bestIndices[0] & 8)
+		{
+			std::swap(bestQuantized[0], bestQuantized[1]);
+			std::swap(bestPBits[0], bestPBits[1]);
+			for (int i = 0; i < 16; i++)
+				bestIndices[i] = 15 - bestIndices[i];
+		}
+
+		memset(output, 0, 16);
+		BlockWriter writer = { output };
+		writer.Write(1 << 6, 7);
+		for (int c = 0; c < 4; c++)
+		{
+			writer.Write(bestQuantized[0][c], 7);
+			writer.Write(bestQuantized[1][c], 7);
+		}
+		writer.Write(bestPBits[0], 1);
+		writer.Write(bestPBits[1], 1);
+		for (int i = 0; i < 16; i++)
+			writer.Write(bestIndices[i], i == 0 ? 3 : 4);
+	}
+
+	void EncodeBlock(DdsFormat format, const Block& block, uint8_t* output)
+	{
+		switch (format)
+		{
+		case DdsFormat::BC1: EncodeBC1(block, output); break;
+		case DdsFormat::BC4: EncodeBC4(block, 0, output); break;
+		case DdsFormat::BC5: EncodeBC4(block, 0, output); EncodeBC4(block, 1, output + 8); break;
+		case DdsFormat::BC7: EncodeBC7(block, output); break;
+		default: break;
+		}
+	}
+
+	// --------------------------------------------------------
+	// Decoding (only what the encoders above write, for BC7)
+	// --------------------------------------------------------
+	void DecodeBC4(const uint8_t* input, uint8_t pixels[16][4], int channel)
+	{
+		float palette[8];
+		Bc4Palette(input[0], input[1], palette);
+
+		uint64_t indices = 0;
+		for (int i = 0; i < 6; i++)
+			indices |= (uint64_t)input[2 + i] << (i * 8);
+		for (int i = 0; i < 16; i++)
+			pixels[i][channel] = ToByte(palette[(indices >> (i * 3)) & 7]);
+	}
+
+	void DecodeBlock(DdsFormat format, const uint8_t* input, uint8_t pixels[16][4])
+	{
+		memset(pixels, 0, 16 * 4);
+		for (int i = 0; i < 16; i++)
+			pixels[i][3] = 255;
+
+		if (format == DdsFormat::BC1)
+		{
+			uint16_t colors[2];
+			uint32_t indices;
+			memcpy(colors, input, 4);
+			memcpy(&indices, input + 4, 4);
+
+			int palette[4][3];
+			Bc1Palette(colors[0], colors[1], palette);
+			for (int i = 0; i < 16; i++)
+			{
+				uint32_t index = (indices >> (i * 2)) & 3;
+				for (int c = 0; c < 3; c++)
+					pixels[i][c] = (uint8_t)palette[index][c];
+				if (colors[0] <= colors[1] && index == 3)
+					pixels[i][3] = 0;
+			}
+		}
+		else if (format == DdsFormat::BC4 || format == DdsFormat::BC5)
+		{
+			DecodeBC4(input, pixels, 0);
+			if (format == DdsFormat::BC5)
+				DecodeBC4(input + 8, pixels, 1);
+		}
+		else if (format == DdsFormat::BC7)
+		{
+			BlockReader reader = { input };
+			if (reader.Read(7) != 1 << 6)
+				return;
+
+			int quantized[2][4], pBits[2];
+			for (int c = 0; c < 4; c++)
+			{
+				quantized[0][c] = reader.Read(7);
+				quantized[1][c] = reader.Read(7);
+			}
+			pBits[0] = reader.Read(1);
+			pBits[1] = reader.Read(1);
+
+			int palette[16][4];
+			Mode6Palette(quantized, pBits, palette);
+			for (int i = 0; i < 16; i++)
+			{
+				uint32_t index = reader.Read(i == 0 ? 3 : 4);
+				for (int c = 0; c < 4; c++)
+					pixels[i][c] = (uint8_t)palette[index][c];
+			}
+		}
+	}
+}
+
+TextureKind TextureCooker::KindFromFileName(const std::filesystem::path& path)
+{
+	// Only the last part counts ("rough_albedo" is still a color)
+	std::string name = path.stem().string();
+	std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char)tolower(c); });
+	std::string suffix = name.substr(name.find_last_of('_') + 1);
+
+	if (suffix == "normals" || suffix == "normal")
+		return TextureKind::Normal;
+	if (suffix == "roughness" || suffix == "metal" || suffix == "metalness" ||
+		suffix == "height" || suffix == "heightmap")
+		return TextureKind::Single;
+	return TextureKind::Color;
+}
+
+DdsFormat TextureCooker::FormatFor(TextureKind kind, bool preferBC1)
+{
+	switch (kind)
+	{
+	case TextureKind::Normal: return DdsFormat::BC5;
+	case TextureKind::Single: return DdsFormat::BC4;
+	case TextureKind::Packed: return DdsFormat::BC7;
+	default: return preferBC1 ? DdsFormat::BC1 : DdsFormat::BC7;
+	}
+}
+
+DdsFormat TextureCooker::PackedFormat(const CpuImage& packed)
+{
+	return packed.Format == CpuImageFormat::RG8 ? DdsFormat::BC5 : DdsFormat::BC7;
+}
+
+bool TextureCooker::CanCook(const CpuImage& image)
+{
+	return image.Width > 0 && image.Height > 0 && image.Width % 4 == 0 && image.Height % 4 == 0;
+}
+
+bool TextureCooker::Cook(const CpuImage& image, TextureKind kind, DdsFormat format, DdsImage& cooked, std::string* error)
+{
+	if (!DdsFile::IsBlockCompressed(format))
+		return Fail(error, "not a block compressed format");
+	if (!CanCook(image))
+		return Fail(error, "size is not a multiple of 4");
+
+	// Every mip down to 1x1
+	std::vector<CpuImage> mips(1);
+	ToRGBA8(image, mips[0]);
+	while (mips.back().Width > 1 || mips.back().Height > 1)
+	{
+		CpuImage next;
+		Downsample(mips.back(), next, kind == TextureKind::Normal);
+		mips.push_back(std::move(next));
+	}
+
+	cooked.Width = image.Width;
+	cooked.Height = image.Height;
+	cooked.MipLevels = (unsigned int)mips.size();
+	cooked.Format = format;
+	cooked.Data.assign(cooked.MipOffset(cooked.MipLevels), 0);
+
+	unsigned int blockBytes = DdsFile::BytesPerBlock(format);
+	for (unsigned int mip = 0; mip < cooked.MipLevels; mip++)
+	{
+		const CpuImage& source = mips[mip];
+		unsigned int blocksWide = (source.Width + 3) / 4;
+		unsigned int blocksHigh = (source.Height + 3) / 4;
+		uint8_t* output = cooked.Data.data() + cooked.MipOffset(mip);
+
+		JobSystem::ParallelFor(blocksWide * blocksHigh, [&](unsigned int begin, unsigned int end)
+			{
+				Block block;
+				for (unsigned int i = begin; i < end; i++)
+				{
+					ReadBlock(source, i % blocksWide, i / blocksWide, block);
+					EncodeBlock(format, block, output + (size_t)i * blockBytes);
+				}
+			});
+	}
+	return true;
+}
+
+void TextureCooker::PackChannels(const CpuImage* const sources[], unsigned int count, CpuImage& packed)
+{
+	// As big as the biggest source
+	packed.Width = 1;
+	packed.Height = 1;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (sources[i])
+		{
+			packed.Width = std::max(packed.Width, sources[i]->Width);
+			packed.Height = std::max(packed.Height, sources[i]->Height);
+		}
+	}
+
+	packed.Format = count <= 2 ? CpuImageFormat::RG8 : CpuImageFormat::RGBA8;
+	unsigned int channels = packed.BytesPerPixel();
+	packed.Pixels.assign((size_t)packed.Width * packed.Height * channels, 0);
+	if (channels == 4 && count < 4)
+		for (size_t i = 3; i < packed.Pixels.size(); i += 4)
+			packed.Pixels[i] = 255;
+
+	for (unsigned int c = 0; c < std::min(count, channels); c++)
+	{
+		const CpuImage* source = sources[c];
+		if (!source)
+			continue;
+
+		for (unsigned int y = 0; y < packed.Height; y++)
+		{
+			size_t sourceRow = (size_t)y * source->Height / packed.Height * source->Width;
+			for (unsigned int x = 0; x < packed.Width; x++)
+			{
+				size_t sourceX = (size_t)x * source->Width / packed.Width;
+				packed.Pixels[((size_t)y * packed.Width + x) * channels + c] = FirstChannel(*source, sourceRow + sourceX);
+			}
+		}
+	}
+}
+
+void TextureCooker::ToRGBA8(const CpuImage& image, CpuImage& rgba)
+{
+	rgba.Width = image.Width;
+	rgba.Height = image.Height;
+	rgba.Format = CpuImageFormat::RGBA8;
+	if (image.Format == CpuImageFormat::RGBA8)
+	{
+		rgba.Pixels = image.Pixels;
+		return;
+	}
+
+	size_t count = (size_t)image.Width * image.Height;
+	rgba.Pixels.resize(count * 4);
+	for (size_t i = 0; i < count; i++)
+	{
+		if (image.Format == CpuImageFormat::RG8)
+		{
+			rgba.Pixels[i * 4 + 0] = image.Pixels[i * 2 + 0];
+			rgba.Pixels[i * 4 + 1] = image.Pixels[i * 2 + 1];
+			rgba.Pixels[i * 4 + 2] = 0;
+		}
+		else
+		{
+			uint8_t gray = FirstChannel(image, i);
+			rgba.Pixels[i * 4 + 0] = gray;
+			rgba.Pixels[i * 4 + 1] = gray;
+			rgba.Pixels[i * 4 + 2] = gray;
+		}
+		rgba.Pixels[i * 4 + 3] = 255;
+	}
+}
+
+void TextureCooker::DecodeMip(const DdsImage& cooked, unsigned int mip, CpuImage& rgba)
+{
+	rgba.Width = cooked.MipWidth(mip);
+	rgba.Height = cooked.MipHeight(mip);
+	rgba.Format = CpuImageFormat::RGBA8;
+	rgba.Pixels.assign((size_t)rgba.Width * rgba.Height * 4, 0);
+
+	unsigned int blockBytes = DdsFile::BytesPerBlock(cooked.Format);
+	unsigned int blocksWide = (rgba.Width + 3) / 4;
+	const uint8_t* input = cooked.Data.data() + cooked.MipOffset(mip);
+	for (unsigned int blockY = 0; blockY < (rgba.Height + 3) / 4; blockY++)
+	{
+		for (unsigned int blockX = 0; blockX < blocksWide; blockX++)
+		{
+			uint8_t pixels[16][4];
+			DecodeBlock(cooked.Format, input + ((size_t)blockY * blocksWide + blockX) * blockBytes, pixels);
+
+			// Pixels past the edge of tiny mips are dropped
+			for (unsigned int y = 0; y < 4 && blockY * 4 + y < rgba.Height; y++)
+				for (unsigned int x = 0; x < 4 && blockX * 4 + x < rgba.Width; x++)
+					memcpy(&rgba.Pixels[((size_t)(blockY * 4 + y) * rgba.Width + blockX * 4 + x) * 4], pixels[y * 4 + x], 4);
+		}
+	}
+}
+
+unsigned int TextureCooker::ChannelCount(DdsFormat format)
+{
+	switch (format)
+	{
+	case DdsFormat::BC4: case DdsFormat::R8: case DdsFormat::R16: return 1;
+	case DdsFormat::BC5: case DdsFormat::RG8: return 2;
+	case DdsFormat::BC1: return 3;
+	default: return 4;
+	}
+}
+
+double TextureCooker::PSNR(const CpuImage& original, const CpuImage& decoded, unsigned int channels)
+{
+	size_t count = (size_t)original.Width * original.Height;
+	double squaredError = 0.0;
+	for (size_t i = 0; i < count; i++)
+	{
+		for (unsigned int c = 0; c < channels; c++)
+		{
+			double difference = (double)original.Pixels[i * 4 + c] - decoded.Pixels[i * 4 + c];
+			squaredError += difference * difference;
+		}
+	}
+
+	double meanSquaredError = squaredError / ((double)count * channels);
+	if (meanSquaredError == 0.0)
+		return INFINITY;
+	return 10.0 * log10(255.0 * 255.0 / meanSquaredError);
+}
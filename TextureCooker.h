@@ -0,0 +1,67 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+#include "DdsFile.h"
+#include "PngDecoder.h"
+
+// What a texture holds, which decides how it gets compressed
+enum class TextureKind
+{
+	Color,		// Albedo and anything else: BC7 (or BC1)
+	Single,		// Roughness, metalness and height: BC4
+	Normal,		// Tangent space normals: BC5, Z rebuilt in the shader
+	Packed		// Roughness, metalness and height in R, G and B: BC5 or BC7
+};
+
+// --------------------------------------------------------
+// Offline block compression of textures into DDS files,
+// with the full mip chain built on the CPU.
+//
+// - BC1: 565 endpoints on the principal axis, 4 colors
+// - BC4: 8 interpolated values between the block's min/max
+// - BC5: two BC4 blocks (normal X and Y)
+// - BC7: mode 6 only (RGBA endpoints + p-bits, 16 weights)
+//
+// Endpoints of BC1/BC7 blocks are refined with a least
+// squares fit.  Blocks are encoded in parallel on the job
+// system.  The decoders exist to measure the error.
+// --------------------------------------------------------
+namespace TextureCooker
+{
+	// Guesses from the file name ("_normals", "_roughness", ...)
+	TextureKind KindFromFileName(const std::filesystem::path& path);
+	DdsFormat FormatFor(TextureKind kind, bool preferBC1 = false);
+
+	// BC5 if only roughness and metalness were packed, BC7 otherwise
+	DdsFormat PackedFormat(const CpuImage& packed);
+
+	// Block compressed textures need sizes that are multiples of 4
+	bool CanCook(const CpuImage& image);
+
+	// Puts the first channel of each source into one image, in
+	// order from R.  Two sources make an RG8 image, three or four
+	// make RGBA8 (alpha 255 if unused).  Missing (null) sources
+	// are 0, and smaller sources are scaled up with point
+	// sampling so 0/1 metalness stays 0/1.
+	void PackChannels(const CpuImage* const sources[], unsigned int count, CpuImage& packed);
+
+	// Needs the job system
+	bool Cook(const CpuImage& image, TextureKind kind, DdsFormat format, DdsImage& cooked, std::string* error = 0);
+
+	// Any CpuImage as RGBA8 (gray goes into RGB, 16 bit is rounded,
+	// RG8 gets B = 0)
+	void ToRGBA8(const CpuImage& image, CpuImage& rgba);
+
+	// One mip of a cooked texture back to RGBA8.  Missing
+	// channels come out as 0 (alpha as 255) like on the GPU.
+	void DecodeMip(const DdsImage& cooked, unsigned int mip, CpuImage& rgba);
+
+	// Channels the format keeps (BC4 = 1, BC5 = 2, BC1 = 3, ...)
+	unsigned int ChannelCount(DdsFormat format);
+
+	// Peak signal to noise ratio over the first "channels"
+	// channels of two RGBA8 images of the same size
+	double PSNR(const CpuImage& original, const CpuImage& decoded, unsigned int channels);
+}
@@ -0,0 +1,338 @@
+#include "TextureLoader.h"
+#include "Graphics.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "ResourceRegistry.h"
+#include "TextureCooker.h"
+#include "TextureStreamer.h"
+#include "WicTextureLoader.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Bytes a texture's whole mip chain takes up
+	size_t TextureBytes(ID3D11Texture2D* texture)
+	{
+		D3D11_TEXTURE2D_DESC desc = {};
+		texture->GetDesc(&desc);
+
+		DdsImage layout;
+		layout.Width = desc.Width;
+		layout.Height = desc.Height;
+		layout.MipLevels = desc.MipLevels;
+		layout.Format = (DdsFormat)desc.Format;
+		if (DdsFile::BytesPerBlock(layout.Format) == 0)
+			layout.Format = DdsFormat::RGBA8;	// Same size as the other formats WIC picks
+		return layout.MipOffset(layout.MipLevels);
+	}
+}
+
+unsigned int TextureLoader::Add(const std::wstring& path, bool generateMips)
+{
+	Request request;
+	request.GenerateMips = generateMips;
+	requests.push_back(std::move(request));
+
+	TextureLoadTiming timing;
+	timing.Path = path;
+	timings.push_back(timing);
+
+	return (unsigned int)requests.size() - 1;
+}
+
+unsigned int TextureLoader::AddPacked(const std::wstring& packedPath, const std::vector<std::wstring>& channelPaths)
+{
+	unsigned int index = Add(packedPath);
+	requests[index].ChannelPaths = channelPaths;
+	timings[index].Packed = true;
+	return index;
+}
+
+void TextureLoader::LoadAll()
+{
+	PROFILE_SCOPE("TextureLoader::LoadAll");
+	uint64_t start = Profiler::Now();
+
+	// Every file at once, each with its own counter so uploads can start early.
+	// Paths already loaded (or earlier in this batch) are shared, not read.
+	unsigned int count = (unsigned int)requests.size();
+	std::unique_ptr<JobCounter[]> decoded(new JobCounter[count]);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		requests[i].Resident = ResourceRegistry::HasTexture(timings[i].Path);
+		for (unsigned int j = 0; j < i && !requests[i].Resident && requests[i].Streamed < 0; j++)
+		{
+			if (timings[j].Path == timings[i].Path)
+			{
+				requests[i].Streamed = requests[j].Streamed;
+				requests[i].Resident = requests[j].Streamed < 0;
+			}
+		}
+
+		// Cooked textures with mips stream instead (only reads their tail)
+		if (streamer && !requests[i].Resident && requests[i].Streamed < 0 && requests[i].GenerateMips)
+		{
+			std::filesystem::path cookedPath = timings[i].Path;
+			cookedPath.replace_extension(".dds");
+			requests[i].Streamed = streamer->Add(cookedPath.wstring());
+		}
+
+		if (!requests[i].Resident && requests[i].Streamed < 0)
+			JobSystem::Run(decoded[i], [this, i]() { Decode(i); });
+	}
+
+	// The device context is only touched here, on the main thread
+	for (unsigned int i = 0; i < count; i++)
+	{
+		JobSystem::Wait(decoded[i]);
+		Upload(i);
+	}
+
+	totalMs = Profiler::TicksToMilliseconds(Profiler::Now() - start);
+}
+
+// Worker side: file -> CPU image (only touches its own request)
+void TextureLoader::Decode(unsigned int index)
+{
+	PROFILE_SCOPE("TextureLoader::Decode");
+	Request& request = requests[index];
+	TextureLoadTiming& timing = timings[index];
+
+	// A cooked version next to the file wins if there is one
+	uint64_t start = Profiler::Now();
+	std::filesystem::path cookedPath = timing.Path;
+	cookedPath.replace_extension(".dds");
+	std::vector<uint8_t> cookedBytes;
+	if (PngDecoder::ReadFile(cookedPath, cookedBytes))
+	{
+		uint64_t read = Profiler::Now();
+		request.Cooked = DdsFile::Read(cookedBytes.data(), cookedBytes.size(), request.CookedImage);
+		request.Hash = ResourceRegistry::HashBytes(cookedBytes.data(), cookedBytes.size());
+		timing.FileBytes = cookedBytes.size();
+		timing.ReadMs = Profiler::TicksToMilliseconds(read - start);
+		timing.DecodeMs = Profiler::TicksToMilliseconds(Profiler::Now() - read);
+
+		// One that can't be read falls back to the original
+		if (request.Cooked)
+			return;
+	}
+
+	// Packed textures start out as one file per channel
+	std::vector<std::wstring> paths = request.ChannelPaths;
+	if (paths.empty())
+		paths.push_back(timing.Path);
+
+	std::vector<CpuImage> images(paths.size());
+	std::vector<const CpuImage*> decoded(paths.size(), 0);
+	timing.FileBytes = 0;
+
+	// Packed textures start from their channel count, so one packed from a
+	// single map never matches the map itself (same for mips or no mips)
+	unsigned int seed[2] = { (unsigned int)request.ChannelPaths.size(), request.GenerateMips };
+	request.Hash = ResourceRegistry::HashBytes(seed, sizeof(seed));
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		uint64_t readStart = Profiler::Now();
+		std::vector<uint8_t> bytes;
+		bool found = PngDecoder::ReadFile(paths[i], bytes);
+		request.FileFound = request.FileFound || found;
+		request.Hash = ResourceRegistry::HashBytes(bytes.data(), bytes.size(), request.Hash);
+		timing.FileBytes += bytes.size();
+
+		uint64_t read = Profiler::Now();
+		if (found && PngDecoder::Decode(bytes.data(), bytes.size(), images[i]))
+			decoded[i] = &images[i];
+		timing.ReadMs += Profiler::TicksToMilliseconds(read - readStart);
+		timing.DecodeMs += Profiler::TicksToMilliseconds(Profiler::Now() - read);
+	}
+
+	request.Decoded = std::any_of(decoded.begin(), decoded.end(), [](const CpuImage* image) { return image != 0; });
+	if (!request.Decoded)
+		return;
+
+	if (request.ChannelPaths.empty())
+		request.Image = std::move(images[0]);
+	else
+	{
+		uint64_t packStart = Profiler::Now();
+		TextureCooker::PackChannels(decoded.data(), (unsigned int)decoded.size(), request.Image);
+		timing.DecodeMs += Profiler::TicksToMilliseconds(Profiler::Now() - packStart);
+	}
+}
+
+// Main thread side: CPU image -> texture + SRV
+void TextureLoader::Upload(unsigned int index)
+{
+	PROFILE_SCOPE("TextureLoader::Upload");
+	Request& request = requests[index];
+	TextureLoadTiming& timing = timings[index];
+	uint64_t start = Profiler::Now();
+
+	if (request.Streamed >= 0)
+	{
+		request.Texture = streamer->GetTexture(request.Streamed);
+		request.SRV = streamer->GetSRV(request.Streamed);
+
+		TextureResidency& residency = streamer->GetResidency();
+		timing.Streamed = true;
+		timing.UsedDDS = true;
+		timing.Loaded = request.SRV != 0;
+		timing.GpuBytes = residency.GetBytes(request.Streamed, residency.GetTailMip(request.Streamed));
+		timing.UploadMs = Profiler::TicksToMilliseconds(Profiler::Now() - start);
+		return;
+	}
+
+	// Loaded before, either from this path or from a file with the same contents
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> existing = request.Resident ?
+		ResourceRegistry::FindTexture(timing.Path) :
+		ResourceRegistry::FindTextureByContent(request.Hash, timing.Path);
+	if (existing)
+	{
+		Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+		existing->GetResource(resource.GetAddressOf());
+		resource.As(&request.Texture);
+		request.SRV = existing;
+		request.Image.Pixels.clear();
+		request.CookedImage.Data.clear();
+
+		timing.Shared = true;
+		timing.Loaded = true;
+		timing.UploadMs = Profiler::TicksToMilliseconds(Profiler::Now() - start);
+		return;
+	}
+
+	if (request.Cooked)
+	{
+		// Already has every mip, so it never changes
+		const DdsImage& image = request.CookedImage;
+
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = image.Width;
+		desc.Height = image.Height;
+		desc.MipLevels = image.MipLevels;
+		desc.ArraySize = 1;
+		desc.Format = (DXGI_FORMAT)image.Format;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_IMMUTABLE;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		std::vector<D3D11_SUBRESOURCE_DATA> mips(image.MipLevels);
+		for (unsigned int mip = 0; mip < image.MipLevels; mip++)
+		{
+			mips[mip].pSysMem = image.Data.data() + image.MipOffset(mip);
+			mips[mip].SysMemPitch = (UINT)image.MipRowPitch(mip);
+		}
+		Graphics::Device->CreateTexture2D(&desc, mips.data(), request.Texture.GetAddressOf());
+		if (request.Texture)
+			Graphics::Device->CreateShaderResourceView(request.Texture.Get(), 0, request.SRV.GetAddressOf());
+
+		request.CookedImage.Data.clear();
+		request.CookedImage.Data.shrink_to_fit();
+		timing.UsedDDS = true;
+	}
+	else if (request.Decoded)
+	{
+		const CpuImage& image = request.Image;
+
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = image.Width;
+		desc.Height = image.Height;
+		desc.ArraySize = 1;
+		desc.Format = GetFormat(image.Format);
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		if (request.GenerateMips)
+		{
+			// Full chain, filled in by the GPU from the top level
+			desc.MipLevels = 0;
+			desc.BindFlags |= D3D11_BIND_RENDER_TARGET;
+			desc.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+			Graphics::Device->CreateTexture2D(&desc, 0, request.Texture.GetAddressOf());
+			if (request.Texture)
+				Graphics::Renderer->UpdateSubresource(request.Texture.Get(), 0, image.Pixels.data(), (unsigned int)image.RowPitch(), image.Pixels.size());
+		}
+		else
+		{
+			desc.MipLevels = 1;
+			D3D11_SUBRESOURCE_DATA data = {};
+			data.pSysMem = image.Pixels.data();
+			data.SysMemPitch = (UINT)image.RowPitch();
+			Graphics::Device->CreateTexture2D(&desc, &data, request.Texture.GetAddressOf());
+		}
+
+		if (request.Texture)
+		{
+			Graphics::Device->CreateShaderResourceView(request.Texture.Get(), 0, request.SRV.GetAddressOf());
+			if (request.GenerateMips && request.SRV)
+				Graphics::Renderer->GenerateMips(request.SRV.Get());
+		}
+
+		// The GPU has its own copy now
+		request.Image.Pixels.clear();
+		request.Image.Pixels.shrink_to_fit();
+	}
+	else if (request.FileFound && request.ChannelPaths.empty())
+	{
+		// Not a PNG the decoder handles - let WIC have a go
+		Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+		DirectX::CreateWICTextureFromFile(
+			Graphics::Device.Get(),
+			request.GenerateMips ? Graphics::Context.Get() : 0,
+			timing.Path.c_str(),
+			resource.GetAddressOf(),
+			request.SRV.GetAddressOf());
+		if (resource)
+			resource.As(&request.Texture);
+		timing.UsedWIC = true;
+	}
+
+	timing.Loaded = request.Texture != 0;
+	if (request.Texture)
+		timing.GpuBytes = TextureBytes(request.Texture.Get());
+	if (request.SRV)
+		ResourceRegistry::AddTexture(timing.Path, request.Hash, request.SRV, timing.GpuBytes);
+	timing.UploadMs = Profiler::TicksToMilliseconds(Profiler::Now() - start);
+}
+
+void TextureLoader::SetStreamer(TextureStreamer* streamer)
+{
+	this->streamer = streamer;
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> TextureLoader::GetSRV(unsigned int index)
+{
+	return requests[index].SRV;
+}
+
+Microsoft::WRL::ComPtr<ID3D11Texture2D> TextureLoader::GetTexture(unsigned int index)
+{
+	return requests[index].Texture;
+}
+
+const std::vector<TextureLoadTiming>& TextureLoader::GetTimings()
+{
+	return timings;
+}
+
+double TextureLoader::GetTotalMs()
+{
+	return totalMs;
+}
+
+DXGI_FORMAT TextureLoader::GetFormat(CpuImageFormat format)
+{
+	switch (format)
+	{
+	case CpuImageFormat::R8: return DXGI_FORMAT_R8_UNORM;
+	case CpuImageFormat::R16: return DXGI_FORMAT_R16_UNORM;
+	case CpuImageFormat::RG8: return DXGI_FORMAT_R8G8_UNORM;
+	default: return DXGI_FORMAT_R8G8B8A8_UNORM;
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <string>
+#include <vector>
+
+#include "DdsFile.h"
+#include "PngDecoder.h"
+
+class TextureStreamer;
+
+// --------------------------------------------------------
+// How long one texture took at each stage
+// --------------------------------------------------------
+struct TextureLoadTiming
+{
+	std::wstring Path;
+	size_t FileBytes = 0;
+	double ReadMs = 0.0;		// Worker thread
+	double DecodeMs = 0.0;		// Worker thread
+	double UploadMs = 0.0;		// Main thread, including mip generation
+	size_t GpuBytes = 0;		// Whole mip chain
+	bool UsedDDS = false;		// Cooked (block compressed) version was found
+	bool Packed = false;		// Several maps in one texture (see AddPacked())
+	bool Shared = false;		// Already loaded (see ResourceRegistry), nothing uploaded
+	bool Streamed = false;		// Handed to a TextureStreamer, only the tail mips loaded
+	bool UsedWIC = false;		// PngDecoder couldn't handle the file
+	bool Loaded = false;
+};
+
+// --------------------------------------------------------
+// Loads a batch of textures at once.
+//
+// Files are read and decoded by PngDecoder as jobs, all at
+// the same time.  The main thread uploads each texture (in
+// the order they were added) as soon as it's decoded,
+// running decode jobs itself while it waits.  Files the
+// decoder can't handle are loaded with WIC instead.
+//
+// If a .dds with the same name sits next to the file (see
+// the "-cook" option), it's loaded instead, mips and all.
+//
+// Every texture goes into the ResourceRegistry.  Paths that
+// are already there aren't read at all, and files with the
+// same contents as a loaded texture share it.
+//
+// With a streamer set, cooked textures with mips go to it
+// instead: only their smallest mips load here and the
+// rest stream in while running (not shared either, since
+// the streamer swaps them).
+//
+// Usage:
+//   Add() ... -> LoadAll() -> GetSRV() / GetTexture()
+// --------------------------------------------------------
+class TextureLoader
+{
+public:
+	// Returns the index to get the texture with later.  Mips are
+	// generated the same way CreateWICTextureFromFile() does.
+	unsigned int Add(const std::wstring& path, bool generateMips = true);
+
+	// One texture holding a single channel map per channel, in order
+	// from R (roughness, metalness, height for the PBR shaders).
+	// Loads packedPath if it was cooked, otherwise packs the separate
+	// files after decoding them.  Missing maps read as 0.
+	unsigned int AddPacked(const std::wstring& packedPath, const std::vector<std::wstring>& channelPaths);
+
+	// Needs the job system, and must be called from the main thread
+	void LoadAll();
+
+	// Optional, before LoadAll()
+	void SetStreamer(TextureStreamer* streamer);
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetSRV(unsigned int index);
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> GetTexture(unsigned int index);
+
+	const std::vector<TextureLoadTiming>& GetTimings();
+	double GetTotalMs();	// Start of LoadAll() to the last upload
+
+	static DXGI_FORMAT GetFormat(CpuImageFormat format);
+
+private:
+	struct Request
+	{
+		bool GenerateMips = true;
+		bool Decoded = false;
+		bool FileFound = false;
+		bool Cooked = false;
+		bool Resident = false;	// Path was already loaded, so there's nothing to decode
+		int Streamed = -1;		// Index in the streamer
+		uint64_t Hash = 0;		// Of the file(s), for the registry
+		std::vector<std::wstring> ChannelPaths;	// Only for packed textures
+		CpuImage Image;
+		DdsImage CookedImage;
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> Texture;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SRV;
+	};
+
+	std::vector<Request> requests;
+	std::vector<TextureLoadTiming> timings;
+	TextureStreamer* streamer = 0;
+	double totalMs = 0.0;
+
+	void Decode(unsigned int index);
+	void Upload(unsigned int index);
+};
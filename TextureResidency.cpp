@@ -0,0 +1,265 @@
+#include "TextureResidency.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+TextureResidency::TextureResidency(size_t budgetBytes, unsigned int tailSize) :
+	maxLoadsInFlight(4),
+	budgetBytes(budgetBytes),
+	tailSize(tailSize),
+	frame(0)
+{
+}
+
+unsigned int TextureResidency::Add(const DdsImage& layout)
+{
+	Texture texture;
+	texture.Layout.Width = layout.Width;
+	texture.Layout.Height = layout.Height;
+	texture.Layout.MipLevels = layout.MipLevels;
+	texture.Layout.Format = layout.Format;
+
+	texture.Bytes.assign(layout.MipLevels + 1, 0);
+	for (int mip = (int)layout.MipLevels - 1; mip >= 0; mip--)
+		texture.Bytes[mip] = texture.Bytes[mip + 1] + layout.MipSize(mip);
+
+	// First mip small enough to always keep (or the last one)
+	while (texture.TailMip + 1 < layout.MipLevels &&
+		std::max(layout.MipWidth(texture.TailMip), layout.MipHeight(texture.TailMip)) > tailSize)
+		texture.TailMip++;
+
+	texture.ResidentMip = texture.TailMip;
+	texture.LoadMip = texture.TailMip;
+	texture.RequestedMip = texture.TailMip;
+	texture.WantedMip = texture.TailMip;
+	textures.push_back(texture);
+	return (unsigned int)textures.size() - 1;
+}
+
+void TextureResidency::Request(unsigned int texture, unsigned int mip)
+{
+	Texture& t = textures[texture];
+	t.RequestedMip = t.Requested ? std::min(t.RequestedMip, mip) : mip;
+	t.Requested = true;
+}
+
+void TextureResidency::Update(std::vector<MipChange>& evictions, std::vector<MipChange>& loads)
+{
+	evictions.clear();
+	loads.clear();
+	frame++;
+
+	// What everything wants this frame (the tail if nobody asked)
+	unsigned int loading = 0;
+	for (Texture& t : textures)
+	{
+		t.WantedMip = t.Requested ? std::min(t.RequestedMip, t.TailMip) : t.TailMip;
+		if (t.Requested)
+			t.LastRequested = frame;
+		loading += t.Loading;
+	}
+
+	// The budget may have shrunk since last time
+	if (Committed() > budgetBytes)
+		Evict(UINT_MAX, Committed() - budgetBytes, evictions);
+
+	// Biggest shortfall first, then whoever wants the most detail
+	std::vector<unsigned int> order;
+	for (unsigned int i = 0; i < textures.size(); i++)
+		if (textures[i].Requested && !textures[i].Loading && textures[i].WantedMip < textures[i].ResidentMip)
+			order.push_back(i);
+	std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b)
+		{
+			const Texture& ta = textures[a];
+			const Texture& tb = textures[b];
+			unsigned int gapA = ta.ResidentMip - ta.WantedMip;
+			unsigned int gapB = tb.ResidentMip - tb.WantedMip;
+			if (gapA != gapB) return gapA > gapB;
+			if (ta.WantedMip != tb.WantedMip) return ta.WantedMip < tb.WantedMip;
+			return a < b;
+		});
+
+	for (unsigned int index : order)
+	{
+		if (loading >= maxLoadsInFlight)
+			break;
+
+		// As much of what it wants as fits, making room if needed
+		Texture& t = textures[index];
+		for (unsigned int target = t.WantedMip; target < t.ResidentMip; target++)
+		{
+			size_t needed = t.Bytes[target] - t.Bytes[t.ResidentMip];
+			size_t committed = Committed();
+			if (committed + needed > budgetBytes && !Evict(index, committed + needed - budgetBytes, evictions))
+				continue;
+
+			MipChange load;
+			load.Texture = index;
+			load.FromMip = t.ResidentMip;
+			load.ToMip = target;
+			loads.push_back(load);
+
+			t.LoadMip = target;
+			t.Loading = true;
+			loading++;
+			stats.Loads++;
+			stats.BytesLoaded += needed;
+			break;
+		}
+	}
+
+	// Report, and start the next frame's requests
+	stats.Textures = (unsigned int)textures.size();
+	stats.Requested = 0;
+	stats.Starved = 0;
+	stats.Loading = loading;
+	stats.ResidentBytes = 0;
+	stats.PendingBytes = 0;
+	stats.BudgetBytes = budgetBytes;
+	for (Texture& t : textures)
+	{
+		stats.Requested += t.Requested;
+		stats.Starved += t.Requested && t.ResidentMip > t.WantedMip;
+		stats.ResidentBytes += t.Bytes[t.ResidentMip];
+		if (t.Loading)
+			stats.PendingBytes += t.Bytes[t.LoadMip] - t.Bytes[t.ResidentMip];
+		t.Requested = false;
+	}
+}
+
+void TextureResidency::FinishLoad(unsigned int texture, bool loaded)
+{
+	Texture& t = textures[texture];
+	if (!t.Loading)
+		return;
+
+	if (loaded)
+		t.ResidentMip = t.LoadMip;
+	t.LoadMip = t.ResidentMip;
+	t.Loading = false;
+}
+
+float TextureResidency::MipForDistance(float textureSize, float uvPerUnit, float distance, float tanHalfFov, float screenHeight)
+{
+	// Texels across one world unit vs. pixels across one world unit
+	float pixelsPerUnit = screenHeight / (2.0f * tanHalfFov * std::max(distance, 0.001f));
+	float texelsPerUnit = textureSize * uvPerUnit;
+	float mip = log2f(texelsPerUnit / pixelsPerUnit);
+	return mip > 0.0f ? mip : 0.0f;
+}
+
+// Everything resident plus everything on its way
+size_t TextureResidency::Committed() const
+{
+	size_t bytes = 0;
+	for (const Texture& t : textures)
+		bytes += t.Bytes[t.Loading ? t.LoadMip : t.ResidentMip];
+	return bytes;
+}
+
+// Drops mips, least recently requested textures first, until
+// "needed" bytes are free.  Nothing happens (false) if that's
+// more than can be freed without going below what's wanted.
+bool TextureResidency::Evict(unsigned int keep, size_t needed, std::vector<MipChange>& evictions)
+{
+	std::vector<unsigned int> victims;
+	size_t freeable = 0;
+	for (unsigned int i = 0; i < textures.size(); i++)
+	{
+		const Texture& t = textures[i];
+		if (i == keep || t.Loading || t.ResidentMip >= t.WantedMip)
+			continue;
+
+		victims.push_back(i);
+		freeable += t.Bytes[t.ResidentMip] - t.Bytes[t.WantedMip];
+	}
+	if (freeable < needed)
+		return false;
+
+	std::sort(victims.begin(), victims.end(), [&](unsigned int a, unsigned int b)
+		{
+			if (textures[a].LastRequested != textures[b].LastRequested)
+				return textures[a].LastRequested < textures[b].LastRequested;
+			return a < b;
+		});
+
+	// A mip at a time, so nothing loses more than it has to
+	size_t freed = 0;
+	for (unsigned int index : victims)
+	{
+		Texture& t = textures[index];
+		unsigned int mip = t.ResidentMip;
+		while (mip < t.WantedMip && freed < needed)
+		{
+			freed += t.Bytes[mip] - t.Bytes[mip + 1];
+			mip++;
+		}
+
+		MipChange eviction;
+		eviction.Texture = index;
+		eviction.FromMip = t.ResidentMip;
+		eviction.ToMip = mip;
+		evictions.push_back(eviction);
+
+		stats.Evictions++;
+		stats.BytesEvicted += t.Bytes[t.ResidentMip] - t.Bytes[mip];
+		t.ResidentMip = mip;
+		t.LoadMip = mip;
+
+		if (freed >= needed)
+			break;
+	}
+	return true;
+}
+
+unsigned int TextureResidency::GetTextureCount() const
+{
+	return (unsigned int)textures.size();
+}
+
+unsigned int TextureResidency::GetResidentMip(unsigned int texture) const
+{
+	return textures[texture].ResidentMip;
+}
+
+unsigned int TextureResidency::GetTailMip(unsigned int texture) const
+{
+	return textures[texture].TailMip;
+}
+
+unsigned int TextureResidency::GetWantedMip(unsigned int texture) const
+{
+	return textures[texture].WantedMip;
+}
+
+bool TextureResidency::IsLoading(unsigned int texture) const
+{
+	return textures[texture].Loading;
+}
+
+size_t TextureResidency::GetBytes(unsigned int texture, unsigned int fromMip) const
+{
+	const Texture& t = textures[texture];
+	return t.Bytes[std::min(fromMip, t.Layout.MipLevels)];
+}
+
+const DdsImage& TextureResidency::GetLayout(unsigned int texture) const
+{
+	return textures[texture].Layout;
+}
+
+const TextureResidencyStats& TextureResidency::GetStats() const
+{
+	return stats;
+}
+
+size_t TextureResidency::GetBudget() const
+{
+	return budgetBytes;
+}
+
+void TextureResidency::SetBudget(size_t budgetBytes)
+{
+	this->budgetBytes = budgetBytes;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "DdsFile.h"
+
+// --------------------------------------------------------
+// One texture moving from one top mip to another (lower
+// numbers = more detail)
+// --------------------------------------------------------
+struct MipChange
+{
+	unsigned int Texture = 0;
+	unsigned int FromMip = 0;
+	unsigned int ToMip = 0;
+};
+
+// --------------------------------------------------------
+// What the residency did in the last Update(), plus totals
+// --------------------------------------------------------
+struct TextureResidencyStats
+{
+	unsigned int Textures = 0;
+	unsigned int Requested = 0;		// Asked for this frame
+	unsigned int Starved = 0;		// Requested, but less detail than wanted is resident
+	unsigned int Loading = 0;		// Loads in flight
+	size_t ResidentBytes = 0;
+	size_t PendingBytes = 0;		// Still being loaded (already counted against the budget)
+	size_t BudgetBytes = 0;
+
+	// Since the start
+	unsigned int Loads = 0;
+	unsigned int Evictions = 0;
+	size_t BytesLoaded = 0;
+	size_t BytesEvicted = 0;
+};
+
+// --------------------------------------------------------
+// Decides which mips of streamed textures should be in
+// memory, without touching any files or the GPU (see
+// TextureStreamer for that), so it can run on its own.
+//
+// Every frame each visible user of a texture requests the
+// mip it needs on screen (see MipForDistance()) and
+// Update() works out:
+//  - Loads, finest wanted detail first, for textures with
+//    less detail resident than requested
+//  - Evictions to make room under the budget, least
+//    recently requested textures first.  Textures nobody
+//    asked for drop to their tail, requested ones only to
+//    the mip they asked for.
+//
+// Mips no bigger than tailSize are always resident, so
+// there's always something to sample.  Loads stay in
+// flight until FinishLoad() and count against the budget
+// from the moment they start.
+// --------------------------------------------------------
+class TextureResidency
+{
+public:
+	TextureResidency(size_t budgetBytes, unsigned int tailSize = 128);
+
+	// Only the size, mip count and format of the layout are used
+	unsigned int Add(const DdsImage& layout);
+
+	// Per frame (any number of times per texture, the finest mip wins)
+	void Request(unsigned int texture, unsigned int mip);
+	void Update(std::vector<MipChange>& evictions, std::vector<MipChange>& loads);
+	void FinishLoad(unsigned int texture, bool loaded = true);	// Not loaded = read failed
+
+	// Mip whose texels are about the size of a pixel, for a surface
+	// with uvPerUnit UV units per world unit seen from distance away
+	static float MipForDistance(float textureSize, float uvPerUnit, float distance, float tanHalfFov, float screenHeight);
+
+	// Getters
+	unsigned int GetTextureCount() const;
+	unsigned int GetResidentMip(unsigned int texture) const;
+	unsigned int GetTailMip(unsigned int texture) const;
+	unsigned int GetWantedMip(unsigned int texture) const;	// From the last Update()
+	bool IsLoading(unsigned int texture) const;
+	size_t GetBytes(unsigned int texture, unsigned int fromMip) const;
+	const DdsImage& GetLayout(unsigned int texture) const;
+	const TextureResidencyStats& GetStats() const;
+
+	size_t GetBudget() const;
+	void SetBudget(size_t budgetBytes);
+
+	unsigned int maxLoadsInFlight;
+
+private:
+	struct Texture
+	{
+		DdsImage Layout;			// No data
+		std::vector<size_t> Bytes;	// From each mip to the end, plus 0
+		unsigned int TailMip = 0;
+		unsigned int ResidentMip = 0;
+		unsigned int LoadMip = 0;	// Where the load in flight goes
+		unsigned int RequestedMip = 0;
+		unsigned int WantedMip = 0;
+		uint64_t LastRequested = 0;	// Frame
+		bool Requested = false;
+		bool Loading = false;
+	};
+
+	size_t Committed() const;
+	bool Evict(unsigned int keep, size_t needed, std::vector<MipChange>& evictions);
+
+	std::vector<Texture> textures;
+	size_t budgetBytes;
+	unsigned int tailSize;
+	uint64_t frame;
+	TextureResidencyStats stats;
+};
@@ -0,0 +1,223 @@
+#include "TextureStreamer.h"
+#include "Graphics.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+
+using namespace DirectX;
+
+TextureStreamer::TextureStreamer(size_t budgetBytes, unsigned int tailSize) :
+	mipBias(0.0f),
+	residency(budgetBytes, tailSize)
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	// Reads in flight write into buffers they share, but don't leave them running
+	for (Streamed& s : streamed)
+		JobSystem::Wait(*s.Read);
+}
+
+int TextureStreamer::Add(const std::wstring& ddsPath)
+{
+	std::ifstream file(std::filesystem::path(ddsPath), std::ios::binary | std::ios::ate);
+	if (!file)
+		return -1;
+	size_t fileSize = (size_t)file.tellg();
+
+	uint8_t header[DdsFile::HeaderSize];
+	file.seekg(0);
+	file.read((char*)header, sizeof(header));
+	DdsImage layout;
+	size_t dataOffset = 0;
+	if (!file || !DdsFile::ReadHeader(header, sizeof(header), layout, dataOffset) ||
+		fileSize < dataOffset + layout.MipOffset(layout.MipLevels))
+		return -1;
+
+	int index = (int)residency.Add(layout);
+	Streamed s;
+	s.Path = ddsPath;
+	s.DataOffset = dataOffset;
+	s.Read = std::make_unique<JobCounter>();
+	streamed.push_back(std::move(s));
+
+	// Only the tail for now, the rest streams in when it's needed
+	unsigned int tail = residency.GetTailMip(index);
+	std::vector<uint8_t> tailData(layout.MipOffset(layout.MipLevels) - layout.MipOffset(tail));
+	file.seekg(dataOffset + layout.MipOffset(tail));
+	file.read((char*)tailData.data(), tailData.size());
+	Rebuild(index, layout.MipLevels, tail, tailData.data());
+	return index;
+}
+
+void TextureStreamer::BindMaterial(std::shared_ptr<Material> material)
+{
+	bool bound = false;
+	for (auto& [name, srv] : material->GetTextureShaderResourceViewMap())
+	{
+		for (int i = 0; i < (int)streamed.size(); i++)
+		{
+			if (srv && streamed[i].SRV == srv)
+			{
+				bindings.push_back({ material.get(), name, i });
+				bound = true;
+			}
+		}
+	}
+
+	// Keeps the material alive as long as bindings point at it
+	if (bound)
+		materials.push_back(material);
+}
+
+void TextureStreamer::RequestForEntity(Entity& entity, Camera& camera, float screenHeight)
+{
+	Material* material = entity.GetMaterial().get();
+	std::shared_ptr<Mesh> mesh = entity.GetMesh();
+
+	// Closest the bounding sphere gets to the camera
+	const BoundingBox& bounds = entity.GetWorldBounds();
+	XMFLOAT3 position = camera.GetTransform().GetPosition();
+	float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Extents)));
+	float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Center) - XMLoadFloat3(&position))) - radius;
+	float tanHalfFov = tanf(camera.GetFOV() * 0.5f);
+
+	// UV units per world unit: the mesh's, tiled by the material and stretched by the entity
+	XMFLOAT3 scale = entity.GetTransform().GetScale();
+	XMFLOAT2 uvScale = material->GetUvScale();
+	float worldScale = (std::max)({ fabsf(scale.x), fabsf(scale.y), fabsf(scale.z), 0.0001f });
+	float uvPerUnit = mesh->GetUVDensity() * (std::max)(uvScale.x, uvScale.y) / worldScale;
+
+	for (const Binding& binding : bindings)
+	{
+		if (binding.Owner != material)
+			continue;
+
+		const DdsImage& layout = residency.GetLayout(binding.Texture);
+		float size = (float)(std::max)(layout.Width, layout.Height);
+		float mip = TextureResidency::MipForDistance(size, uvPerUnit, distance, tanHalfFov, screenHeight) + mipBias;
+		mip = std::clamp(mip, 0.0f, (float)(layout.MipLevels - 1));
+		residency.Request(binding.Texture, (unsigned int)mip);
+	}
+}
+
+void TextureStreamer::Update()
+{
+	PROFILE_SCOPE("TextureStreamer::Update");
+
+	// Upload whatever has been read
+	for (int i = 0; i < (int)streamed.size(); i++)
+	{
+		Streamed& s = streamed[i];
+		if (!residency.IsLoading(i) || s.Read->pending.load(std::memory_order_acquire) > 0)
+			continue;
+
+		const DdsImage& layout = residency.GetLayout(i);
+		unsigned int from = residency.GetResidentMip(i);
+		bool read = s.ReadData->size() == layout.MipOffset(from) - layout.MipOffset(s.ReadMip);
+		if (read)
+			Rebuild(i, from, s.ReadMip, s.ReadData->data());
+		residency.FinishLoad(i, read);
+		s.ReadData.reset();
+	}
+
+	// Nothing can ask for detail on textures no material was bound
+	// to (particles, ...), so those always get everything
+	for (int i = 0; i < (int)streamed.size(); i++)
+		if (std::none_of(bindings.begin(), bindings.end(), [i](const Binding& binding) { return binding.Texture == i; }))
+			residency.Request(i, 0);
+
+	// Drop first so there's room, then start reading
+	residency.Update(evictions, loads);
+	for (const MipChange& eviction : evictions)
+		Rebuild(eviction.Texture, eviction.FromMip, eviction.ToMip, 0);
+
+	for (const MipChange& load : loads)
+	{
+		Streamed& s = streamed[load.Texture];
+		const DdsImage& layout = residency.GetLayout(load.Texture);
+		size_t offset = s.DataOffset + layout.MipOffset(load.ToMip);
+		size_t size = layout.MipOffset(load.FromMip) - layout.MipOffset(load.ToMip);
+		std::wstring path = s.Path;
+		std::shared_ptr<std::vector<uint8_t>> data = std::make_shared<std::vector<uint8_t>>();
+
+		s.ReadMip = load.ToMip;
+		s.ReadData = data;
+		JobSystem::Run(*s.Read, [path, offset, size, data]() {
+			PROFILE_SCOPE("TextureStreamer::Read");
+			std::ifstream file(std::filesystem::path(path), std::ios::binary);
+			file.seekg(offset);
+			data->resize(size);
+			file.read((char*)data->data(), size);
+			if (!file)
+				data->clear();
+		});
+	}
+}
+
+// Makes the texture again starting at a different mip.  Mips it
+// already had are copied on the GPU, new ones come from newMips
+// (every mip from topMip up to the old top mip, finest first).
+void TextureStreamer::Rebuild(int texture, unsigned int fromMip, unsigned int topMip, const uint8_t* newMips)
+{
+	Streamed& s = streamed[texture];
+	const DdsImage& layout = residency.GetLayout(texture);
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = layout.MipWidth(topMip);
+	desc.Height = layout.MipHeight(topMip);
+	desc.MipLevels = layout.MipLevels - topMip;
+	desc.ArraySize = 1;
+	desc.Format = (DXGI_FORMAT)layout.Format;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> rebuilt;
+	Graphics::Device->CreateTexture2D(&desc, 0, rebuilt.GetAddressOf());
+	if (!rebuilt)
+		return;
+
+	for (unsigned int mip = topMip; mip < layout.MipLevels; mip++)
+	{
+		if (mip < fromMip)
+			Graphics::Renderer->UpdateSubresource(rebuilt.Get(), mip - topMip,
+				newMips + layout.MipOffset(mip) - layout.MipOffset(topMip),
+				(unsigned int)layout.MipRowPitch(mip), layout.MipSize(mip));
+		else if (s.Texture)
+			Graphics::Renderer->CopySubresourceRegion(rebuilt.Get(), mip - topMip, s.Texture.Get(), mip - fromMip);
+	}
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	Graphics::Device->CreateShaderResourceView(rebuilt.Get(), 0, srv.GetAddressOf());
+	s.Texture = rebuilt;
+	s.SRV = srv;
+
+	for (const Binding& binding : bindings)
+		if (binding.Texture == texture)
+			binding.Owner->AddTextureSRV(binding.Name, srv);
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> TextureStreamer::GetSRV(int texture)
+{
+	return streamed[texture].SRV;
+}
+
+Microsoft::WRL::ComPtr<ID3D11Texture2D> TextureStreamer::GetTexture(int texture)
+{
+	return streamed[texture].Texture;
+}
+
+const std::wstring& TextureStreamer::GetPath(int texture)
+{
+	return streamed[texture].Path;
+}
+
+TextureResidency& TextureStreamer::GetResidency()
+{
+	return residency;
+}
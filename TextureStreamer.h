@@ -0,0 +1,89 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Camera.h"
+#include "Entity.h"
+#include "JobSystem.h"
+#include "Material.h"
+#include "TextureResidency.h"
+
+// --------------------------------------------------------
+// Streams the mips of cooked (.dds) textures in and out
+// under a memory budget, using TextureResidency to decide
+// what should be resident.
+//
+// Add() only reads a texture's small tail mips.  Each
+// frame visible entities request the mip their materials'
+// textures need at their distance (from the mesh's UV
+// density, the material's UV scale and the entity's
+// scale), and Update() reads the missing mips as jobs,
+// uploads them once they're read and drops mips to make
+// room.  Either way the texture is recreated with its new
+// top mip (keeping the mips it already had on the GPU) and
+// handed to every material that uses it.  Textures no
+// material was bound to always want every mip.
+//
+// Usage:
+//   Add() -> BindMaterial() -> every frame:
+//   RequestForEntity() ... -> Update()
+// --------------------------------------------------------
+class TextureStreamer
+{
+public:
+	TextureStreamer(size_t budgetBytes, unsigned int tailSize = 128);
+	~TextureStreamer();
+
+	// Returns -1 if the file can't be read (or isn't a DDS file)
+	int Add(const std::wstring& ddsPath);
+
+	// Finds which of the material's textures are streamed, so
+	// they can be swapped when their mips change
+	void BindMaterial(std::shared_ptr<Material> material);
+
+	// Per frame
+	void RequestForEntity(Entity& entity, Camera& camera, float screenHeight);
+	void Update();
+
+	// Getters
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetSRV(int texture);
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> GetTexture(int texture);
+	const std::wstring& GetPath(int texture);
+	TextureResidency& GetResidency();
+
+	float mipBias;	// Added to every requested mip (positive = blurrier)
+
+private:
+	struct Streamed
+	{
+		std::wstring Path;
+		size_t DataOffset = 0;	// Where the mips start in the file
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> Texture;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SRV;
+
+		// Mips being read by a job, finest first
+		std::unique_ptr<JobCounter> Read;
+		std::shared_ptr<std::vector<uint8_t>> ReadData;
+		unsigned int ReadMip = 0;
+	};
+
+	struct Binding
+	{
+		Material* Owner;
+		std::string Name;
+		int Texture;
+	};
+
+	void Rebuild(int texture, unsigned int fromMip, unsigned int topMip, const uint8_t* newMips);
+
+	TextureResidency residency;
+	std::vector<Streamed> streamed;
+	std::vector<Binding> bindings;
+	std::vector<std::shared_ptr<Material>> materials;
+	std::vector<MipChange> evictions;
+	std::vector<MipChange> loads;
+};
@@ -53,6 +53,29 @@ HWND Window::Handle() { return windowHandle; }
 bool Window::HasFocus() { return hasFocus; }
 bool Window::IsMinimized() { return isMinimized; }
 
+// --------------------------------------------------------
+// Sets up window details without an OS-level window, for
+// headless runs.  The handle stays null and the title bar
+// stats are never shown.
+// 
+// width  - Pretend width of the window
+// height - Pretend height of the window
+// --------------------------------------------------------
+HRESULT Window::CreateHeadless(unsigned int width, unsigned int height)
+{
+	// Verify
+	if (windowCreated)
+		return E_FAIL;
+
+	windowWidth = width;
+	windowHeight = height;
+	windowStats = false;
+	hasFocus = true;
+
+	windowCreated = true;
+	return S_OK;
+}
+
 // --------------------------------------------------------
 // Creates the actual window for our application
 // 